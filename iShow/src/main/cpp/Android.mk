@@ -41,17 +41,23 @@ STASM_SOURCE := \
 	$(THIS_PATH)/stasm/MOD_1/initasm.cpp   \
 
 VENUS_SOURCE := \
+	$(THIS_PATH)/venus/AdjustmentChain.cpp \
 	$(THIS_PATH)/venus/Beauty.cpp          \
 	$(THIS_PATH)/venus/blend.cpp           \
 	$(THIS_PATH)/venus/blur.cpp            \
 	$(THIS_PATH)/venus/colorspace.cpp      \
 	$(THIS_PATH)/venus/Effect.cpp          \
+	$(THIS_PATH)/venus/FaceTracker.cpp     \
 	$(THIS_PATH)/venus/Feature.cpp         \
 	$(THIS_PATH)/venus/ImageWarp.cpp       \
 	$(THIS_PATH)/venus/inpaint.cpp         \
+	$(THIS_PATH)/venus/LandmarkFilter.cpp  \
 	$(THIS_PATH)/venus/Makeup.cpp          \
+	$(THIS_PATH)/venus/MakeupSession.cpp   \
+	$(THIS_PATH)/venus/MaskCache.cpp       \
 	$(THIS_PATH)/venus/opencv_utility.cpp  \
 	$(THIS_PATH)/venus/Region.cpp          \
+	$(THIS_PATH)/venus/ThreadPool.cpp      \
 
 PLATFORM_SOURCE := \
 	$(THIS_PATH)/platform/com_cloudream_ishow_algorithm_Effect.cpp   \
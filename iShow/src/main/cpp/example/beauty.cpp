@@ -28,6 +28,9 @@ void detectSkin(const cv::Mat& image)
 	Mat mask_hsv = Beauty::calculateSkinRegion_HSV(image);
 	TIME_STOP("calculateSkinRegion_HSV");
 
+	Mat mask_models = Beauty::calculateSkinRegion(image, Beauty::SKIN_RGB | Beauty::SKIN_YCbCr);
+	TIME_STOP("calculateSkinRegion");
+
 	// How about combining two methods?
 	Mat mask_combined;
 	double weight = 0.72;
@@ -39,6 +42,7 @@ void detectSkin(const cv::Mat& image)
 	cv::imshow("mask_ycbcr",    mask_ycbcr);
 	cv::imshow("mask_hsv",      mask_hsv);
 	cv::imshow("mask_combined", mask_combined);
+	cv::imshow("mask_models",   mask_models);
 	cv::waitKey();
 }
 
@@ -0,0 +1,590 @@
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "example/benchmark.h"
+#include "stasm/stasm.h"
+#include "venus/blend.h"
+#include "venus/blur.h"
+#include "venus/Effect.h"
+#include "venus/FaceTracker.h"
+#include "venus/Feature.h"
+#include "venus/inpaint.h"
+#include "venus/LandmarkFilter.h"
+#include "venus/Makeup.h"
+#include "venus/MaskCache.h"
+#include "venus/scalar.h"
+
+using namespace cv;
+
+// Run func over all positions, return descriptors per second.
+template <typename Func>
+static double descPerSecond(const std::vector<Point>& positions, int repeat, Func func)
+{
+	int64 start = getTickCount();
+	for(int r = 0; r < repeat; ++r)
+		for(const Point& pt : positions)
+			func(pt);
+	double seconds = static_cast<double>(getTickCount() - start) / getTickFrequency();
+	return positions.size() * repeat / seconds;
+}
+
+void benchmarkHatDesc(const cv::Mat& image)
+{
+	Mat gray;
+	if(image.channels() == 1)
+		gray = image;
+	else
+		cvtColor(image, gray, image.channels() == 4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+
+	const char* kernel = stasm::HatSimdKernel();
+	if(kernel == nullptr)
+	{
+		printf("benchmarkHatDesc: no SIMD HAT kernel for this CPU\n");
+		return;
+	}
+
+	stasm::Image img(gray);
+	const int patch_width = stasm::HAT_PATCH_WIDTH;
+
+	stasm::Hat scalar, simd;
+	scalar.Init_(img, patch_width, false);
+	simd.Init_(img, patch_width, true);
+
+	// sample the positions a search would visit, including some off the image border
+	std::vector<Point> positions;
+	const int margin = patch_width / 2;
+	for(int y = -margin; y < gray.rows + margin; y += stasm::HAT_SEARCH_RESOL)
+	for(int x = -margin; x < gray.cols + margin; x += stasm::HAT_SEARCH_RESOL)
+		positions.push_back(Point(x, y));
+
+	double max_diff = 0;
+	for(const Point& pt : positions)
+	{
+		const stasm::VEC a = scalar.Desc_(pt.x, pt.y);
+		const stasm::VEC b = simd.Desc_(pt.x, pt.y);
+		max_diff = std::max(max_diff, norm(a, b, NORM_INF));
+	}
+
+	const int repeat = 5;
+	volatile double sink = 0;  // keep the descriptors from being optimized away
+	double scalar_rate = descPerSecond(positions, repeat, [&](const Point& pt) { sink = sink + scalar.Desc_(pt.x, pt.y)(0); });
+	double simd_rate   = descPerSecond(positions, repeat, [&](const Point& pt) { sink = sink + simd.Desc_(pt.x, pt.y)(0); });
+
+	printf("HAT descriptors, %dx%d image, %d positions x %d\n", gray.cols, gray.rows, static_cast<int>(positions.size()), repeat);
+	printf("  scalar: %10.0f desc/s\n", scalar_rate);
+	printf("  %-6s: %10.0f desc/s (%.2fx)\n", kernel, simd_rate, simd_rate / scalar_rate);
+	printf("  max element difference: %g (descriptor L2 norm is 10)\n", max_diff);
+}
+
+// The brute-force selective blur that venus::gaussianBlurSelective used before, as reference.
+static void gaussianBlurSelectiveReference(Mat& dst, const Mat& src, const Mat& mask, float radius, float tolerance)
+{
+	const int R = cvRound(radius);
+	src.copyTo(dst);
+	const int channel = src.channels();
+
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+	for(int c = 0; c < src.cols; ++c)
+	{
+		if(mask.at<uchar>(r, c) == 0)
+			continue;
+
+		const uchar* center = src.ptr<uchar>(r) + c * channel;
+		double accumulated[3] = {0, 0, 0}, count[3] = {0, 0, 0};
+		for(int y = std::max(r - R, 0); y <= std::min(r + R, src.rows - 1); ++y)
+		for(int x = std::max(c - R, 0); x <= std::min(c + R, src.cols - 1); ++x)
+		{
+			const float weight = std::exp(-0.5F * ((y - r)*(y - r) + (x - c)*(x - c)) / radius);
+			const uchar* around = src.ptr<uchar>(y) + x * channel;
+			for(int m = 0; m < 3; ++m)
+				if(std::abs(center[m] - around[m]) <= tolerance)
+				{
+					accumulated[m] += weight * around[m];
+					count[m] += weight;
+				}
+		}
+
+		uchar* target = dst.ptr<uchar>(r) + c * channel;
+		for(int m = 0; m < 3; ++m)
+			target[m] = saturate_cast<uchar>(accumulated[m] / count[m]);
+	}
+}
+
+void benchmarkSelectiveBlur(const cv::Mat& image, const cv::Mat& mask, float radius, float tolerance)
+{
+	CV_Assert(image.depth() == CV_8U && image.channels() >= 3 && mask.type() == CV_8UC1);
+
+	Mat fast, reference;
+	venus::gaussianBlurSelective(fast, image, mask, radius, tolerance);  // warm up
+
+	const int runs = 5;
+	int64 start = getTickCount();
+	for(int r = 0; r < runs; ++r)
+		venus::gaussianBlurSelective(fast, image, mask, radius, tolerance);
+	double fast_ms = (getTickCount() - start) * 1000.0 / getTickFrequency() / runs;
+
+	start = getTickCount();
+	gaussianBlurSelectiveReference(reference, image, mask, radius, tolerance);
+	double reference_ms = (getTickCount() - start) * 1000.0 / getTickFrequency();
+
+	// only the first 3 channels are blurred, the others are copied and add no error
+	const int masked = countNonZero(mask);
+	double mse = masked > 0 ? norm(fast, reference, NORM_L2SQR, mask) / (masked * 3) : 0;
+	double psnr = mse > 0 ? 10 * std::log10(255 * 255 / mse) : std::numeric_limits<double>::infinity();
+	double max_diff = norm(fast, reference, NORM_INF, mask);
+
+	printf("selective gaussian blur, %dx%d image, radius %g, tolerance %g, %d masked pixels\n",
+			image.cols, image.rows, radius, tolerance, masked);
+	printf("  brute force: %10.1f ms\n", reference_ms);
+	printf("  separable  : %10.1f ms (%.1fx)\n", fast_ms, reference_ms / fast_ms);
+	printf("  PSNR %.2f dB, max difference %g\n", psnr, max_diff);
+}
+
+// milliseconds per call of func
+template <typename Func>
+static double millisecondsPerCall(int runs, Func func)
+{
+	func();  // warm up
+	int64 start = getTickCount();
+	for(int r = 0; r < runs; ++r)
+		func();
+	return (getTickCount() - start) * 1000.0 / getTickFrequency() / runs;
+}
+
+void benchmarkMapColor(const cv::Mat& image)
+{
+	CV_Assert(image.depth() == CV_8U);
+	Mat src;
+	switch(image.channels())
+	{
+	case 1:  cvtColor(image, src, COLOR_GRAY2BGRA); break;
+	case 3:  cvtColor(image, src, COLOR_BGR2BGRA);  break;
+	default: src = image;                           break;
+	}
+
+	uint8_t table[256];
+	for(int i = 0; i < 256; ++i)
+		table[i] = saturate_cast<uchar>(std::pow(i / 255.0, 0.8) * 255.0);
+
+	Mat mask(src.size(), CV_8UC1);
+	randu(mask, Scalar(0), Scalar(256));
+
+	// the loops mapColor used before, with mask indexed by pixel
+	auto reference = [&](Mat& dst, const uchar* weights)
+	{
+		dst.create(src.size(), src.type());
+		const int length = src.rows * src.cols * 4;
+		const uchar* src_data = src.data;
+		uchar* dst_data = dst.data;
+
+		#pragma omp parallel for
+		for(int i = 0; i < length; i += 4)
+		{
+			for(int k = 0; k < 3; ++k)
+				dst_data[i + k] = weights == nullptr ? table[src_data[i + k]] :
+						venus::lerp(src_data[i + k], table[src_data[i + k]], weights[i / 4]);
+			dst_data[i + 3] = src_data[i + 3];
+		}
+	};
+
+	Mat expected, actual;
+	const int runs = 10;
+	double plain_ms = millisecondsPerCall(runs, [&]() { reference(expected, nullptr); });
+	double fast_ms  = millisecondsPerCall(runs, [&]() { venus::Effect::mapColor(actual, src, table); });
+	double plain_diff = norm(expected, actual, NORM_INF);
+
+	double plain_masked_ms = millisecondsPerCall(runs, [&]() { reference(expected, mask.data); });
+	double fast_masked_ms  = millisecondsPerCall(runs, [&]() { venus::Effect::mapColor(actual, src, mask, table); });
+	double masked_diff = norm(expected, actual, NORM_INF);
+
+	printf("Effect::mapColor, %dx%d 4 channel image, %s kernel\n", src.cols, src.rows, venus::Effect::mapColorKernel());
+	printf("  unmasked: %8.2f ms -> %8.2f ms (%.2fx), max difference %g\n", plain_ms, fast_ms, plain_ms / fast_ms, plain_diff);
+	printf("  masked  : %8.2f ms -> %8.2f ms (%.2fx), max difference %g\n", plain_masked_ms, fast_masked_ms, plain_masked_ms / fast_masked_ms, masked_diff);
+}
+
+void benchmarkColorAdjustment(const cv::Mat& image)
+{
+	CV_Assert(image.depth() == CV_8U);
+	Mat src;
+	switch(image.channels())
+	{
+	case 1:  cvtColor(image, src, COLOR_GRAY2BGRA); break;
+	case 3:  cvtColor(image, src, COLOR_BGR2BGRA);  break;
+	default: src = image;                           break;
+	}
+
+	const Vec3f config[3] = { Vec3f(0.3F, -0.2F, 0.1F), Vec3f(-0.5F, 0.4F, 0.0F), Vec3f(0.2F, 0.2F, -0.6F) };
+
+	// the float path is the reference, it's what 8-bit images went through before
+	auto viaFloat = [&](Mat& dst, const std::function<void(Mat&, const Mat&)>& adjust)
+	{
+		Mat src_float, dst_float;
+		src.convertTo(src_float, CV_32F, 1 / 255.0);
+		adjust(dst_float, src_float);
+		dst_float.convertTo(dst, CV_8U, 255.0);
+	};
+
+	auto report = [&](const char* name, const std::function<void(Mat&, const Mat&)>& adjust)
+	{
+		Mat expected, actual;
+		const int runs = 5;
+		double float_ms = millisecondsPerCall(runs, [&]() { viaFloat(expected, adjust); });
+		double fixed_ms = millisecondsPerCall(runs, [&]() { adjust(actual, src); });
+
+		Mat diff;
+		absdiff(expected, actual, diff);
+		const int off = countNonZero(diff.reshape(1) > 1);
+		printf("  %-24s: %8.2f ms -> %8.2f ms (%.2fx), max difference %g, %d values off by more than 1\n",
+				name, float_ms, fixed_ms, float_ms / fixed_ms, norm(diff, NORM_INF), off);
+	};
+
+	printf("Effect color adjustments, %dx%d 4 channel image, float path vs 8-bit path\n", src.cols, src.rows);
+	report("adjustHueSaturation", [](Mat& out, const Mat& in) { venus::Effect::adjustHueSaturation(out, in, 0.1F, 1.3F, 0.2F); });
+	report("adjustColorBalance", [&](Mat& out, const Mat& in) { venus::Effect::adjustColorBalance(out, in, config, false); });
+	report("adjustColorBalance (L)", [&](Mat& out, const Mat& in) { venus::Effect::adjustColorBalance(out, in, config, true); });
+}
+
+void benchmarkBlend(const cv::Mat& image)
+{
+	CV_Assert(image.depth() == CV_8U);
+	Mat dst3, dst4;
+	switch(image.channels())
+	{
+	case 1:  cvtColor(image, dst3, COLOR_GRAY2BGR);  break;
+	case 3:  dst3 = image;                           break;
+	default: cvtColor(image, dst3, COLOR_BGRA2BGR);  break;
+	}
+	cvtColor(dst3, dst4, COLOR_BGR2BGRA);
+
+	// a cosmetic like layer, opaque in an ellipse and fully transparent around it
+	Mat layer(dst3.rows / 2, dst3.cols / 2, CV_8UC4);
+	randu(layer, Scalar::all(0), Scalar::all(256));
+	Mat alpha(layer.size(), CV_8UC1, Scalar(0));
+	ellipse(alpha, Point(layer.cols / 2, layer.rows / 2), Size(layer.cols / 3, layer.rows / 3), 0, 0, 360, Scalar(255), -1);
+	GaussianBlur(alpha, alpha, Size(0, 0), layer.cols / 40.0 + 1);
+	int from_to[] = { 0, 3 };
+	mixChannels(&alpha, 1, &layer, 1, from_to, 1);
+
+	const Point origin(dst3.cols / 4, dst3.rows / 4);
+	const float amount = 0.8F;
+
+	// the per pixel loop Makeup::blend used before
+	auto reference = [&](Mat& result, const Mat& dst)
+	{
+		dst.copyTo(result);
+		for(int r = 0; r < layer.rows; ++r)
+		for(int c = 0; c < layer.cols; ++c)
+		{
+			const Vec4b& src_color = layer.at<Vec4b>(r, c);
+			if(result.type() == CV_8UC3)
+			{
+				Vec3b& dst_color = result.at<Vec3b>(r + origin.y, c + origin.x);
+				dst_color = venus::mix(dst_color, *reinterpret_cast<const Vec3b*>(&src_color), src_color[3]/255.0F * amount);
+			}
+			else
+			{
+				Vec4b& dst_color = result.at<Vec4b>(r + origin.y, c + origin.x);
+				dst_color = venus::mix(dst_color, src_color, amount);
+			}
+		}
+	};
+
+	printf("Makeup::blend, %dx%d layer on %dx%d image\n", layer.cols, layer.rows, dst3.cols, dst3.rows);
+	const Mat* targets[] = { &dst3, &dst4 };
+	for(const Mat* dst : targets)
+	{
+		Mat expected, actual;
+		const int runs = 10;
+		double plain_ms = millisecondsPerCall(runs, [&]() { reference(expected, *dst); });
+		double fast_ms  = millisecondsPerCall(runs, [&]() { venus::Makeup::blend(actual, *dst, layer, origin, amount); });
+		double diff = norm(expected, actual, NORM_INF);
+		printf("  %d channel: %8.2f ms -> %8.2f ms (%.2fx), max difference %g\n", dst->channels(), plain_ms, fast_ms, plain_ms / fast_ms, diff);
+	}
+}
+
+void benchmarkBlendLayers(const cv::Mat& image)
+{
+	CV_Assert(image.depth() == CV_8U);
+	Mat base;
+	switch(image.channels())
+	{
+	case 1:  cvtColor(image, base, COLOR_GRAY2BGR); break;
+	case 4:  cvtColor(image, base, COLOR_BGRA2BGR); break;
+	default: base = image;                          break;
+	}
+
+	Mat layer;
+	GaussianBlur(base, layer, Size(0, 0), 8.0);
+	layer = Scalar::all(255) - layer;
+	const float opacity = 0.7F;
+
+	// per pixel blending through a function pointer, like blendAlphaF() does
+	auto reference = [&](Mat& dst, uint8_t (*blend)(uint8_t, uint8_t))
+	{
+		dst.create(base.size(), base.type());
+		const int length = base.rows * base.cols * 3;
+		for(int i = 0; i < length; ++i)
+			dst.data[i] = venus::lerp(base.data[i], blend(base.data[i], layer.data[i]), opacity);
+	};
+
+	struct Case
+	{
+		const char* name;
+		venus::BlendMode mode;
+		uint8_t (*blend)(uint8_t, uint8_t);
+	};
+	const Case cases[] =
+	{
+		{ "multiply",    venus::BlendMode::MULTIPLY,    venus::blendMultiply   },
+		{ "overlay",     venus::BlendMode::OVERLAY,     venus::blendOverlay    },
+		{ "soft light",  venus::BlendMode::SOFT_LIGHT,  venus::blendSoftLight  },
+		{ "color dodge", venus::BlendMode::COLOR_DODGE, venus::blendColorDodge },
+	};
+
+	printf("venus::blendLayers, %dx%d 3 channel image\n", base.cols, base.rows);
+	for(const Case& c : cases)
+	{
+		Mat expected, actual;
+		const int runs = 10;
+		double plain_ms = millisecondsPerCall(runs, [&]() { reference(expected, c.blend); });
+		double fast_ms  = millisecondsPerCall(runs, [&]() { venus::blendLayers(actual, base, layer, c.mode, opacity); });
+		double diff = norm(expected, actual, NORM_INF);
+		printf("  %-11s: %8.2f ms -> %8.2f ms (%.2fx), max difference %g\n", c.name, plain_ms, fast_ms, plain_ms / fast_ms, diff);
+	}
+
+	Mat hue;
+	double hue_ms = millisecondsPerCall(3, [&]() { venus::blendLayers(hue, base, layer, venus::BlendMode::HUE, opacity); });
+	printf("  %-11s: %8.2f ms\n", "hue", hue_ms);
+}
+
+void benchmarkMaskCache(const cv::Mat& image)
+{
+	// a blush like polygon, which stays still while the color and amount sliders move
+	const Point2f center(image.cols / 2.0F, image.rows / 2.0F);
+	const std::vector<Point2f> polygon = venus::Makeup::createHeartPolygon(center, std::min(image.cols, image.rows) / 4.0F);
+	const Rect rect = boundingRect(polygon);
+
+	venus::MaskCache cache;
+	const int runs = 50;
+	Mat expected, actual;
+	double plain_ms = millisecondsPerCall(runs, [&]() { expected = venus::Feature::maskPolygonSmooth(rect, polygon, 8); });
+	double cache_ms = millisecondsPerCall(runs, [&]() { actual = cache.maskPolygonSmooth(rect, polygon, 8); });
+	double diff = norm(expected, actual, NORM_INF);
+
+	venus::MaskCache::Statistics statistics = cache.getStatistics();
+	printf("MaskCache, %dx%d smooth polygon mask\n", rect.width, rect.height);
+	printf("  %8.3f ms -> %8.3f ms (%.2fx), max difference %g\n", plain_ms, cache_ms, plain_ms / cache_ms, diff);
+	printf("  hits %zu, misses %zu, evictions %zu, %zu masks in %zu bytes\n", statistics.hits, statistics.misses,
+			statistics.evictions, statistics.count, statistics.bytes);
+}
+
+void benchmarkSoftMask(const cv::Mat& image)
+{
+	const Point2f center(image.cols / 2.0F, image.rows / 2.0F);
+	const std::vector<Point2f> polygon = venus::Makeup::createHeartPolygon(center, std::min(image.cols, image.rows) / 4.0F);
+
+	// fill then blur, which Feature::createMask did before
+	auto reference = [&](Mat& mask, float radius)
+	{
+		Rect rect = boundingRect(polygon);
+		rect.x -= cvCeil(radius);  rect.width  += 2 * cvCeil(radius);
+		rect.y -= cvCeil(radius);  rect.height += 2 * cvCeil(radius);
+		std::vector<Point> contour;
+		for(const Point2f& point : polygon)
+			contour.push_back(Point(cvRound(point.x), cvRound(point.y)) - rect.tl());
+		mask = Mat::zeros(rect.size(), CV_8UC1);
+		fillPoly(mask, std::vector<std::vector<Point>>{ contour }, Scalar(255));
+		venus::gaussianBlur(mask, mask, radius);
+	};
+
+	printf("Feature::createMask, feathered heart polygon\n");
+	const float radii[] = { 2.0F, 8.0F, 32.0F };
+	for(float radius : radii)
+	{
+		Mat expected, actual;
+		const int runs = 20;
+		double plain_ms = millisecondsPerCall(runs, [&]() { reference(expected, radius); });
+		double fast_ms  = millisecondsPerCall(runs, [&]() { actual = venus::Feature::createMask(polygon, radius); });
+		printf("  radius %4.1f: %8.3f ms -> %8.3f ms (%.2fx), %dx%d\n", radius, plain_ms, fast_ms, plain_ms / fast_ms, actual.cols, actual.rows);
+	}
+
+	const Rect rect = boundingRect(polygon);
+	const int levels[] = { 4, 8, 16 };
+	for(int level : levels)
+	{
+		const int runs = 20;
+		double ms = millisecondsPerCall(runs, [&]() { venus::Feature::maskPolygonSmooth(rect, polygon, level); });
+		printf("  maskPolygonSmooth level %2d: %8.3f ms\n", level, ms);
+	}
+}
+
+void benchmarkInpaint(const cv::Mat& image)
+{
+	Mat bgr;
+	switch(image.channels())
+	{
+	case 1:  cvtColor(image, bgr, COLOR_GRAY2BGR);  break;
+	case 3:  bgr = image;                           break;
+	default: cvtColor(image, bgr, COLOR_BGRA2BGR);  break;
+	}
+
+	// remove a blob in the middle
+	Mat target(bgr.size(), CV_8UC1, Scalar(0));
+	const int radius = std::min(bgr.cols, bgr.rows) / 16;
+	circle(target, Point(bgr.cols / 2, bgr.rows / 2), radius, Scalar(255), -1);
+
+	printf("Inpainter, r=%d hole in %dx%d image\n", radius, bgr.cols, bgr.rows);
+	const venus::Inpainter::Method methods[] = { venus::Inpainter::Method::EXEMPLAR, venus::Inpainter::Method::PATCH_MATCH };
+	const char* names[] = { "EXEMPLAR", "PATCH_MATCH" };
+	for(int i = 0; i < 2; ++i)
+	{
+		venus::Inpainter inpainter;
+		inpainter.setSourceImage(bgr);
+		inpainter.setTargetMask(target);
+		inpainter.setPatchSize(9);
+		inpainter.setMethod(methods[i]);
+
+		int steps = 0;
+		double ms = millisecondsPerCall(1, [&]()
+		{
+			inpainter.initialize();
+			while(inpainter.hasMoreSteps())
+			{
+				inpainter.step();
+				++steps;
+			}
+		});
+
+		// not a quality metric, only tells how far it's from the removed content
+		double error = norm(inpainter.image(), bgr, NORM_L1, target) / (countNonZero(target) * 3);
+		printf("  %-12s %10.2f ms, %d steps, mean difference from original %.2f\n", names[i], ms, steps, error);
+	}
+}
+
+void benchmarkFaceTracker(const cv::Mat& image, const std::string& classifier_dir)
+{
+	Mat gray;
+	switch(image.channels())
+	{
+	case 1:  gray = image;                           break;
+	case 3:  cvtColor(image, gray, COLOR_BGR2GRAY);  break;
+	default: cvtColor(image, gray, COLOR_BGRA2GRAY); break;
+	}
+
+	// drift around like a hand held phone, and jump once as if the face moved fast
+	constexpr int frame_count = 60;
+	std::vector<Mat> frames(frame_count);
+	for(int i = 0; i < frame_count; ++i)
+	{
+		double phase = 2 * CV_PI * i / 30;
+		double dx = 6 * std::sin(phase) + (i >= 40 ? gray.cols / 8 : 0);
+		double dy = 4 * std::cos(phase);
+		Matx23d shift(1, 0, dx, 0, 1, dy);
+		warpAffine(gray, frames[i], shift, gray.size(), INTER_LINEAR, BORDER_REPLICATE);
+	}
+
+	// frames must be processed in order, so only load the models before timing
+	venus::Feature::detectFace(frames[0], "warm up", classifier_dir);
+	std::vector<std::vector<Point2f>> detected(frame_count), tracked(frame_count);
+	int64 start = getTickCount();
+	for(int i = 0; i < frame_count; ++i)
+		detected[i] = venus::Feature::detectFace(frames[i], "detect", classifier_dir);
+	double detect_ms = (getTickCount() - start) * 1000.0 / getTickFrequency() / frame_count;
+
+	venus::FaceTracker tracker(classifier_dir);
+	start = getTickCount();
+	for(int i = 0; i < frame_count; ++i)
+		tracked[i] = tracker.track(frames[i]);
+	double track_ms = (getTickCount() - start) * 1000.0 / getTickFrequency() / frame_count;
+
+	double distance = 0;
+	int count = 0;
+	for(int i = 0; i < frame_count; ++i)
+		if(!detected[i].empty() && detected[i].size() == tracked[i].size())
+		{
+			for(size_t k = 0; k < detected[i].size(); ++k)
+				distance += norm(detected[i][k] - tracked[i][k]);
+			count += static_cast<int>(detected[i].size());
+		}
+
+	venus::FaceTracker::Statistics statistics = tracker.getStatistics();
+	printf("FaceTracker, %d frames of %dx%d\n", frame_count, gray.cols, gray.rows);
+	printf("  detectFace  %10.2f ms/frame\n", detect_ms);
+	printf("  track       %10.2f ms/frame, fine %d, full %d, detect %d\n", track_ms,
+			statistics.fine, statistics.full, statistics.detect);
+	printf("  mean distance from detected points %.2f px\n", count > 0 ? distance / count : 0.0);
+}
+
+void benchmarkLandmarkFilter(const cv::Mat& image, const std::string& classifier_dir)
+{
+	Mat gray;
+	switch(image.channels())
+	{
+	case 1:  gray = image;                           break;
+	case 3:  cvtColor(image, gray, COLOR_BGR2GRAY);  break;
+	default: cvtColor(image, gray, COLOR_BGRA2GRAY); break;
+	}
+
+	const std::vector<Point2f> face = venus::Feature::detectFace(gray, "filter", classifier_dir);
+	if(face.empty())
+	{
+		printf("LandmarkFilter, no face found\n");
+		return;
+	}
+
+	// ASM jitters about half a pixel, hold still for 2 seconds then move right at 100 pixels per second
+	constexpr int frame_count = 120, still_count = 60, settle_count = 10;
+	constexpr float fps = 30.0F, speed = 100.0F;
+	RNG rng(0);
+	venus::LandmarkFilter filter;
+	venus::MaskCache raw_cache, filtered_cache;  // lip masks as Makeup would make them
+	double raw_jitter = 0, filtered_jitter = 0, raw_lag = 0, filtered_lag = 0;
+	std::vector<Point2f> points(face.size()), previous_raw, previous_filtered;
+	for(int i = 0; i < frame_count; ++i)
+	{
+		const float shift = i < still_count ? 0.0F : (i - still_count) * speed / fps;
+		for(size_t k = 0; k < face.size(); ++k)
+			points[k] = face[k] + Point2f(shift + static_cast<float>(rng.gaussian(0.5)), static_cast<float>(rng.gaussian(0.5)));
+		const std::vector<Point2f>& filtered = filter.filter(points, i / fps);
+
+		for(bool upper : { true, false })
+		{
+			std::vector<Point2f> polygon = venus::Feature::calculateLipPolygon(points, upper);
+			raw_cache.maskPolygon(boundingRect(polygon), polygon);
+			polygon = venus::Feature::calculateLipPolygon(filtered, upper);
+			filtered_cache.maskPolygon(boundingRect(polygon), polygon);
+		}
+
+		if(0 < i && i < still_count)
+			for(size_t k = 0; k < face.size(); ++k)
+			{
+				raw_jitter += norm(points[k] - previous_raw[k]);
+				filtered_jitter += norm(filtered[k] - previous_filtered[k]);
+			}
+		else if(i >= still_count + settle_count)
+			for(size_t k = 0; k < face.size(); ++k)
+			{
+				raw_lag += face[k].x + shift - points[k].x;
+				filtered_lag += face[k].x + shift - filtered[k].x;
+			}
+
+		previous_raw = points;
+		previous_filtered = filtered;
+	}
+
+	const double still_points = (still_count - 1) * face.size();
+	const double moving_points = (frame_count - still_count - settle_count) * face.size();
+	printf("LandmarkFilter, %d frames still then %d moving at %.0f px/s\n", still_count, frame_count - still_count, speed);
+	printf("  %-8s %8s %8s %10s\n", "", "jitter", "lag", "mask hits");
+	printf("  %-8s %8.3f %8.3f %10zu\n", "raw", raw_jitter / still_points, raw_lag / moving_points,
+			raw_cache.getStatistics().hits);
+	printf("  %-8s %8.3f %8.3f %10zu\n", "filtered", filtered_jitter / still_points, filtered_lag / moving_points,
+			filtered_cache.getStatistics().hits);
+}
@@ -0,0 +1,101 @@
+#ifndef EXAMPLE_BENCHMARK_H_
+#define EXAMPLE_BENCHMARK_H_
+
+#include <string>
+
+#include <opencv2/core/mat.hpp>
+
+/**
+ * Compare descriptors per second of the SIMD HAT kernel against the scalar Hat::Desc_,
+ * and report the largest element difference between the two descriptors.
+ *
+ * @param[in] image  Any image, converted to grayscale internally.
+ */
+void benchmarkHatDesc(const cv::Mat& image);
+
+/**
+ * Time venus::gaussianBlurSelective, and compare its output with the brute-force 2D window
+ * filter it replaced, as PSNR and largest difference over the masked pixels.
+ *
+ * @param[in] image      CV_8UC3 or CV_8UC4 image.
+ * @param[in] mask       CV_8UC1 mask, e.g. a skin region.
+ * @param[in] radius     Blur radius.
+ * @param[in] tolerance  Range [0, 255].
+ */
+void benchmarkSelectiveBlur(const cv::Mat& image, const cv::Mat& mask, float radius, float tolerance);
+
+/**
+ * Compare venus::Effect::mapColor, masked and unmasked, against the plain table loops it replaced.
+ * Both run on the same OpenMP threads, set OMP_NUM_THREADS=1 for per core numbers.
+ *
+ * @param[in] image  Any 8-bit image, converted to 4 channels internally.
+ */
+void benchmarkMapColor(const cv::Mat& image);
+
+/**
+ * Compare the fixed-point 8-bit paths of venus::Effect::adjustHueSaturation and adjustColorBalance against
+ * their float paths, as time and difference in levels. Pixels that color balance maps to black or white while
+ * preserving luminosity may differ more, the float path turns round-off into a hue there.
+ *
+ * @param[in] image  Any 8-bit image, converted to 4 channels internally.
+ */
+void benchmarkColorAdjustment(const cv::Mat& image);
+
+/**
+ * Compare venus::Makeup::blend against the per pixel mix() loop it replaced, on 3 and 4 channel images, with a
+ * layer that is transparent outside an ellipse. Differences of 1 level come from the fixed-point amount.
+ *
+ * @param[in] image  Any 8-bit image.
+ */
+void benchmarkBlend(const cv::Mat& image);
+
+/**
+ * Compare venus::blendLayers against blending pixel by pixel through a function pointer, for a few blend modes.
+ * The 8-bit kernels differ from venus::lerp() by at most 1 level, which rounds opacity in float.
+ *
+ * @param[in] image  Any 8-bit image.
+ */
+void benchmarkBlendLayers(const cv::Mat& image);
+
+/**
+ * Compare venus::Feature::maskPolygonSmooth against venus::MaskCache on repeated calls with the same polygon,
+ * as happens when a slider re-renders a cosmetic, and print the cache statistics.
+ *
+ * @param[in] image  Any image, only its size is used.
+ */
+void benchmarkMaskCache(const cv::Mat& image);
+
+/**
+ * Time venus::Feature::createMask on the signed distance backend against fill then blur, for a few feather
+ * radii, and venus::Feature::maskPolygonSmooth for a few levels. The new timings barely depend on either.
+ *
+ * @param[in] image  Any image, only its size is used.
+ */
+void benchmarkSoftMask(const cv::Mat& image);
+
+/**
+ * Time venus::Inpainter with Method::EXEMPLAR and Method::PATCH_MATCH on a round hole in the middle of the image.
+ *
+ * @param[in] image  Any 8-bit image.
+ */
+void benchmarkInpaint(const cv::Mat& image);
+
+/**
+ * Time venus::FaceTracker against venus::Feature::detectFace on a simulated video, the image drifting a few pixels per
+ * frame and jumping once, and report how the tracker found the face and how far its points are from detection.
+ *
+ * @param[in] image           An image with a face.
+ * @param[in] classifier_dir  The classifiers directory.
+ */
+void benchmarkFaceTracker(const cv::Mat& image, const std::string& classifier_dir);
+
+/**
+ * Feed venus::LandmarkFilter with the points detected in an image plus noise, still and then moving, and report the
+ * jitter and lag of raw and filtered points, and the venus::MaskCache hits of lip masks made from each.
+ *
+ * @param[in] image           An image with a face.
+ * @param[in] classifier_dir  The classifiers directory.
+ */
+void benchmarkLandmarkFilter(const cv::Mat& image, const std::string& classifier_dir);
+
+#endif /* EXAMPLE_BENCHMARK_H_ */
@@ -1,9 +1,12 @@
 ﻿#include "example/beauty.h"
+#include "example/benchmark.h"
 #include "example/makeup.h"
 #include "example/utility.h"
 
 #include <opencv2/imgcodecs.hpp>
 
+#include "venus/Beauty.h"
+
 using namespace cv;
 using namespace venus;
 
@@ -39,5 +42,17 @@ int main()
 //	applyEyeLash(image_name);
 //	applyBrow(image_name);
 
+//	benchmarkHatDesc(image);
+//	benchmarkSelectiveBlur(image, Beauty::calculateSkinRegion_RGB(image), 15.0F, 12.0F);
+//	benchmarkMapColor(image);
+//	benchmarkColorAdjustment(image);
+//	benchmarkBlend(image);
+//	benchmarkBlendLayers(image);
+//	benchmarkMaskCache(image);
+//	benchmarkSoftMask(image);
+//	benchmarkInpaint(image);
+//	benchmarkFaceTracker(image, CLASSIFIER_DIR);
+//	benchmarkLandmarkFilter(image, CLASSIFIER_DIR);
+
 	return 0;
 }
\ No newline at end of file
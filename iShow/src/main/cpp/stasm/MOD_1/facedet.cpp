@@ -9,8 +9,6 @@
 namespace stasm
 {
 
-static cv::CascadeClassifier facedet_g;  // the face detector
-
 static const double BORDER_FRAC = 0.1; // fraction of image width or height
                                       // use 0.0 for no border
 
@@ -20,7 +18,7 @@ void FaceDetector::OpenFaceDetector_( // called by stasm_init, init face det fro
     const char* datadir,         // in: directory of face detector files
     void*)                       // in: unused (func signature compatibility)
 {
-    OpenDetector(facedet_g, "haarcascade_frontalface_alt2.xml",  datadir);
+    OpenDetector(facedet_, "haarcascade_frontalface_alt2.xml",  datadir);
 }
 
 // If a face is near the edge of the image, the OpenCV detectors tend to
@@ -41,12 +39,13 @@ static Image EnborderImg(    // return the image with a border
     return bordered_img;
 }
 
-void DetectFaces(          // all face rects into detpars
+static void DetectFaces(   // all face rects into detpars
     std::vector<DetectorParameter>&  detpars,  // out
+    cv::CascadeClassifier& facedet,  // in: the face detector
     const Image& img,      // in
     int          minwidth) // in: as percent of img width
 {
-    CV_Assert(!facedet_g.empty()); // check that OpenFaceDetector_ was called
+    CV_Assert(!facedet.empty()); // check that OpenFaceDetector_ was called
 
     int leftborder = 0, topborder = 0; // border size in pixels
     Image bordered_img(BORDER_FRAC == 0?
@@ -71,7 +70,7 @@ void DetectFaces(          // all face rects into detpars
     static const int    DETECTOR_FLAGS = 0;
 
     vec_Rect facerects = // all face rects in image
-        Detect(equalized_img, facedet_g, NULL,
+        Detect(equalized_img, facedet, NULL,
                SCALE_FACTOR, MIN_NEIGHBORS, DETECTOR_FLAGS, minpix);
 
     // copy face rects into the detpars vector
@@ -181,7 +180,7 @@ void FaceDetector::DetectFaces_( // call once per image to find all the faces
     void*        user)      // in: unused (match virt func signature)
 {
     CV_Assert(user == NULL);
-    DetectFaces(detpars_, img, minwidth);
+    DetectFaces(detpars_, facedet_, img, minwidth);
     char tracepath[SLEN];
     sprintf(tracepath, "%s_00_unsortedfacedet.bmp", Base(imgpath));
     TraceFaces(detpars_, img, tracepath);
@@ -218,4 +217,10 @@ const DetectorParameter FaceDetector::NextFace_(void)
     return detpar;
 }
 
+const DetectorParameter FaceDetector::Face_(int iface) const
+{
+    CV_Assert(iface >= 0 && iface < NSIZE(detpars_));
+    return detpars_[iface];
+}
+
 } // namespace stasm
@@ -33,9 +33,20 @@ public:
 
     const DetectorParameter NextFace_(void); // get next face from faces found by DetectFaces_
 
+    int NFaces_(void) const { return NSIZE(detpars_); } // number of faces found
+
+    const DetectorParameter Face_( // get face iface without bumping the face index
+        int iface) const;          // in: 0 <= iface < NFaces_()
+
     FaceDetector() {}                  // constructor
 
 private:
+    // Each FaceDetector has its own cascade because cv::CascadeClassifier
+    // keeps per-image state during detectMultiScale, so one instance can't
+    // safely be shared by concurrent stasm_ctx's.
+
+    cv::CascadeClassifier facedet_;  // the face detector
+
     vector<DetectorParameter>  detpars_;     // all the valid faces in the current image
 
     int             iface_;       // index of current face for NextFace_
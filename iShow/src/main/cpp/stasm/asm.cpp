@@ -91,6 +91,7 @@ static void TraceShape(  // write an image file showing current shape on the ima
 
 void Mod::SuggestShape_( // args same as non OpenMP version, see below
     Shape&       shape,  // io
+    HatLevData&  hatdata,// io
     int          ilev,   // in
     const Image& img,    // in
     const Shape& pinned) // in
@@ -123,7 +124,7 @@ const
                     logprintf("[nthreads %d]", omp_get_num_threads());
                 }
                 descmods_[ilev][ipoint]->
-                    DescSearch_(shape(ipoint, IX), shape(ipoint, IY),
+                    DescSearch_(shape(ipoint, IX), shape(ipoint, IY), hatdata,
                                 img, inshape, ilev, ipoint);
             }
             catch(...)
@@ -145,6 +146,7 @@ const
 
 void Mod::SuggestShape_( // estimate shape by matching descr at each point
     Shape&       shape,  // io: points will be moved for best descriptor matches
+    HatLevData&  hatdata,// io: HAT data for this search at this pyr lev
     int          ilev,   // in: pyramid level (0 is full size)
     const Image& img,    // in: image scaled to this pyramid level
     const Shape& pinned) // in: if no rows then no pinned landmarks, else
@@ -162,14 +164,34 @@ const
             // descriptor model is used for each point.
 
             descmods_[ilev][ipoint]->
-                DescSearch_(shape(ipoint, IX), shape(ipoint, IY),
+                DescSearch_(shape(ipoint, IX), shape(ipoint, IY), hatdata,
                             img, inshape, ilev, ipoint);
         }
 }
 #endif // not _OPENMP
 
-void Mod::LevSearch_(         // do an ASM search at one level in the image pyr
+// The misfit returned by LevSearch_ is the mean distance, in pixels at this
+// pyr lev, between the points suggested by the descriptor models and the
+// shape after conforming it to the shape model, in the last iteration.
+// When the descriptors match a face, the shape model barely has to move
+// the suggested points.  When they don't (the face turned away, is
+// occluded, or was lost altogether) the suggestions scatter and the shape
+// model can't follow them, so the misfit grows.
+
+static double MeanDist( // mean distance between corresponding points
+    const Shape& shape1, // in
+    const Shape& shape2) // in
+{
+    double dist = 0;
+    for (int i = 0; i < shape1.rows; i++)
+        dist += sqrt(SQ(shape1(i, IX) - shape2(i, IX)) +
+                     SQ(shape1(i, IY) - shape2(i, IY)));
+    return dist / shape1.rows;
+}
+
+double Mod::LevSearch_(       // do an ASM search at one level in the image pyr
     Shape&       shape,       // io: the face shape for this pyramid level
+    HatLevData&  hatdata,     // io: HAT data for this search
     int          ilev,        // in: pyramid level (0 is full size)
     const Image& img,         // in: image scaled to this pyramid level
     const Shape& pinnedshape) // in: if no rows then no pinned landmarks, else
@@ -178,21 +200,23 @@ const
 {
     TraceShape(shape, img, ilev, 0, "enterlevsearch");
 
-    InitHatLevData(img, ilev); // init internal HAT mats for this lev
+    hatdata.Init_(img, ilev); // init internal HAT mats for this lev
 
     VEC b(NSIZE(shapemod_.eigvals_), 1, 0.); // eigvec weights, init to 0
 
+    double misfit = 0;
     for (int iter = 0; iter < SHAPEMODEL_ITERS; iter++)
     {
         // suggest shape by descriptor matching at each landmark
 
-        SuggestShape_(shape,
+        SuggestShape_(shape, hatdata,
                       ilev, img, pinnedshape);
 
         TraceShape(shape, img, ilev, iter, "suggested");
 
         // adjust suggested shape to conform to the shape model
 
+        const Shape suggested(shape.clone());
         if (pinnedshape.rows)
             shape = shapemod_.ConformShapeToMod_Pinned_(b,
                                                         shape, ilev, pinnedshape);
@@ -200,8 +224,11 @@ const
             shape = shapemod_.ConformShapeToMod_(b,
                                                  shape, ilev);
 
+        misfit = MeanDist(suggested, shape);
+
         TraceShape(shape, img, ilev, iter, "conformed");
     }
+    return misfit;
 }
 
 static void CreatePyr(    // create image pyramid
@@ -226,11 +253,20 @@ static double GetPrescale(   // factor to scale face to standard size prior to s
 }
 
 Shape Mod::ModSearch_(            // returns coords of the facial landmarks
+        HatLevData&  hatdata,     // io: HAT data, reused across searches
         const Shape& startshape,  // in: startshape roughly positioned on face
         const Image& img,         // in: grayscale image (typically just ROI)
-        const Shape* pinnedshape) // in: pinned landmarks, NULL if nothing pinned
+        const Shape* pinnedshape, // in: pinned landmarks, NULL if nothing pinned
+        int          nlevs,       // in: search only the nlevs finest pyr levs
+        double*      misfit)      // out: if not NULL, misfit at pyr lev 0 as a
+                                  //      fraction of the eye-mouth distance
 const
 {
+    // When tracking, the start shape is already close to the face and the
+    // coarse pyramid levels (which are there to pull in a rough start
+    // shape) can be skipped.
+    CV_Assert(nlevs >= 1 && nlevs <= N_PYR_LEVS);
+
     Image scaledimg;         // image scaled to fixed eye-mouth distance
     const double imgscale = GetPrescale(startshape);
 
@@ -241,22 +277,28 @@ const
     TraceShape(startshape * imgscale, scaledimg, 0, -1, "start");
 
     vector<Image> pyr;       // image pyramid (a vec of images, one for each pyr lev)
-    CreatePyr(pyr, scaledimg, N_PYR_LEVS);
+    CreatePyr(pyr, scaledimg, nlevs);
 
-    Shape shape(startshape * imgscale * GetPyrScale(N_PYR_LEVS));
+    Shape shape(startshape * imgscale * GetPyrScale(nlevs));
 
     Shape pinned;            // pinnedshape scaled to current pyr lev
     if (pinnedshape)
-        pinned = *pinnedshape * imgscale * GetPyrScale(N_PYR_LEVS);
+        pinned = *pinnedshape * imgscale * GetPyrScale(nlevs);
 
-    for (int ilev = N_PYR_LEVS-1; ilev >= 0; ilev--)
+    double levmisfit = 0;
+    for (int ilev = nlevs-1; ilev >= 0; ilev--)
     {
         shape  *= PYR_RATIO; // scale shape to this pyr lev
         pinned *= PYR_RATIO;
 
-        LevSearch_(shape,
-                   ilev, pyr[ilev], pinned);
+        levmisfit = LevSearch_(shape, hatdata,
+                               ilev, pyr[ilev], pinned);
     }
+    if (misfit) // scaledimg has a standard eye-mouth distance
+        *misfit = levmisfit / EYEMOUTH_DIST;
+    if (trace_g)
+        lprintf("[hat cache hits %d misses %d] ",
+                hatdata.NHits_(), hatdata.NMisses_());
     return shape / imgscale;
 }
 
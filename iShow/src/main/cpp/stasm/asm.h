@@ -28,11 +28,24 @@ class Mod // An ASM model for finding landmarks.
 {         // If multiple model Stasm, will use a separate Mod for each yaw range.
 public:
     Shape ModSearch_(                  // returns coords of the facial landmarks
+        HatLevData&  hatdata,          // io: HAT data, reused across searches
         const Shape& startshape,       // in: startshape roughly positioned on face
         const Image& img,              // in: grayscale image (typically just ROI)
-        const Shape* pinnedshape=NULL) // in: pinned landmarks, NULL if nothing pinned
+        const Shape* pinnedshape=NULL, // in: pinned landmarks, NULL if nothing pinned
+        int          nlevs=N_PYR_LEVS, // in: search only the nlevs finest pyr levs
+        double*      misfit=NULL)      // out: if not NULL, see LevSearch_
     const;
 
+    Shape ModSearch_(                  // as above but with temporary HAT data
+        const Shape& startshape,       // in: startshape roughly positioned on face
+        const Image& img,              // in: grayscale image (typically just ROI)
+        const Shape* pinnedshape=NULL) // in: pinned landmarks, NULL if nothing pinned
+    const
+    {
+        HatLevData hatdata;
+        return ModSearch_(hatdata, startshape, img, pinnedshape);
+    }
+
     const Shape ConformShapeToMod_Pinned_( // wrapper around the func in ShapeMod
         const Shape& shape,                // in
         const Shape& pinnedshape)          // in
@@ -117,14 +130,17 @@ private: // all data remains constant after Mod construction
 
     void SuggestShape_(
         Shape&       shape,   // io: points will be moved to give best desc matches
+        HatLevData&  hatdata, // io: HAT data for this search at this pyr lev
         int          ilev,    // in: pyramid level (0 is full size)
         const Image& img,     // in: image scaled to this pyramid level
         const Shape& pinned)  // in: if no rows then no pinned landmarks, else
                               //     points except those equal to 0,0 are pinned
     const;
 
-    void LevSearch_(              // do an ASM search at one level in the image pyr
+    double LevSearch_(            // do an ASM search at one level in the image pyr,
+                                  // returns misfit of the shape (see asm.cpp)
         Shape&       shape,       // io: the face shape for this pyramid level
+        HatLevData&  hatdata,     // io: HAT data for this search
         int          ilev,        // in: pyramid level (0 is full size)
         const Image& img,         // in: image scaled to this pyramid level
         const Shape& pinnedshape) // in: if no rows then no pinned landmarks, else
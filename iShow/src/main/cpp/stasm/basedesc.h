@@ -23,6 +23,8 @@
 // different value of x and y.)  Thus for the OpenMP code to work
 // correctly, DescSearch_ and its callees must not modify any variables that
 // are not on the stack unless the variable is protected by a critical region.
+// Any state shared by the points of one search (such as the HAT data) is
+// passed in by the caller, so separate searches never share mutable data.
 //
 // Copyright (C) 2005-2013, Stephen Milborrow
 
@@ -31,12 +33,15 @@
 
 namespace stasm
 {
+class HatLevData; // defined in hatdesc.h
+
 class BaseDescMod // abstract base class for all descriptor models
 {
 public:
     virtual void DescSearch_( // search in area around the current point
         double&      x,       // io: (in: old posn of landmark, out: new posn)
         double&      y,       // io
+        HatLevData&  hatdata, // io: HAT data for this search at this pyr level
         const Image& img,     // in: image scaled to this pyramid level
         const Shape& shape,   // in: current position of the landmarks
         int          ilev,    // in: pyramid level (0 is full size)
@@ -28,7 +28,7 @@ VEC ClassicProf(           // used only during training a new model
 class ClassicDescMod: public BaseDescMod
 {
 public:
-    virtual void DescSearch_(double& x, double& y,                 // io
+    virtual void DescSearch_(double& x, double& y, HatLevData&,    // io
                              const Image& img, const Shape& shape, // in
                              int, int ipoint) const                // in
     {
@@ -23,17 +23,27 @@
 // by "stasm_") use try blocks internally, and code that calls
 // them doesn't have to worry about the above exception.
 //
+// Concurrency: the error message is per thread, so each thread sees the
+// error from its own stasm_ctx calls.  OpenCV has only one process-wide
+// error callback, so it is installed when the first thread enters a
+// CatchOpenCvErrs region and restored when the last thread leaves.
+//
 // Copyright (C) 2005-2013, Stephen Milborrow
 
 #include "stasm.h"
+#include <mutex>
 
 namespace stasm
 {
-static char err_g[SBIG]; // err msg saved for retrieval by LastErr and stasm_lasterr
+static THREAD_LOCAL char err_g[SBIG]; // err msg saved for retrieval by LastErr and stasm_lasterr
+
+static THREAD_LOCAL int depth_g;      // CatchOpenCvErrs nesting in this thread
+
+static std::mutex handler_mutex_g;    // protects the two variables below
 
-static vector<cv::ErrorCallback> stack_g(10); // stack of err handlers, 10 is generous
+static cv::ErrorCallback prev_handler_g; // handler active before the first CatchOpenCvErrs
 
-static int istack_g;                          // index into stack_g
+static int ncatchers_g;               // nbr of threads in a CatchOpenCvErrs region
 
 //-----------------------------------------------------------------------------
 
@@ -87,19 +97,27 @@ static int CV_CDECL CvErrorCallbackForStasm(
 void CatchOpenCvErrs(void) // makes CV_Assert work with LastErr and stasm_lasterr
 {
     err_g[0] = 0;
-    cv::ErrorCallback prev = cv::redirectError(CvErrorCallbackForStasm);
-    if (istack_g < NSIZE(stack_g))
-        stack_g[istack_g++] = prev;
-    else // should never get here (CatchErr regions nested too deeply)
-        printf("\nCallback stack overpush\n");
+    if (depth_g++ == 0) // outermost region in this thread?
+    {
+        std::lock_guard<std::mutex> lock(handler_mutex_g);
+        if (ncatchers_g++ == 0) // first thread in?
+            prev_handler_g = cv::redirectError(CvErrorCallbackForStasm);
+    }
 }
 
 void UncatchOpenCvErrs(void) // restore handler that was active before CatchOpenCvErrs
 {
-    if (istack_g > 0)
-        cv::redirectError(stack_g[--istack_g]);
-    else // should never get here (call to UncatchErr without matching CatchErr)
+    if (depth_g <= 0) // should never get here (UncatchErr without matching CatchErr)
+    {
         printf("\nCallback stack overpop\n");
+        return;
+    }
+    if (--depth_g == 0) // leaving outermost region in this thread?
+    {
+        std::lock_guard<std::mutex> lock(handler_mutex_g);
+        if (--ncatchers_g == 0) // last thread out?
+            cv::redirectError(prev_handler_g);
+    }
 }
 
 void Err(const char* format, ...) // args like printf, throws an exception
@@ -8,10 +8,6 @@
 
 namespace stasm
 {
-static cv::CascadeClassifier leye_det_g;  // left eye detector
-static cv::CascadeClassifier reye_det_g;  // right eye detector
-static cv::CascadeClassifier mouth_det_g; // mouth detector
-
 //-----------------------------------------------------------------------------
 
 // Return the region of the face we search for the left or right eye.
@@ -193,39 +189,27 @@ static Rect MouthSearchRect(     // will search for mouth in this rectangle
 bool NeedEyes(           // true if we need the eye detectors for the given mods
     const vec_Mod& mods) // in: the ASM model(s)
 {
-    static bool need_eyes = true; // static for efficiency
-    if (need_eyes && leye_det_g.empty()) // not yet opened?
+    // use the estart field to determine if we need the eyes for any model
+    for (int imod = 0; imod < NSIZE(mods); imod++)
     {
-        // use the estart field to determine if we need the eyes for any model
-        need_eyes = false;
-        for (int imod = 0; imod < NSIZE(mods); imod++)
+        ESTART estart = mods[imod]->Estart_();
+        if (estart == ESTART_EYES ||
+            estart == ESTART_EYE_AND_MOUTH)
         {
-            ESTART estart = mods[imod]->Estart_();
-            if (estart == ESTART_EYES ||
-                estart == ESTART_EYE_AND_MOUTH)
-            {
-                need_eyes = true;
-            }
+            return true;
         }
     }
-    return need_eyes;
+    return false;
 }
 
 bool NeedMouth(          // true if we need the mouth detector for the given mods
     const vec_Mod& mods) // in: the ASM model(s)
 {
-    static bool need_mouth = true; // static for efficiency
-    if (need_mouth && mouth_det_g.empty()) // not yet opened?
-    {
-        // we need the eyes if the estart field of any model is ESTART_EYE_AND_MOUTH
-        need_mouth = false;
-        for (int imod = 0; imod < NSIZE(mods); imod++)
-            if (mods[imod]->Estart_() == ESTART_EYE_AND_MOUTH)
-            {
-                need_mouth = true;
-            }
-    }
-    return need_mouth;
+    // we need the mouth if the estart field of any model is ESTART_EYE_AND_MOUTH
+    for (int imod = 0; imod < NSIZE(mods); imod++)
+        if (mods[imod]->Estart_() == ESTART_EYE_AND_MOUTH)
+            return true;
+    return false;
 }
 
 // Possibly open OpenCV eye detectors and mouth detector.  We say "possibly" because
@@ -233,6 +217,7 @@ bool NeedMouth(          // true if we need the mouth detector for the given mod
 // actually needs them.  That is determined by the model's estart field.
 
 void OpenEyeMouthDetectors(    // open eye and mouth detectors, if necessary
+    EyeMouthDetectors& dets,   // io
     bool           need_eyes,  // in: true if we need the eye detectors
     bool           need_mouth, // in: true if we need the mouth detector
     const char*    datadir)    // in
@@ -248,29 +233,31 @@ void OpenEyeMouthDetectors(    // open eye and mouth detectors, if necessary
         // the MUCT and BioID sets: haarcascade_mcs_lefteye.xml finds more eyes
         // on the viewer's left than it finds on the right (milbo Lusaka Dec 2011).
 
-        OpenDetector(leye_det_g,  "haarcascade_mcs_lefteye.xml",  datadir);
-        OpenDetector(reye_det_g,  "haarcascade_mcs_righteye.xml", datadir);
+        OpenDetector(dets.leye,  "haarcascade_mcs_lefteye.xml",  datadir);
+        OpenDetector(dets.reye,  "haarcascade_mcs_righteye.xml", datadir);
     }
     if (need_mouth)
-        OpenDetector(mouth_det_g,  "haarcascade_mcs_mouth.xml", datadir);
+        OpenDetector(dets.mouth,  "haarcascade_mcs_mouth.xml", datadir);
 }
 
 void OpenEyeMouthDetectors( // open eye and mouth detectors, if necessary for given mods
+    EyeMouthDetectors& dets, // io
     const vec_Mod& mods,    // in: the ASM models (to see if we need eyes or mouth)
     const char*    datadir) // in
 {
-    OpenEyeMouthDetectors(NeedEyes(mods), NeedMouth(mods), datadir);
+    OpenEyeMouthDetectors(dets, NeedEyes(mods), NeedMouth(mods), datadir);
 }
 
 static void DetectAllEyes(
     vec_Rect&    leyes,    // out: a vector of detected left eyes
     vec_Rect&    reyes,    // out: a vector of detected right eyes
+    EyeMouthDetectors& dets, // in
     const Image& img,      // in
     EYAW         eyaw,     // in
     const Rect&  facerect) // in: the detected face rectangle
 {
-    CV_Assert(!leye_det_g.empty()); // detector initialized?
-    CV_Assert(!reye_det_g.empty());
+    CV_Assert(!dets.leye.empty()); // detector initialized?
+    CV_Assert(!dets.reye.empty());
 
     // 1.2 is 40ms faster than 1.1 but finds slightly fewer eyes
     static const double EYE_SCALE_FACTOR   = 1.2;
@@ -280,32 +267,33 @@ static void DetectAllEyes(
     const Rect left_searchrect(EyeSearchRect(eyaw, facerect, false));
 
     if (left_searchrect.width)
-        leyes = Detect(img, leye_det_g, &left_searchrect,
+        leyes = Detect(img, dets.leye, &left_searchrect,
                        EYE_SCALE_FACTOR, EYE_MIN_NEIGHBORS, EYE_DETECTOR_FLAGS,
                        facerect.width / 10);
 
     const Rect right_searchrect(EyeSearchRect(eyaw, facerect, true));
 
     if (right_searchrect.width)
-        reyes = Detect(img, reye_det_g, &right_searchrect,
+        reyes = Detect(img, dets.reye, &right_searchrect,
                        EYE_SCALE_FACTOR, EYE_MIN_NEIGHBORS, EYE_DETECTOR_FLAGS,
                        facerect.width / 10);
 }
 
 static void DetectAllMouths(
     vec_Rect&       mouths,           // out: a vector of detected mouths
+    cv::CascadeClassifier& mouth_det, // in
     const Image&    img,              // in
     const Rect&     facerect,         // in: the detected face rectangle
     const Rect&     mouth_searchrect) // in
 {
-    CV_Assert(!mouth_det_g.empty()); // detector initialized?
+    CV_Assert(!mouth_det.empty()); // detector initialized?
 
     static const double MOUTH_SCALE_FACTOR   = 1.2; // less false pos with 1.2 than 1.1
     static const int    MOUTH_MIN_NEIGHBORS  = 5;   // less false pos with 5 than 3
     static const int    MOUTH_DETECTOR_FLAGS = 0;
 
     mouths =
-        Detect(img, mouth_det_g, &mouth_searchrect,
+        Detect(img, mouth_det, &mouth_searchrect,
                MOUTH_SCALE_FACTOR, MOUTH_MIN_NEIGHBORS, MOUTH_DETECTOR_FLAGS,
                facerect.width / 10);
 }
@@ -816,6 +804,7 @@ static void TraceEyeMouthImg(
 
 void DetectEyesAndMouth(  // use OpenCV detectors to find the eyes and mouth
     DetectorParameter& detpar, // io: eye and mouth fields updated, other fields untouched
+    EyeMouthDetectors& dets,   // in: the detectors opened by OpenEyeMouthDetectors
     const Image& image)   // in: ROI around face (already rotated if necessary)
 {
 #if TRACE_IMAGES
@@ -834,9 +823,9 @@ void DetectEyesAndMouth(  // use OpenCV detectors to find the eyes and mouth
     detpar.rex = detpar.rey = INVALID;
     vec_Rect leyes, reyes;
     int ileft_best = -1, iright_best = -1; // index into leyes and reyes vecs
-    if (!leye_det_g.empty()) // need the eyes? (depends on model estart field)
+    if (!dets.leye.empty()) // need the eyes? (depends on model estart field)
     {
-        DetectAllEyes(leyes, reyes, image, detpar.eyaw, facerect);
+        DetectAllEyes(leyes, reyes, dets, image, detpar.eyaw, facerect);
 
         SelectEyes(ileft_best, iright_best, // indices of best left and right eye
                    detpar.eyaw, leyes, reyes, EyeInnerRect(detpar.eyaw, facerect));
@@ -854,13 +843,13 @@ void DetectEyesAndMouth(  // use OpenCV detectors to find the eyes and mouth
     // possibly get the mouth
     detpar.mouthx = detpar.mouthy = INVALID;  // mark mouth as unavailable
     int imouth_best = -1; // index into mouths vector
-    if (!mouth_det_g.empty()) // need the mouth? (depends on model estart field)
+    if (!dets.mouth.empty()) // need the mouth? (depends on model estart field)
     {
         const Rect mouth_searchrect(
             MouthSearchRect(facerect, detpar.eyaw,
                             ileft_best, iright_best, leyes, reyes));
         vec_Rect mouths;
-        DetectAllMouths(mouths, image, facerect, mouth_searchrect);
+        DetectAllMouths(mouths, dets.mouth, image, facerect, mouth_searchrect);
 
         if (!mouths.empty())
         {
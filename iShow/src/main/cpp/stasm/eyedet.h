@@ -7,6 +7,17 @@
 
 namespace stasm
 {
+// The OpenCV eye and mouth detectors.  A detector is left empty if none of
+// the models needs it.  Each stasm_ctx has its own set because a
+// cv::CascadeClassifier can't be used by multiple threads at once.
+
+struct EyeMouthDetectors
+{
+    cv::CascadeClassifier leye;  // left eye detector
+    cv::CascadeClassifier reye;  // right eye detector
+    cv::CascadeClassifier mouth; // mouth detector
+};
+
 bool NeedEyes(                 // true if we need the eye detectors for the given mods
     const vec_Mod& mods);      // in: the ASM model(s)
 
@@ -14,16 +25,19 @@ bool NeedMouth(                // true if we need the mouth detector for the giv
     const vec_Mod& mods);      // in: the ASM model(s)
 
 void OpenEyeMouthDetectors(    // open eye and mouth detectors, if necessary
+    EyeMouthDetectors& dets,   // io
     bool           need_eyes,  // in: true if we need the eye detectors
     bool           need_mouth, // in: true if we need the mouth detector
     const char*    datadir);   // in
 
 void OpenEyeMouthDetectors(  // possibly open OpenCV eye detectors and mouth detector
+    EyeMouthDetectors& dets, // io
     const vec_Mod& mods,     // in: the ASM models (used to see if we need eyes or mouth)
     const char*    datadir); // in
 
 void DetectEyesAndMouth(     // use OpenCV detectors to find the eyes and mouth
     DetectorParameter&      detpar,     // io: eye and mouth fields updated, other fields untouched
+    EyeMouthDetectors&      dets,       // in: the detectors opened by OpenEyeMouthDetectors
     const Image& img);       // in: ROI around face (already rotated if necessary)
 
 } // namespace stasm
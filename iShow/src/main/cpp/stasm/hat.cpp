@@ -7,6 +7,30 @@
 
 #include "stasm.h"
 
+// SIMD kernels compiled into this file.  The x86 kernels are selected at
+// run time with cv::checkHardwareSupport, so the AVX2 kernel is compiled
+// with a function target attribute and the build flags needn't change.
+// NEON is decided at compile time (always on arm64-v8a, and on
+// armeabi-v7a only if built with -mfpu=neon).
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define HAT_SSE2 1
+  #include <emmintrin.h>
+#endif
+#if HAT_SSE2 && (defined(_MSC_VER) || defined(__GNUC__))
+  #define HAT_AVX2 1
+  #include <immintrin.h>
+  #if defined(_MSC_VER)
+    #define HAT_TARGET_AVX2
+  #else
+    #define HAT_TARGET_AVX2 __attribute__((target("avx2,fma")))
+  #endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #define HAT_NEON 1
+  #include <arm_neon.h>
+#endif
+
 namespace stasm
 {
 static const int GRIDHEIGHT = 4;       // 4 x 5 grid of histograms in descriptor
@@ -19,6 +43,9 @@ static const double WINDOW_SIGMA = .5; // gaussian window as frac of patch width
 
 static const double FINAL_SCALE = 10;  // arb but 10 is good for %g printing of descriptors
 
+static_assert(HAT_DESC_LEN == GRIDHEIGHT * GRIDWIDTH * BINS_PER_HIST,
+              "HAT_DESC_LEN in hat.h does not match the grid constants");
+
 // Get gradient magnitude and orientation of pixels in given img.
 // We use a [1,-1] convolution mask rather than [1,0,-1] because it gives as good
 // Stasm results and doesn't "waste" pixels on the left and top image boundary.
@@ -137,22 +164,6 @@ static inline void InitIndices(
     }
 }
 
-// Init the data that doesn't change unless the image, patch width, or
-// GRIDHEIGHT or WIDTH changes (i.e. for Stasm this must be called
-// once per pyramid lev).
-
-void Hat::Init_(
-    const Image& img,        // in: image scaled to current pyramid level
-    const int    patchwidth) // in: patch will be patchwidth x patchwidth pixels
-{
-    patchwidth_ = patchwidth;
-
-    InitGradMagAndOrientMats(magmat_, orientmat_, img);
-
-    InitIndices(row_indices_, row_fracs_, col_indices_, col_fracs_, pixelweights_,
-                patchwidth_);
-}
-
 // Calculate the image patch gradient mags and orients.
 // Note that the mag for a pixel out of the image boundaries is set
 // to 0 and thus contributes nothing later in TrilinearAccumulate.
@@ -384,6 +395,314 @@ static void NormalizeDesc( // take sqrt of elems and divide by L2 norm
     }
 }
 
+//-----------------------------------------------------------------------------
+// SIMD path.  Instead of apportioning each pixel's grad mag across
+// the orientation bins for every descriptor (TrilinearAccumulate), we do
+// the orientation split once per pyramid level in InitOrientMags.  Each
+// pixel then carries BINS_PER_HIST floats and the per-descriptor work
+// reduces to adding four scaled copies of those 8 floats into the four
+// neighboring histograms, which is what the kernels below do.
+//
+// Results match the scalar path to within float precision and the
+// accuracy of cv::cartToPolar (about .3 degrees), which is negligible
+// after NormalizeDesc.
+
+static const int SIMD_ROWSTRIDE  = (1 + GRIDWIDTH + 1) * BINS_PER_HIST;
+static const int SIMD_NHISTBINS  = (1 + GRIDHEIGHT + 1) * SIMD_ROWSTRIDE;
+
+struct HatPatch           // the part of a patch that is in the image
+{
+    const float* src;     // orientmags of the first in-image pixel of the patch
+    int          srcstride; // floats per image row in orientmags
+    int          pxmin, pxmax, pymin, pymax; // in-image patch cols and rows
+    int          patchwidth;
+    const int*   cellindices;
+    const float* cellweights;
+};
+
+#if HAT_SSE2
+static inline void AccumSse2(
+    float* p, const __m128 lo, const __m128 hi, const float weight)
+{
+    const __m128 w = _mm_set1_ps(weight);
+    _mm_storeu_ps(p,     _mm_add_ps(_mm_loadu_ps(p),     _mm_mul_ps(lo, w)));
+    _mm_storeu_ps(p + 4, _mm_add_ps(_mm_loadu_ps(p + 4), _mm_mul_ps(hi, w)));
+}
+
+static void AccumulateSse2(
+    float*          histbins, // io
+    const HatPatch& patch)    // in
+{
+    for (int py = patch.pymin; py < patch.pymax; py++)
+    {
+        const float* src = patch.src + (py - patch.pymin) * patch.srcstride;
+        for (int px = patch.pxmin; px < patch.pxmax; px++, src += BINS_PER_HIST)
+        {
+            const int ipix = py * patch.patchwidth + px;
+            const float* const w = patch.cellweights + 4 * ipix;
+            float* const p = histbins + patch.cellindices[ipix];
+            const __m128 lo = _mm_loadu_ps(src), hi = _mm_loadu_ps(src + 4);
+            AccumSse2(p,                                  lo, hi, w[0]);
+            AccumSse2(p + BINS_PER_HIST,                  lo, hi, w[1]);
+            AccumSse2(p + SIMD_ROWSTRIDE,                 lo, hi, w[2]);
+            AccumSse2(p + SIMD_ROWSTRIDE + BINS_PER_HIST, lo, hi, w[3]);
+        }
+    }
+}
+#endif // HAT_SSE2
+
+#if HAT_AVX2
+static inline HAT_TARGET_AVX2 void AccumAvx2(
+    float* p, const __m256 v, const float weight)
+{
+    _mm256_storeu_ps(p,
+        _mm256_fmadd_ps(v, _mm256_set1_ps(weight), _mm256_loadu_ps(p)));
+}
+
+static HAT_TARGET_AVX2 void AccumulateAvx2(
+    float*          histbins, // io
+    const HatPatch& patch)    // in
+{
+    for (int py = patch.pymin; py < patch.pymax; py++)
+    {
+        const float* src = patch.src + (py - patch.pymin) * patch.srcstride;
+        for (int px = patch.pxmin; px < patch.pxmax; px++, src += BINS_PER_HIST)
+        {
+            const int ipix = py * patch.patchwidth + px;
+            const float* const w = patch.cellweights + 4 * ipix;
+            float* const p = histbins + patch.cellindices[ipix];
+            const __m256 v = _mm256_loadu_ps(src);
+            AccumAvx2(p,                                  v, w[0]);
+            AccumAvx2(p + BINS_PER_HIST,                  v, w[1]);
+            AccumAvx2(p + SIMD_ROWSTRIDE,                 v, w[2]);
+            AccumAvx2(p + SIMD_ROWSTRIDE + BINS_PER_HIST, v, w[3]);
+        }
+    }
+}
+#endif // HAT_AVX2
+
+#if HAT_NEON
+static inline void AccumNeon(
+    float* p, const float32x4_t lo, const float32x4_t hi, const float weight)
+{
+    vst1q_f32(p,     vmlaq_n_f32(vld1q_f32(p),     lo, weight));
+    vst1q_f32(p + 4, vmlaq_n_f32(vld1q_f32(p + 4), hi, weight));
+}
+
+static void AccumulateNeon(
+    float*          histbins, // io
+    const HatPatch& patch)    // in
+{
+    for (int py = patch.pymin; py < patch.pymax; py++)
+    {
+        const float* src = patch.src + (py - patch.pymin) * patch.srcstride;
+        for (int px = patch.pxmin; px < patch.pxmax; px++, src += BINS_PER_HIST)
+        {
+            const int ipix = py * patch.patchwidth + px;
+            const float* const w = patch.cellweights + 4 * ipix;
+            float* const p = histbins + patch.cellindices[ipix];
+            const float32x4_t lo = vld1q_f32(src), hi = vld1q_f32(src + 4);
+            AccumNeon(p,                                  lo, hi, w[0]);
+            AccumNeon(p + BINS_PER_HIST,                  lo, hi, w[1]);
+            AccumNeon(p + SIMD_ROWSTRIDE,                 lo, hi, w[2]);
+            AccumNeon(p + SIMD_ROWSTRIDE + BINS_PER_HIST, lo, hi, w[3]);
+        }
+    }
+}
+#endif // HAT_NEON
+
+struct SimdKernel
+{
+    void (*func)(float* histbins, const HatPatch& patch);
+    const char* name;
+};
+
+static SimdKernel ChooseSimdKernel(void) // called once, result is cached
+{
+#if HAT_AVX2
+    if (cv::checkHardwareSupport(CV_CPU_AVX2) && cv::checkHardwareSupport(CV_CPU_FMA3))
+        return SimdKernel{ AccumulateAvx2, "AVX2" };
+#endif
+#if HAT_SSE2
+    if (cv::checkHardwareSupport(CV_CPU_SSE2))
+        return SimdKernel{ AccumulateSse2, "SSE2" };
+#endif
+#if HAT_NEON
+    return SimdKernel{ AccumulateNeon, "NEON" };
+#endif
+    return SimdKernel{ NULL, NULL };
+}
+
+static const SimdKernel& TheSimdKernel(void)
+{
+    static const SimdKernel kernel = ChooseSimdKernel(); // thread-safe init
+    return kernel;
+}
+
+const char* HatSimdKernel(void) // name of SIMD kernel for this CPU, NULL if none
+{
+    return TheSimdKernel().name;
+}
+
+// Like InitGradMagAndOrientMats but also split each grad mag across its
+// two nearest orientation bins.  cv::cartToPolar does the sqrt and atan2
+// with OpenCV's own vectorized code.
+
+static void InitOrientMags(
+    std::vector<float>& orientmags, // out: BINS_PER_HIST floats per pixel
+    const Image&        img)        // in:  ROI scaled to current pyramid level
+{
+    const int nrows = img.rows, nrows1 = img.rows-1;
+    const int ncols = img.cols, ncols1 = img.cols-1;
+
+    cv::Mat_<float> xdelta(nrows, ncols, 0.f), ydelta(nrows, ncols, 0.f);
+    for (int y = 0; y < nrows1; y++)
+    {
+        const byte* const buf    = (byte*)(img.data) + y     * ncols;
+        const byte* const buf_y1 = (byte*)(img.data) + (y+1) * ncols;
+        float* const xbuf = xdelta[y];
+        float* const ybuf = ydelta[y];
+        for (int x = 0; x < ncols1; x++)
+        {
+            xbuf[x] = float(buf[x+1]    - buf[x]);
+            ybuf[x] = float(buf_y1[x]   - buf[x]);
+        }
+    }
+    cv::Mat_<float> mag, orient;
+    cv::cartToPolar(xdelta, ydelta, mag, orient, true); // orient in degrees
+
+    const float bins_per_degree = BINS_PER_HIST / 360.f;
+    orientmags.assign(size_t(nrows) * ncols * BINS_PER_HIST, 0.f);
+    for (int y = 0; y < nrows; y++)
+    {
+        const float* const magbuf    = mag[y];
+        const float* const orientbuf = orient[y];
+        float* const dst = &orientmags[size_t(y) * ncols * BINS_PER_HIST];
+        for (int x = 0; x < ncols; x++)
+        {
+            float o = orientbuf[x] * bins_per_degree; // 0 <= o <= BINS_PER_HIST
+            int io = int(o);
+            if (io >= BINS_PER_HIST) // cartToPolar can return exactly 360
+            {
+                io -= BINS_PER_HIST;
+                o  -= BINS_PER_HIST;
+            }
+            const float a1 = magbuf[x] * (o - io);
+            float* const p = dst + x * BINS_PER_HIST;
+            p[io] += magbuf[x] - a1;
+            p[(io + 1) % BINS_PER_HIST] += a1; // 360 wraps to 0
+        }
+    }
+}
+
+// Fold the row and col fracs and the pixel weight of each patch pixel
+// into the four weights of the bilinear spatial accumulate.
+
+static void InitCellWeights(
+    vec_int&            cellindices,  // out
+    std::vector<float>& cellweights,  // out
+    const vec_int&      row_indices,  // in
+    const vec_double&   row_fracs,    // in
+    const vec_int&      col_indices,  // in
+    const vec_double&   col_fracs,    // in
+    const vec_double&   pixelweights) // in
+{
+    const int npix = NSIZE(pixelweights);
+    cellindices.resize(npix);
+    cellweights.resize(4 * npix);
+    for (int ipix = 0; ipix < npix; ipix++)
+    {
+        cellindices[ipix] = (row_indices[ipix] + 1) * SIMD_ROWSTRIDE +
+                            (col_indices[ipix] + 1) * BINS_PER_HIST;
+        const double
+            a1  = pixelweights[ipix] * row_fracs[ipix], a0  = pixelweights[ipix] - a1,
+            a11 = a1 * col_fracs[ipix],                 a10 = a1 - a11,
+            a01 = a0 * col_fracs[ipix],                 a00 = a0 - a01;
+        float* const w = &cellweights[4 * ipix];
+        w[0] = float(a00); // ThisRow ThisCol
+        w[1] = float(a01); // ThisRow NextCol
+        w[2] = float(a10); // NextRow ThisCol
+        w[3] = float(a11); // NextRow NextCol
+    }
+}
+
+VEC Hat::DescSimd_( // return HAT descriptor using the SIMD kernel
+    const double x, // in: x coord of center of patch (may be off image)
+    const double y) // in: y coord of center of patch (may be off image)
+    const
+{
+    const int halfpatchwidth = (patchwidth_-1) / 2;
+    const int x0 = cvRound(x) - halfpatchwidth; // top left of patch
+    const int y0 = cvRound(y) - halfpatchwidth;
+
+    HatPatch patch;
+    patch.pxmin = MAX(0, -x0);
+    patch.pxmax = MIN(patchwidth_, planecols_ - x0);
+    patch.pymin = MAX(0, -y0);
+    patch.pymax = MIN(patchwidth_, planerows_ - y0);
+
+    float histbins[SIMD_NHISTBINS] = { 0 };
+
+    // pixels off the image have a zero mag so we just skip them
+    if (patch.pxmin < patch.pxmax && patch.pymin < patch.pymax)
+    {
+        patch.src = &orientmags_[(size_t(y0 + patch.pymin) * planecols_ +
+                                  x0 + patch.pxmin) * BINS_PER_HIST];
+        patch.srcstride   = planecols_ * BINS_PER_HIST;
+        patch.patchwidth  = patchwidth_;
+        patch.cellindices = &cellindices_[0];
+        patch.cellweights = &cellweights_[0];
+        accum_(histbins, patch);
+    }
+    VEC desc(HAT_DESC_LEN, 1);
+    double* const data = Buf(desc);
+    for (int row = 0; row < GRIDHEIGHT; row++)
+        for (int col = 0; col < GRIDWIDTH; col++)
+        {
+            const float* const p =
+                histbins + (row+1) * SIMD_ROWSTRIDE + (col+1) * BINS_PER_HIST;
+            double* const d = data + (row * GRIDWIDTH + col) * BINS_PER_HIST;
+            for (int i = 0; i < BINS_PER_HIST; i++)
+                d[i] = p[i];
+        }
+    NormalizeDesc(desc);
+    return desc;
+}
+
+// Init the data that doesn't change unless the image, patch width, or
+// GRIDHEIGHT or WIDTH changes (i.e. for Stasm this must be called
+// once per pyramid lev).
+
+void Hat::Init_(
+    const Image& img,        // in: image scaled to current pyramid level
+    const int    patchwidth, // in: patch will be patchwidth x patchwidth pixels
+    const bool   simd)       // in: use the SIMD kernel if the CPU has one
+{
+    patchwidth_ = patchwidth;
+
+    InitIndices(row_indices_, row_fracs_, col_indices_, col_fracs_, pixelweights_,
+                patchwidth_);
+
+    accum_ = simd? TheSimdKernel().func: NULL;
+
+    if (accum_)
+    {
+        magmat_.release();   // not needed by the SIMD path
+        orientmat_.release();
+        planerows_ = img.rows;
+        planecols_ = img.cols;
+        InitOrientMags(orientmags_, img);
+        InitCellWeights(cellindices_, cellweights_,
+                        row_indices_, row_fracs_, col_indices_, col_fracs_,
+                        pixelweights_);
+    }
+    else
+    {
+        orientmags_.clear();
+        InitGradMagAndOrientMats(magmat_, orientmat_, img);
+    }
+}
+
 // Hat::Init_ must be called before calling this function.
 //
 // A HAT descriptor is a vector of doubles of length
@@ -394,22 +713,23 @@ static void NormalizeDesc( // take sqrt of elems and divide by L2 norm
 // type conversions are unneeded when applying the formula).
 //
 // Note also that a trial implementation that used floats instead of
-// doubles (and with a float form of HatFit) was slower.
+// doubles (and with a float form of HatFit) was slower.  The SIMD path
+// accumulates in floats internally but still returns doubles.
 
 VEC Hat::Desc_( // return HAT descriptor, Init_ must be called first
     const double x,    // in: x coord of center of patch (may be off image)
     const double y)    // in: y coord of center of patch (may be off image)
     const
 {
+    if (accum_)
+        return DescSimd_(x, y);
+
     CV_Assert(magmat_.rows);         // verify that Hat::Init_ was called
 
-#if _OPENMP // can't be static because multiple instances
-    vec_double        mags, orients;
-    vec_double        histbins;
-#else       // static faster since size rarely changes
-    static vec_double mags, orients; // the image patch grad mags and orientations
-    static vec_double histbins;      // the histograms
-#endif
+    // Can't be static because OpenMP threads and concurrent stasm_ctx's
+    // call this at the same time.
+    vec_double mags, orients; // the image patch grad mags and orientations
+    vec_double histbins;      // the histograms
 
     GetMagsAndOrients(mags, orients,
                       cvRound(x), cvRound(y), patchwidth_,
@@ -421,7 +741,7 @@ VEC Hat::Desc_( // return HAT descriptor, Init_ must be called first
 
     WrapHistograms(histbins);        // wrap 360 degrees back to 0
 
-    VEC desc(GRIDHEIGHT * GRIDWIDTH * BINS_PER_HIST, 1); // the HAT descriptor
+    VEC desc(HAT_DESC_LEN, 1); // the HAT descriptor
 
     CopyHistsToDesc(desc,
                     histbins);
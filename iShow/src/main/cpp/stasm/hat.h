@@ -7,19 +7,28 @@
 
 namespace stasm
 {
+static const int HAT_DESC_LEN = 4 * 5 * 8; // GRIDHEIGHT * GRIDWIDTH * BINS_PER_HIST
+
+struct HatPatch;                  // defined in hat.cpp
+
+const char* HatSimdKernel(void);  // name of SIMD kernel for this CPU, NULL if none
+
 class Hat
 {
 public:
     void Init_(                   // init the HAT internal grad mat and indices
         const Image& img,         // in: image ROI scaled to the current pyr lev
-        const int    patchwidth); // in: patch will be patchwidth x patchwidth pixs
+        const int    patchwidth,  // in: patch will be patchwidth x patchwidth pixs
+        const bool   simd=true);  // in: use the SIMD kernel if the CPU has one
 
     VEC Desc_(                    // return HAT descriptor, Init_ must be called first
         const double x,           // in: x coord of center of patch (may be off image)
         const double y)           // in: y coord of center of patch (may be off image)
     const;
 
-    Hat() {}                      // constructor
+    bool Simd_() const { return accum_ != NULL; } // true if Desc_ uses SIMD kernel
+
+    Hat() : patchwidth_(0), accum_(NULL), planerows_(0), planecols_(0) {}
 
 private:
     // All these private variables are initialized by Hat::Init_.  They must
@@ -40,6 +49,23 @@ private:
 
     vec_double pixelweights_;     // weight pixel by closeness to center of patch
 
+    // The following are used instead of the above mats if accum_ is not NULL.
+    // The grad mag of each pixel is pre-split across the BINS_PER_HIST
+    // orient bins, so the per-descriptor work is a bilinear spatial
+    // accumulate of 8-float vectors, which maps directly onto SIMD regs.
+
+    typedef void (*AccumFunc)(float* histbins, const HatPatch& patch);
+
+    AccumFunc  accum_;            // SIMD histogram kernel, NULL for scalar path
+    std::vector<float> orientmags_; // 8 orient-binned grad mags per pixel
+    int        planerows_;        // dims of the image used to init orientmags_
+    int        planecols_;
+    vec_int    cellindices_;      // index in histbins of each patch pixel's cell
+    std::vector<float> cellweights_; // 4 bilinear cell weights per patch pixel,
+                                  // pixelweights_ are folded into these
+
+    VEC DescSimd_(const double x, const double y) const;
+
     DISALLOW_COPY_AND_ASSIGN(Hat);
 
 }; // end class Hat
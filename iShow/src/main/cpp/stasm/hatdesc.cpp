@@ -6,143 +6,180 @@
 
 #include "stasm.h"
 
-// define to 0 if your compiler doesn't support hash_map
-// Stasm runs faster if 1
-#define CACHE 1
-
-#include <unordered_map>
-/*
-#if CACHE
-  // define hash_map,  current implementations are compiler dependent (2013)
-  #ifdef _MSC_VER // microsoft
-    #include <hash_map>
-    using namespace stdext;
-  #else          // assume gcc
-    #include <ext/hash_map>
-    using namespace __gnu_cxx;
-  #endif
-#endif
-*/
-
 namespace stasm
 {
-// hat_g is global because we initialize the HAT internal data
-// (grads and orients etc.) once for the entire pyramid level.
-// Initialized in InitHatLevData.
+static const int CELL_EMPTY = -1; // cache cell states, see HatLevData in hatdesc.h
+static const int CELL_BUSY  = -2;
+
+// Number of descriptors in an arena chunk.  A single shape model iteration
+// can visit a couple of thousand grid positions (77 landmarks times 25
+// offsets, less the overlaps), so the arena grows a chunk at a time as
+// positions are visited.  Each grid cell takes at most one slot, so the
+// arena never holds more than ncells_ descriptors and never fills up.
 
-static Hat hat_g;
+static const int HAT_CHUNK_DESCS = 512;
 
 //-----------------------------------------------------------------------------
 
-#if CACHE
+static int round2(double x) // return closest int to x that is divisible by 2
+{
+    return 2 * cvRound(x / 2);
+}
 
-// For speed, we cache the HAT descriptors, so we have the descriptor at
-// hand if we revisit an xy position in the image, which is very common in ASMs.
-// (Note: an implementation with cache_g as a vector<vector VEC> was slower.)
+static int PatchWidth( // patchwidth at the given pyramid level
+    int ilev)          // in: pyramid level (0 is full size)
+{
+    return HAT_PATCH_WIDTH + round2(ilev * HAT_PATCH_WIDTH_ADJ);
+}
 
-static std::unordered_map<unsigned, VEC> cache_g; // cached descriptors
-//static hash_map<unsigned, VEC> cache_g; // cached descriptors
-static const bool TRACE_CACHE = 0;      // for checking cache hit rate
-static int ncalls_g, nhits_g;           // only used if TRACE_CACHE
+int HatLevData::CellIndex_( // index into cells_, -1 if x,y not in grid
+    int x,                  // in
+    int y)                  // in
+const
+{
+    const int gx = x + margin_, gy = y + margin_;
+    if (gx < 0 || gy < 0 ||
+            gx % HAT_SEARCH_RESOL || gy % HAT_SEARCH_RESOL) // not a grid position?
+        return -1;
+    const int col = gx / HAT_SEARCH_RESOL, row = gy / HAT_SEARCH_RESOL;
+    if (col >= gridwidth_ || row >= gridheight_)
+        return -1;
+    return row * gridwidth_ + col;
+}
 
-static unsigned Key(int x, int y) // pack x,y into 32 bits for cache key
+HatLevData::~HatLevData() // destructor
 {
-    return ((y & 0xffff) << 16) | (x & 0xffff);
+    for (int i = 0; i < nchunksalloced_; i++)
+        delete[] chunks_[i].load(std::memory_order_relaxed);
 }
 
-static double GetHatFit( // args same as non CACHE version, see below
-    int          x,      // in
-    int          y,      // in
-    const HatFit hatfit) // in
+double* HatLevData::Slot_( // arena slot, allocates its chunk if need be
+    int islot)             // in: 0 <= islot < ncells_
 {
-    const double* descbuf = NULL;       // the HAT descriptor
-    // for max cache hit rate, x and y should divisible by HAT_SEARCH_RESOL
-    CV_DbgAssert(x % HAT_SEARCH_RESOL == 0);
-    CV_DbgAssert(y % HAT_SEARCH_RESOL == 0);
-    if (TRACE_CACHE)
-        ncalls_g++;
-    const unsigned key(Key(x, y));
-    #pragma omp critical                // prevent OpenMP concurrent access to cache_g
+    CV_DbgAssert(islot >= 0 && islot < ncells_);
+    std::atomic<double*>& chunk = chunks_[islot / HAT_CHUNK_DESCS];
+    double* buf = chunk.load(std::memory_order_acquire);
+    if (!buf) // first slot used in this chunk?
     {
-        std::unordered_map<unsigned, VEC>:: const_iterator it(cache_g.find(key));
-        if (it != cache_g.end())        // in cache?
-        {
-            descbuf = Buf(it->second);  // use cached descriptor
-            if (TRACE_CACHE)
-                nhits_g++;
-        }
+        double* const newbuf = new double[HAT_CHUNK_DESCS * HAT_DESC_LEN];
+        if (chunk.compare_exchange_strong(buf, newbuf, std::memory_order_acq_rel))
+            buf = newbuf;
+        else
+            delete[] newbuf; // another thread beat us to it, buf is its chunk
     }
-    if (descbuf == NULL)                // descriptor not in cache?
-    {
-        const VEC desc(hat_g.Desc_(x, y));
-        #pragma omp critical            // prevent OpenMP concurrent access to cache_g
-        cache_g[key] = desc;            // remember descriptor for possible re-use
-        descbuf = Buf(desc);
-    }
-    return hatfit(descbuf);
+    return buf + (islot % HAT_CHUNK_DESCS) * HAT_DESC_LEN;
 }
 
-#else // not CACHE
-
-// Get the HAT descriptor at the given ipoint and x,y coords, and return
-// how well the descriptor matches the model.  High fit means good match.
+// For speed, we cache the HAT descriptors, so we have the descriptor at
+// hand if we revisit an xy position in the image, which is very common in ASMs.
+//
+// The thread that finds a cell empty claims it with a compare-and-swap,
+// calculates the descriptor into a fresh arena slot, and then publishes
+// the slot index with a release store.  A thread that finds the cell busy
+// calculates the descriptor itself rather than waiting (this is rare).
 
-static double GetHatFit(
+double HatLevData::Fit_(
     int          x,      // in: image x coord (may be off image)
     int          y,      // in: image y coord (may be off image)
     const HatFit hatfit) // in: func to estimate descriptor match
 {
-    return hatfit(Buf(hat_g.Desc_(x, y)));
-}
-
-#endif // not CACHE
-
-static int round2(double x) // return closest int to x that is divisible by 2
-{
-    return 2 * cvRound(x / 2);
-}
-
-static int PatchWidth( // patchwidth at the given pyramid level
-    int ilev)          // in: pyramid level (0 is full size)
-{
-    return HAT_PATCH_WIDTH + round2(ilev * HAT_PATCH_WIDTH_ADJ);
+    // for max cache hit rate, x and y should divisible by HAT_SEARCH_RESOL
+    CV_DbgAssert(x % HAT_SEARCH_RESOL == 0);
+    CV_DbgAssert(y % HAT_SEARCH_RESOL == 0);
+    const int icell = CellIndex_(x, y);
+    if (icell >= 0)
+    {
+        std::atomic<int>& cell = cells_[icell];
+        int islot = cell.load(std::memory_order_acquire);
+        if (islot >= 0) // in cache?
+        {
+            nhits_.fetch_add(1, std::memory_order_relaxed);
+            return hatfit(Slot_(islot));
+        }
+        if (islot == CELL_EMPTY &&
+            cell.compare_exchange_strong(islot, CELL_BUSY,
+                                         std::memory_order_relaxed))
+        {
+            // we own the cell, calculate the descriptor and publish it
+            islot = nslots_.fetch_add(1, std::memory_order_relaxed);
+            double* const descbuf = Slot_(islot);
+            const VEC desc(hat_.Desc_(x, y));
+            memcpy(descbuf, Buf(desc), HAT_DESC_LEN * sizeof(double));
+            cell.store(islot, std::memory_order_release);
+            nmisses_.fetch_add(1, std::memory_order_relaxed);
+            return hatfit(descbuf);
+        }
+    }
+    nmisses_.fetch_add(1, std::memory_order_relaxed);
+    return hatfit(Buf(hat_.Desc_(x, y))); // not cacheable
 }
 
-void InitHatLevData(   // init the global HAT data needed for this pyr level
-    const Image& img,  // in
-    int          ilev) // in
+void HatLevData::Init_( // init the HAT data needed for this pyr level
+    const Image& img,   // in
+    int          ilev)  // in
 {
     if (ilev <= HAT_START_LEV) // we use HATs only at upper pyr levs
     {
-        hat_g.Init_(img, PatchWidth(ilev));
-#if CACHE
-        if (TRACE_CACHE) // show results from previous run
-            lprintf("[calls %d hitrate %.2f cachesize %d]\n",
-                    ncalls_g, double(nhits_g) / ncalls_g, cache_g.size());
-        cache_g.clear();
-#endif
+        const int patchwidth = PatchWidth(ilev);
+        hat_.Init_(img, patchwidth);
+
+        // The grid covers the image plus a margin of a patch width and the
+        // search offset, so it holds any position a landmark in the image can
+        // search.  The margin is a multiple of HAT_SEARCH_RESOL so that image
+        // coords 0,0 is a grid position.
+
+        margin_ = HAT_SEARCH_RESOL *
+                  ((patchwidth + HAT_MAX_OFFSET) / HAT_SEARCH_RESOL + 1);
+        gridwidth_  = (img.cols + 2 * margin_) / HAT_SEARCH_RESOL + 1;
+        gridheight_ = (img.rows + 2 * margin_) / HAT_SEARCH_RESOL + 1;
+        ncells_ = gridwidth_ * gridheight_;
+        if (ncells_ > ncellsalloced_)
+        {
+            cells_.reset(new std::atomic<int>[ncells_]);
+            ncellsalloced_ = ncells_;
+        }
+        for (int i = 0; i < ncells_; i++)
+            cells_[i].store(CELL_EMPTY, std::memory_order_relaxed);
+
+        // Make room in chunks_ for a slot per cell.  The chunks themselves
+        // are allocated by Slot_ when first used, and reused thereafter.
+        const int nchunks = (ncells_ + HAT_CHUNK_DESCS - 1) / HAT_CHUNK_DESCS;
+        if (nchunks > nchunksalloced_)
+        {
+            std::unique_ptr<std::atomic<double*>[]> chunks(
+                                        new std::atomic<double*>[nchunks]);
+            for (int i = 0; i < nchunks; i++)
+                chunks[i].store(i < nchunksalloced_?
+                                    chunks_[i].load(std::memory_order_relaxed): NULL,
+                                std::memory_order_relaxed);
+            chunks_.swap(chunks);
+            nchunksalloced_ = nchunks;
+        }
+        nslots_.store(0, std::memory_order_relaxed);
     }
 }
 
 VEC HatDesc( // used only during training new models
+    const HatLevData& hatdata, // in
     double x,   // in
     double y)   // in
 {
-    return hat_g.Desc_(cvRound(x), cvRound(y));
+    return hatdata.Desc_(x, y);
 }
 
 // Note 1: The image is not passed directly to this function.  Instead this
 // function accesses the image gradient magnitude and orientation stored in
-// fields of the global variable hat_g and previously initialized by the
-// call to InitHatLevData.
+// hatdata and previously initialized by the call to HatLevData::Init_.
 //
 // Note 2: If OpenMP is enabled, multiple instances of this function will be
 // called concurrently (each call will have a different value of x and y). Thus
-// this function and its callees do not modify any data that is not on the stack.
+// this function and its callees do not modify any data that is not on the
+// stack, except the descriptor cache which is updated atomically.
 
 void HatDescSearch(      // search in a grid around the current landmark
     double&      x,      // io: (in: old position of landmark, out: new position)
     double&      y,      // io:
+    HatLevData&  hatdata,// io: HAT data for this search and pyr level
     const HatFit hatfit) // in: func to estimate descriptor match
 {
     // If HAT_SEARCH_RESOL is 2, force x,y positions to be divisible
@@ -163,7 +200,7 @@ void HatDescSearch(      // search in a grid around the current landmark
                  xoffset <= HAT_MAX_OFFSET;
                  xoffset += HAT_SEARCH_RESOL)
         {
-            const double fit = GetHatFit(ix + xoffset, iy + yoffset, hatfit);
+            const double fit = hatdata.Fit_(ix + xoffset, iy + yoffset, hatfit);
             if (fit > fit_best)
             {
                 fit_best = fit;
@@ -27,28 +27,109 @@ static const int HAT_START_LEV = 2;    // HAT descriptors are for pyr levs 0...2
 // define HatFit: a pointer to a func for measuring fit of HAT descriptor
 typedef double(*HatFit)(const double* const);
 
-void InitHatLevData(      // init the global HAT data needed for this pyr level
-    const Image& img,     // in
-    int          ilev);   // in: pyramid level, 0 is full size
+// The HAT data for one ASM search at one pyramid level: the image gradients
+// (in the Hat) and the descriptors already calculated.  Each stasm_ctx owns
+// one HatLevData, so concurrent searches share nothing.  Within a search
+// the OpenMP threads in SuggestShape_ share it.
+//
+// The descriptor cache is a dense grid with one cell per searched position
+// (every HAT_SEARCH_RESOL pixels) over the pyr level image plus a margin.
+// The descriptors themselves are stored in an arena of fixed size chunks,
+// allocated on first use, so the arena grows with the number of positions
+// visited without moving descriptors that other threads may be reading.
+// A cell is claimed and published with atomic operations, so lookups and
+// inserts need no lock.  The chunks are reused from one pyr level and image
+// to the next.
+
+class HatLevData
+{
+public:
+    void Init_(               // init the HAT data needed for this pyr level
+        const Image& img,     // in
+        int          ilev);   // in: pyramid level, 0 is full size
+
+    double Fit_(              // how well the descriptor at x,y matches the model
+        int          x,       // in: image x coord (may be off image)
+        int          y,       // in: image y coord (may be off image)
+        const HatFit hatfit); // in: func to estimate descriptor match
+
+    VEC Desc_(                // the HAT descriptor at x,y (not cached)
+        double x,             // in
+        double y)             // in
+    const
+    {
+        return hat_.Desc_(cvRound(x), cvRound(y));
+    }
+
+    int NHits_(void)   const { return nhits_;   } // cache hits since ResetStats_
+    int NMisses_(void) const { return nmisses_; } // cache misses since ResetStats_
+
+    void ResetStats_(void) { nhits_ = 0; nmisses_ = 0; }
+
+    HatLevData()              // constructor
+        : margin_(0), gridwidth_(0), gridheight_(0),
+          ncells_(0), ncellsalloced_(0), nchunksalloced_(0),
+          nslots_(0), nhits_(0), nmisses_(0)
+    {
+    }
+
+    ~HatLevData();            // destructor, frees the arena chunks
+
+private:
+    int CellIndex_(int x, int y) const; // index into cells_, -1 if x,y not in grid
+
+    double* Slot_(int islot);           // arena slot, allocates its chunk if need be
+
+    Hat        hat_;          // grads and orients for the current pyr level
+
+    int        margin_;       // grid extends this many pixels beyond the image
+    int        gridwidth_;    // grid size in cells
+    int        gridheight_;
+
+    int        ncells_;       // gridwidth_ * gridheight_
+    int        ncellsalloced_;// allocated size of cells_
+
+    // Each cell holds CELL_EMPTY, CELL_BUSY (descriptor being calculated
+    // by another thread), or the index of its arena slot.
+
+    std::unique_ptr<std::atomic<int>[]> cells_;
+
+    // The arena: chunk i holds slots i*HAT_CHUNK_DESCS and up, HAT_DESC_LEN
+    // doubles each.  A chunk is NULL until a slot in it is first used.
+
+    std::unique_ptr<std::atomic<double*>[]> chunks_;
+    int        nchunksalloced_;// allocated size of chunks_, enough for ncells_ slots
+
+    std::atomic<int> nslots_; // nbr of arena slots used at this pyr level
+
+    std::atomic<int> nhits_;  // statistics, see NHits_ and NMisses_
+    std::atomic<int> nmisses_;
+
+    DISALLOW_COPY_AND_ASSIGN(HatLevData);
+
+}; // end class HatLevData
 
 VEC HatDesc(              // used only during training new models
+    const HatLevData& hatdata, // in: initialized for this pyr level
     double x,             // in
     double y);            // in
 
 void HatDescSearch(       // search in a grid around the current landmark
     double&      x,       // io: (in: old posn of landmark, out: new posn)
     double&      y,       // io
+    HatLevData&  hatdata, // io: HAT data for this search and pyr level
     const HatFit hatfit); // in: func to estimate descriptor match
 
 class HatDescMod: public BaseDescMod
 {
 public:
     virtual void DescSearch_(double& x, double& y,       // io
+                             HatLevData& hatdata,        // io
                              const Image&, const Shape&, // in
                              int, int) const             // in
     {
         HatDescSearch(x, y,
-                      hatfit_);
+                      hatdata, hatfit_);
     }
 
     HatDescMod(const HatFit hatfit) // constructor
@@ -22,7 +22,7 @@ namespace stasm
 
 const char* ssprintf(const char* format, ...)
 {
-    static char s[SBIG];
+    static THREAD_LOCAL char s[SBIG];
     va_list args;
     va_start(args, format);
     VSPRINTF(s, format, args);
@@ -66,7 +66,7 @@ void ConvertBackslashesToForwardAndStripFinalSlash(char* s)
 
 const char* BaseExt(const char* path)
 {
-    static char s[SLEN];
+    static THREAD_LOCAL char s[SLEN];
     char base[SLEN], ext[SLEN];
     splitpath(path, NULL, NULL, base, ext);
     sprintf(s, "%s%s", base, ext);
@@ -77,7 +77,7 @@ const char* BaseExt(const char* path)
 
 const char* Base(const char* path)
 {
-    static char s[SLEN];
+    static THREAD_LOCAL char s[SLEN];
     splitpath(path, NULL, NULL, s, NULL);
     return s;
 }
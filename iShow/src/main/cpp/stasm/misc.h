@@ -94,6 +94,16 @@ static const unsigned C_YELLOW = 0xffff00;
           }
 #endif
 
+// Storage class for the few scratch buffers and error strings that must be
+// private to each thread so that multiple stasm_ctx's can search concurrently.
+// (Visual Studio 2015 is the first Microsoft compiler with thread_local.)
+
+#if _MSC_VER && _MSC_VER < 1900
+  #define THREAD_LOCAL __declspec(thread)
+#else
+  #define THREAD_LOCAL thread_local
+#endif
+
 // A macro to disallow the copy constructor and operator= functions.
 // This is used in the private declarations for a class where those member
 // functions have not been explicitly defined.  This macro prevents use of
@@ -1,4 +1,5 @@
 // pinstart.cpp: utilities for creating a start shape from manually pinned points
+//               or from the shape in the previous video frame
 //
 // Copyright (C) 2005-2013, Stephen Milborrow
 
@@ -291,4 +292,35 @@ void PinnedStartShapeAndRoi(   // use the pinned landmarks to init the start sha
     }
 }
 
+// Use the shape found in the previous video frame as the start shape.  No
+// face, eye or mouth detectors are run: the pose is estimated from the
+// shape itself and the ROI is taken around it.  Unlike the pinned case only
+// the ROI is flipped for left facing faces, not the entire image, as
+// StartShapeAndRoi does.
+
+void TrackStartShapeAndRoi(    // use the previous shape to init the start shape
+    Shape&         startshape, // out: the start shape (in ROI frame)
+    Image&         face_roi,   // out: ROI around face, possibly rotated upright
+    DetectorParameter& detpar_roi, // out: detpar wrt to face_roi
+    DetectorParameter& detpar,     // out: detpar wrt to img
+    const Image&   img,        // in: the image (grayscale)
+    const vec_Mod& mods,       // in: a vector of models, one for each yaw range
+    const Shape&   prevshape)  // in: shape in the previous frame, in img frame
+{
+    double rot, yaw;
+    EstRotAndYawFrom5PointShape(rot, yaw,
+                                Shape5(prevshape, mods[0]->MeanShape_()));
+    detpar = PseudoDetParFromStartShape(prevshape, rot, yaw, NSIZE(mods));
+    if (trace_g)
+        lprintf("%-6.6s yaw %3.0f rot %3.0f ", EyawAsString(detpar.eyaw), yaw, rot);
+    FaceRoiAndDetectorParameter(face_roi, detpar_roi, img, detpar, false);
+    startshape = ImgShapeToRoiFrame(prevshape, detpar_roi, detpar);
+    if (IsLeftFacing(detpar.eyaw)) // our models are for right facing faces
+    {
+        FlipImgInPlace(face_roi);
+        startshape = FlipShape(startshape, face_roi.cols);
+    }
+    JitterPointsAt00InPlace(startshape);
+}
+
 } // namespace stasm
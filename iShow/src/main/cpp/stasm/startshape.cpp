@@ -481,24 +481,25 @@ double EyeAngle(        // eye angle in degrees, INVALID if eye angle not availa
 // (Note also that the ROI is flipped if necessary because our three-quarter
 // models are right facing and the face may be left facing.)
 
-static void StartShapeAndRoi(  // we have the facerect, now get the rest
+void StartShapeAndRoi(         // we have the facerect, now get the rest
     Shape&         startshape, // out: the start shape we are looking for
     Image&         face_roi,   // out: ROI around face, possibly rotated upright
     DetectorParameter&        detpar_roi, // out: detpar wrt to face_roi
     DetectorParameter&        detpar,     // io:  detpar wrt to img (has face rect on entry)
     const Image&   img,        // in:  the image (grayscale)
-    const vec_Mod& mods)       // in:  a vector of models, one for each yaw range
+    const vec_Mod& mods,       // in:  a vector of models, one for each yaw range
                                //       (use only estart, and meanshape)
+    EyeMouthDetectors& eyemouth) // in: the eye and mouth detectors
 {
     PossiblySetRotToZero(detpar.rot);          // treat small rots as zero rots
 
     FaceRoiAndDetectorParameter(face_roi, detpar_roi,     // get ROI around face
                      img, detpar, false);
 
-    DetectEyesAndMouth(detpar_roi, face_roi);  // use OpenCV eye and mouth detectors
+    DetectEyesAndMouth(detpar_roi, eyemouth, face_roi);  // use OpenCV eye and mouth detectors
 
     // Some face detectors return the face rotation, some don't (in
-    // the call to NextFace_ just made via NextStartShapeAndRoi).
+    // the detpar passed in by the caller, which came from NextFace_ or Face_).
     // If we don't have the rotation, then estimate it from the eye
     // angle, if the eyes are available.
 
@@ -517,7 +518,7 @@ static void StartShapeAndRoi(  // we have the facerect, now get the rest
             face_roi = Image(0,0);
 
             FaceRoiAndDetectorParameter(face_roi, detpar_roi, img, detpar, false);
-            DetectEyesAndMouth(detpar_roi, face_roi);  // use OpenCV eye and mouth detectors
+            DetectEyesAndMouth(detpar_roi, eyemouth, face_roi);  // use OpenCV eye and mouth detectors
         }
     }
     TraceEyesMouth(face_roi, detpar_roi);
@@ -544,35 +545,4 @@ static void StartShapeAndRoi(  // we have the facerect, now get the rest
     JitterPointsAt00InPlace(startshape);
 }
 
-// Get the start shape for the next face in the image, and the ROI around it.
-// The returned shape is wrt the ROI frame.
-//
-// Note that we we previously called the face detector, and the face
-// rectangle(s) were saved privately in facedet, and are now ready for
-// immediate retrieval by NextFace_.
-//
-// The following comment applies for three-quarter models (not for frontal
-// models): If the three-quarter face is left-facing, we flip the ROI so
-// the returned face is right-facing.  This is because our three-quarter
-// ASM models are for right-facing faces.  For frontal faces (the yaw00
-// model), faces are not flipped.
-
-bool NextStartShapeAndRoi(     // use face detector results to estimate start shape
-    Shape&         startshape, // out: the start shape
-    Image&         face_roi,   // out: ROI around face, possibly rotated upright
-    DetectorParameter&        detpar_roi, // out: detpar wrt to face_roi
-    DetectorParameter&        detpar,     // out: detpar wrt to img
-    const Image&   img,        // in:  the image (grayscale)
-    const vec_Mod& mods,       // in:  a vector of models, one for each yaw range
-                               //       (use only estart, and meanshape)
-    FaceDetector&       facedet)    // io:  the face detector (internal face index bumped)
-{
-    detpar = facedet.NextFace_();  // get next face's detpar from the face det
-
-    if (Valid(detpar.x))           // NextFace_ returned a face?
-        StartShapeAndRoi(startshape, face_roi, detpar_roi, detpar, img, mods);
-
-    return Valid(detpar.x);
-}
-
 } // namespace stasm
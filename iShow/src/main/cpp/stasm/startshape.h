@@ -24,16 +24,16 @@ double EyeAngle(           // eye angle in degrees, INVALID if eye angle not ava
 double EyeAngle(           // eye angle in degrees, INVALID if eye angle not available
     const Shape& shape);   // in
 
-// get the start shape for the next face in the image, and the ROI around it
+// get the start shape for a face found by the face detector, and the ROI around it
 
-bool NextStartShapeAndRoi(          // use face detector results to estimate start shape
+void StartShapeAndRoi(              // start shape for a face from the face detector
     Shape&              startshape, // out: the start shape we are looking for
     Image&              face_roi,   // out: ROI around face, possibly rotated upright
     DetectorParameter&  detpar_roi, // out: detpar wrt to face_roi
-    DetectorParameter&  detpar,     // out: detpar wrt to img
+    DetectorParameter&  detpar,     // io:  detpar wrt to img (has face rect on entry)
     const Image&        img,        // in: the image (grayscale)
     const vec_Mod&      mods,       // in: a vector of models, one for each yaw range
-    FaceDetector&       facedet);   // io:  the face detector (internal face index bumped)
+    EyeMouthDetectors&  eyemouth);  // in:  the eye and mouth detectors
 
 void PinnedStartShapeAndRoi(   // use the pinned landmarks to init the start shape
     Shape&         startshape, // out: the start shape (in ROI frame)
@@ -51,6 +51,9 @@ static const char* const STASM_VERSION = "4.1.0"
 #include <string>
 #include <functional>
 #include <algorithm>
+#include <memory>
+#include <atomic>
+#include <mutex>
 #if _OPENMP
 #include <omp.h>
 #endif
@@ -13,20 +13,61 @@ using namespace stasm;
 
 const char* const stasm_VERSION = STASM_VERSION;
 
-static vec_Mod mods_g;    // the ASM model(s)
-static FaceDetector facedet_g; // the face detector
+// The per-image state.  Everything here is private to one context.
+// The ASM models are read-only after stasm_init and shared by all contexts.
+
+struct stasm_ctx
+{
+    Image             img;      // the current image
+    FaceDetector      facedet;  // face detector and the faces it found in img
+    EyeMouthDetectors eyemouth; // eye and mouth detectors
+    HatLevData        hatdata;  // HAT grads and descriptor cache, reused per search
+
+    int ntrack_fine   = 0;      // frames tracked with only the fine pyr levs
+    int ntrack_full   = 0;      // frames tracked with the full pyramid
+    int ntrack_detect = 0;      // frames where the face had to be detected
+};
+
+static vec_Mod mods_g;          // the ASM model(s), shared by all contexts
+static string datadir_g;        // directory of face detector files
+static void* detparams_g;       // face detector parameters passed to stasm_init_ext
+static stasm_ctx* ctx_g;        // the default context, used by stasm_open_image etc.
+static std::mutex init_mutex_g; // serializes stasm_init_ext
 
 //-----------------------------------------------------------------------------
 
 namespace stasm
 {
-static Image img_g;     // the current image
 static void CheckStasmInit(void)
 {
-    if (mods_g.empty())
+    if (mods_g.empty() || !ctx_g)
         Err("Models not initialized (missing call to stasm_init?)");
 }
 
+static void CheckCtx(     // check that stasm_init was called and ctx is valid
+    const stasm_ctx* ctx) // in
+{
+    CheckStasmInit();
+    if (!ctx)
+        Err("NULL stasm_ctx (missing call to stasm_ctx_create?)");
+}
+
+static stasm_ctx* NewCtx(void) // new context with its own detectors
+{
+    stasm_ctx* ctx = new stasm_ctx;
+    try
+    {
+        ctx->facedet.OpenFaceDetector_(datadir_g.c_str(), detparams_g);
+        OpenEyeMouthDetectors(ctx->eyemouth, mods_g, datadir_g.c_str());
+    }
+    catch(...)
+    {
+        delete ctx;
+        throw;
+    }
+    return ctx;
+}
+
 static void ShapeToLandmarks( // convert Shape to landmarks (float *)
     float*       landmarks,   // out
     const Shape& shape)       // in
@@ -58,6 +99,135 @@ static const Shape LandmarksAsShape( // return a Shape
     return shape;
 }
 
+static void SearchFace(            // ASM search of a face found by the face detector
+    float*            landmarks,   // out: x0, y0, x1, y1, ..., caller must allocate
+    float*            estyaw,      // out: NULL or pointer to estimated yaw
+    stasm_ctx*        ctx,         // io:  supplies the eye detectors and HAT data
+    const Image&      img,         // in:  the image (grayscale)
+    DetectorParameter detpar)      // in:  the face rect, in img frame
+{
+    Shape shape;       // the shape with landmarks
+    Image face_roi;    // cropped to area around startshape and possibly rotated
+    DetectorParameter detpar_roi; // detpar translated to ROI frame
+
+    // Get the start shape for the face, and the ROI around it.
+    // The shape will be wrt the ROI frame.
+    StartShapeAndRoi(shape, face_roi, detpar_roi, detpar, img, mods_g, ctx->eyemouth);
+
+    // now working with maybe flipped ROI and start shape in ROI frame
+    if (trace_g)   // show start shape?
+        LogShape(RoiShapeToImgFrame(shape, face_roi, detpar_roi, detpar),
+                 "auto_start");
+
+    // select an ASM model based on the face's yaw
+    const int imod = ABS(EyawAsModIndex(detpar.eyaw, mods_g));
+
+    // do the actual ASM search
+    shape = mods_g[imod]->ModSearch_(ctx->hatdata, shape, face_roi);
+#if TRACE_IMAGES
+    CImage cimg; cvtColor(face_roi, cimg, CV_GRAY2BGR); // color image
+    DrawShape(cimg, shape);
+    char s[SLEN]; sprintf(s, "%s_90_roishape.bmp", Base(imgpath_g));
+    lprintf("%s\n", s);
+    if (!cv::imwrite(s, cimg))
+        Err("Cannot write %s", s);
+#endif
+    shape = RoundMat(RoiShapeToImgFrame(shape, face_roi, detpar_roi, detpar));
+    // now working with non flipped start shape in image frame
+    ShapeToLandmarks(landmarks, shape);
+    if (estyaw)
+        *estyaw = float(detpar.yaw);
+}
+
+// When tracking a face in a video, the shape found in the previous frame
+// is a far better start shape than the face detector can give.  So the
+// cascades are skipped, and if the face barely moved only the finest pyr
+// levs are searched.  The thresholds are fractions of the eye-mouth
+// distance of the previous shape.
+//
+// Motion alone can't tell that the face is lost: started on the previous
+// shape, the search returns a similar shape wherever the face went.  So the
+// misfit of the search (see Mod::LevSearch_) is checked too.  On a face it
+// is typically one or two pixels at the standard eye-mouth distance of
+// EYEMOUTH_DIST=100, and it can't exceed the diagonal of the descriptor
+// search grid (HAT_MAX_OFFSET*sqrt(2), under 6 pixels).
+
+static const int    TRACK_NLEVS        = 2;    // pyr levs searched for small motion
+static const double TRACK_MAX_MOTION   = .05;  // max mean motion for the TRACK_NLEVS search
+static const double TRACK_MAX_LOST     = .30;  // more than this and the face is lost
+static const double TRACK_MAX_SCALE    = 1.25; // max change of face size between frames
+static const double TRACK_MAX_MISFIT   = .035; // more than this and the shape is not on a face
+static const double TRACK_MIN_EYEMOUTH = 10;   // pixels, smaller prev shapes are not tracked
+
+static bool FitsPrevShape(         // true if shape is a plausible successor of prevshape
+    const Shape& shape,            // in
+    const Shape& prevshape,        // in
+    double       maxmotion,        // in: max mean landmark motion
+    int          ncols,            // in: image width
+    int          nrows)            // in: image height
+{
+    const double eyemouth = EyeMouthDist(prevshape);
+    const double scale = EyeMouthDist(shape) / eyemouth;
+    if (scale > TRACK_MAX_SCALE || scale < 1 / TRACK_MAX_SCALE)
+        return false;
+
+    double motion = 0, xmean = 0, ymean = 0;
+    for (int i = 0; i < shape.rows; i++)
+    {
+        motion += sqrt(SQ(shape(i, IX) - prevshape(i, IX)) +
+                       SQ(shape(i, IY) - prevshape(i, IY)));
+        xmean += shape(i, IX);
+        ymean += shape(i, IY);
+    }
+    xmean /= shape.rows;
+    ymean /= shape.rows;
+
+    return motion / (shape.rows * eyemouth) <= maxmotion &&
+           xmean >= 0 && xmean < ncols && ymean >= 0 && ymean < nrows;
+}
+
+static int TrackFace(              // returns nbr of pyr levs searched, 0 if face lost
+    float*            landmarks,   // out: x0, y0, x1, y1, ..., unchanged if face lost
+    stasm_ctx*        ctx,         // io:  supplies the image and HAT data
+    const Shape&      prevshape)   // in:  the shape in the previous frame
+{
+    Shape startshape;  // prevshape in ROI frame
+    Image face_roi;    // cropped to area around prevshape and possibly rotated
+    DetectorParameter detpar_roi; // detpar translated to ROI frame
+    DetectorParameter detpar;     // pseudo detpar around prevshape, in img frame
+
+    TrackStartShapeAndRoi(startshape, face_roi, detpar_roi, detpar,
+                          ctx->img, mods_g, prevshape);
+
+    const Mod* mod = mods_g[ABS(EyawAsModIndex(detpar.eyaw, mods_g))];
+
+    int nlevs = TRACK_NLEVS;
+    double misfit;
+    Shape shape(mod->ModSearch_(ctx->hatdata, startshape, face_roi, NULL, nlevs, &misfit));
+    shape = RoundMat(RoiShapeToImgFrame(shape, face_roi, detpar_roi, detpar));
+
+    if (misfit > TRACK_MAX_MISFIT ||
+        !FitsPrevShape(shape, prevshape, TRACK_MAX_MOTION, ctx->img.cols, ctx->img.rows))
+    {
+        // the face moved too much for the fine levs alone, search the full pyramid
+        nlevs = N_PYR_LEVS;
+        shape = mod->ModSearch_(ctx->hatdata, startshape, face_roi, NULL, nlevs, &misfit);
+        shape = RoundMat(RoiShapeToImgFrame(shape, face_roi, detpar_roi, detpar));
+
+        if (misfit > TRACK_MAX_MISFIT ||
+            !FitsPrevShape(shape, prevshape, TRACK_MAX_LOST, ctx->img.cols, ctx->img.rows))
+        {
+            if (trace_g)
+                lprintf("[track lost misfit %.3f] ", misfit);
+            return 0;
+        }
+    }
+    if (trace_g)
+        lprintf("[track nlevs %d misfit %.3f] ", nlevs, misfit);
+    ShapeToLandmarks(landmarks, shape);
+    return nlevs;
+}
+
 } // namespace stasm
 
 //-----------------------------------------------------------------------------
@@ -69,11 +239,12 @@ int stasm_init_ext(        // extended version of stasm_init
 {
     int returnval = 1;     // assume success
     CatchOpenCvErrs();
+    std::lock_guard<std::mutex> lock(init_mutex_g);
     try
     {
         print_g = (trace != 0);
         trace_g = (trace != 0);
-        if (mods_g.empty()) // not yet initialized?
+        if (!ctx_g) // not yet initialized?
         {
             if (trace)
             {
@@ -86,8 +257,9 @@ int stasm_init_ext(        // extended version of stasm_init
                     stasm_VERSION, trace? "  Logging to stasm.log": "");
             CV_Assert(datadir && datadir[0] && STRNLEN(datadir, SLEN) < SLEN);
             InitMods(mods_g, datadir); // init ASM model(s)
-            facedet_g.OpenFaceDetector_(datadir, detparams);
-            OpenEyeMouthDetectors(mods_g, datadir);
+            datadir_g = datadir;
+            detparams_g = detparams;
+            ctx_g = NewCtx();
         }
         CheckStasmInit();
     }
@@ -106,8 +278,9 @@ int stasm_init(            // call once, at bootup (to read models from disk)
     return stasm_init_ext(datadir, trace, NULL);
 }
 
-int stasm_open_image_ext(  // extended version of stasm_open_image
-    const char* image,       // in: gray image data, top left corner at 0,0
+int stasm_ctx_open_image_ext( // extended version of stasm_ctx_open_image
+    stasm_ctx*  ctx,       // io
+    const char* image,     // in: gray image data, top left corner at 0,0
     int         width,     // in: image width
     int         height,    // in: image height
     const char* imgpath,   // in: image path, used only for err msgs and debug
@@ -123,15 +296,15 @@ int stasm_open_image_ext(  // extended version of stasm_open_image
         CV_Assert(multiface == 0 || multiface == 1);
         CV_Assert(minwidth >= 1 && minwidth <= 100);
 
-        CheckStasmInit();
+        CheckCtx(ctx);
 
-        img_g = Image(height, width,(unsigned char*)image);
+        ctx->img = Image(height, width,(unsigned char*)image);
 
 #if TRACE_IMAGES
         strcpy(imgpath_g, imgpath); // save the image path (for naming debug images)
 #endif
         // call the face detector to detect the face rectangle(s)
-        facedet_g.DetectFaces_(img_g, imgpath, multiface == 1, minwidth, user);
+        ctx->facedet.DetectFaces_(ctx->img, imgpath, multiface == 1, minwidth, user);
     }
     catch(...)
     {
@@ -141,6 +314,32 @@ int stasm_open_image_ext(  // extended version of stasm_open_image
     return returnval;
 }
 
+int stasm_ctx_open_image(  // like stasm_open_image, but for the given context
+    stasm_ctx*  ctx,       // io
+    const char* image,     // in: gray image data, top left corner at 0,0
+    int         width,     // in: image width
+    int         height,    // in: image height
+    const char* imgpath,   // in: image path, used only for err msgs and debug
+    int         multiface, // in: 0=return only one face, 1=allow multiple faces
+    int         minwidth)  // in: min face width as percentage of img width
+{
+    return stasm_ctx_open_image_ext(ctx, image, width, height, imgpath,
+                                    multiface, minwidth, NULL);
+}
+
+int stasm_open_image_ext(  // extended version of stasm_open_image
+    const char* image,     // in: gray image data, top left corner at 0,0
+    int         width,     // in: image width
+    int         height,    // in: image height
+    const char* imgpath,   // in: image path, used only for err msgs and debug
+    int         multiface, // in: 0=return only one face, 1=allow multiple faces
+    int         minwidth,  // in: min face width as percentage of img width
+    void*       user)      // in: NULL or pointer to user abort func
+{
+    return stasm_ctx_open_image_ext(ctx_g, image, width, height, imgpath,
+                                    multiface, minwidth, user);
+}
+
 int stasm_open_image(      // call once per image, detect faces
     const char* image,     // in: gray image data, top left corner at 0,0
     int         width,     // in: image width
@@ -153,7 +352,8 @@ int stasm_open_image(      // call once per image, detect faces
                                 multiface, minwidth, NULL);
 }
 
-int stasm_search_auto_ext( // extended version of stasm_search_auto
+int stasm_ctx_search_auto_ext( // extended version of stasm_ctx_search_auto
+    stasm_ctx* ctx,        // io
     int*   foundface,      // out: 0=no more faces, 1=found face
     float* landmarks,      // out: x0, y0, x1, y1, ..., caller must allocate
     float* estyaw)         // out: NULL or pointer to estimated yaw
@@ -163,46 +363,61 @@ int stasm_search_auto_ext( // extended version of stasm_search_auto
     CatchOpenCvErrs();
     try
     {
-        CheckStasmInit();
+        CheckCtx(ctx);
 
-        if (img_g.rows == 0 || img_g.cols == 0)
+        if (ctx->img.rows == 0 || ctx->img.cols == 0)
             Err("Image not open (missing call to stasm_open_image?)");
 
-        Shape shape;       // the shape with landmarks
-        Image face_roi;    // cropped to area around startshape and possibly rotated
-        DetectorParameter detpar_roi; // detpar translated to ROI frame
-        DetectorParameter detpar;     // params returned by face det, in img frame
-
-        // Get the start shape for the next face in the image, and the ROI around it.
-        // The shape will be wrt the ROI frame.
-        if (NextStartShapeAndRoi(shape, face_roi, detpar_roi, detpar,
-                                 img_g, mods_g, facedet_g))
+        DetectorParameter detpar(ctx->facedet.NextFace_()); // next face from face det
+        if (Valid(detpar.x))
         {
-            // now working with maybe flipped ROI and start shape in ROI frame
             *foundface = 1;
-            if (trace_g)   // show start shape?
-                LogShape(RoiShapeToImgFrame(shape, face_roi, detpar_roi, detpar),
-                         "auto_start");
+            SearchFace(landmarks, estyaw, ctx, ctx->img, detpar);
+        }
+    }
+    catch(...)
+    {
+        returnval = 0; // a call was made to Err or a CV_Assert failed
+    }
+    UncatchOpenCvErrs();
+    return returnval;
+}
 
-            // select an ASM model based on the face's yaw
-            const int imod = ABS(EyawAsModIndex(detpar.eyaw, mods_g));
+int stasm_ctx_search_auto( // like stasm_search_auto, but for the given context
+    stasm_ctx* ctx,        // io
+    int*   foundface,      // out: 0=no more faces, 1=found face
+    float* landmarks)      // out: x0, y0, x1, y1, ..., caller must allocate
+{
+    return stasm_ctx_search_auto_ext(ctx, foundface, landmarks, NULL);
+}
 
-            // do the actual ASM search
-            shape = mods_g[imod]->ModSearch_(shape, face_roi);
-#if TRACE_IMAGES
-            CImage cimg; cvtColor(face_roi, cimg, CV_GRAY2BGR); // color image
-            DrawShape(cimg, shape);
-            char s[SLEN]; sprintf(s, "%s_90_roishape.bmp", Base(imgpath_g));
-            lprintf("%s\n", s);
-            if (!cv::imwrite(s, cimg))
-                Err("Cannot write %s", s);
-#endif
-            shape = RoundMat(RoiShapeToImgFrame(shape, face_roi, detpar_roi, detpar));
-            // now working with non flipped start shape in image frame
-            ShapeToLandmarks(landmarks, shape);
-            if (estyaw)
-                *estyaw = float(detpar.yaw);
-        }
+int stasm_ctx_nfaces(        // number of faces found by stasm_ctx_open_image
+    const stasm_ctx* ctx)    // in
+{
+    return ctx? ctx->facedet.NFaces_(): 0;
+}
+
+int stasm_ctx_search_face(   // ASM search of one of the faces found in detctx
+    stasm_ctx*       ctx,    // io: does the search, can be detctx
+    const stasm_ctx* detctx, // in: context that opened the image
+    int          iface,      // in: 0 <= iface < stasm_ctx_nfaces(detctx)
+    float*       landmarks)  // out: x0, y0, x1, y1, ..., caller must allocate
+{
+    int returnval = 1;     // assume success
+    CatchOpenCvErrs();
+    try
+    {
+        CheckCtx(ctx);
+        CheckCtx(detctx);
+
+        if (detctx->img.rows == 0 || detctx->img.cols == 0)
+            Err("Image not open (missing call to stasm_ctx_open_image?)");
+
+        if (iface < 0 || iface >= detctx->facedet.NFaces_())
+            Err("Face index %d out of range (the image has %d faces)",
+                iface, detctx->facedet.NFaces_());
+
+        SearchFace(landmarks, NULL, ctx, detctx->img, detctx->facedet.Face_(iface));
     }
     catch(...)
     {
@@ -212,6 +427,14 @@ int stasm_search_auto_ext( // extended version of stasm_search_auto
     return returnval;
 }
 
+int stasm_search_auto_ext( // extended version of stasm_search_auto
+    int*   foundface,      // out: 0=no more faces, 1=found face
+    float* landmarks,      // out: x0, y0, x1, y1, ..., caller must allocate
+    float* estyaw)         // out: NULL or pointer to estimated yaw
+{
+    return stasm_ctx_search_auto_ext(ctx_g, foundface, landmarks, estyaw);
+}
+
 int stasm_search_auto( // call repeatedly to find all faces
     int*   foundface,  // out: 0=no more faces, 1=found face
     float* landmarks)  // out: x0, y0, x1, y1, ..., caller must allocate
@@ -238,7 +461,8 @@ int stasm_search_single(   // wrapper for stasm_search_auto and friends
     return stasm_search_auto(foundface, landmarks);
 }
 
-int stasm_search_pinned(    // call after the user has pinned some points
+int stasm_ctx_search_pinned( // like stasm_search_pinned, but for the given context
+    stasm_ctx*   ctx,       // io
     float*       landmarks, // out: x0, y0, x1, y1, ..., caller must allocate
     const float* pinned,    // in: pinned landmarks (0,0 points not pinned)
     const char*  image,     // in: gray image data, top left corner at 0,0
@@ -251,9 +475,9 @@ int stasm_search_pinned(    // call after the user has pinned some points
     try
     {
         CV_Assert(imgpath && STRNLEN(imgpath, SLEN) < SLEN);
-        CheckStasmInit();
+        CheckCtx(ctx);
 
-        img_g = Image(height, width, (unsigned char*)image);
+        ctx->img = Image(height, width, (unsigned char*)image);
 
         const Shape pinnedshape(LandmarksAsShape(pinned));
 
@@ -264,12 +488,13 @@ int stasm_search_pinned(    // call after the user has pinned some points
         DetectorParameter detpar;     // params returned by pseudo face det, in img frame
 
         PinnedStartShapeAndRoi(shape, face_roi, detpar_roi, detpar, pinned_roi,
-                               img_g, mods_g, pinnedshape);
+                               ctx->img, mods_g, pinnedshape);
 
         // now working with maybe flipped ROI and start shape in ROI frame
         const int imod = ABS(EyawAsModIndex(detpar.eyaw, mods_g));
 
-        shape = mods_g[imod]->ModSearch_(shape, face_roi, &pinned_roi); // ASM search
+        shape = mods_g[imod]->ModSearch_(ctx->hatdata, // ASM search
+                                         shape, face_roi, &pinned_roi);
 
         shape = RoundMat(RoiShapeToImgFrame(shape, face_roi, detpar_roi, detpar));
         // now working with non flipped start shape in image frame
@@ -286,6 +511,146 @@ int stasm_search_pinned(    // call after the user has pinned some points
     return returnval;
 }
 
+int stasm_search_pinned(    // call after the user has pinned some points
+    float*       landmarks, // out: x0, y0, x1, y1, ..., caller must allocate
+    const float* pinned,    // in: pinned landmarks (0,0 points not pinned)
+    const char*  image,     // in: gray image data, top left corner at 0,0
+    int          width,     // in: image width
+    int          height,    // in: image height
+    const char*  imgpath)   // in: image path, used only for err msgs and debug
+{
+    return stasm_ctx_search_pinned(ctx_g, landmarks, pinned,
+                                   image, width, height, imgpath);
+}
+
+int stasm_ctx_track(            // track a face in a video, detect it only if lost
+    stasm_ctx*   ctx,            // io
+    int*         foundface,      // out: 0=no face, 1=found face
+    float*       landmarks,      // out: x0, y0, x1, y1, ..., caller must allocate
+    const float* prevlandmarks,  // in: landmarks in the previous frame, NULL if none
+    const char*  image,          // in: gray image data, top left corner at 0,0
+    int          width,          // in: image width
+    int          height,         // in: image height
+    const char*  imgpath,        // in: image path, used only for err msgs and debug
+    int          minwidth)       // in: min face width as percentage of img width
+{
+    int returnval = 1;     // assume success
+    *foundface = 0;        // but assume no face found
+    CatchOpenCvErrs();
+    try
+    {
+        CV_Assert(imgpath && STRNLEN(imgpath, SLEN) < SLEN);
+        CV_Assert(minwidth >= 1 && minwidth <= 100);
+        CheckCtx(ctx);
+
+        ctx->img = Image(height, width, (unsigned char*)image);
+
+        int nlevs = 0;     // stays 0 if there is no face to track or it was lost
+        if (prevlandmarks)
+        {
+            Shape prevshape(LandmarksAsShape(prevlandmarks));
+            JitterPointsAt00InPlace(prevshape); // points forced into the img corner
+            if (EyeMouthDist(prevshape) >= TRACK_MIN_EYEMOUTH) // not all zeros?
+                nlevs = TrackFace(landmarks, ctx, prevshape);
+        }
+
+        if (nlevs)
+        {
+            *foundface = 1;
+            if (nlevs == N_PYR_LEVS)
+                ctx->ntrack_full++;
+            else
+                ctx->ntrack_fine++;
+        }
+        else // detect the face all over again, as stasm_search_single does
+        {
+            ctx->ntrack_detect++;
+            ctx->facedet.DetectFaces_(ctx->img, imgpath, false, minwidth, NULL);
+            DetectorParameter detpar(ctx->facedet.NextFace_());
+            if (Valid(detpar.x))
+            {
+                *foundface = 1;
+                SearchFace(landmarks, NULL, ctx, ctx->img, detpar);
+            }
+        }
+    }
+    catch(...)
+    {
+        returnval = 0; // a call was made to Err or a CV_Assert failed
+    }
+    UncatchOpenCvErrs();
+    return returnval;
+}
+
+int stasm_track(                 // stasm_ctx_track with the default context
+    int*         foundface,      // out: 0=no face, 1=found face
+    float*       landmarks,      // out: x0, y0, x1, y1, ..., caller must allocate
+    const float* prevlandmarks,  // in: landmarks in the previous frame, NULL if none
+    const char*  image,          // in: gray image data, top left corner at 0,0
+    int          width,          // in: image width
+    int          height,         // in: image height
+    const char*  imgpath,        // in: image path, used only for err msgs and debug
+    int          minwidth)       // in: min face width as percentage of img width
+{
+    return stasm_ctx_track(ctx_g, foundface, landmarks, prevlandmarks,
+                           image, width, height, imgpath, minwidth);
+}
+
+void stasm_ctx_track_stats( // how stasm_ctx_track found the faces
+    stasm_ctx* ctx,         // io
+    int*       nfine,       // out: can be NULL, frames tracked with the fine pyr levs
+    int*       nfull,       // out: can be NULL, frames tracked with the full pyramid
+    int*       ndetect,     // out: can be NULL, frames where the face was detected
+    int        reset)       // in: 1 to zero the counts after reading them
+{
+    if (nfine)
+        *nfine = ctx? ctx->ntrack_fine: 0;
+    if (nfull)
+        *nfull = ctx? ctx->ntrack_full: 0;
+    if (ndetect)
+        *ndetect = ctx? ctx->ntrack_detect: 0;
+    if (ctx && reset)
+        ctx->ntrack_fine = ctx->ntrack_full = ctx->ntrack_detect = 0;
+}
+
+stasm_ctx* stasm_ctx_create(void) // call after stasm_init, returns NULL on error
+{
+    stasm_ctx* ctx = NULL;
+    CatchOpenCvErrs();
+    try
+    {
+        CheckStasmInit();
+        ctx = NewCtx();
+    }
+    catch(...)
+    {
+        ctx = NULL; // a call was made to Err or a CV_Assert failed
+    }
+    UncatchOpenCvErrs();
+    return ctx;
+}
+
+void stasm_ctx_destroy( // free a context created by stasm_ctx_create
+    stasm_ctx* ctx)     // in: can be NULL
+{
+    if (ctx != ctx_g)   // the default context lives until program exit
+        delete ctx;
+}
+
+void stasm_ctx_hat_cache_stats( // HAT descriptor cache hits and misses
+    stasm_ctx* ctx,         // io
+    int*       nhits,       // out: can be NULL
+    int*       nmisses,     // out: can be NULL
+    int        reset)       // in: 1 to zero the counts after reading them
+{
+    if (nhits)
+        *nhits = ctx? ctx->hatdata.NHits_(): 0;
+    if (nmisses)
+        *nmisses = ctx? ctx->hatdata.NMisses_(): 0;
+    if (ctx && reset)
+        ctx->hatdata.ResetStats_();
+}
+
 const char* stasm_lasterr(void) // same as LastErr but not in stasm namespace
 {
     return LastErr(); // return the last error message (stashed in sgErr)
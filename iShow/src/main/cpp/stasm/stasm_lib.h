@@ -23,6 +23,13 @@
 // The interface is defined in vanilla C so can be used by code
 // in "any" language.
 //
+// Multithreaded usage: the functions above use one default context, so
+// only one image can be processed at a time.  To process images in
+// parallel, create a context per thread with stasm_ctx_create and use the
+// stasm_ctx_ functions.  The ASM models are loaded once by stasm_init and
+// shared by all contexts.  A context must not be used by two threads at once.
+// stasm_lasterr returns the last error in the calling thread.
+//
 //-----------------------------------------------------------------------------
 //
 //               Stasm License Agreement
@@ -102,6 +109,81 @@ int stasm_search_pinned(     // call after the user has pinned some points
     int          height,     // in: image height
     const char* imgpath);   // in: image path, used only for err msgs and debug
 
+// reentrant interface, each context holds the state for one image
+
+typedef struct stasm_ctx stasm_ctx; // opaque
+
+stasm_ctx* stasm_ctx_create(void); // call after stasm_init, returns NULL on error
+
+void stasm_ctx_destroy(      // free a context created by stasm_ctx_create
+    stasm_ctx*   ctx);       // in: can be NULL
+
+int stasm_ctx_open_image(    // like stasm_open_image, but for the given context
+    stasm_ctx*   ctx,        // io
+    const char*  img,        // in: gray image data, top left corner at 0,0
+    int          width,      // in: image width
+    int          height,     // in: image height
+    const char*  imgpath,    // in: image path, used only for err msgs and debug
+    int          multiface,  // in: 0=return only one face, 1=allow multiple faces
+    int          minwidth);  // in: min face width as percentage of img width
+
+int stasm_ctx_search_auto(   // like stasm_search_auto, but for the given context
+    stasm_ctx*   ctx,        // io
+    int*         foundface,  // out: 0=no more faces, 1=found face
+    float*       landmarks); // out: x0, y0, x1, y1, ..., caller must allocate
+
+int stasm_ctx_search_pinned( // like stasm_search_pinned, but for the given context
+    stasm_ctx*   ctx,        // io
+    float*       landmarks,  // out: x0, y0, x1, y1, ..., caller must allocate
+    const float* pinned,     // in: pinned landmarks (0,0 points not pinned)
+    const char*  img,        // in: gray image data, top left corner at 0,0
+    int          width,      // in: image width
+    int          height,     // in: image height
+    const char*  imgpath);   // in: image path, used only for err msgs and debug
+
+// To spread the faces of one image across threads, open the image with
+// one context and then call stasm_ctx_search_face from each thread with
+// that thread's own context.  The opening context (detctx) is only read,
+// and must not be reopened until all the searches are done.
+
+int stasm_ctx_nfaces(        // number of faces found by stasm_ctx_open_image
+    const stasm_ctx* ctx);   // in
+
+int stasm_ctx_search_face(   // ASM search of one of the faces found in detctx
+    stasm_ctx*       ctx,    // io: does the search, can be detctx
+    const stasm_ctx* detctx, // in: context that opened the image
+    int          iface,      // in: 0 <= iface < stasm_ctx_nfaces(detctx)
+    float*       landmarks); // out: x0, y0, x1, y1, ..., caller must allocate
+
+// Tracking a face in a video: pass the landmarks found in the previous
+// frame (NULL for the first frame) and the search starts from them, without
+// the face and feature detectors.  If the face moved little, only the finest
+// pyramid levels are searched.  If the result moved too far from the
+// previous shape, or the shape model fits the image poorly (the face was
+// lost), the face is detected as stasm_search_single does.  prevlandmarks
+// may be the same buffer as landmarks.
+
+int stasm_ctx_track(            // track a face in a video, detect it only if lost
+    stasm_ctx*   ctx,           // io
+    int*         foundface,     // out: 0=no face, 1=found face
+    float*       landmarks,     // out: x0, y0, x1, y1, ..., caller must allocate
+    const float* prevlandmarks, // in: landmarks in the previous frame, NULL if none
+    const char*  img,           // in: gray image data, top left corner at 0,0
+    int          width,         // in: image width
+    int          height,        // in: image height
+    const char*  imgpath,       // in: image path, used only for err msgs and debug
+    int          minwidth);     // in: min face width as percentage of img width
+
+int stasm_track(                // stasm_ctx_track with the default context
+    int*         foundface,     // out: 0=no face, 1=found face
+    float*       landmarks,     // out: x0, y0, x1, y1, ..., caller must allocate
+    const float* prevlandmarks, // in: landmarks in the previous frame, NULL if none
+    const char*  img,           // in: gray image data, top left corner at 0,0
+    int          width,         // in: image width
+    int          height,        // in: image height
+    const char*  imgpath,       // in: image path, used only for err msgs and debug
+    int          minwidth);     // in: min face width as percentage of img width
+
 const char* stasm_lasterr(void); // return string describing last error
 
 void stasm_force_points_into_image( // force landmarks into image boundary
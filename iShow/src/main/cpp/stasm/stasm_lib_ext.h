@@ -27,6 +27,37 @@ int stasm_search_auto_ext(   // extended version of stasm_search_auto
     float*       landmarks,  // out: x0, y0, x1, y1, ..., caller must allocate
     float*       estyaw);    // out: NULL or pointer to estimated yaw
 
+// HAT descriptor cache statistics, accumulated over all searches with
+// the context since it was created or since the last reset
+void stasm_ctx_hat_cache_stats(
+    stasm_ctx*   ctx,        // io
+    int*         nhits,      // out: can be NULL
+    int*         nmisses,    // out: can be NULL
+    int          reset);     // in: 1 to zero the counts after reading them
+
+void stasm_ctx_track_stats(   // how stasm_ctx_track found the faces
+    stasm_ctx*   ctx,        // io
+    int*         nfine,      // out: can be NULL, frames tracked with the fine pyr levs
+    int*         nfull,      // out: can be NULL, frames tracked with the full pyramid
+    int*         ndetect,    // out: can be NULL, frames where the face was detected
+    int          reset);     // in: 1 to zero the counts after reading them
+
+int stasm_ctx_open_image_ext( // extended version of stasm_ctx_open_image
+    stasm_ctx*   ctx,        // io
+    const char*  img,        // in: gray image data, top left corner at 0,0
+    int          width,      // in: image width
+    int          height,     // in: image height
+    const char*  imgpath,    // in: image path, used only for err msgs and debug
+    int          multiface,  // in: 0=return only one face, 1=allow multiple faces
+    int          minwidth,   // in: min face width as percentage of img width
+    void*        user);      // in: NULL or pointer to user abort func
+
+int stasm_ctx_search_auto_ext( // extended version of stasm_ctx_search_auto
+    stasm_ctx*   ctx,        // io
+    int*         foundface,  // out: 0=no more faces, 1=found face
+    float*       landmarks,  // out: x0, y0, x1, y1, ..., caller must allocate
+    float*       estyaw);    // out: NULL or pointer to estimated yaw
+
 
 }
 #endif // STASM_LIB_EXT_H
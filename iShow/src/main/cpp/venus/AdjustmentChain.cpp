@@ -0,0 +1,317 @@
+#include <assert.h>
+#include <algorithm>
+#include <cstring>
+
+#include "venus/AdjustmentChain.h"
+#include "venus/Effect.h"
+
+using namespace cv;
+
+namespace venus {
+
+constexpr int AdjustmentChain::GRID;
+
+AdjustmentChain::Stage::Stage(Type type):
+	type(type),
+	preserve_luminosity(false)
+{
+	std::fill(param, param + 9, 0.0F);
+}
+
+bool AdjustmentChain::Stage::operator==(const Stage& other) const
+{
+	return type == other.type && preserve_luminosity == other.preserve_luminosity &&
+			std::equal(param, param + 9, other.param);
+}
+
+AdjustmentChain::AdjustmentChain():
+	built(false)
+{
+}
+
+AdjustmentChain& AdjustmentChain::adjustBrightnessAndContrast(float brightness/* = 0.0F */, float contrast/* = 1.0F */)
+{
+	Stage stage(Stage::BRIGHTNESS_CONTRAST);
+	stage.param[0] = brightness;
+	stage.param[1] = contrast;
+	stages.push_back(stage);
+	return *this;
+}
+
+AdjustmentChain& AdjustmentChain::adjustGamma(float gamma)
+{
+	return adjustGamma(Vec3f(gamma, gamma, gamma));
+}
+
+AdjustmentChain& AdjustmentChain::adjustGamma(const cv::Vec3f& gamma)
+{
+	Stage stage(Stage::GAMMA);
+	for(int k = 0; k < 3; ++k)
+		stage.param[k] = gamma[k];
+	stages.push_back(stage);
+	return *this;
+}
+
+AdjustmentChain& AdjustmentChain::posterize(float level)
+{
+	Stage stage(Stage::POSTERIZE);
+	stage.param[0] = level;
+	stages.push_back(stage);
+	return *this;
+}
+
+AdjustmentChain& AdjustmentChain::adjustColorBalance(const cv::Vec3f config[3], bool preserve_luminosity)
+{
+	Stage stage(Stage::COLOR_BALANCE);
+	for(int i = 0; i < 3; ++i)
+	for(int k = 0; k < 3; ++k)
+		stage.param[i * 3 + k] = config[i][k];
+	stage.preserve_luminosity = preserve_luminosity;
+	stages.push_back(stage);
+	return *this;
+}
+
+AdjustmentChain& AdjustmentChain::adjustHueSaturation(float hue/* = 0.0F */, float saturation/* = 1.0F */, float lightness/* = 0.0F */)
+{
+	Stage stage(Stage::HUE_SATURATION);
+	stage.param[0] = hue;
+	stage.param[1] = saturation;
+	stage.param[2] = lightness;
+	stages.push_back(stage);
+	return *this;
+}
+
+size_t AdjustmentChain::splitIndex(const std::vector<Stage>& stages)
+{
+	size_t i = 0;
+	while(i < stages.size() && stages[i].isPerChannel())
+		++i;
+	return i;
+}
+
+void AdjustmentChain::buildTable(uint8_t table[3][256], const Stage& stage)
+{
+	// run the 8-bit Effect function on a gray ramp, so the tables are exactly what it would do
+	Mat ramp(1, 256, CV_8UC3), mapped;
+	for(int i = 0; i < 256; ++i)
+		ramp.at<Vec3b>(0, i) = Vec3b(i, i, i);
+
+	switch(stage.type)
+	{
+	case Stage::BRIGHTNESS_CONTRAST:
+		Effect::adjustBrightnessAndContrast(mapped, ramp, stage.param[0], stage.param[1]);
+		break;
+	case Stage::GAMMA:
+		Effect::adjustGamma(mapped, ramp, Vec3f(stage.param[0], stage.param[1], stage.param[2]));
+		break;
+	case Stage::POSTERIZE:
+		Effect::posterize(mapped, ramp, stage.param[0]);
+		break;
+	default:
+		assert(false);  // not a per channel stage
+		break;
+	}
+
+	for(int i = 0; i < 256; ++i)
+	{
+		const Vec3b& color = mapped.at<Vec3b>(0, i);
+		for(int k = 0; k < 3; ++k)
+			table[k][i] = color[k];
+	}
+}
+
+void AdjustmentChain::applyStage(cv::Mat& grid, const Stage& stage)
+{
+	assert(grid.type() == CV_32FC3);
+	Mat result;
+	switch(stage.type)
+	{
+	case Stage::COLOR_BALANCE:
+	{
+		const Vec3f config[3] =
+		{
+			Vec3f(stage.param[0], stage.param[1], stage.param[2]),
+			Vec3f(stage.param[3], stage.param[4], stage.param[5]),
+			Vec3f(stage.param[6], stage.param[7], stage.param[8]),
+		};
+		Effect::adjustColorBalance(result, grid, config, stage.preserve_luminosity);
+		break;
+	}
+	case Stage::HUE_SATURATION:
+		Effect::adjustHueSaturation(result, grid, stage.param[0], stage.param[1], stage.param[2]);
+		break;
+	default:
+	{
+		// per channel stage after a cross channel one, interpolate its 8-bit tables
+		uint8_t table[3][256];
+		buildTable(table, stage);
+
+		result.create(grid.size(), grid.type());
+		const float* src_data = grid.ptr<float>();
+		float* dst_data = result.ptr<float>();
+		const int length = grid.rows * grid.cols * 3;
+		for(int i = 0; i < length; ++i)
+		{
+			const int k = i % 3;
+			const float x = std::min(std::max(src_data[i], 0.0F), 1.0F) * 255.0F;
+			const int x0 = std::min(static_cast<int>(x), 254);
+			const float t = x - x0;
+			dst_data[i] = (table[k][x0] + (table[k][x0 + 1] - table[k][x0]) * t) / 255.0F;
+		}
+		break;
+	}
+	}
+
+	grid = result;
+}
+
+void AdjustmentChain::update()
+{
+	if(built && stages == built_stages)
+		return;
+
+	const size_t split = splitIndex(stages);
+	const size_t built_split = splitIndex(built_stages);
+
+	bool same_shaper = built && split == built_split &&
+			std::equal(stages.begin(), stages.begin() + split, built_stages.begin());
+	if(!same_shaper)
+	{
+		for(int k = 0; k < 3; ++k)
+		for(int i = 0; i < 256; ++i)
+			shaper[k][i] = static_cast<uint8_t>(i);
+
+		// compose the tables, shaper = table_n(... table_1(x))
+		for(size_t s = 0; s < split; ++s)
+		{
+			uint8_t table[3][256];
+			buildTable(table, stages[s]);
+			for(int k = 0; k < 3; ++k)
+			for(int i = 0; i < 256; ++i)
+				shaper[k][i] = table[k][shaper[k][i]];
+		}
+	}
+
+	bool same_cube = built && stages.size() - split == built_stages.size() - built_split &&
+			std::equal(stages.begin() + split, stages.end(), built_stages.begin() + built_split);
+	if(!same_cube)
+	{
+		if(split == stages.size())
+			cube.clear();
+		else
+		{
+			// Evaluate the remaining stages on every grid node, it's only GRID^3 pixels.
+			const int N = GRID;
+			Mat grid(1, N * N * N, CV_32FC3);
+			Vec3f* node = grid.ptr<Vec3f>();
+			for(int i0 = 0; i0 < N; ++i0)
+			for(int i1 = 0; i1 < N; ++i1)
+			for(int i2 = 0; i2 < N; ++i2)
+				*node++ = Vec3f(i0, i1, i2) / static_cast<float>(N - 1);
+
+			for(size_t s = split; s < stages.size(); ++s)
+				applyStage(grid, stages[s]);
+
+			cube.resize(N * N * N * 3);
+			const float* grid_data = grid.ptr<float>();
+			for(size_t i = 0; i < cube.size(); ++i)
+				cube[i] = std::min(std::max(grid_data[i], 0.0F), 1.0F) * 255.0F;
+		}
+	}
+
+	built_stages = stages;
+	built = true;
+}
+
+void AdjustmentChain::apply(cv::Mat& dst, const cv::Mat& src)
+{
+	assert(src.type() == CV_8UC3 || src.type() == CV_8UC4);
+	update();
+
+	if(stages.empty())
+	{
+		src.copyTo(dst);
+		return;
+	}
+
+	if(dst.data != src.data)
+		dst.create(src.size(), src.type());
+	const int channels = src.channels();
+
+	if(cube.empty())
+	{
+		#pragma omp parallel for
+		for(int r = 0; r < src.rows; ++r)
+		{
+			const uint8_t* src_row = src.ptr<uint8_t>(r);
+			uint8_t* dst_row = dst.ptr<uint8_t>(r);
+			for(int c = 0; c < src.cols * channels; c += channels)
+			{
+				dst_row[c + 0] = shaper[0][src_row[c + 0]];
+				dst_row[c + 1] = shaper[1][src_row[c + 1]];
+				dst_row[c + 2] = shaper[2][src_row[c + 2]];
+				if(channels == 4)
+					dst_row[c + 3] = src_row[c + 3];  // keep alpha untouched
+			}
+		}
+		return;
+	}
+
+	// grid cell and position inside it of each 8-bit value
+	const int N = GRID;
+	int   cell[256];
+	float fraction[256];
+	for(int i = 0; i < 256; ++i)
+	{
+		const float x = i * (N - 1) / 255.0F;
+		cell[i] = std::min(static_cast<int>(x), N - 2);
+		fraction[i] = x - cell[i];
+	}
+
+	const int S0 = N * N * 3, S1 = N * 3, S2 = 3;  // strides of the cube
+	const float* const lut = cube.data();
+
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+	{
+		const uint8_t* src_row = src.ptr<uint8_t>(r);
+		uint8_t* dst_row = dst.ptr<uint8_t>(r);
+		for(int c = 0; c < src.cols * channels; c += channels)
+		{
+			const uint8_t v0 = shaper[0][src_row[c + 0]];
+			const uint8_t v1 = shaper[1][src_row[c + 1]];
+			const uint8_t v2 = shaper[2][src_row[c + 2]];
+			const float f0 = fraction[v0], f1 = fraction[v1], f2 = fraction[v2];
+			const float* c000 = lut + cell[v0] * S0 + cell[v1] * S1 + cell[v2] * S2;
+			const float* c111 = c000 + S0 + S1 + S2;
+
+			// Tetrahedral interpolation, the cube is split into 6 tetrahedra along its main diagonal, pick
+			// the one containing the point by sorting the fractions, then walk c000 -> a -> b -> c111.
+			const float* a;
+			const float* b;
+			float w0, w1, w2;  // weights of the three edges of the walk
+			if(f0 >= f1)
+			{
+				if(f1 >= f2)      { a = c000 + S0; b = a + S1; w0 = f0; w1 = f1; w2 = f2; }
+				else if(f0 >= f2) { a = c000 + S0; b = a + S2; w0 = f0; w1 = f2; w2 = f1; }
+				else              { a = c000 + S2; b = a + S0; w0 = f2; w1 = f0; w2 = f1; }
+			}
+			else
+			{
+				if(f2 >= f1)      { a = c000 + S2; b = a + S1; w0 = f2; w1 = f1; w2 = f0; }
+				else if(f2 >= f0) { a = c000 + S1; b = a + S2; w0 = f1; w1 = f2; w2 = f0; }
+				else              { a = c000 + S1; b = a + S0; w0 = f1; w1 = f0; w2 = f2; }
+			}
+
+			for(int k = 0; k < 3; ++k)
+			{
+				float value = c000[k] + w0 * (a[k] - c000[k]) + w1 * (b[k] - a[k]) + w2 * (c111[k] - b[k]);
+				dst_row[c + k] = static_cast<uint8_t>(value + 0.5F);
+			}
+			if(channels == 4)
+				dst_row[c + 3] = src_row[c + 3];  // keep alpha untouched
+		}
+	}
+}
+
+} /* namespace venus */
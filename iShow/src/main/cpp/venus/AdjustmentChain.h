@@ -0,0 +1,114 @@
+#ifndef VENUS_ADJUSTMENT_CHAIN_H_
+#define VENUS_ADJUSTMENT_CHAIN_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace venus {
+
+/**
+ * Records a chain of Effect color adjustments, and applies them all in a single pass over the image.
+ *
+ * Per channel adjustments (brightness and contrast, gamma, posterize) compose into one 256-entry table
+ * per channel. Once a cross channel adjustment (color balance, hue and saturation) shows up, it and all the
+ * adjustments after it are baked into a 33x33x33 3D LUT, which is looked up with tetrahedral interpolation
+ * after the per channel tables. The tables are built by running the Effect functions themselves, on a color
+ * ramp and on the LUT grid, so the result follows Effect's 8-bit semantics.
+ *
+ * The tables are cached. A UI can clear() and record the chain again whenever a slider moves, apply() only
+ * rebuilds the part of the tables whose adjustments changed, and the pixels are always visited once.
+ *
+ * <code>
+ * chain.clear();
+ * chain.adjustBrightnessAndContrast(0.1F, 1.2F).adjustGamma(1.1F).adjustHueSaturation(0.0F, 1.3F);
+ * chain.apply(dst, src);
+ * </code>
+ *
+ * It isn't thread safe, since apply() updates the cached tables.
+ */
+class AdjustmentChain
+{
+private:
+	struct Stage
+	{
+		enum Type
+		{
+			BRIGHTNESS_CONTRAST,
+			GAMMA,
+			POSTERIZE,
+			COLOR_BALANCE,
+			HUE_SATURATION,
+		};
+
+		Type  type;
+		float param[9];            ///< meaning depends on type, unused ones are zero
+		bool  preserve_luminosity;
+
+		explicit Stage(Type type);
+
+		bool isPerChannel() const { return type == BRIGHTNESS_CONTRAST || type == GAMMA || type == POSTERIZE; }
+		bool operator==(const Stage& other) const;
+		bool operator!=(const Stage& other) const { return !(*this == other); }
+	};
+
+	static constexpr int GRID = 33;  ///< 3D LUT size of each dimension
+
+	std::vector<Stage> stages;
+
+	// cache, built from the stages in built_stages
+	std::vector<Stage> built_stages;
+	bool built;
+	uint8_t shaper[3][256];          ///< per channel tables of the leading per channel stages
+	std::vector<float> cube;         ///< GRID^3 x 3 colors in [0, 255], empty if there is no cross channel stage
+
+	/**
+	 * @return index of the first cross channel stage, or stages.size() if there is none.
+	 */
+	static size_t splitIndex(const std::vector<Stage>& stages);
+
+	static void buildTable(uint8_t table[3][256], const Stage& stage);
+	static void applyStage(cv::Mat& grid, const Stage& stage);
+
+	void update();
+
+public:
+	AdjustmentChain();
+
+	/// @see Effect::adjustBrightnessAndContrast(cv::Mat&, const cv::Mat&, float, float)
+	AdjustmentChain& adjustBrightnessAndContrast(float brightness = 0.0F, float contrast = 1.0F);
+
+	/// @see Effect::adjustGamma(cv::Mat&, const cv::Mat&, float)
+	AdjustmentChain& adjustGamma(float gamma);
+
+	/// @see Effect::adjustGamma(cv::Mat&, const cv::Mat&, const cv::Vec3f&)
+	AdjustmentChain& adjustGamma(const cv::Vec3f& gamma);
+
+	/// @see Effect::posterize(cv::Mat&, const cv::Mat&, float)
+	AdjustmentChain& posterize(float level);
+
+	/// @see Effect::adjustColorBalance(cv::Mat&, const cv::Mat&, const cv::Vec3f[3], bool)
+	AdjustmentChain& adjustColorBalance(const cv::Vec3f config[3], bool preserve_luminosity);
+
+	/// @see Effect::adjustHueSaturation(cv::Mat&, const cv::Mat&, float, float, float)
+	AdjustmentChain& adjustHueSaturation(float hue = 0.0F, float saturation = 1.0F, float lightness = 0.0F);
+
+	/**
+	 * Remove all the recorded adjustments, the cached tables are kept for the next apply().
+	 */
+	void clear() { stages.clear(); }
+
+	bool empty() const { return stages.empty(); }
+
+	/**
+	 * Apply all the recorded adjustments in order.
+	 *
+	 * @param[out] dst The output image, can be the same as @p src.
+	 * @param[in]  src CV_8UC3 or CV_8UC4 image, alpha channel is kept untouched.
+	 */
+	void apply(cv::Mat& dst, const cv::Mat& src);
+};
+
+} /* namespace venus */
+#endif /* VENUS_ADJUSTMENT_CHAIN_H_ */
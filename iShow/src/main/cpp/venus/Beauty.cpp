@@ -1,4 +1,5 @@
 ﻿#include <assert.h>
+#include <algorithm>
 
 #include <opencv2/imgproc.hpp>
 #include "venus/colorspace.h"
@@ -50,46 +51,120 @@ static bool isSkinColor_RGB(const uint8_t* color)
 	return false;
 }
 
-static cv::Mat calculateSkinRegion(const cv::Mat& image, bool(*predicate)(const uint8_t*))
+/*
+	The rule based classifiers only depend on the 8-bit color, so evaluate them once for all the 2^24 colors, and keep
+	the answers in a bit set of 2 MiB. A lookup is much cheaper than the rules, the HSV conversion in particular, and the
+	table is small enough to stay in the last level cache, so classification is bounded by memory bandwidth instead.
+
+	A color is indexed by its first 3 bytes in memory order, which makes the table independent of USE_BGRA_LAYOUT.
+*/
+class ColorBitset
 {
-	// an RGB/RGBA image is required
-	assert(image.depth() == CV_8U && image.isContinuous());
+private:
+	std::vector<uint8_t> bits;
 
-	const int channel = image.channels();
-	assert(channel >= 3);
-	const int length = image.rows * image.cols;
-	const uint8_t* image_data = image.data;
+public:
+	explicit ColorBitset(bool(*predicate)(const uint8_t*)):
+		bits(1 << 21)
+	{
+		#pragma omp parallel for
+		for(int i = 0; i < (1 << 21); ++i)
+		{
+			uint8_t byte = 0;
+			for(int k = 0; k < 8; ++k)
+			{
+				const int index = i << 3 | k;
+				const uint8_t color[3] = { static_cast<uint8_t>(index >> 16), static_cast<uint8_t>(index >> 8), static_cast<uint8_t>(index) };
+				if(predicate(color))
+					byte |= 1 << k;
+			}
+			bits[i] = byte;
+		}
+	}
 
-	Mat mask(image.rows, image.cols, CV_8UC1);
-	uint8_t* mask_data = mask.data;
+	bool test(const uint8_t* color) const
+	{
+		const int index = color[0] << 16 | color[1] << 8 | color[2];
+		return (bits[index >> 3] >> (index & 7)) & 1;
+	}
+};
 
-	#pragma omp parallel for
-	for(int i = 0; i < length; ++i)
-		mask_data[i] = predicate(image_data + i * channel) ? 255 : 0;
-	
-	return mask;
+// Tables are built on first use and shared afterwards, C++11 makes the initialization of local statics thread safe.
+static const ColorBitset& skinBitset_RGB()
+{
+	static const ColorBitset bitset(isSkinColor_RGB);
+	return bitset;
 }
 
-cv::Mat Beauty::calculateSkinRegion_RGB(const cv::Mat& image)
+// the larger the radius, the more time closing consumes, so no more than 2 here.
+static int closingRadius(const cv::Mat& image)
 {
-	Mat mask = calculateSkinRegion(image, isSkinColor_RGB);
+	return std::min(2, cvRound(std::max(image.rows, image.cols) * 0.01F));
+}
 
-#if 1
-	// post-processing, use closing morphology operation to kick out small holes
-	// the larger the radius, the more time it consumes, so no more than 2 here.
-	int radius  = std::min(2, cvRound(std::max(image.rows, image.cols) * 0.01F));
+/*
+	Classify the image band by band, and close each band while it's still in cache, rather than writing the whole mask
+	out and reading it back again for the morphology. Closing is a dilation followed by an erosion, each reaches radius
+	rows away, so a band classifies 2 * radius extra rows on both sides, and the result is identical to closing the
+	whole mask at once.
+*/
+template <typename Predicate>
+static cv::Mat classifySkin(const cv::Mat& image, int radius, const Predicate& is_skin)
+{
+	// an RGB/RGBA image is required
+	assert(image.depth() == CV_8U && image.channels() >= 3);
+	const int channel = image.channels();
+
+	Mat mask(image.rows, image.cols, CV_8UC1);
 
-	const int size = radius * 2 + 1;
 	const Point2i anchor(radius, radius);
-	int iterations = 1;  // can be tuned
-	Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, Size(size, size), anchor);
+	Mat kernel;
+	if(radius > 0)
+	{
+		const int size = radius * 2 + 1;
+		kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, Size(size, size), anchor);
+	}
 
-	cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, kernel, anchor, iterations);
-#endif
+	const int BAND = 64;
+	const int halo = radius * 2;
+	const int band_count = (image.rows + BAND - 1) / BAND;
+
+	#pragma omp parallel for schedule(dynamic)
+	for(int band = 0; band < band_count; ++band)
+	{
+		const int y0 = band * BAND, y1 = std::min(y0 + BAND, image.rows);
+		const int t0 = std::max(y0 - halo, 0), t1 = std::min(y1 + halo, image.rows);
+
+		// without closing, classify right into the mask
+		Mat region = radius > 0 ? Mat(t1 - t0, image.cols, CV_8UC1) : mask.rowRange(t0, t1);
+		for(int r = t0; r < t1; ++r)
+		{
+			const uint8_t* image_row = image.ptr<uint8_t>(r);
+			uint8_t* region_row = region.ptr<uint8_t>(r - t0);
+			for(int c = 0; c < image.cols; ++c)
+				region_row[c] = is_skin(image_row + c * channel) ? 255 : 0;
+		}
+
+		if(radius > 0)
+		{
+			Mat closed;
+			int iterations = 1;  // can be tuned
+			cv::morphologyEx(region, closed, cv::MORPH_CLOSE, kernel, anchor, iterations);
+			closed.rowRange(y0 - t0, y1 - t0).copyTo(mask.rowRange(y0, y1));
+		}
+	}
 
 	return mask;
 }
 
+cv::Mat Beauty::calculateSkinRegion_RGB(const cv::Mat& image)
+{
+	const ColorBitset& bitset = skinBitset_RGB();
+
+	// post-processing, use closing morphology operation to kick out small holes
+	return classifySkin(image, closingRadius(image), [&bitset](const uint8_t* color) { return bitset.test(color); });
+}
+
 /*
 	"Pixel-Based Skin Color Classifier: A Review" by Amit Kumar and Shivani Malhotra
 
@@ -109,14 +184,41 @@ cv::Mat Beauty::calculateSkinRegion_RGB(const cv::Mat& image)
 		C = [97.0946 24.4700; 24.4700 141.9966]
 		inv(C) = [0.0107668  -0.0018554; -0.0018554   0.0073622]
 */
-static float skinColorProbability(const uint8_t* color)
+static float skinColorProbability(float U, float V)
 {
-#if USE_BGRA_LAYOUT
-	const uint8_t& B = color[0], &G = color[1], &R = color[2];
-#else
-	const uint8_t& R = color[0], &G = color[1], &B = color[2];
-#endif
+	// [Cb-m0 Cr-m1] * [  0.0107668 -0.0018554 ] * [ Cb-m0 ]
+	//                 [ -0.0018554  0.0073622 ]   [ Cr-m1 ]
+	float tmp0 = U - 117.4316F;
+	float tmp1 = V - 148.5599F;
+	float tmp2 = +0.0107668F * tmp0 - 0.0018554F * tmp1;
+	float tmp3 = -0.0018554F * tmp0 + 0.0073622F * tmp1;
+	float tmp4 = tmp0 * tmp2 + tmp1 * tmp3;
+
+	return std::exp(-0.5F * tmp4);
+}
+
+/*
+	The probability only depends on (Cb, Cr). They are computed in fixed point at half unit steps, and the probability
+	is looked up from a 512x512 table of 16-bit values, 512 KiB which fits in L2 cache. The error of quantization is less
+	than 0.025 in probability. 16 bits rather than 8 keep the levels of a narrow probability range apart, so that they
+	are not merged before calculateSkinRegion_YCbCr() stretches the range.
+*/
+class SkinProbabilityTable
+{
+private:
+	static constexpr int STEPS = 512;  ///< half unit steps of Cb and Cr in [0, 256)
+	static constexpr int SHIFT = 13;   ///< fixed point precision of the coefficients
+
+	int coeff_u[4];  ///< R, G, B and offset of 2 * Cb
+	int coeff_v[4];  ///< R, G, B and offset of 2 * Cr
+	std::vector<uint16_t> table;
 
+	static int fix(float x) { return cvRound(x * (2 << SHIFT)); }
+
+public:
+	SkinProbabilityTable():
+		table(STEPS * STEPS)
+	{
 /*
 	https://en.wikipedia.org/wiki/YUV#Conversion_to.2Ffrom_RGB
 	the term YUV is commonly used in the computer industry to describe file-formats
@@ -131,73 +233,117 @@ static float skinColorProbability(const uint8_t* color)
 	| G | = |  0.00456621 -0.00153632 -0.00318811 | * | Cb | - | 128 |
 	\ B /   \  0.00456621  0.00791071  0          /   \ Cr /   \ 128 /
 
-	tranform RGB to YUV color space. Here, we reduce 6 multiplications to 5.
+	The model was fitted with
+		Y = 0.299 * R + 0.587 * G + 0.114 * B + 16;
+		U = 0.492 * (B - Y) + 128;
+		V = 0.877 * (R - Y) + 128;
+	expand them into linear combinations of R, G and B.
+
+	https://github.com/Itseez/opencv/blob/master/modules/imgproc/src/color.cpp#L7502
+	Currently, there is a bug in conversion CV_BGR2YUV and CV_RGB2YUV,
+	The channels red and blue are misplaced in the implemented formula.
+	see http://code.opencv.org/issues/4227 for details.
 */
-//	float U = (-0.148 * R - 0.291 * G + 0.439 * B + 128);
-//	float V = ( 0.439 * R - 0.368 * G - 0.071 * B + 128);
-	float Y = 0.299F * R + 0.587F * G + 0.114F * B + 16.0F;
-	float U = 0.492F * (B - Y) + 128.0F;
-	float V = 0.877F * (R - Y) + 128.0F;
+		const float KR = 0.299F, KG = 0.587F, KB = 0.114F, KU = 0.492F, KV = 0.877F;
+		const int half = 1 << (SHIFT - 1);  // round to nearest
+		coeff_u[0] = fix(-KU * KR);
+		coeff_u[1] = fix(-KU * KG);
+		coeff_u[2] = fix( KU * (1 - KB));
+		coeff_u[3] = fix(128.0F - KU * 16.0F) + half;
+		coeff_v[0] = fix( KV * (1 - KR));
+		coeff_v[1] = fix(-KV * KG);
+		coeff_v[2] = fix(-KV * KB);
+		coeff_v[3] = fix(128.0F - KV * 16.0F) + half;
 
-	// [Cb-m0 Cr-m1] * [  0.0107668 -0.0018554 ] * [ Cb-m0 ]
-	//                 [ -0.0018554  0.0073622 ]   [ Cr-m1 ]
-	float tmp0 = U - 117.4316F;
-	float tmp1 = V - 148.5599F;
-	float tmp2 = +0.0107668F * tmp0 - 0.0018554F * tmp1;
-	float tmp3 = -0.0018554F * tmp0 + 0.0073622F * tmp1;
-	float tmp4 = tmp0 * tmp2 + tmp1 * tmp3;
+		#pragma omp parallel for
+		for(int v = 0; v < STEPS; ++v)
+		for(int u = 0; u < STEPS; ++u)
+			table[v * STEPS + u] = saturate_cast<uint16_t>(skinColorProbability(u * 0.5F, v * 0.5F) * MAX);
+	}
 
-	return std::exp(-0.5F * tmp4);
+	static constexpr int MAX = 65535;  ///< probability 1
+
+	/**
+	 * @return skin probability of the color scaled to [0, MAX]
+	 */
+	uint16_t lookup(const uint8_t* color) const
+	{
+#if USE_BGRA_LAYOUT
+		const int B = color[0], G = color[1], R = color[2];
+#else
+		const int R = color[0], G = color[1], B = color[2];
+#endif
+		// Cb and Cr slightly go beyond [0, 256), where the probability is 0 anyway.
+		int u = (coeff_u[0] * R + coeff_u[1] * G + coeff_u[2] * B + coeff_u[3]) >> SHIFT;
+		int v = (coeff_v[0] * R + coeff_v[1] * G + coeff_v[2] * B + coeff_v[3]) >> SHIFT;
+		u = std::min(std::max(u, 0), STEPS - 1);
+		v = std::min(std::max(v, 0), STEPS - 1);
+		return table[v * STEPS + u];
+	}
+};
+
+static const SkinProbabilityTable& skinProbabilityTable()
+{
+	static const SkinProbabilityTable table;
+	return table;
 }
 
 cv::Mat Beauty::calculateSkinRegion_YCbCr(const cv::Mat& image)
 {
 	// an RGB/RGBA image is required
-	assert(image.depth() == CV_8U && image.isContinuous());
-
+	assert(image.depth() == CV_8U && image.channels() >= 3);
 	const int channel = image.channels();
-	assert(channel >= 3);
-	const int length = image.rows * image.cols;
-	const uint8_t* image_data = image.data;
+	const SkinProbabilityTable& table = skinProbabilityTable();
 
-	Mat mask(image.rows, image.cols, CV_32FC1);
-	float* mask_data = mask.ptr<float>();
+	Mat mask(image.rows, image.cols, CV_8UC1);
 
-/*
-	https://github.com/Itseez/opencv/blob/master/modules/imgproc/src/color.cpp#L7502
-	Currently, there is a bug in conversion CV_BGR2YUV and CV_RGB2YUV,
-	The channels red and blue are misplaced in the implemented formula.
-	see http://code.opencv.org/issues/4227 for details.
+#if 1  // equalization
+	// The range is found first, and the probabilities are stretched while still in 16-bit, a narrow range would
+	// have few levels left if it were stretched after rounding to 8-bit. Looking up twice is cheaper than a 16-bit
+	// temporary image.
+	std::vector<uint16_t> row_min(image.rows), row_max(image.rows);
 
-	Otherwise, we could use the line below to convert RGB to YUV color mode.
-	cvtColor(image_rgb, image_yuv, CV_BGR2YUV);
-*/
 	#pragma omp parallel for
-	for(int i = 0; i < length; ++i)
-		mask_data[i] = skinColorProbability(image_data + i * channel);
+	for(int r = 0; r < image.rows; ++r)
+	{
+		const uint8_t* image_row = image.ptr<uint8_t>(r);
+		uint16_t min = SkinProbabilityTable::MAX, max = 0;
+		for(int c = 0; c < image.cols; ++c)
+		{
+			const uint16_t probability = table.lookup(image_row + c * channel);
+			min = std::min(min, probability);
+			max = std::max(max, probability);
+		}
+		row_min[r] = min;
+		row_max[r] = max;
+	}
 
-#if 1  // equalization
-	double min; // = *std::min_element(region.begin<float>(), region.end<float>());
-	double max; // = *std::max_element(region.begin<float>(), region.end<float>());
-//	auto min_max = std::minmax_element(region.begin<float>(), region.end<float>());
-	cv::minMaxLoc(mask, &min, &max);
-//	std::cout << "min = " << min << ", max = " << max << '\n';
+	int min = *std::min_element(row_min.begin(), row_min.end());
+	int max = *std::max_element(row_max.begin(), row_max.end());
 
 	// binaryzation
 //	float mean = (min + max)/2;
 //	cv::threshold(region, region, mean/* threshold */, 1.0/* max_value */, THRESH_BINARY);
 
-	if(min == max)  // single color in original image, bypass divided by zero.
-		mask.convertTo(mask, CV_8UC1, 255.0F);
-	else
+	// If min == max, there is a single color in original image, keep the probability as it is.
+	if(min == max)
+		min = 0, max = SkinProbabilityTable::MAX;
+#else
+	const int min = 0, max = SkinProbabilityTable::MAX;
+#endif
+
+	// [min, max] maps to [0, 255], y = (x - min) * 255/(max - min);
+	const float scale = 255.0F / (max - min);
+
+	#pragma omp parallel for
+	for(int r = 0; r < image.rows; ++r)
 	{
-		// [min, max] maps to [0, 1], y = (x - min)/(max - min);
-		// y = k*x + b; k = 1/(max -min); b = -min/(max -min);
-		double k = 255/(max - min), b = -min * k;
-		mask.convertTo(mask, CV_8UC1, k, b);
+		const uint8_t* image_row = image.ptr<uint8_t>(r);
+		uint8_t* mask_row = mask.ptr<uint8_t>(r);
+		for(int c = 0; c < image.cols; ++c)
+			mask_row[c] = saturate_cast<uint8_t>((table.lookup(image_row + c * channel) - min) * scale);
 	}
 //	cv::imshow("mask", mask);
-#endif
 	return mask;
 }
 
@@ -220,10 +366,36 @@ static bool isSkinColor_HSV(const uint8_t* color)
 		0.35F < hsv[2] && hsv[2] <= 1.00F;
 }
 
+static const ColorBitset& skinBitset_HSV()
+{
+	static const ColorBitset bitset(isSkinColor_HSV);
+	return bitset;
+}
+
 cv::Mat Beauty::calculateSkinRegion_HSV(const cv::Mat& image)
 {
-	Mat mask = calculateSkinRegion(image, isSkinColor_HSV);
-	return mask;
+	const ColorBitset& bitset = skinBitset_HSV();
+	return classifySkin(image, 0, [&bitset](const uint8_t* color) { return bitset.test(color); });
+}
+
+cv::Mat Beauty::calculateSkinRegion(const cv::Mat& image, int models, float probability/* = 0.5F */)
+{
+	assert((models & (SKIN_RGB | SKIN_HSV | SKIN_YCbCr)) != 0);
+
+	// only the tables of the chosen models are built
+	const ColorBitset* rgb = (models & SKIN_RGB) != 0 ? &skinBitset_RGB() : nullptr;
+	const ColorBitset* hsv = (models & SKIN_HSV) != 0 ? &skinBitset_HSV() : nullptr;
+	const SkinProbabilityTable* ycbcr = (models & SKIN_YCbCr) != 0 ? &skinProbabilityTable() : nullptr;
+	const int threshold = cvRound(probability * SkinProbabilityTable::MAX);
+
+	auto is_skin = [rgb, hsv, ycbcr, threshold](const uint8_t* color)
+	{
+		return (rgb == nullptr || rgb->test(color)) &&
+			(hsv == nullptr || hsv->test(color)) &&
+			(ycbcr == nullptr || ycbcr->lookup(color) >= threshold);
+	};
+
+	return classifySkin(image, closingRadius(image), is_skin);
 }
 
 // <gegl>/operations/common/red-eye-removal.c
@@ -328,49 +500,166 @@ void Beauty::whitenSkinByLogCurve(cv::Mat& dst, const cv::Mat& src, const cv::Ma
 	}
 }
 
-// Refer to paper "Digital Image Enhancement and Noise Filtering by Use of Local Statistics" by Jong-sen Lee, 1979
-void Beauty::beautifySkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level)
+// Bounding rectangle of the nonzero pixels of a CV_8UC1 mask, empty if there is none.
+static cv::Rect maskBoundingRect(const cv::Mat& mask)
 {
-	assert(src.rows == mask.rows && src.cols == mask.cols && mask.channels() == 1);
-	double max;
-	Mat _src  = venus::normalize(src, &max);
-	Mat _mask = venus::normalize(mask);
+	int top = mask.rows, bottom = -1, left = mask.cols, right = -1;
+	for(int r = 0; r < mask.rows; ++r)
+	{
+		const uint8_t* mask_row = mask.ptr<uint8_t>(r);
+		int c0 = 0, c1 = mask.cols - 1;
+		while(c0 < mask.cols && mask_row[c0] == 0)
+			++c0;
+		if(c0 == mask.cols)
+			continue;
+		while(mask_row[c1] == 0)
+			--c1;
+
+		top = std::min(top, r);
+		bottom = r;
+		left = std::min(left, c0);
+		right = std::max(right, c1);
+	}
 
-//	level = 10 + level * level * 5;
-	int size = cvRound(radius) * 2 + 1;
+	return bottom < 0 ? Rect() : Rect(left, top, right - left + 1, bottom - top + 1);
+}
 
-	// expectation: E[x] = (x1 + x2 + ... + xn)/n;  //x1*p1 + x2*p2 + ... + xn*pn;
-	// variance: Var(X) = E[(X - miu)^2] = E[X^2] - E[X]^2
-	Mat expectation, variance;
-	cv::blur(_src, expectation, Size(size, size), Point(-1, -1), BorderTypes::BORDER_CONSTANT);
+// Refer to paper "Digital Image Enhancement and Noise Filtering by Use of Local Statistics" by Jong-sen Lee, 1979
+void Beauty::beautifySkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level)
+{
+	std::vector<uint32_t> buffer;
+	beautifySkin(dst, src, mask, radius, level, buffer);
+}
 
-	dst = expectation - _src;
-//	cv::multiply(dst, dst, dst);  // dst = dst .* dst;  // element-wise multiplication
-	float* const dst_data = dst.ptr<float>();
-	const int channel = src.channels();
-	const int length = src.rows * src.cols * channel;
+void Beauty::beautifySkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level, std::vector<uint32_t>& buffer)
+{
+	assert(src.depth() == CV_8U && src.channels() >= 3);
+	assert(mask.type() == CV_8UC1 && src.rows == mask.rows && src.cols == mask.cols);
+
+	/*
+	 * Lee filter: y = E[x] + k * (x - E[x]), k = Var(x) / (Var(x) + level), where the local mean and
+	 * variance Var(x) = E[x^2] - E[x]^2 come from running sums of x and x^2 over a (2R+1)^2 window.
+	 * Everything is fused into one pass that reads 8-bit source pixels and writes 8-bit destination
+	 * pixels, and only the bounding rectangle of the mask is processed.
+	 *
+	 * The rows are split into bands which run in parallel, each band keeps running column sums for
+	 * its own rows, and slides a horizontal window along them. The window is clipped to the image.
+	 */
+	const bool in_place = dst.data == src.data;
+	if(!in_place)
+		src.copyTo(dst);
 
-	#pragma omp parallel for
-	for(int i = 0; i < length; ++i)
-		dst_data[i] *= dst_data[i];
+	const Rect roi = maskBoundingRect(mask);
+	const int R = cvRound(radius);
+	if(roi.area() <= 0 || R <= 0)
+		return;
+
+	// columns and rows the windows of the ROI reach
+	const int x0 = std::max(roi.x - R, 0), x1 = std::min(roi.x + roi.width + R, src.cols);
+	const int y0 = std::max(roi.y - R, 0), y1 = std::min(roi.y + roi.height + R, src.rows);
+	const int C = 3;  // alpha channel is kept unchanged
+	const int cn = src.channels();
+	const int sum_length = (x1 - x0) * C;
+
+	// level is for normalized [0, 1] data, scale it for [0, 255] data
+	const float level_255 = level * 255.0F * 255.0F;
+
+	const int band_height = std::max(32, 4 * R);
+	const int band_count = (roi.height + band_height - 1) / band_height;
+
+	// In place, filtered pixels would leak into the windows of the rows below, so the source pixels the windows
+	// reach are copied to the end of buffer first. That's the ROI expanded by R, not the whole image, and dst
+	// is left untouched outside the ROI.
+	const size_t sums_size = static_cast<size_t>(band_count) * sum_length * 2;
+	const size_t copy_bytes = in_place ? static_cast<size_t>(y1 - y0) * (x1 - x0) * src.elemSize() : 0;
+	buffer.resize(sums_size + (copy_bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+	Mat copy;
+	if(in_place)
+	{
+		copy = Mat(y1 - y0, x1 - x0, src.type(), buffer.data() + sums_size);
+		src(Rect(x0, y0, x1 - x0, y1 - y0)).copyTo(copy);
+	}
 
-	cv::blur(dst, variance, Size(size, size), Point(-1, -1), BorderTypes::BORDER_CONSTANT);
-	
-	const float* _src_data = _src.ptr<float>();
-	const float* _mask_data = _mask.ptr<float>();
-	const float* expectation_data = expectation.ptr<float>();
-	const float* variance_data = variance.ptr<float>();
+	// source row r, from column x0 on
+	auto source_row = [&](int r) -> const uint8_t*
+	{
+		return in_place ? copy.ptr<uint8_t>(r - y0) : src.ptr<uint8_t>(r) + x0 * cn;
+	};
 
-	#pragma omp parallel for
-	for(int i = 0; i < length; ++i)
+	#pragma omp parallel for schedule(dynamic)
+	for(int band = 0; band < band_count; ++band)
 	{
-		float k = variance_data[i] / (variance_data[i] + level);
-		float interp = lerp(expectation_data[i], _src_data[i], k);
-//		dst_data[i] = interp;
-		dst_data[i] = lerp(_src_data[i], interp, _mask_data[i/channel]);
-	}
+		uint32_t* const column_sum = buffer.data() + static_cast<size_t>(band) * sum_length * 2;
+		uint32_t* const column_square_sum = column_sum + sum_length;
+		std::fill(column_sum, column_sum + sum_length * 2, 0U);
 
-	dst.convertTo(dst, src.depth(), max);  // keep dst and src the same type
+		// add (sign = 1) or subtract (sign = -1) source row r to the column sums
+		auto accumulate = [&](int r, int sign)
+		{
+			if(r < y0 || r >= y1)
+				return;
+			const uint8_t* row = source_row(r);
+			for(int i = 0, c = 0; c < x1 - x0; ++c)
+				for(int m = 0; m < C; ++m, ++i)
+				{
+					const uint32_t x = row[c * cn + m];
+					column_sum[i] += sign * x;  // unsigned wrap around is fine here
+					column_square_sum[i] += sign * (x * x);
+				}
+		};
+
+		const int y_begin = roi.y + band * band_height;
+		const int y_end = std::min(y_begin + band_height, roi.y + roi.height);
+		for(int r = y_begin - R; r < y_begin + R; ++r)
+			accumulate(r, 1);
+
+		for(int y = y_begin; y < y_end; ++y)
+		{
+			accumulate(y + R, 1);
+			if(y > y_begin)
+				accumulate(y - R - 1, -1);
+
+			const uint8_t* mask_row = mask.ptr<uint8_t>(y);
+			const uint8_t* src_row = source_row(y);
+			uint8_t* dst_row = dst.ptr<uint8_t>(y);
+			const int rows = std::min(y + R + 1, src.rows) - std::max(y - R, 0);
+
+			// horizontal window [c - R, c + R] clipped to [x0, x1)
+			uint32_t sum[C] = {0, 0, 0};
+			uint64_t square_sum[C] = {0, 0, 0};
+			int left = std::max(roi.x - R, x0), right = left;  // window is [left, right)
+			for(int c = roi.x; c < roi.x + roi.width; ++c)
+			{
+				for(; right < std::min(c + R + 1, x1); ++right)
+					for(int m = 0; m < C; ++m)
+					{
+						sum[m] += column_sum[(right - x0) * C + m];
+						square_sum[m] += column_square_sum[(right - x0) * C + m];
+					}
+				for(; left < c - R; ++left)
+					for(int m = 0; m < C; ++m)
+					{
+						sum[m] -= column_sum[(left - x0) * C + m];
+						square_sum[m] -= column_square_sum[(left - x0) * C + m];
+					}
+
+				if(mask_row[c] == 0)
+					continue;
+
+				const float n = static_cast<float>(rows * (right - left));
+				const float amount = mask_row[c] / 255.0F;
+				for(int m = 0; m < C; ++m)
+				{
+					const float mean = sum[m] / n;
+					const float variance = std::max(square_sum[m] / n - mean * mean, 0.0F);
+					const float k = variance / (variance + level_255);
+					const float x = src_row[(c - x0) * cn + m];
+					const float interp = lerp(mean, x, k);
+					dst_row[c * cn + m] = saturate_cast<uint8_t>(lerp(x, interp, amount));
+				}
+			}
+		}
+	}
 }
 
 } /* namespace venus */
\ No newline at end of file
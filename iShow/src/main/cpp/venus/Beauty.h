@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <functional>
+#include <vector>
 
 #include <opencv2/core/mat.hpp>
 
@@ -27,8 +28,10 @@ public:
 	 * Skin detection is performed in the YCbCr colour space. Usually, skin color segmentation algorithm model by using Gaussian mixture model,
 	 * because facial color region can be described by Gaussian distribution.
 	 *
+	 * The probability is looked up from a quantized CbCr table, and equalized to [0, 255] over the image.
+	 *
 	 * @param[in] image an RGB(A) image
-	 * @return single channel mask of float type
+	 * @return single channel mask of uint8_t type
 	 */
 	static cv::Mat calculateSkinRegion_YCbCr(const cv::Mat& image);
 
@@ -40,6 +43,27 @@ public:
 	 */
 	static cv::Mat calculateSkinRegion_HSV(const cv::Mat& image);
 
+	enum SkinModel
+	{
+		SKIN_RGB   = 1 << 0,  ///< @see calculateSkinRegion_RGB
+		SKIN_HSV   = 1 << 1,  ///< @see calculateSkinRegion_HSV
+		SKIN_YCbCr = 1 << 2,  ///< @see calculateSkinRegion_YCbCr
+	};
+
+	/**
+	 * Skin detection with several models at once, a pixel is skin only if all the chosen models agree, which trims
+	 * the false positives of each model. The mask is closed like calculateSkinRegion_RGB() does.
+	 *
+	 * All the skin detections classify a pixel by table lookup, the tables are built on first use and shared.
+	 *
+	 * @param[in] image       an RGB(A) image
+	 * @param[in] models      bitwise OR of SkinModel values
+	 * @param[in] probability Threshold of the YCbCr model in [0, 1], it applies to the raw probability, not the
+	 *                        equalized one of calculateSkinRegion_YCbCr().
+	 * @return single channel mask of uint8_t type, 255 for skin and 0 otherwise.
+	 */
+	static cv::Mat calculateSkinRegion(const cv::Mat& image, int models, float probability = 0.5F);
+
 	/**
 	 * Remove the red eye effect caused by camera flashes.
 	 * This procedure removes the red eye effect caused by camera flashes by using a percentage based red color threshold.
@@ -65,7 +89,19 @@ public:
 	static void whitenSkinByLogCurve(cv::Mat& dst, const cv::Mat& src, float level);
 	static void whitenSkinByLogCurve(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float level);
 	
+	/**
+	 * Smooth skin with a Lee filter, which averages flat areas and keeps edges. Only the bounding rectangle of
+	 * @p mask is processed, and it runs directly on 8-bit data without full size temporary images.
+	 *
+	 * @param[out] dst    The output image, can be @p src.
+	 * @param[in]  src    CV_8UC3 or CV_8UC4 image, alpha channel is kept unchanged.
+	 * @param[in]  mask   CV_8UC1 skin mask, the same size as @p src, 255 takes the full effect.
+	 * @param[in]  radius Window radius of the local statistics.
+	 * @param[in]  level  Noise variance of normalized [0, 1] color, the bigger, the smoother.
+	 * @param[in,out] buffer Scratch memory, pass the same one across calls to avoid reallocations.
+	 */
 	static void beautifySkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level);
+	static void beautifySkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level, std::vector<uint32_t>& buffer);
 };
 
 } /* namespace venus */
@@ -3,6 +3,8 @@
 #endif
 #include <cmath>
 #include <cassert>
+#include <cstdlib>
+#include <algorithm>
 
 #include <opencv2/imgproc.hpp>
 #if TRACE_IMAGES 
@@ -53,77 +55,384 @@ cv::Vec<T, N> interpolate(const Mat& image,
 	return color;
 }
 
-void Effect::mapColor(cv::Mat& dst, const cv::Mat&src, const uint8_t table[256])
+/*
+ * Row kernels of mapColor(). A row is @p pixels pixels of @p channels bytes, @p mask is one weight per
+ * pixel or nullptr, and the 4th channel of a 4 channel image is alpha which is kept untouched.
+ * The masked result is lerp(src, table[src], mask), rounded the same way as lerp(T, T, uint8_t).
+ *
+ * The x86 kernels are selected at run time with cv::checkHardwareSupport, and compiled with function
+ * target attributes so that the build flags needn't change. NEON is decided at compile time, the
+ * 256-entry TBL lookup exists on arm64 only.
+ */
+typedef void (*MapColorRowFunc)(uint8_t* dst, const uint8_t* src, const uint8_t* mask, int pixels, int channels, const uint8_t table[256]);
+
+template <int N>
+static void mapColorRow(uint8_t* dst, const uint8_t* src, const uint8_t* mask, int pixels, int channels, const uint8_t table[256])
 {
-	assert(src.depth() == CV_8U);
-	dst.create(src.rows, src.cols, src.type());
-
-	const int channels = src.channels();
-	const int length = src.rows * src.cols * channels;
+	if(N > 0)
+		channels = N;  // known at compile time, so the inner loops unroll
 
-	if(channels == 4)
+	const int color_channels = channels == 4 ? 3 : channels;
+	const int length = pixels * channels;
+	if(mask == nullptr)
 	{
-		uint8_t* dst_data = dst.data;
-		const uint8_t* src_data = src.data;
-
-		#pragma omp parallel for
-		for(int i = 0; i < length; i += 4)
+		for(int i = 0; i < length; i += channels)
 		{
-			dst_data[i+0] = table[src_data[i+0]];
-			dst_data[i+1] = table[src_data[i+1]];
-			dst_data[i+2] = table[src_data[i+2]];
-			dst_data[i+3] = src_data[i+3];  // keep alpha untouched
+			for(int k = 0; k < color_channels; ++k)
+				dst[i + k] = table[src[i + k]];
+			for(int k = color_channels; k < channels; ++k)
+				dst[i + k] = src[i + k];  // keep alpha untouched
 		}
 	}
 	else
 	{
-		uint8_t* dst_data = dst.data;
-		const uint8_t* src_data = src.data;
+		for(int p = 0, i = 0; p < pixels; ++p, i += channels)
+		{
+			for(int k = 0; k < color_channels; ++k)
+				dst[i + k] = lerp(src[i + k], table[src[i + k]], mask[p]);
+			for(int k = color_channels; k < channels; ++k)
+				dst[i + k] = src[i + k];  // keep alpha untouched
+		}
+	}
+}
 
-		#pragma omp parallel for
-		for(int i = 0; i < length; ++i)
-			dst_data[i] = table[src_data[i]];
+static void mapColorRow(uint8_t* dst, const uint8_t* src, const uint8_t* mask, int pixels, int channels, const uint8_t table[256])
+{
+	switch(channels)
+	{
+	case 1:  mapColorRow<1>(dst, src, mask, pixels, channels, table); break;
+	case 3:  mapColorRow<3>(dst, src, mask, pixels, channels, table); break;
+	case 4:  mapColorRow<4>(dst, src, mask, pixels, channels, table); break;
+	default: mapColorRow<0>(dst, src, mask, pixels, channels, table); break;
 	}
 }
 
-void Effect::mapColor(cv::Mat& dst, const cv::Mat&src, const uint8_t* mask, const uint8_t table[256])
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#	define VENUS_LUT_X86 1
+#	include <immintrin.h>
+#	define VENUS_TARGET_SSSE3 __attribute__((target("ssse3")))
+#	define VENUS_TARGET_AVX2  __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#	define VENUS_LUT_X86 1
+#	include <immintrin.h>
+#	define VENUS_TARGET_SSSE3
+#	define VENUS_TARGET_AVX2
+#endif
+#if defined(__aarch64__)
+#	define VENUS_LUT_NEON 1
+#	include <arm_neon.h>
+#endif
+
+#if VENUS_LUT_X86 || VENUS_LUT_NEON
+#define X 0x80  // shuffle index which yields 0, as weight of alpha channel
+// Shuffles that spread 16 mask bytes over the 16 * channels bytes of 16 pixels, one vector at a time.
+alignas(16) static const uint8_t EXPAND3[3][16] =
 {
-	assert(src.depth() == CV_8U && mask != nullptr);
-	dst.create(src.rows, src.cols, src.type());
+	{ 0,  0,  0,  1,  1,  1,  2,  2,  2,  3,  3,  3,  4,  4,  4,  5},
+	{ 5,  5,  6,  6,  6,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10, 10},
+	{10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15},
+};
+alignas(16) static const uint8_t EXPAND4[4][16] =
+{
+	{ 0,  0,  0,  X,  1,  1,  1,  X,  2,  2,  2,  X,  3,  3,  3,  X},
+	{ 4,  4,  4,  X,  5,  5,  5,  X,  6,  6,  6,  X,  7,  7,  7,  X},
+	{ 8,  8,  8,  X,  9,  9,  9,  X, 10, 10, 10,  X, 11, 11, 11,  X},
+	{12, 12, 12,  X, 13, 13, 13,  X, 14, 14, 14,  X, 15, 15, 15,  X},
+};
+#undef X
+alignas(16) static const uint8_t ALPHA4[16] = {0, 0, 0, 0xFF, 0, 0, 0, 0xFF, 0, 0, 0, 0xFF, 0, 0, 0, 0xFF};
+
+static inline const uint8_t* expandMask(int channels, int index)
+{
+	return channels == 3 ? EXPAND3[index] : EXPAND4[index];
+}
+#endif
 
-	const int channels = src.channels();
-	const int length = src.rows * src.cols * channels;
+#if VENUS_LUT_X86
+/*
+ * PSHUFB looks up 16 entries, and yields 0 for an index with the high bit set. The table is split into
+ * 16 rows, and delta[h] = row[h] ^ row[h - 1] (starting over at h = 8). For x < 128, looking up delta[h]
+ * with x - 16*h hits exactly for h <= x/16 and yields 0 after that, so the XOR of all the lookups is
+ * row[x/16][x%16]. The upper half does the same with x ^ 0x80, and the sign bit of x picks the half.
+ */
+VENUS_TARGET_SSSE3
+static inline __m128i lookupSsse3(const __m128i delta[16], __m128i x)
+{
+	const __m128i k16 = _mm_set1_epi8(16);
+	__m128i index = x, lower = _mm_setzero_si128();
+	for(int h = 0; h < 8; ++h)
+	{
+		lower = _mm_xor_si128(lower, _mm_shuffle_epi8(delta[h], index));
+		index = _mm_sub_epi8(index, k16);
+	}
+
+	__m128i upper = _mm_setzero_si128();
+	index = _mm_xor_si128(x, _mm_set1_epi8(static_cast<char>(0x80)));
+	for(int h = 8; h < 16; ++h)
+	{
+		upper = _mm_xor_si128(upper, _mm_shuffle_epi8(delta[h], index));
+		index = _mm_sub_epi8(index, k16);
+	}
+
+	const __m128i is_upper = _mm_cmplt_epi8(x, _mm_setzero_si128());
+	return _mm_or_si128(_mm_and_si128(is_upper, upper), _mm_andnot_si128(is_upper, lower));
+}
+
+// lerp(s, t, w) in 16 bit fixed point, (v + 128 + ((v + 128) >> 8)) >> 8 is v/255 rounded.
+VENUS_TARGET_SSSE3
+static inline __m128i lerpSsse3(__m128i s, __m128i t, __m128i w)
+{
+	const __m128i zero = _mm_setzero_si128(), k128 = _mm_set1_epi16(128);
+	const __m128i w_ = _mm_xor_si128(w, _mm_set1_epi8(static_cast<char>(0xFF)));  // 255 - w
+
+	__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(w_, zero)),
+			_mm_mullo_epi16(_mm_unpacklo_epi8(t, zero), _mm_unpacklo_epi8(w, zero)));
+	__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(w_, zero)),
+			_mm_mullo_epi16(_mm_unpackhi_epi8(t, zero), _mm_unpackhi_epi8(w, zero)));
+	lo = _mm_add_epi16(lo, k128);
+	hi = _mm_add_epi16(hi, k128);
+	lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+	hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+	return _mm_packus_epi16(lo, hi);
+}
+
+VENUS_TARGET_SSSE3
+static void mapColorRowSsse3(uint8_t* dst, const uint8_t* src, const uint8_t* mask, int pixels, int channels, const uint8_t table[256])
+{
+	if(channels != 1 && channels != 3 && channels != 4)
+		return mapColorRow(dst, src, mask, pixels, channels, table);
 
-	if(channels == 4)
+	__m128i delta[16];
+	for(int h = 0; h < 16; ++h)
 	{
-		uint8_t* dst_data = dst.data;
-		const uint8_t* src_data = src.data;
+		const __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + h * 16));
+		delta[h] = (h % 8 == 0) ? row : _mm_xor_si128(row, _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + h * 16 - 16)));
+	}
+	const __m128i alpha = _mm_load_si128(reinterpret_cast<const __m128i*>(ALPHA4));
 
-		#pragma omp parallel for
-		for(int i = 0; i < length; i += 4)
+	int p = 0;
+	for(; p + 16 <= pixels; p += 16)
+	{
+		const __m128i m = mask != nullptr ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + p)) : _mm_setzero_si128();
+		for(int j = 0; j < channels; ++j)
 		{
-			int _0 = i, _1 = i + 1, _2 = i + 2, _3 = i + 3;
-			dst_data[_0] = lerp(src_data[_0], table[src_data[_0]], mask[i]);
-			dst_data[_1] = lerp(src_data[_1], table[src_data[_1]], mask[i]);
-			dst_data[_2] = lerp(src_data[_2], table[src_data[_2]], mask[i]);
-			dst_data[_3] =      src_data[_3];  // keep alpha untouched
+			const int offset = p * channels + j * 16;
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + offset));
+			__m128i y = lookupSsse3(delta, x);
+			if(mask != nullptr)
+			{
+				const __m128i w = channels == 1 ? m : _mm_shuffle_epi8(m,
+						_mm_load_si128(reinterpret_cast<const __m128i*>(expandMask(channels, j))));
+				y = lerpSsse3(x, y, w);
+			}
+			else if(channels == 4)
+				y = _mm_or_si128(_mm_and_si128(alpha, x), _mm_andnot_si128(alpha, y));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + offset), y);
 		}
 	}
-	else
+
+	mapColorRow(dst + p * channels, src + p * channels, mask != nullptr ? mask + p : nullptr, pixels - p, channels, table);
+}
+
+// the same as lookupSsse3, on both 128-bit lanes
+VENUS_TARGET_AVX2
+static inline __m256i lookupAvx2(const __m256i delta[16], __m256i x)
+{
+	const __m256i k16 = _mm256_set1_epi8(16);
+	__m256i index = x, lower = _mm256_setzero_si256();
+	for(int h = 0; h < 8; ++h)
 	{
-		uint8_t* dst_data = dst.data;
-		const uint8_t* src_data = src.data;
+		lower = _mm256_xor_si256(lower, _mm256_shuffle_epi8(delta[h], index));
+		index = _mm256_sub_epi8(index, k16);
+	}
 
-		#pragma omp parallel for
-		for(int i = 0; i < length; ++i)
+	__m256i upper = _mm256_setzero_si256();
+	index = _mm256_xor_si256(x, _mm256_set1_epi8(static_cast<char>(0x80)));
+	for(int h = 8; h < 16; ++h)
+	{
+		upper = _mm256_xor_si256(upper, _mm256_shuffle_epi8(delta[h], index));
+		index = _mm256_sub_epi8(index, k16);
+	}
+
+	return _mm256_blendv_epi8(lower, upper, x);
+}
+
+VENUS_TARGET_AVX2
+static inline __m256i lerpAvx2(__m256i s, __m256i t, __m256i w)
+{
+	const __m256i zero = _mm256_setzero_si256(), k128 = _mm256_set1_epi16(128);
+	const __m256i w_ = _mm256_xor_si256(w, _mm256_set1_epi8(static_cast<char>(0xFF)));  // 255 - w
+
+	__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(w_, zero)),
+			_mm256_mullo_epi16(_mm256_unpacklo_epi8(t, zero), _mm256_unpacklo_epi8(w, zero)));
+	__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(w_, zero)),
+			_mm256_mullo_epi16(_mm256_unpackhi_epi8(t, zero), _mm256_unpackhi_epi8(w, zero)));
+	lo = _mm256_add_epi16(lo, k128);
+	hi = _mm256_add_epi16(hi, k128);
+	lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+	hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+	return _mm256_packus_epi16(lo, hi);  // unpack and pack are both per lane, so the order is kept
+}
+
+VENUS_TARGET_AVX2
+static void mapColorRowAvx2(uint8_t* dst, const uint8_t* src, const uint8_t* mask, int pixels, int channels, const uint8_t table[256])
+{
+	if(channels != 1 && channels != 3 && channels != 4)
+		return mapColorRow(dst, src, mask, pixels, channels, table);
+
+	__m256i delta[16];
+	for(int h = 0; h < 16; ++h)
+	{
+		__m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + h * 16));
+		if(h % 8 != 0)
+			row = _mm_xor_si128(row, _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + h * 16 - 16)));
+		delta[h] = _mm256_broadcastsi128_si256(row);
+	}
+	const __m256i alpha = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(ALPHA4)));
+
+	// 32 pixels a time, which are channels vectors, or 2 * channels halves, of 16 pixels each
+	int p = 0;
+	for(; p + 32 <= pixels; p += 32)
+	{
+		__m128i m[2];
+		if(mask != nullptr)
 		{
-			if(mask[i] == 0)
-				dst_data[i] = src_data[i];  // copy transparent region
-			else
-//				dst_data[i] = lerp(src_data[i], table[src_data[i]], mask[i]/255.0F);
-				dst_data[i] = lerp(src_data[i], table[src_data[i]], mask[i]);
+			m[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + p));
+			m[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + p + 16));
+		}
+
+		for(int j = 0; j < channels; ++j)
+		{
+			const int offset = p * channels + j * 32;
+			const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + offset));
+			__m256i y = lookupAvx2(delta, x);
+			if(mask != nullptr)
+			{
+				__m128i w[2];
+				for(int half = 0; half < 2; ++half)
+				{
+					const int chunk = j * 2 + half;  // 16 byte chunk, in group chunk / channels of 16 pixels
+					const __m128i& group = m[chunk / channels];
+					w[half] = channels == 1 ? group : _mm_shuffle_epi8(group,
+							_mm_load_si128(reinterpret_cast<const __m128i*>(expandMask(channels, chunk % channels))));
+				}
+				y = lerpAvx2(x, y, _mm256_inserti128_si256(_mm256_castsi128_si256(w[0]), w[1], 1));
+			}
+			else if(channels == 4)
+				y = _mm256_blendv_epi8(y, x, alpha);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + offset), y);
 		}
 	}
+
+	mapColorRowSsse3(dst + p * channels, src + p * channels, mask != nullptr ? mask + p : nullptr, pixels - p, channels, table);
+}
+#endif  // VENUS_LUT_X86
+
+#if VENUS_LUT_NEON
+static void mapColorRowNeon(uint8_t* dst, const uint8_t* src, const uint8_t* mask, int pixels, int channels, const uint8_t table[256])
+{
+	if(channels != 1 && channels != 3 && channels != 4)
+		return mapColorRow(dst, src, mask, pixels, channels, table);
+
+	// TBL looks up 64 entries and yields 0 beyond, TBX leaves the byte as it is beyond.
+	uint8x16x4_t quarter[4];
+	for(int q = 0; q < 4; ++q)
+		for(int i = 0; i < 4; ++i)
+			quarter[q].val[i] = vld1q_u8(table + q * 64 + i * 16);
+	const uint8x16_t k64 = vdupq_n_u8(64), k255 = vdupq_n_u8(255);
+	const uint16x8_t k128 = vdupq_n_u16(128);
+	const uint8x16_t alpha = vld1q_u8(ALPHA4);
+
+	int p = 0;
+	for(; p + 16 <= pixels; p += 16)
+	{
+		const uint8x16_t m = mask != nullptr ? vld1q_u8(mask + p) : vdupq_n_u8(0);
+		for(int j = 0; j < channels; ++j)
+		{
+			const int offset = p * channels + j * 16;
+			const uint8x16_t x = vld1q_u8(src + offset);
+			uint8x16_t index = x;
+			uint8x16_t y = vqtbl4q_u8(quarter[0], index);
+			for(int q = 1; q < 4; ++q)
+			{
+				index = vsubq_u8(index, k64);
+				y = vqtbx4q_u8(y, quarter[q], index);
+			}
+
+			if(mask != nullptr)
+			{
+				const uint8x16_t w = channels == 1 ? m : vqtbl1q_u8(m, vld1q_u8(expandMask(channels, j)));
+				const uint8x16_t w_ = vsubq_u8(k255, w);
+				uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(x), vget_low_u8(w_)), vget_low_u8(y), vget_low_u8(w));
+				uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(x), vget_high_u8(w_)), vget_high_u8(y), vget_high_u8(w));
+				lo = vaddq_u16(lo, k128);
+				hi = vaddq_u16(hi, k128);
+				y = vcombine_u8(vshrn_n_u16(vsraq_n_u16(lo, lo, 8), 8), vshrn_n_u16(vsraq_n_u16(hi, hi, 8), 8));
+			}
+			else if(channels == 4)
+				y = vbslq_u8(alpha, x, y);
+			vst1q_u8(dst + offset, y);
+		}
+	}
+
+	mapColorRow(dst + p * channels, src + p * channels, mask != nullptr ? mask + p : nullptr, pixels - p, channels, table);
+}
+#endif  // VENUS_LUT_NEON
+
+struct MapColorKernel
+{
+	MapColorRowFunc func;
+	const char* name;
+};
+
+static MapColorKernel chooseMapColorKernel()
+{
+#if VENUS_LUT_X86
+	if(cv::checkHardwareSupport(CV_CPU_AVX2))
+		return MapColorKernel{ mapColorRowAvx2, "AVX2" };
+	if(cv::checkHardwareSupport(CV_CPU_SSSE3))
+		return MapColorKernel{ mapColorRowSsse3, "SSSE3" };
+#endif
+#if VENUS_LUT_NEON
+	return MapColorKernel{ mapColorRowNeon, "NEON" };
+#endif
+	return MapColorKernel{ mapColorRow, "scalar" };
+}
+
+static const MapColorKernel& getMapColorKernel()
+{
+	static const MapColorKernel kernel = chooseMapColorKernel();  // thread-safe init
+	return kernel;
+}
+
+const char* Effect::mapColorKernel()
+{
+	return getMapColorKernel().name;
+}
+
+void Effect::mapColor(cv::Mat& dst, const cv::Mat&src, const uint8_t table[256])
+{
+	mapColor(dst, src, Mat(), table);
+}
+
+void Effect::mapColor(cv::Mat& dst, const cv::Mat&src, const uint8_t* mask, const uint8_t table[256])
+{
+	assert(mask != nullptr);
+	mapColor(dst, src, Mat(src.rows, src.cols, CV_8UC1, const_cast<uint8_t*>(mask)), table);
+}
+
+void Effect::mapColor(cv::Mat& dst, const cv::Mat&src, const cv::Mat& mask, const uint8_t table[256])
+{
+	assert(src.depth() == CV_8U);
+	assert(mask.empty() || (mask.type() == CV_8UC1 && mask.size() == src.size()));
+	dst.create(src.rows, src.cols, src.type());
+
+	const MapColorRowFunc map_row = getMapColorKernel().func;
+	const int channels = src.channels();
+
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+		map_row(dst.ptr<uint8_t>(r), src.ptr<uint8_t>(r), mask.empty() ? nullptr : mask.ptr<uint8_t>(r), src.cols, channels, table);
 }
 
 void Effect::tone(cv::Mat& dst, const cv::Mat& src, uint32_t color, float amount)
@@ -337,7 +646,7 @@ void Effect::unsharpMask(cv::Mat& dst, const cv::Mat& src,  float radius/* = 5.0
 	src.copyTo(dst, lowContrastMask);
 }
 
-float Effect::mapColorBalance(float value, float lightness, float shadows, float midtones, float highlights)
+static float colorBalanceOffset(float lightness, float shadows, float midtones, float highlights)
 {
 	/* Apply masks to the corrections for shadows, midtones and highlights so that each correction affects only one range.
 	 * Those masks look like this:
@@ -358,13 +667,79 @@ float Effect::mapColorBalance(float value, float lightness, float shadows, float
 	midtones = midtones * clamp_01((lightness - b) /  a + 0.5F) *
 			clamp_01((lightness + b - 1) / -a + 0.5F) * scale;
 	highlights = highlights * clamp_01((lightness + b - 1) / a + 0.5F) * scale;
-	
-	value += shadows;
-	value += midtones;
-	value += highlights;
-	value = clamp_01(value);
-	
-	return value;
+
+	return shadows + midtones + highlights;
+}
+
+float Effect::mapColorBalance(float value, float lightness, float shadows, float midtones, float highlights)
+{
+	// the offset only depends on lightness, 8-bit images use a table of it.
+	value += colorBalanceOffset(lightness, shadows, midtones, highlights);
+	return clamp<float>(value, 0, 1);
+}
+
+/*
+	8-bit color balance, in fixed point with 8 fraction bits. A channel is shifted by an offset which depends on the
+	channel and on HSL lightness (max + min)/2. In 8-bit, max + min takes 511 values, so the offsets make a small table.
+*/
+static void adjustColorBalance_8u(cv::Mat& dst, const cv::Mat& src, const cv::Vec3f config[3], bool preserve_luminosity)
+{
+	constexpr int ONE = 255 << 8;  // 1.0 in fixed point
+
+	int offset[511][3];
+	for(int sum = 0; sum <= 510; ++sum)
+	for(int k = 0; k < 3; ++k)
+		offset[sum][k] = cvRound(ONE * colorBalanceOffset(sum / 510.0F,
+				config[RANGE_SHADOW][k], config[RANGE_MIDTONE][k], config[RANGE_HIGHLIGHT][k]));
+
+	const int channels = src.channels();
+
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+	{
+		const uint8_t* src_row = src.ptr<uint8_t>(r);
+		uint8_t* dst_row = dst.ptr<uint8_t>(r);
+		for(int c = 0; c < src.cols * channels; c += channels)
+		{
+			const uint8_t* src_rgb = src_row + c;
+			uint8_t* dst_rgb = dst_row + c;
+
+			const int sum = std::max(std::max(src_rgb[0], src_rgb[1]), src_rgb[2]) +
+					std::min(std::min(src_rgb[0], src_rgb[1]), src_rgb[2]);
+
+			int value[3];
+			for(int k = 0; k < 3; ++k)
+				value[k] = clamp((src_rgb[k] << 8) + offset[sum][k], 0, ONE);
+
+			if(preserve_luminosity)
+			{
+				/*
+					Putting the original lightness back while keeping hue and saturation scales the distance of each
+					channel to lightness by the ratio of the chroma limits 1 - |2L - 1| of both lightness, so
+					value = L + (value - L') * ratio, computed with doubled lightness to stay in integers.
+				*/
+				const int mapped_sum = std::max(std::max(value[0], value[1]), value[2]) +
+						std::min(std::min(value[0], value[1]), value[2]);
+				const int target_sum = sum << 8;
+				const int mapped_limit = ONE - std::abs(mapped_sum - ONE);
+				const int target_limit = ONE - std::abs(target_sum - ONE);
+
+				if(mapped_limit == 0)  // black or white, there is no hue to keep
+					value[0] = value[1] = value[2] = target_sum / 2;
+				else
+				{
+					const int64_t ratio = (static_cast<int64_t>(target_limit) << 16) / mapped_limit;
+					for(int k = 0; k < 3; ++k)
+						value[k] = (target_sum + static_cast<int>(((2 * value[k] - mapped_sum) * ratio) >> 16)) / 2;
+				}
+			}
+
+			for(int k = 0; k < 3; ++k)
+				dst_rgb[k] = static_cast<uint8_t>(clamp((value[k] + 128) >> 8, 0, 255));
+			if(channels == 4)
+				dst_rgb[3] = src_rgb[3];
+		}
+	}
 }
 
 void Effect::adjustColorBalance(cv::Mat& dst, const cv::Mat& src, const cv::Vec3f config[3], bool preserve_luminosity)
@@ -373,25 +748,17 @@ void Effect::adjustColorBalance(cv::Mat& dst, const cv::Mat& src, const cv::Vec3
 	if(src.data != dst.data)
 		dst.create(src.rows, src.cols, src.type());
 
-	const int channels = src.channels();
-	const int length = src.rows * src.cols * channels;
-	bool need_cast = src.depth() == CV_8U;
-	Mat _src, _dst;
-	const float* src_data;
-	float* dst_data;
-	if(need_cast)
-	{
-		src.convertTo(_src, CV_32F, 1/255.0F);
-		_dst.create(_src.rows, _src.cols, _src.type());
-		dst_data = _dst.ptr<float>();
-		src_data = _src.ptr<float>();
-	}
-	else
+	if(src.depth() == CV_8U)
 	{
-		dst_data = dst.ptr<float>();
-		src_data = src.ptr<float>();
+		adjustColorBalance_8u(dst, src, config, preserve_luminosity);
+		return;
 	}
 
+	const int channels = src.channels();
+	const int length = src.rows * src.cols * channels;
+	const float* src_data = src.ptr<float>();
+	float* dst_data = dst.ptr<float>();
+
 	for(int i = 0; i < length; i += channels)
 	{
 		const float* src_rgb = src_data + i;
@@ -415,10 +782,9 @@ void Effect::adjustColorBalance(cv::Mat& dst, const cv::Mat& src, const cv::Vec3
 
 		for(int k = 0; k < 3; ++k)
 			assert(0.0F <= dst_rgb[k] && dst_rgb[k] <= 1.0F);
+		if(channels == 4)
+			dst_rgb[3] = src_rgb[3];
 	}
-
-	if(need_cast)
-		_dst.convertTo(dst, 255.0F);
 }
 
 void Effect::adjustBrightnessAndContrast(Mat& dst, const Mat& src, float brightness/* = 0.0F */, float contrast/* = 1.0F */)
@@ -537,6 +903,108 @@ void Effect::adjustGamma(cv::Mat& dst, const cv::Mat& src, const cv::Vec3f& gamm
 	cv::merge(channels, dst);
 }
 
+/*
+	8-bit hue and saturation adjustment, in fixed point. Colors and lightness carry 8 fraction bits, and hue is in
+	[0, 6 * HUE_ONE), a unit per sector. HSL lightness only depends on max + min, which takes 511 values, so the
+	adjusted lightness, and the factor which turns chroma into adjusted chroma, are looked up from tables.
+*/
+static void adjustHueSaturation_8u(cv::Mat& dst, const cv::Mat& src, float hue, float saturation, float lightness)
+{
+#if USE_BGRA_LAYOUT
+	constexpr int _0 = 2, _1 = 1, _2 = 0;
+#else
+	constexpr int _0 = 0, _1 = 1, _2 = 2;
+#endif
+	constexpr int ONE = 255 << 8;
+	constexpr int HUE_ONE = 1 << 16;
+	constexpr int HUE_PERIOD = 6 * HUE_ONE;
+
+	int adjusted[511];  // lightness after adjustment
+	int limit[511];     // chroma limit 1 - |2L - 1| of the adjusted lightness
+	uint32_t gain[511];  // chroma of a level turns into chroma * gain >> 8, the saturation ratio
+	for(int sum = 0; sum <= 510; ++sum)
+	{
+		float l = sum / 510.0F;
+		if(lightness < 0.0F)
+			l *= (lightness + 1.0F);
+		else
+			l += lightness * (1.0F - l);
+
+		adjusted[sum] = cvRound(l * ONE);
+		limit[sum] = ONE - std::abs(2 * adjusted[sum] - ONE);
+
+		// S = chroma / (1 - |2L - 1|) before, chroma = S * (1 - |2L - 1|) after
+		const int old_limit = 255 - std::abs(sum - 255);
+		const float ratio = old_limit > 0 ? saturation * limit[sum] / old_limit : 0.0F;
+		gain[sum] = static_cast<uint32_t>(cvRound(std::min(ratio, static_cast<float>(limit[sum])) * 256));
+	}
+
+	int reciprocal[256];  // HUE_ONE / chroma
+	reciprocal[0] = 0;
+	for(int i = 1; i < 256; ++i)
+		reciprocal[i] = (HUE_ONE + i / 2) / i;
+
+	const int shift = cvRound(hue * HUE_PERIOD);
+	const int channels = src.channels();
+
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+	{
+		const uint8_t* src_row = src.ptr<uint8_t>(r);
+		uint8_t* dst_row = dst.ptr<uint8_t>(r);
+		for(int c = 0; c < src.cols * channels; c += channels)
+		{
+			const int red = src_row[c + _0], green = src_row[c + _1], blue = src_row[c + _2];
+			const int max = std::max(std::max(red, green), blue);
+			const int min = std::min(std::min(red, green), blue);
+			const int sum = max + min, chroma = max - min;
+
+			int rgb[3];
+			if(chroma == 0)  // gray stays gray
+				rgb[0] = rgb[1] = rgb[2] = adjusted[sum];
+			else
+			{
+				int h;
+				if(red == max)
+					h = (green - blue) * reciprocal[chroma];
+				else if(green == max)
+					h = 2 * HUE_ONE + (blue - red) * reciprocal[chroma];
+				else
+					h = 4 * HUE_ONE + (red - green) * reciprocal[chroma];
+
+				h += shift;  // wrap around
+				if(h < 0)
+					h += HUE_PERIOD;
+				else if(h >= HUE_PERIOD)
+					h -= HUE_PERIOD;
+
+				const int C = std::min(static_cast<int>((chroma * gain[sum] + 128) >> 8), limit[sum]);
+				const int m = adjusted[sum] - C / 2;
+				const int sector = h >> 16, fraction = h & (HUE_ONE - 1);
+				const int X = static_cast<int>((static_cast<int64_t>(C) * ((sector & 1) ? HUE_ONE - fraction : fraction)) >> 16);
+
+				switch(sector)
+				{
+				case 0:  rgb[0] = C; rgb[1] = X; rgb[2] = 0; break;
+				case 1:  rgb[0] = X; rgb[1] = C; rgb[2] = 0; break;
+				case 2:  rgb[0] = 0; rgb[1] = C; rgb[2] = X; break;
+				case 3:  rgb[0] = 0; rgb[1] = X; rgb[2] = C; break;
+				case 4:  rgb[0] = X; rgb[1] = 0; rgb[2] = C; break;
+				default: rgb[0] = C; rgb[1] = 0; rgb[2] = X; break;
+				}
+				for(int k = 0; k < 3; ++k)
+					rgb[k] += m;
+			}
+
+			dst_row[c + _0] = static_cast<uint8_t>(clamp((rgb[0] + 128) >> 8, 0, 255));
+			dst_row[c + _1] = static_cast<uint8_t>(clamp((rgb[1] + 128) >> 8, 0, 255));
+			dst_row[c + _2] = static_cast<uint8_t>(clamp((rgb[2] + 128) >> 8, 0, 255));
+			if(channels == 4)
+				dst_row[c + 3] = src_row[c + 3];
+		}
+	}
+}
+
 void Effect::adjustHueSaturation(cv::Mat& dst, const cv::Mat& src, float hue/* = 0.0F */, float saturation/* = 1.0F */, float lightness/* = 0.0F */)
 {
 	assert(-0.5F <= hue && hue <= 0.5F);
@@ -545,56 +1013,47 @@ void Effect::adjustHueSaturation(cv::Mat& dst, const cv::Mat& src, float hue/* =
 
 	const int channel = src.channels();
 	const int depth   = src.depth();
-	const int length  = src.rows * src.cols * channel;
-	assert(channel >= 3 && (depth == CV_8U || depth == CV_32F));
-	assert(dst.data != src.data);
+	assert((channel == 3 || channel == 4) && (depth == CV_8U || depth == CV_32F));
 
-	Mat _dst, _src;  // float type storage
 	if(depth == CV_8U)
-		src.convertTo(_src, CV_32F, 1/255.0F);
-	else
-		src.copyTo(_src);
-#if USE_BGRA_LAYOUT
-	const bool has_alpha = channel > 3;
-	cvtColor(_src, _src, has_alpha?CV_BGRA2RGBA:CV_BGR2RGB);
-#endif
+	{
+		if(src.data != dst.data)
+			dst.create(src.rows, src.cols, src.type());
+		adjustHueSaturation_8u(dst, src, hue, saturation, lightness);
+		return;
+	}
 
-	_src.copyTo(_dst);
-	const float* _src_data = _src.ptr<float>();
-	float* _dst_data = _dst.ptr<float>();
+	// the conversions take care of 8-bit scaling and channel order
+	Mat hsl;
+	rgb2hsl(src, hsl);
 
 	#pragma omp parallel for
-	for(int i = 0; i < length; i += channel)
+	for(int r = 0; r < hsl.rows; ++r)
 	{
-		float hsl[3];
-		rgb2hsl(_src_data + i, hsl);
+		float* hsl_row = hsl.ptr<float>(r);
+		for(int c = 0; c < hsl.cols * channel; c += channel)
+		{
+			float* color = hsl_row + c;
 
-		// wrap around interval [0, 1], make sure that hue interval length is 1.
-		hsl[0] += hue;
-		if(hsl[0] < 0.0F)
-			hsl[0] += 1.0F;
-		else if(hsl[0] > 1.0F)
-			hsl[0] -= 1.0F;
+			// wrap around interval [0, 1], make sure that hue interval length is 1.
+			color[0] += hue;
+			if(color[0] < 0.0F)
+				color[0] += 1.0F;
+			else if(color[0] > 1.0F)
+				color[0] -= 1.0F;
 
-		hsl[1] *= saturation;
-		hsl[1] = clamp(hsl[1]);
+			color[1] *= saturation;
+			color[1] = clamp(color[1]);
 
-		float v = lightness;
-		if(v < 0.0F)
-			hsl[2] *= (v + 1.0F);
-		else
-			hsl[2] += v * (1.0F - hsl[2]);
-		
-		hsl2rgb(hsl, _dst_data + i);
+			float v = lightness;
+			if(v < 0.0F)
+				color[2] *= (v + 1.0F);
+			else
+				color[2] += v * (1.0F - color[2]);
+		}
 	}
-	
-#if USE_BGRA_LAYOUT
-	cvtColor(_dst, _dst, has_alpha?CV_RGBA2BGRA:CV_RGB2BGR);
-#endif
-	if(depth == CV_8U)
-		_dst.convertTo(dst, CV_8U, 255.0F);
-	else
-		_dst.copyTo(dst);
+
+	hsl2rgb(hsl, dst, depth);
 }
 
 } /* namespace venus */
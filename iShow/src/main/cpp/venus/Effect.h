@@ -18,8 +18,24 @@ private:
 	static float mapColorBalance(float value, float lightness, float shadows, float midtones, float highlights);
 
 public:
+	/**
+	 * Map every color channel through a lookup table, alpha channel of a 4 channel image is kept untouched.
+	 * It uses a SIMD kernel if the CPU has one, and works on any cv::Mat, including ROI views of a larger image.
+	 *
+	 * @param[out] dst   The output image, can be the same as @p src.
+	 * @param[in]  src   8-bit image of any channel count.
+	 * @param[in]  mask  CV_8UC1 weight of each pixel, the same size as @p src, dst = lerp(src, table[src], mask).
+	 *                   The pointer version points at src.rows * src.cols continuous weights.
+	 * @param[in]  table The lookup table.
+	 */
 	static void mapColor(cv::Mat& dst, const cv::Mat&src, const uint8_t table[256]);
 	static void mapColor(cv::Mat& dst, const cv::Mat&src, const uint8_t* mask, const uint8_t table[256]);
+	static void mapColor(cv::Mat& dst, const cv::Mat&src, const cv::Mat& mask, const uint8_t table[256]);
+
+	/**
+	 * @return name of the kernel mapColor() runs on this CPU, "AVX2", "SSSE3", "NEON" or "scalar".
+	 */
+	static const char* mapColorKernel();
 
 	/**
 	 * Tone is a color term commonly used by painters. Toning a bitmap with specified color, it's 
@@ -107,8 +123,8 @@ public:
 	 * color balance is the global adjustment of the intensities of the colors (typically red, green, and blue primary colors).
 	 * @see https://en.wikipedia.org/wiki/Color_balance for details.
 	 *
-	 * @param[out] dst
-	 * @param[in]  src
+	 * @param[out] dst    The output image, can be the same as @p src.
+	 * @param[in]  src    RGB(A) image of CV_8U or CV_32F depth, 8-bit images are processed in fixed point.
 	 * @param[in]  config Array of {shadows, midtones, highlights}, each RangeMode is a Vec3f(CYAN_RED, MAGENTA_GREEN, YELLOW_BLUE)
 	 *                    each channel is in range [-1.0, 1.0].
 	 * @param[in] preserve_luminosity
@@ -149,9 +165,11 @@ public:
 	/**
 	 * Adjust hue, saturation, and lightness.
 	 *
-	 * @param[in] hue         Range [-0.5, 0.5], which maps to [-180, 180] degree interval.
-	 * @param[in] saturation  Range [ 0.0, 2.0]
-	 * @param[in] lightness   Range [-0.5, 0.5]
+	 * @param[out] dst         The output image, can be the same as @p src.
+	 * @param[in]  src         RGB(A) image of CV_8U or CV_32F depth, 8-bit images are processed in fixed point.
+	 * @param[in]  hue         Range [-0.5, 0.5], which maps to [-180, 180] degree interval.
+	 * @param[in]  saturation  Range [ 0.0, 2.0]
+	 * @param[in]  lightness   Range [-0.5, 0.5]
 	 */
 	static void adjustHueSaturation(cv::Mat& dst, const cv::Mat& src, float hue = 0.0F, float saturation = 1.0F, float lightness = 0.0F);
 	
@@ -0,0 +1,70 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "venus/FaceTracker.h"
+#include "venus/Feature.h"
+
+#include "stasm/stasm_lib.h"
+#include "stasm/stasm_lib_ext.h"
+
+using namespace cv;
+
+namespace venus {
+
+FaceTracker::FaceTracker(const std::string& classifier_dir, int min_width_percentage/* = 10 */):
+	ctx(nullptr),
+	min_width_percentage(min_width_percentage)
+{
+	// stasm_init loads the models on its first call only
+	if(!stasm_init(classifier_dir.c_str(), 0 /*trace*/))
+		printf("stasm_init failed: %s\n", stasm_lasterr());
+	else if((ctx = stasm_ctx_create()) == nullptr)
+		printf("stasm_ctx_create failed: %s\n", stasm_lasterr());
+}
+
+FaceTracker::~FaceTracker()
+{
+	stasm_ctx_destroy(ctx);
+}
+
+std::vector<cv::Point2f> FaceTracker::track(const cv::Mat& image)
+{
+	assert(image.channels() == 1 && image.isContinuous());  // single channel required, namely gray image.
+	if(ctx == nullptr)
+		return {};
+
+	// track in place, stasm reads the previous landmarks before writing the new ones
+	const bool tracking = isTracking();
+	landmarks.resize(stasm_NLANDMARKS * 2);
+	int found_face = 0;
+	if(!stasm_ctx_track(ctx, &found_face, landmarks.data(), tracking ? landmarks.data() : nullptr,
+			reinterpret_cast<const char*>(image.data), image.cols, image.rows, "track", min_width_percentage))
+		printf("stasm_ctx_track failed: %s\n", stasm_lasterr());
+
+	if(!found_face)
+	{
+		landmarks.clear();
+		return {};
+	}
+
+	return Feature::fromLandmarks(landmarks.data());
+}
+
+void FaceTracker::reset()
+{
+	landmarks.clear();
+}
+
+FaceTracker::Statistics FaceTracker::getStatistics() const
+{
+	Statistics statistics;
+	stasm_ctx_track_stats(ctx, &statistics.fine, &statistics.full, &statistics.detect, 0);
+	return statistics;
+}
+
+void FaceTracker::resetStatistics()
+{
+	stasm_ctx_track_stats(ctx, nullptr, nullptr, nullptr, 1);
+}
+
+} /* namespace venus */
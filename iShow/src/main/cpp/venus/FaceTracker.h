@@ -0,0 +1,79 @@
+#ifndef VENUS_FACE_TRACKER_H_
+#define VENUS_FACE_TRACKER_H_
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+struct stasm_ctx;
+
+namespace venus {
+
+/**
+ * Tracks the feature points of one face through the frames of a video, e.g. a camera preview.
+ *
+ * Feature::detectFace() runs the face, eye and mouth cascades and the whole ASM pyramid on every image. A tracker
+ * starts the ASM search from the landmarks of the previous frame instead, inside a region around them, and searches
+ * only the finest pyramid levels while the face moves little. The face is detected again when the result moved or
+ * scaled too much from the previous frame, or when the shape model fits the image poorly: the points the descriptors
+ * match scatter away from any face shape, as they do when the face is lost, occluded or turned far away.
+ *
+ * <code>
+ * FaceTracker tracker(CLASSIFIER_DIR);
+ * while(camera.read(frame))
+ * {
+ *     cvtColor(frame, gray, COLOR_BGR2GRAY);
+ *     std::vector<Point2f> points = tracker.track(gray);
+ *     if(!points.empty())
+ *         ...
+ * }
+ * </code>
+ *
+ * A tracker owns a stasm context, different trackers can be used in different threads.
+ */
+class FaceTracker
+{
+public:
+	struct Statistics
+	{
+		int fine;    ///< frames tracked with the finest pyramid levels only
+		int full;    ///< frames tracked with the whole pyramid, the face moved more
+		int detect;  ///< frames in which the face had to be detected
+	};
+
+private:
+	stasm_ctx* ctx;
+	std::vector<float> landmarks;  ///< of the previous frame, empty if the face is not being tracked
+	int min_width_percentage;
+
+public:
+	/**
+	 * @param[in] classifier_dir       The classifiers (haarcascade_frontalface_alt2.xml and so on) directory.
+	 * @param[in] min_width_percentage Minimum face width as percentage of image width, used when detecting.
+	 */
+	explicit FaceTracker(const std::string& classifier_dir, int min_width_percentage = 10);
+	~FaceTracker();
+
+	FaceTracker(const FaceTracker&) = delete;
+	FaceTracker& operator=(const FaceTracker&) = delete;
+
+	/**
+	 * @param[in] image The next @p gray frame, must be continuous.
+	 * @return Feature points of the face as Feature::detectFace() returns, empty if there is no face.
+	 */
+	std::vector<cv::Point2f> track(const cv::Mat& image);
+
+	/**
+	 * Forget the face, the next frame will be detected from scratch. Call it on a cut, or when the camera switches.
+	 */
+	void reset();
+
+	bool isTracking() const { return !landmarks.empty(); }
+
+	Statistics getStatistics() const;
+	void resetStatistics();
+};
+
+} /* namespace venus */
+#endif /* VENUS_FACE_TRACKER_H_ */
@@ -1,10 +1,17 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+
 #include <opencv2/imgcodecs.hpp>
 
 #include "venus/blur.h"
 #include "venus/Effect.h"
 #include "venus/Feature.h"
+#include "venus/MaskCache.h"
 #include "venus/opencv_utility.h"
 #include "venus/scalar.h"
+#include "venus/ThreadPool.h"
 
 #include "stasm/stasm_lib.h"
 
@@ -361,7 +368,7 @@ static void sort(std::vector<std::vector<cv::Point2f>>& faces)
 	}
 }
 
-static std::vector<cv::Point2f> process(float landmarks[stasm_NLANDMARKS * 2])
+static std::vector<cv::Point2f> process(const float landmarks[stasm_NLANDMARKS * 2])
 {
 	std::vector<Point2f> points;
 
@@ -423,6 +430,7 @@ static std::vector<cv::Point2f> process(float landmarks[stasm_NLANDMARKS * 2])
 
 	for(; i < stasm_NLANDMARKS; ++i)
 		points.push_back(Point2f(landmarks[i*2], landmarks[i*2+1]));
+#endif
 
 #if 0
 	// add more points for better Delaunay triangulation result.
@@ -530,7 +538,6 @@ std::vector<std::vector<cv::Point2f>> Feature::detectFaces(const cv::Mat& image,
 
 		std::vector<cv::Point2f> points = process(landmarks);
 		faces.push_back(std::move(points));
-#endif
 		// Stasm doesn't detect iris precisely, post-processing feature points for fine result.
 //		correctIris(image, points);
     }
@@ -539,6 +546,122 @@ std::vector<std::vector<cv::Point2f>> Feature::detectFaces(const cv::Mat& image,
 	return faces;
 }
 
+// Each stasm context loads its own cascade classifiers, which is slow, so contexts are recycled
+// across calls instead of being created per image. They are destroyed at program exit, after the
+// shared ThreadPool, whose workers might still return them, since that one is created later.
+static struct ContextPool
+{
+	std::mutex mutex;
+	std::vector<stasm_ctx*> contexts;
+
+	~ContextPool()
+	{
+		for(stasm_ctx* ctx : contexts)
+			stasm_ctx_destroy(ctx);
+	}
+} context_pool;
+
+class ContextGuard
+{
+public:
+	stasm_ctx* const ctx;
+
+	ContextGuard():
+		ctx(acquire())
+	{
+	}
+
+	~ContextGuard()
+	{
+		if(ctx != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(context_pool.mutex);
+			context_pool.contexts.push_back(ctx);
+		}
+	}
+
+	ContextGuard(const ContextGuard&) = delete;
+	ContextGuard& operator=(const ContextGuard&) = delete;
+
+private:
+	static stasm_ctx* acquire()
+	{
+		{
+			std::lock_guard<std::mutex> lock(context_pool.mutex);
+			if(!context_pool.contexts.empty())
+			{
+				stasm_ctx* ctx = context_pool.contexts.back();
+				context_pool.contexts.pop_back();
+				return ctx;
+			}
+		}
+
+		stasm_ctx* ctx = stasm_ctx_create();
+		if(ctx == nullptr)
+			printf("stasm_ctx_create failed: %s\n", stasm_lasterr());
+		return ctx;
+	}
+};
+
+std::vector<std::vector<std::vector<cv::Point2f>>> Feature::detectFacesBatch(const std::vector<cv::Mat>& images, const std::string& classifier_dir)
+{
+	std::vector<std::vector<std::vector<cv::Point2f>>> result(images.size());
+	if(images.empty())
+		return result;
+
+	// stasm_init loads the models on its first call only
+	if(!stasm_init(classifier_dir.c_str(), 0 /*trace*/))
+	{
+		printf("stasm_init failed: %s\n", stasm_lasterr());
+		return result;
+	}
+
+	ThreadPool& pool = ThreadPool::shared();
+	pool.parallelFor(static_cast<int>(images.size()), [&](int i)
+	{
+		const cv::Mat& image = images[i];
+		assert(image.channels() == 1 && image.isContinuous());
+
+		ContextGuard detector;
+		if(detector.ctx == nullptr)
+			return;
+
+		const std::string tag = "batch#" + to_string(i);
+		int allow_multiple_faces = 1;
+		int min_width_percentage = 10;
+		if(!stasm_ctx_open_image(detector.ctx, reinterpret_cast<const char*>(image.data), image.cols, image.rows,
+				tag.c_str(), allow_multiple_faces, min_width_percentage))
+		{
+			printf("stasm_ctx_open_image failed: %s\n", stasm_lasterr());
+			return;
+		}
+
+		const int nb_face = stasm_ctx_nfaces(detector.ctx);
+		std::vector<std::vector<cv::Point2f>> faces(nb_face);
+		pool.parallelFor(nb_face, [&](int j)
+		{
+			// The first face is searched in the detector's own context, other faces only read its image and face
+			// list, so a lone face, the common case, needs no other context.
+			std::unique_ptr<ContextGuard> searcher(j > 0 ? new ContextGuard() : nullptr);
+			stasm_ctx* ctx = searcher ? searcher->ctx : detector.ctx;
+
+			float landmarks[stasm_NLANDMARKS * 2];  // x, y coordinates
+			if(ctx != nullptr && stasm_ctx_search_face(ctx, detector.ctx, j, landmarks))
+				faces[j] = process(landmarks);
+			else
+				printf("stasm_ctx_search_face failed: %s\n", stasm_lasterr());
+		});
+
+		auto failed = [](const std::vector<cv::Point2f>& face) { return face.empty(); };
+		faces.erase(std::remove_if(faces.begin(), faces.end(), failed), faces.end());
+
+		sort(faces);  // sort multiple faces in area descending order
+		result[i] = std::move(faces);
+	});
+
+	return result;
+}
+
 std::vector<std::vector<cv::Point2f>> Feature::detectFaces(cv::Size2i* size, const std::string& image_name, const std::string& classifier_dir)
 {
 	cv::Mat image = cv::imread(image_name, cv::IMREAD_GRAYSCALE);
@@ -554,6 +677,11 @@ std::vector<std::vector<cv::Point2f>> Feature::detectFaces(cv::Size2i* size, con
 	return detectFaces(image, image_name, classifier_dir);
 }
 
+std::vector<cv::Point2f> Feature::fromLandmarks(const float* landmarks)
+{
+	return process(landmarks);
+}
+
 void Feature::mark(Mat& image, const std::vector<Point2f>& points)
 {
 	const cv::Scalar text_color = CV_RGB(0, 255, 0);
@@ -809,6 +937,126 @@ cv::Vec4f Feature::getSymmetryAxis(const std::vector<cv::Point2f>& points)
 	return line;
 }
 
+/*
+ * Signed distance from pixel centers of @p rect to the edges of @p polygons, positive inside. Pixel (x, y) is
+ * at point (x, y), same as cv::fillPoly(), and inside is decided by the even-odd rule, same as cv::fillPoly()
+ * with several contours. Distances beyond @p band are clamped to ±band, and edges that far away are skipped.
+ */
+static void signedDistance(cv::Mat& distance, const cv::Rect2i& rect, const std::vector<std::vector<cv::Point2f>>& polygons, float band)
+{
+	struct Edge
+	{
+		Point2f a, ab;
+		float inv_length2;  // 1/|ab|^2, 0 for degenerate edges
+		float top, bottom;
+	};
+
+	std::vector<Edge> edges;
+	for(const std::vector<Point2f>& polygon : polygons)
+	for(size_t i = 0, n = polygon.size(); i < n; ++i)
+	{
+		const Point2f& a = polygon[i];
+		const Point2f& b = polygon[(i + 1) % n];
+		Edge edge;
+		edge.a = a;
+		edge.ab = b - a;
+		const float length2 = edge.ab.dot(edge.ab);
+		edge.inv_length2 = length2 > 0 ? 1.0F / length2 : 0.0F;
+		edge.top = std::min(a.y, b.y);
+		edge.bottom = std::max(a.y, b.y);
+		edges.push_back(edge);
+	}
+
+	distance.create(rect.size(), CV_32FC1);
+	const float band2 = band * band;
+
+	#pragma omp parallel for
+	for(int r = 0; r < rect.height; ++r)
+	{
+		const float y = static_cast<float>(rect.y + r);
+
+		// x of the crossings in this row, for the even-odd rule
+		std::vector<float> crossings;
+		// edges which may be within band of this row
+		std::vector<const Edge*> nearby;
+		for(const Edge& edge : edges)
+		{
+			const Point2f& a = edge.a;
+			const float by = a.y + edge.ab.y;
+			if((a.y <= y) != (by <= y))
+				crossings.push_back(a.x + (y - a.y) * edge.ab.x / edge.ab.y);
+
+			const float gap = y < edge.top ? edge.top - y : (y > edge.bottom ? y - edge.bottom : 0.0F);
+			if(gap * gap < band2)
+				nearby.push_back(&edge);
+		}
+		std::sort(crossings.begin(), crossings.end());
+
+		float* distance_row = distance.ptr<float>(r);
+		size_t k = 0;  // crossings on the left of x
+		for(int c = 0; c < rect.width; ++c)
+		{
+			const Point2f p(static_cast<float>(rect.x + c), y);
+			while(k < crossings.size() && crossings[k] <= p.x)
+				++k;
+
+			float d2 = band2;
+			for(const Edge* edge : nearby)
+			{
+				const Point2f ap = p - edge->a;
+				const float t = clamp(ap.dot(edge->ab) * edge->inv_length2, 0.0F, 1.0F);
+				const Point2f v = ap - edge->ab * t;
+				d2 = std::min(d2, v.dot(v));
+			}
+
+			const float d = std::sqrt(d2);
+			distance_row[c] = (k & 1) ? d : -d;
+		}
+	}
+}
+
+// Map signed distance to alpha, which ramps up from -outer to +inner.
+static void distanceToMask(cv::Mat& mask, const cv::Mat& distance, float inner, float outer, Feature::Falloff falloff)
+{
+	assert(distance.type() == CV_32FC1 && inner + outer > 0);
+	mask.create(distance.size(), CV_8UC1);
+	const float scale = 1.0F / (inner + outer);
+
+	#pragma omp parallel for
+	for(int r = 0; r < distance.rows; ++r)
+	{
+		const float* distance_row = distance.ptr<float>(r);
+		uint8_t* mask_row = mask.ptr<uint8_t>(r);
+		for(int c = 0; c < distance.cols; ++c)
+		{
+			float t = clamp((distance_row[c] + outer) * scale, 0.0F, 1.0F);
+			switch(falloff)
+			{
+			case Feature::Falloff::LINEAR:                            break;
+			case Feature::Falloff::SMOOTH:    t = t * t * (3 - 2 * t); break;
+			case Feature::Falloff::QUADRATIC: t = t * (2 - t);         break;
+			}
+			mask_row[c] = static_cast<uint8_t>(t * 255 + 0.5F);
+		}
+	}
+}
+
+cv::Mat Feature::maskPolygonSoft(const cv::Rect2i& rect, const std::vector<std::vector<cv::Point2f>>& polygons,
+		float inner, float outer, Falloff falloff/* = Falloff::SMOOTH */)
+{
+	assert(inner >= 0 && outer >= 0 && inner + outer > 0);
+	Mat distance, mask;
+	signedDistance(distance, rect, polygons, std::max(inner, outer));
+	distanceToMask(mask, distance, inner, outer, falloff);
+	return mask;
+}
+
+cv::Mat Feature::maskPolygonSoft(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points,
+		float inner, float outer, Falloff falloff/* = Falloff::SMOOTH */)
+{
+	return maskPolygonSoft(rect, std::vector<std::vector<Point2f>>{ points }, inner, outer, falloff);
+}
+
 cv::Mat Feature::createMask(const std::vector<cv::Point2f>& points, float blur_radius/* = 0.0F */, cv::Point2i* position/* = nullptr */)
 {
 	assert(points.size() >= 3 && blur_radius >= 0.0F);
@@ -820,12 +1068,15 @@ cv::Mat Feature::createMask(const std::vector<cv::Point2f>& points, float blur_r
 		Region::inset(rect, blur_radius);
 
 	Rect2i _rect = rect;
-	cv::Mat mask(_rect.size(), CV_8UC1, Scalar(0));
-
 	cv::Point2i _position = _rect.tl();
 	if(position)
 		*position = _position;
 
+	// venus::gaussianBlur() used to feather it, whose kernel is nearly flat within radius, namely a linear ramp.
+	if(enable_blur)
+		return maskPolygonSoft(_rect, points, blur_radius, blur_radius, Falloff::LINEAR);
+
+	cv::Mat mask(_rect.size(), CV_8UC1, Scalar(0));
 	const size_t length = points.size();
 	std::vector<cv::Point2i> points_(length);
 	for(size_t i = 0; i < length; ++i)
@@ -834,10 +1085,6 @@ cv::Mat Feature::createMask(const std::vector<cv::Point2f>& points, float blur_r
 	const Point2i* polygon_data[1] = { points_.data() };
 	const int       point_count[1] = { static_cast<int>(points_.size()) };
 	cv::fillPoly(mask, polygon_data, point_count, 1, Scalar(255));
-
-	if(enable_blur)
-		venus::gaussianBlur(mask, mask, blur_radius);
-	
 	return mask;
 }
 
@@ -868,29 +1115,14 @@ cv::Mat Feature::maskPolygonSmooth(const cv::Rect2i& rect, const std::vector<cv:
 {
 	assert(level > 0);
 
+	// It used to fill @p level shrinking copies of the polygon, value rising as (1 - s^2) where s is the scale
+	// from polygon center, then blur by measure/level. In terms of the distance to edges, that's a quadratic
+	// ease out from the edge up to the deepest point, with a feather of measure/level outside, minus the bands.
 	Point2f sum(0.0f, 0.0f);
 	for(const Point2f& point : points)
 		sum += point;
 	Point2f center = sum / static_cast<int>(points.size());
 
-//	Rect rect = cv::boundingRect(points);  // expose rect as parameter
-	const Point2f origin = rect.tl();
-	std::vector<Point2i> tmp_points = cast(points);
-	Mat mask(rect.size(), CV_8UC1, Scalar(0));
-
-	const Point* polygons[] = { tmp_points.data() };
-	const int  num_points[] = { static_cast<int>(tmp_points.size()) };
-	for(int j = 1; j <= level; ++j)
-	{
-		float FACTOR = std::sqrt(1.0F - static_cast<float>(j-1)/level);  // every step shrinks a little bit.
-
-		for(size_t i = 0; i < points.size(); ++i)
-			tmp_points[i] = (points[i] - center) * FACTOR + center - origin;
-
-		cv::fillPoly(mask, polygons, num_points, 1, Scalar(j*255.0/level));
-	}
-
-	// find max distance from center
 	float measure = 0;
 	for(const Point2f& point : points)
 	{
@@ -900,7 +1132,12 @@ cv::Mat Feature::maskPolygonSmooth(const cv::Rect2i& rect, const std::vector<cv:
 	measure /= points.size();
 	measure = std::sqrt(measure);
 
-	venus::gaussianBlur(mask, mask, measure/level);
+	Mat distance, mask;
+	signedDistance(distance, rect, std::vector<std::vector<Point2f>>{ points }, std::numeric_limits<float>::infinity());
+	double depth = 0;
+	cv::minMaxLoc(distance, nullptr, &depth);
+
+	distanceToMask(mask, distance, static_cast<float>(std::max(depth, 1.0)), measure/level, Falloff::QUADRATIC);
 	return mask;
 }
 
@@ -1227,7 +1464,7 @@ Region Feature::calculateEyeRegion(const std::vector<cv::Point2f>& points, const
 	std::vector<Point2f> polygon = calculateEyePolygon(points, right);
 	std::vector<Point2i> polygon2 = venus::cast(polygon);
 	Rect rect = cv::boundingRect(polygon);
-	Mat mask = maskPolygon(rect, polygon);
+	Mat mask = MaskCache::instance().maskPolygonSoft(rect, polygon, 0.5F, 0.5F, Falloff::LINEAR);  // anti-aliased edge
 
 	Point2f pivot = right?
 		(points[36] + points[40])/2:
@@ -1262,15 +1499,9 @@ Region Feature::calculateLipsRegion(const std::vector<cv::Point2f>& points, cons
 	Point2f pivot = (rect.tl() + rect.br())/2.0f;
 	Size2f size = calculateSize(box, line);
 
-	std::vector<cv::Point2i> _polygon = cast(polygon);
-	const Point2i position = rect.tl();
-	for(Point2i& point : _polygon)
-		point -= position;
-
-	const Point2i* polygons[] = { _polygon.data(), _polygon.data() + length_t };
-	const int    num_points[] = { length_t, length_b };
-	Mat mask(rect.size(), CV_8UC1, Scalar(0));
-	cv::fillPoly(mask, polygons, num_points, 2, Scalar(255));
+	// anti-aliased edge, the two lips are filled with even-odd rule like cv::fillPoly() does.
+	Mat mask = MaskCache::instance().maskPolygonSoft(rect, std::vector<std::vector<Point2f>>{ polygon_t, polygon_b },
+			0.5F, 0.5F, Falloff::LINEAR);
 
 	return Region(pivot, size, mask);
 }
@@ -67,6 +67,25 @@ public:
 	 */
 	static std::vector<std::vector<cv::Point2f>> detectFaces(cv::Size2i* size, const std::string& image_name, const std::string& classifier_dir);
 
+	/**
+	 * Detect feature points from many images at once, e.g. a whole album. Both the images and the faces
+	 * inside each image are spread across ThreadPool::shared(), and the models are loaded only once.
+	 *
+	 * @param[in] images         The @p gray images to be detected, each must be continuous.
+	 * @param[in] classifier_dir The classifiers (haarcascade_frontalface_alt2.xml and so on) directory.
+	 * @return Faces detected of each image, in the same order as @p images. Faces of one image are ordered
+	 *         as detectFaces() does.
+	 */
+	static std::vector<std::vector<std::vector<cv::Point2f>>> detectFacesBatch(const std::vector<cv::Mat>& images, const std::string& classifier_dir);
+
+	/**
+	 * Convert landmarks found by stasm into feature points, with the bonus points that detectFace() adds.
+	 *
+	 * @param[in] landmarks x0, y0, x1, y1, ... of stasm_NLANDMARKS points.
+	 * @return COUNT feature points.
+	 */
+	static std::vector<cv::Point2f> fromLandmarks(const float* landmarks);
+
 	static void mark(cv::Mat& image, const std::vector<cv::Point2f>& points);
 
 	static void markWithIndices(cv::Mat& image, const std::vector<cv::Point2f>& points);
@@ -82,10 +101,47 @@ public:
 	static cv::Vec4f getSymmetryAxis(const std::vector<cv::Point2f>& points);
 	inline cv::Vec4f getSymmetryAxis() const { return line; }
 
+	/**
+	 * How alpha of a soft mask rises across the feather, as a function of t in [0, 1].
+	 */
+	enum class Falloff
+	{
+		LINEAR,     ///< t
+		SMOOTH,     ///< t^2 * (3 - 2*t), smoothstep
+		QUADRATIC,  ///< t * (2 - t), eases out towards the inside
+	};
+
+	/**
+	 * Create a feathered mask from the exact signed distance of every pixel to the polygon edges, instead of
+	 * filling then blurring, so there are no bands and the cost doesn't grow with the feather. Alpha ramps up
+	 * from 0 at @p outer pixels outside the edges, to 255 at @p inner pixels inside. Rows are done in parallel.
+	 *
+	 * @param[in] rect     Area of the mask, in the same coordinates as @p polygons.
+	 * @param[in] polygons One or more polygons, inside is decided by the even-odd rule, like cv::fillPoly().
+	 * @param[in] inner    Feather width inside the edges.
+	 * @param[in] outer    Feather width outside the edges. Use inner = outer = 0.5 for an anti-aliased polygon.
+	 * @param[in] falloff  Shape of the ramp.
+	 * @return CV_8UC1 mask of @p rect size.
+	 */
+	static cv::Mat maskPolygonSoft(const cv::Rect2i& rect, const std::vector<std::vector<cv::Point2f>>& polygons,
+			float inner, float outer, Falloff falloff = Falloff::SMOOTH);
+	static cv::Mat maskPolygonSoft(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points,
+			float inner, float outer, Falloff falloff = Falloff::SMOOTH);
+
+	/**
+	 * @param[in]  points      Polygon vertices.
+	 * @param[in]  blur_radius Feather width on both sides of the edges, 0 for a hard mask.
+	 * @param[out] position    Nullable, top left corner of the mask.
+	 */
 	static cv::Mat createMask(const std::vector<cv::Point2f>& points, float blur_radius = 0.0F, cv::Point2i* position = nullptr);
 
 	static cv::Mat maskPolygon(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points, int start, int length);
 	static cv::Mat maskPolygon(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points);
+
+	/**
+	 * A mask that rises from the polygon edges to its deepest point, with a feather of about 1/level of its size
+	 * outside. Computed with maskPolygonSoft(), @p level no longer means the number of fills.
+	 */
 	static cv::Mat maskPolygonSmooth(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points, const int level = 8);
 
 	static std::vector<cv::Point2f> calculateBrowPolygon (const std::vector<cv::Point2f>& points, bool right);
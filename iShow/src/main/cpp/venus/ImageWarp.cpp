@@ -1,3 +1,6 @@
+#include <map>
+
+#include "venus/Feature.h"
 #include "venus/ImageWarp.h"
 #include "venus/opencv_utility.h"
 #include "venus/scalar.h"
@@ -8,6 +11,7 @@ using namespace cv;
 namespace venus {
 
 ImageWarp::ImageWarp(int grid_size):
+	field_dirty(true),
 	grid_size(grid_size)
 {
 }
@@ -34,59 +38,73 @@ cv::Mat ImageWarp::setAllAndGenerate(const cv::Mat& src,
 	return genNewImage(src, amount);
 }
 
-cv::Mat ImageWarp::genNewImage(const cv::Mat& src, float amount)
+void ImageWarp::updateField()
 {
-	Mat dst(dst_size.height, dst_size.width, src.type());
-	for(int i = 0; i < dst_size.height; i += grid_size)
-	for(int j = 0; j < dst_size.width; j += grid_size)
+	const int rows = dst_size.height, cols = dst_size.width;
+	field_dx.create(rows, cols);
+	field_dy.create(rows, cols);
+
+	#pragma omp parallel for
+	for(int r = 0; r < rows; ++r)
 	{
+		// the grid rows around r, the last cell is shrunk to fit as calculateDelta does
+		int i = r / grid_size * grid_size;
 		int ni = i + grid_size;
-		int nj = j + grid_size;
-		float w = static_cast<float>(grid_size), h = w;
-		if(ni >= dst_size.height) ni = dst_size.height - 1, h = static_cast<float>(ni - i + 1);
-		if(nj >= dst_size.width)  nj = dst_size.width - 1,  w = static_cast<float>(nj - j + 1);
+		float h = static_cast<float>(grid_size);
+		if(ni >= rows) ni = rows - 1, h = static_cast<float>(ni - i + 1);
+		const float di = (r - i) / h;
 
-		for(int di = 0; di < h; ++di)
-		for(int dj = 0; dj < w; ++dj)
+		const float* dx0 = rDx[i], *dx1 = rDx[ni];
+		const float* dy0 = rDy[i], *dy1 = rDy[ni];
+		float* dx = field_dx[r];
+		float* dy = field_dy[r];
+
+		for(int j = 0; j < cols; j += grid_size)
 		{
-			float deltaX = bilinear_interp(di/h, dj/w, rDx(i,j),rDx(i, nj), rDx(ni, j), rDx(ni, nj));
-			float deltaY = bilinear_interp(di/h, dj/w, rDy(i,j),rDy(i, nj), rDy(ni, j), rDy(ni, nj));
-			float nx = j + dj + deltaX * amount;
-			float ny = i + di + deltaY * amount;
-
-			nx = clamp(nx, 0.0F, static_cast<float>(src_size.width - 1));
-			ny = clamp(ny, 0.0F, static_cast<float>(src_size.height - 1));
-   
-			int x0 = int(nx), y0 = int(ny);
-			int x1 = std::ceil(nx), y1 = std::ceil(ny);
-			
-			switch(src.channels())
-			{
-			case 1:
-				dst.at<uchar>(i + di, j + dj) = bilinear_interp(ny - y0, nx - x0,
-						src.at<uchar>(y0, x0), src.at<uchar>(y0, x1),
-						src.at<uchar>(y1, x0), src.at<uchar>(y1, x1));
-				break;
-			case 3:
-				for(int b=0; b<3; ++b)
-					dst.at<Vec3b>(i + di, j + dj)[b] = bilinear_interp(ny - y0, nx - x0,
-						src.at<Vec3b>(y0, x0)[b], src.at<Vec3b>(y0, x1)[b],
-						src.at<Vec3b>(y1, x0)[b], src.at<Vec3b>(y1, x1)[b]);
-				break;
-			case 4:
+			int nj = j + grid_size;
+			float w = static_cast<float>(grid_size);
+			if(nj >= cols) nj = cols - 1, w = static_cast<float>(nj - j + 1);
+
+			const int end = std::min(j + grid_size, cols);
+			for(int c = j; c < end; ++c)
 			{
-				for(int b=0; b<4; ++b)
-					dst.at<Vec4b>(i + di, j + dj)[b] = bilinear_interp(ny - y0, nx - x0,
-						src.at<Vec4b>(y0, x0)[b], src.at<Vec4b>(y0, x1)[b],
-						src.at<Vec4b>(y1, x0)[b], src.at<Vec4b>(y1, x1)[b]);
-			}
-				break;
-			default:
-				assert(false);
-				break;
+				const float dj = (c - j) / w;
+				dx[c] = bilinear_interp(di, dj, dx0[j], dx0[nj], dx1[j], dx1[nj]);
+				dy[c] = bilinear_interp(di, dj, dy0[j], dy0[nj], dy1[j], dy1[nj]);
 			}
 		}
 	}
+
+	field_dirty = false;
+}
+
+cv::Mat ImageWarp::genNewImage(const cv::Mat& src, float amount)
+{
+	if(field_dirty)
+		updateField();
+
+	const int rows = dst_size.height, cols = dst_size.width;
+	map_x.create(rows, cols);
+	map_y.create(rows, cols);
+
+	#pragma omp parallel for
+	for(int r = 0; r < rows; ++r)
+	{
+		const float* dx = field_dx[r];
+		const float* dy = field_dy[r];
+		float* x = map_x[r];
+		float* y = map_y[r];
+		for(int c = 0; c < cols; ++c)  // simple enough to be vectorized by compiler
+		{
+			x[c] = c + dx[c] * amount;
+			y[c] = r + dy[c] * amount;
+		}
+	}
+
+	// cv::remap does the bilinear gather with fixed-point SIMD code and splits the rows across threads.
+	// BORDER_REPLICATE is the same as clamping the coordinates into the source image.
+	Mat dst;
+	cv::remap(src, dst, map_x, map_y, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
 	return dst;
 }
 
@@ -98,11 +116,6 @@ void ImageWarp::setMappingPoints(const std::vector<cv::Point2f>& dst_points, con
 	this->dst_points = src_points;
 }
 
-ImageWarp_Rigid::ImageWarp_Rigid()
-{
-	prescale = false;
-}
-
 static float calculateArea(const std::vector<cv::Point2f>& points)
 {
 	Vec4f box = venus::boundingBox(points);
@@ -110,420 +123,476 @@ static float calculateArea(const std::vector<cv::Point2f>& points)
 	return (box[2] - box[0])*(box[3] - box[1]);
 }
 
-void ImageWarp_Rigid::calculateDelta(float alpha)
+/*
+	Moments of node v, with p = src_points[k] - v, q = dst_points[k] - v and w = |p|^(-2*alpha):
+	0: sum(w)
+	1, 2: sum(w*p)
+	3, 4: sum(w*q)
+	5: sum(w*|p|^2)
+	6, 7, 8, 9: sum(w*q.x*p.x), sum(w*q.x*p.y), sum(w*q.y*p.x), sum(w*q.y*p.y)
+
+	All the centered sums used by MLS follow from these, e.g. sum(w*(q - q*)*(p - p*)^T) = sum(w*q*p^T) - sum(w)*q**p*^T.
+	Coordinates are relative to the node to keep the cancellation error small, and sums are kept in double
+	because updateMappingPoints() adds and subtracts terms repeatedly.
+*/
+static constexpr int MOMENT_COUNT = 10;
+
+// grid node coordinates, the same nodes calculateDelta always used
+static std::vector<int> gridCoordinates(int length, int grid_size)
 {
-	const int N = static_cast<int>(src_points.size());
-
-	float ratio;
-	if(prescale)
+	std::vector<int> coordinates;
+	for(int i = 0; ; i += grid_size)
 	{
-		// TODO use cv::contourArea(), the area is computed using the Green formula.
-		float src_area = calculateArea(src_points);
-		float dst_area = calculateArea(dst_points);
-		ratio = std::sqrt(dst_area / src_area);
+		if(i >= length && i < length + grid_size - 1)
+			i = length - 1;
+		else if(i >= length)
+			break;
 
-		for(int i = 0; i < N; ++i)
-			dst_points[i] /= ratio;
+		coordinates.push_back(i);
 	}
+	return coordinates;
+}
 
-	std::vector<float> w(N);
+static inline float weight(float d2, float alpha)
+{
+	return alpha == 1.0F ? 1.0F / d2 : std::pow(d2, -alpha);
+}
 
-	rDx.create(dst_size);
-	rDy.create(dst_size);
+// add (sign = 1) or remove (sign = -1) the terms of one control point
+static inline void accumulate(double* m, const Point2f& p, const Point2f& q, float alpha, double sign)
+{
+	const double w = sign * weight(p.x * p.x + p.y * p.y, alpha);
+	m[0] += w;
+	m[1] += w * p.x;
+	m[2] += w * p.y;
+	m[3] += w * q.x;
+	m[4] += w * q.y;
+	m[5] += w * (p.x * p.x + p.y * p.y);
+	m[6] += w * q.x * p.x;
+	m[7] += w * q.x * p.y;
+	m[8] += w * q.y * p.x;
+	m[9] += w * q.y * p.y;
+}
 
-	if(N < 2)
+ImageWarp_MLS::ImageWarp_MLS(Transform transform):
+	transform(transform),
+	prescale(false),
+	alpha(1.0F)
+{
+}
+
+void ImageWarp_MLS::calculateDelta(float alpha)
+{
+	// similarity transform has always used 1/d^2 as weight
+	this->alpha = transform == Transform::SIMILARITY ? 1.0F : alpha;
+
+	grid_x = gridCoordinates(dst_size.width, grid_size);
+	grid_y = gridCoordinates(dst_size.height, grid_size);
+
+	const int N = static_cast<int>(src_points.size());
+	const int nx = static_cast<int>(grid_x.size()), ny = static_cast<int>(grid_y.size());
+	moments.assign(static_cast<size_t>(nx) * ny * MOMENT_COUNT, 0.0);
+	pinned.assign(static_cast<size_t>(nx) * ny, -1);
+
+	// structure of arrays, so the inner loop over control points can be vectorized
+	std::vector<float> px(N), py(N), qx(N), qy(N);
+	for(int k = 0; k < N; ++k)
 	{
-		rDx.setTo(0);
-		rDy.setTo(0);
-		return;
+		px[k] = src_points[k].x, py[k] = src_points[k].y;
+		qx[k] = dst_points[k].x, qy[k] = dst_points[k].y;
 	}
 
-	for(int i = 0; ; i += grid_size)
+	#pragma omp parallel for
+	for(int r = 0; r < ny; ++r)
+	for(int c = 0; c < nx; ++c)
 	{
-		if(i >= dst_size.width && i < dst_size.width + grid_size - 1)
-			i = dst_size.width - 1;
-		else if(i >= dst_size.width)
-			break;
+		const float x = static_cast<float>(grid_x[c]), y = static_cast<float>(grid_y[r]);
+		const int node = r * nx + c;
 
-		for(int j = 0; ; j += grid_size)
+		double m[MOMENT_COUNT] = { 0 };
+		int on_node = 0;
+		for(int k = 0; k < N; ++k)
 		{
-			if (j >= dst_size.height && j < dst_size.height + grid_size - 1)
-				j = dst_size.height - 1;
-			else if (j >= dst_size.height)
-				break;
-
-			float sw = 0;
-			Point2f swp(0, 0), swq(0, 0), newP(0, 0), curV(i, j);
+			const float dpx = px[k] - x, dpy = py[k] - y;
+			const float dqx = qx[k] - x, dqy = qy[k] - y;
+			const float d2 = dpx * dpx + dpy * dpy;
+			on_node += d2 == 0;
+			const double w = d2 > 0 ? weight(d2, this->alpha) : 0.0;
+			m[0] += w;
+			m[1] += w * dpx;
+			m[2] += w * dpy;
+			m[3] += w * dqx;
+			m[4] += w * dqy;
+			m[5] += w * d2;
+			m[6] += w * dqx * dpx;
+			m[7] += w * dqx * dpy;
+			m[8] += w * dqy * dpx;
+			m[9] += w * dqy * dpy;
+		}
 
-			int k;
-			for(k = 0; k < N; ++k)
-			{
-				if((i == src_points[k].x) && j == src_points[k].y)
+		if(on_node > 0)
+			for(int k = 0; k < N; ++k)
+				if(px[k] == x && py[k] == y)
+				{
+					pinned[node] = k;
 					break;
+				}
 
-//				float denorm = distance(Point2f(i, j), src_points[k]);
-				float denorm = ((i - src_points[k].x)*(i - src_points[k].x) +
-								(j - src_points[k].y)*(j - src_points[k].y));
-				if(alpha == 1.0F)
-					w[k] = 1.0F / denorm;
-				else
-					w[k] = std::pow(denorm, -alpha);
-
-				sw  = sw  + w[k];
-				swp = swp + w[k] * src_points[k];
-				swq = swq + w[k] * dst_points[k];
-			}
+		std::copy(m, m + MOMENT_COUNT, &moments[node * MOMENT_COUNT]);
+	}
 
-			if(k == N)
-			{
-				Point2f pstar = swp / sw;
-				Point2f qstar = swq / sw;
+	evaluate();
+}
 
-				// Calc miu_r
-				// miu_s = 0;
-				float s1 = 0, s2 = 0;
-				for(k = 0; k < N; ++k)
-				{
-					if (i == src_points[k].x && j == src_points[k].y)
-						continue;
-
-					Point2f Pi = src_points[k] - pstar;
-					Point2f PiJ;
-					PiJ.x = -Pi.y, PiJ.y = Pi.x;
-					Point2f Qi = dst_points[k] - qstar;
-					s1 += w[k] * Qi.dot(Pi);
-					s2 += w[k] * Qi.dot(PiJ);
-				}
+void ImageWarp_MLS::updateMappingPoints(const std::vector<int>& indices,
+		const std::vector<cv::Point2f>& dst_points, const std::vector<cv::Point2f>& src_points)
+{
+	assert(indices.size() == dst_points.size() && indices.size() == src_points.size());
+	if(moments.empty())  // calculateDelta() isn't called yet
+	{
+		for(size_t i = 0; i < indices.size(); ++i)
+		{
+			this->src_points[indices[i]] = dst_points[i];
+			this->dst_points[indices[i]] = src_points[i];
+		}
+		invalidateField();
+		return;
+	}
 
-				float miu_r = std::sqrt(s1*s1 + s2*s2);
-				curV -= pstar;
-				Point2f curVJ;
-				curVJ.x = -curV.y, curVJ.y = curV.x;
+	const int nx = static_cast<int>(grid_x.size()), ny = static_cast<int>(grid_y.size());
+	const int M = static_cast<int>(indices.size());
 
-				for(k = 0; k < N; ++k)
-				{
-					if(i==src_points[k].x && j==src_points[k].y)
-						continue;
-
-					Point2f Pi = src_points[k] - pstar;
-					Point2f PiJ;
-					PiJ.x = -Pi.y, PiJ.y = Pi.x;
-
-					Point2f tmpP;
-					tmpP.x = Pi.dot(curV) * dst_points[k].x - PiJ.dot(curV) * dst_points[k].y;
-					tmpP.y = -Pi.dot(curVJ) * dst_points[k].x + PiJ.dot(curVJ) * dst_points[k].y;
-					tmpP *= w[k]/miu_r;
-					newP += tmpP;
-				}
-				newP += qstar;
-			}
-			else
-			{
-				newP = dst_points[k];
-			}
+	#pragma omp parallel for
+	for(int r = 0; r < ny; ++r)
+	for(int c = 0; c < nx; ++c)
+	{
+		const Point2f v(static_cast<float>(grid_x[c]), static_cast<float>(grid_y[r]));
+		const int node = r * nx + c;
+		double* m = &moments[node * MOMENT_COUNT];
 
-			if(prescale)
+		for(int i = 0; i < M; ++i)
+		{
+			const int k = indices[i];
+
+			// note the swap, as setMappingPoints does
+			const Point2f old_p = this->src_points[k] - v, old_q = this->dst_points[k] - v;
+			const Point2f new_p = dst_points[i] - v, new_q = src_points[i] - v;
+
+			if(old_p.x == 0 && old_p.y == 0)
 			{
-				rDx(j, i) = newP.x * ratio - i;
-				rDy(j, i) = newP.y * ratio - j;
+				if(pinned[node] == k)
+					pinned[node] = -1;
 			}
 			else
-			{
-				rDx(j, i) = newP.x - i;
-				rDy(j, i) = newP.y - j;
-			}
+				accumulate(m, old_p, old_q, alpha, -1.0);
+
+			if(new_p.x == 0 && new_p.y == 0)
+				pinned[node] = k;
+			else
+				accumulate(m, new_p, new_q, alpha, +1.0);
 		}
 	}
-	
-	if(prescale)
+
+	for(int i = 0; i < M; ++i)
 	{
-		for(int i = 0; i < N; ++i)
-			dst_points[i] *= ratio;
+		this->src_points[indices[i]] = dst_points[i];
+		this->dst_points[indices[i]] = src_points[i];
 	}
+
+	evaluate();
 }
 
-void ImageWarp_Similarity::calculateDelta(float alpha)
+void ImageWarp_MLS::evaluate()
 {
-	const int N = static_cast<int>(src_points.size());
-	std::vector<float> w(N);
+	invalidateField();
 
 	rDx.create(dst_size);
 	rDy.create(dst_size);
 
-	if (N < 2)
+	const int N = static_cast<int>(src_points.size());
+	const int nx = static_cast<int>(grid_x.size()), ny = static_cast<int>(grid_y.size());
+	if(N < 2)
 	{
 		rDx.setTo(0);
 		rDy.setTo(0);
 		return;
 	}
 
-	for(int i = 0; ; i += grid_size)
+	// Pre-scaling q by 1/ratio leaves T/mu of rigid transform unchanged and scales q* by 1/ratio,
+	// so scaling the result back by ratio is the same as multiplying T/mu by ratio.
+	double ratio = 1.0;
+	if(transform == Transform::RIGID && prescale)
 	{
-		if(i >= dst_size.width && i < dst_size.width + grid_size - 1)
-			i = dst_size.width - 1;
-		else if(i >= dst_size.width)
-			break;
-
-		for(int j = 0; ; j += grid_size)
-		{
-			if(j >= dst_size.height && j < dst_size.height + grid_size - 1)
-				j = dst_size.height - 1;
-			else if(j >= dst_size.height)
-				break;
+		// TODO use cv::contourArea(), the area is computed using the Green formula.
+		float src_area = calculateArea(src_points);
+		float dst_area = calculateArea(dst_points);
+		ratio = std::sqrt(dst_area / src_area);
+	}
 
-			float sw = 0;
-			Point2f swp(0, 0), swq(0, 0), newP(0, 0), curV(i, j);
+	#pragma omp parallel for
+	for(int r = 0; r < ny; ++r)
+	for(int c = 0; c < nx; ++c)
+	{
+		const int x = grid_x[c], y = grid_y[r];
+		const int node = r * nx + c;
 
-			int k;
-			for(k = 0; k < N; ++k)
+		Point2f delta;
+		if(pinned[node] >= 0)
+			delta = dst_points[pinned[node]] - Point2f(static_cast<float>(x), static_cast<float>(y));
+		else
+		{
+			const double* m = &moments[node * MOMENT_COUNT];
+			const double sw = m[0];
+			const double psx = m[1] / sw, psy = m[2] / sw;  // p*
+			const double qsx = m[3] / sw, qsy = m[4] / sw;  // q*
+
+			// sum(w*(q - q*)*(p - p*)^T)
+			const double cxx = m[6] - sw * qsx * psx, cxy = m[7] - sw * qsx * psy;
+			const double cyx = m[8] - sw * qsy * psx, cyy = m[9] - sw * qsy * psy;
+
+			const double vx = -psx, vy = -psy;  // v - p*, v is the origin here
+			const double vjx = -vy, vjy = vx;   // perpendicular of v - p*
+			double tx = cxx * vx + cxy * vy + cyx * vjx + cyy * vjy;
+			double ty = -(cxx * vjx + cxy * vjy) + cyx * vx + cyy * vy;
+
+			double miu;
+			if(transform == Transform::RIGID)
 			{
-				if(i == src_points[k].x && j==src_points[k].y)
-					break;
-
-				float denorm = (i - src_points[k].x)*(i - src_points[k].x)+
-				               (j - src_points[k].y)*(j - src_points[k].y);
-				// w[k] = std::pow(denorm, -alpha);
-				w[k] = 1 / denorm;
-				sw  = sw  + w[k];
-				swp = swp + w[k] * src_points[k];
-				swq = swq + w[k] * dst_points[k];
+				const double s1 = cxx + cyy, s2 = cyx - cxy;
+				miu = std::sqrt(s1 * s1 + s2 * s2) / ratio;
 			}
+			else
+				miu = m[5] - sw * (psx * psx + psy * psy);
 
-			if(k == N)
-			{
-				Point2f pstar = swp / sw;
-				Point2f qstar = swq / sw;
-
-				// Calc miu_s
-				float miu_s = 0;
-				for(k = 0; k < N; ++k)
-				{
-					if(i == src_points[k].x && j == src_points[k].y)
-						continue;
+			delta.x = static_cast<float>(tx / miu + qsx);
+			delta.y = static_cast<float>(ty / miu + qsy);
+		}
 
-					Point2f Pi = src_points[k] - pstar;
-					miu_s += w[k] * Pi.dot(Pi);
-				}
+		rDx(y, x) = delta.x;
+		rDy(y, x) = delta.y;
+	}
+}
 
-				curV -= pstar;
-				Point2f curVJ;
-				curVJ.x = -curV.y;
-				curVJ.y = curV.x;
+ImageWarp_Rigid::ImageWarp_Rigid():
+	ImageWarp_MLS(Transform::RIGID)
+{
+}
 
-				for(k = 0; k < N; ++k)
-				{
-					if(i == src_points[k].x && j == src_points[k].y)
-						continue;
-
-					Point2f Pi = src_points[k] - pstar;
-					Point2f PiJ, tmpP;
-					PiJ.x = -Pi.y;
-					PiJ.y = Pi.x;
-
-					tmpP.x = Pi.dot(curV) * dst_points[k].x - PiJ.dot(curV) * dst_points[k].y;
-					tmpP.y = -Pi.dot(curVJ) * dst_points[k].x + PiJ.dot(curVJ) * dst_points[k].y;
-					tmpP *= w[k]/miu_s;
-					newP += tmpP;
-				}
-				newP += qstar;
-			}
-			else
-			{
-				newP = dst_points[k];
-			}
+void ImageWarp_Rigid::set(bool prescale)
+{
+	this->prescale = prescale;
+}
 
-			rDx(j, i) = newP.x - i;
-			rDy(j, i) = newP.y - j;
-		}
-	}
+ImageWarp_Similarity::ImageWarp_Similarity():
+	ImageWarp_MLS(Transform::SIMILARITY)
+{
 }
-#if 0
+
 ImageWarp_PiecewiseAffine::ImageWarp_PiecewiseAffine():
-	fill_mood(BackgroundFillMode::NONE)
+	ImageWarp_MLS(Transform::SIMILARITY),
+	fill_mode(BackgroundFillMode::NONE)
 {
 }
 
-ImageWarp_PiecewiseAffine::~ImageWarp_PiecewiseAffine()
+void ImageWarp_PiecewiseAffine::calculateDelta(float alpha)
 {
+	invalidateField();  // the triangles are mapped in updateField(), since they're cheap
+
+	if(fill_mode == BackgroundFillMode::MLS)
+		ImageWarp_MLS::calculateDelta(alpha);
 }
 
-cv::Point2f ImageWarp_PiecewiseAffine::getMLSDelta(int x, int y)
+static std::vector<cv::Vec3i> delaunay(const std::vector<cv::Point2f>& points)
 {
-	const int N = static_cast<int>(src_points.size());
+	Vec4f box = venus::boundingBox(points);
+	Rect rect(cvFloor(box[0]) - 1, cvFloor(box[1]) - 1, cvCeil(box[2] - box[0]) + 3, cvCeil(box[3] - box[1]) + 3);
 
-	std::vector<float> w;
-	w.resize(N);
+	Subdiv2D subdiv(rect);
+	subdiv.insert(points);
 
-	static Point2f  curV;
-	float miu_s;
+	// Subdiv2D reports triangles by coordinates, map them back to indices. Duplicated points share one vertex.
+	std::map<std::pair<float, float>, int> indices;
+	for(size_t i = 0; i < points.size(); ++i)
+		indices.emplace(std::make_pair(points[i].x, points[i].y), static_cast<int>(i));
 
-	int i = x;
-	int j = y;
-	int k;
+	std::vector<Vec6f> list;
+	subdiv.getTriangleList(list);
 
-	float sw = 0;
-	Point2f swp(0, 0), swq(0, 0), newP(0, 0), curV(i, j);
-	for(k = 0; k < N; k++)
+	std::vector<Vec3i> triangles;
+	triangles.reserve(list.size());
+	for(const Vec6f& t: list)
 	{
-		if ((i==src_points[k].x) && j==src_points[k].y)
-			break;
-
-		float denorm = (i - src_points[k].x)*(i - src_points[k].x)+
-		               (j - src_points[k].y)*(j - src_points[k].y);
-		// w[k] = std::pow(denorm, -alpha);
-		w[k] = 1 / denorm;
+		Vec3i triangle;
+		int k = 0;
+		for(; k < 3; ++k)
+		{
+			auto it = indices.find(std::make_pair(t[2*k], t[2*k + 1]));
+			if(it == indices.end())
+				break;  // one of the virtual vertices of Subdiv2D
+			triangle[k] = it->second;
+		}
 
-		sw  = sw  + w[k];
-		swp += w[k] * src_points[k];
-		swq += w[k] * dst_points[k];
+		if(k == 3)
+			triangles.push_back(triangle);
 	}
 
-	if(k == N)
-	{
-		Point2f pstar = swp / sw;
-		Point2f qstar = swq / sw;
+	return triangles;
+}
 
-		// Calc miu_s
-		miu_s = 0;
-		for(k = 0; k < N; k++)
-		{
-			if (i==src_points[k].x && j==src_points[k].y)
-				continue;
+/*
+	Fill the pixels covered by the triangles with their affine deltas. Later triangles overwrite
+	earlier ones on shared pixels, the values agree on shared edges anyway. Rows are split into
+	tiles and each tile only visits the triangles overlapping it, so tiles can run in parallel.
+*/
+static void rasterize(cv::Mat_<float>& field_dx, cv::Mat_<float>& field_dy,
+		const std::vector<cv::Point2f>& vertices, const std::vector<cv::Point2f>& targets,
+		const std::vector<cv::Vec3i>& triangles)
+{
+	struct Item
+	{
+		Matx23f delta;   ///< affine transform of the delta, namely target(v) - v
+		Vec3f   a, b, c; ///< edge functions a*x + b*y + c, non-negative inside the triangle
+		int     top, bottom;
+	};
+
+	const int rows = field_dx.rows, cols = field_dx.cols;
+	std::vector<Item> items;
+	items.reserve(triangles.size());
+	for(const Vec3i& t: triangles)
+	{
+		const Point2f v[3] = { vertices[t[0]], vertices[t[1]], vertices[t[2]] };
+		const Point2f q[3] = { targets [t[0]], targets [t[1]], targets [t[2]] };
 
-			Point2f Pi = src_points[k] - pstar;
-			miu_s += w[k] * Pi.dot(Pi);
-		}
+		const float area = (v[1] - v[0]).cross(v[2] - v[0]);
+		if(std::abs(area) < 1E-6F)
+			continue;  // degenerated triangle
 
-		curV -= pstar;
-		Point2f curVJ;
-		curVJ.x = -curV.y, curVJ.y = curV.x;
+		Item item;
+		Matx23d affine = cv::getAffineTransform(v, q);
+		item.delta = Matx23f(
+			static_cast<float>(affine(0, 0) - 1), static_cast<float>(affine(0, 1)), static_cast<float>(affine(0, 2)),
+			static_cast<float>(affine(1, 0)), static_cast<float>(affine(1, 1) - 1), static_cast<float>(affine(1, 2)));
 
-		for (k = 0; k < N; k++)
+		const float sign = area > 0 ? 1.0F : -1.0F;
+		for(int k = 0; k < 3; ++k)
 		{
-			if(i == src_points[k].x && j == src_points[k].y)
-				continue;
-
-			Point2f Pi = src_points[k] - pstar;
-			Point2f PiJ, tmpP;
-			PiJ.x = -Pi.y, PiJ.y = Pi.x;
-
-			tmpP.x = Pi.dot(curV) * dst_points[k].x
-					 - PiJ.dot(curV) * dst_points[k].y;
-			tmpP.y = -Pi.dot(curVJ) * dst_points[k].x
-					 + PiJ.dot(curVJ) * dst_points[k].y;
-			tmpP *= w[k] / miu_s;
-			newP += tmpP;
+			const Point2f& p0 = v[k];
+			const Point2f& p1 = v[(k + 1) % 3];
+			// (p1 - p0) x (p - p0)
+			item.a[k] = -sign * (p1.y - p0.y);
+			item.b[k] =  sign * (p1.x - p0.x);
+			item.c[k] = -sign * ((p1.x - p0.x) * p0.y - (p1.y - p0.y) * p0.x);
 		}
-		newP += qstar;
+
+		item.top    = std::max(cvCeil (std::min({ v[0].y, v[1].y, v[2].y })), 0);
+		item.bottom = std::min(cvFloor(std::max({ v[0].y, v[1].y, v[2].y })), rows - 1);
+		if(item.top <= item.bottom)
+			items.push_back(item);
 	}
-	else
+
+	constexpr int TILE = 32;
+	const int tile_count = (rows + TILE - 1) / TILE;
+	std::vector<std::vector<int>> buckets(tile_count);
+	for(int i = 0; i < static_cast<int>(items.size()); ++i)
+		for(int tile = items[i].top / TILE; tile <= items[i].bottom / TILE; ++tile)
+			buckets[tile].push_back(i);
+
+	#pragma omp parallel for schedule(dynamic)
+	for(int tile = 0; tile < tile_count; ++tile)
+	for(int i: buckets[tile])
 	{
-		newP = dst_points[k];
+		const Item& item = items[i];
+		const int top = std::max(item.top, tile * TILE);
+		const int bottom = std::min(item.bottom, tile * TILE + TILE - 1);
+		for(int y = top; y <= bottom; ++y)
+		{
+			// intersect the half planes a*x + (b*y + c) >= 0 on this row
+			float left = 0, right = static_cast<float>(cols - 1);
+			for(int k = 0; k < 3; ++k)
+			{
+				const float a = item.a[k], rest = item.b[k] * y + item.c[k];
+				if(a > 0)
+					left = std::max(left, -rest / a);
+				else if(a < 0)
+					right = std::min(right, -rest / a);
+				else if(rest < 0)
+					right = -1;  // whole row is outside
+			}
+
+			constexpr float EPSILON = 1E-4F;
+			const int x0 = cvCeil(left - EPSILON), x1 = cvFloor(right + EPSILON);
+			float* dx = field_dx[y];
+			float* dy = field_dy[y];
+			const Matx23f& d = item.delta;
+			const float cx = d(0, 1) * y + d(0, 2), cy = d(1, 1) * y + d(1, 2);
+			for(int x = x0; x <= x1; ++x)
+			{
+				dx[x] = d(0, 0) * x + cx;
+				dy[x] = d(1, 0) * x + cy;
+			}
+		}
 	}
-	
-	newP.x -= i;
-	newP.y -= j;
-	return newP;
 }
 
-struct Triangle
-{
-	Point_< int > v[3];
-};
-
-void ImageWarp_PiecewiseAffine::calculateDelta(float alpha)
+void ImageWarp_PiecewiseAffine::updateField()
 {
+	const int rows = dst_size.height, cols = dst_size.width;
 	const int N = static_cast<int>(src_points.size());
 
-	Mat_<int> imgLabel = Mat_<int>::zeros(dst_size.height, dst_size.width);
-
-	rDx = Mat_<float>::zeros(dst_size);
-	rDy = Mat_<float>::zeros(dst_size);
-	for(int i = 0; i < N; ++i)
+	switch(fill_mode)
 	{
-		Point2f& point = src_points[i];
-		//! Ignore points outside the target image
-		point.x = clamp<float>(point.x, 0, dst_size.width - 1);
-		point.y = clamp<float>(point.y, 0, dst_size.height - 1);
-		
-		rDx(point) = dst_points[i].x - point.x;
-		rDy(point) = dst_points[i].y - point.y;
-	}
+	case BackgroundFillMode::MLS:
+		ImageWarp::updateField();  // interpolate the MLS grid of calculateDelta()
+		break;
+
+	case BackgroundFillMode::NONE:
+		field_dx.create(rows, cols);
+		field_dy.create(rows, cols);
+		#pragma omp parallel for
+		for(int r = 0; r < rows; ++r)
+		for(int c = 0; c < cols; ++c)
+		{
+			field_dx(r, c) = static_cast<float>(-c);  // all map to the origin
+			field_dy(r, c) = static_cast<float>(-r);
+		}
+		break;
 
-	rDx(0, 0) = rDy(0, 0) = 0;
-	rDx(dst_size.height - 1, 0) = rDy(0, dst_size.width-1) = 0;
-	rDy(dst_size.height - 1, 0) = rDy(dst_size.height-1, dst_size.width-1) = src_size.height - dst_size.height;
-	rDx(0, dst_size.width - 1)  = rDx(dst_size.height-1, dst_size.width-1) = src_size.width - dst_size.width;
-	
-	std::vector<Triangle>::iterator it;
-	cv::Rect2i boundRect(0, 0, dst_size.width, dst_size.height);
-	std::vector<Triangle> oL1 = src_points;
-	if(fill_mood == BackgroundFillMode::PIECEWISE)
+	case BackgroundFillMode::PIECEWISE:
 	{
-		oL1.push_back(Point2f(0,0));
-		oL1.push_back(Point2f(0,dst_size.height-1));
-		oL1.push_back(Point2f(dst_size.width-1, 0));
-		oL1.push_back(Point2f(dst_size.width-1,dst_size.height-1));
+		field_dx.create(rows, cols);
+		field_dy.create(rows, cols);
+
+		// the image corners map onto each other, together they cover the whole image
+		std::vector<Point2f> vertices = src_points, targets = dst_points;
+		const float dst_right = static_cast<float>(cols - 1), dst_bottom = static_cast<float>(rows - 1);
+		const float src_right = static_cast<float>(src_size.width - 1), src_bottom = static_cast<float>(src_size.height - 1);
+		vertices.insert(vertices.end(), { Point2f(0, 0), Point2f(dst_right, 0), Point2f(0, dst_bottom), Point2f(dst_right, dst_bottom) });
+		targets .insert(targets .end(), { Point2f(0, 0), Point2f(src_right, 0), Point2f(0, src_bottom), Point2f(src_right, src_bottom) });
+		rasterize(field_dx, field_dy, vertices, targets, delaunay(vertices));
+		break;
 	}
-	// In order preserv the background
-	std::vector<Point2i> V = delaunayDiv(oL1, boundRect);
-	
-	Mat_<uint8_t> imgTmp = Mat_<uint8_t>::zeros(dst_size.height, dst_size.width);
-	for(it = V.begin(); it != V.end(); ++it)
-	{
-		cv::line(imgTmp, it->v[0], it->v[1], 255, 1, CV_AA);
-		cv::line(imgTmp, it->v[0], it->v[2], 255, 1, CV_AA);
-		cv::line(imgTmp, it->v[2], it->v[1], 255, 1, CV_AA);
-		
-		// Not interested in points outside the region.
-		if(!(it->v[0].inside(boundRect) && it->v[1].inside(boundRect) && it->v[2].inside(boundRect)))
-			continue;
-		
-		cv::fillConvexPoly(imgLabel, it->v, 3, cv::Scalar_<int>(it-V.begin()+1));
+
+	default:
+		assert(false);
+		break;
 	}
 
-	for(int i = 0; ; i += grid_size)
+	if(N >= 3)
 	{
-		if(i >= dst_size.width && i < dst_size.width + grid_size - 1)
-			i = dst_size.width - 1;
-		else if(i >= dst_size.width)
-			break;
-
-		for(int j = 0; ; j += grid_size)
+		const std::vector<Vec3i>* mesh = &triangles;
+		std::vector<Vec3i> default_mesh;
+		if(triangles.empty())
 		{
-			if(j >= dst_size.height && j < dst_size.height + grid_size - 1)
-				j = dst_size.height - 1;
-			else if(j >= dst_size.height)
-				break;
-
-			int id = imgLabel(j, i) - 1;
-			if(id < 0)
-			{
-				if (fill_mood == BackgroundFillMode::MLS)
-				{
-					Point_<float> dV = getMLSDelta(i, j);
-					rDx(j, i) = dV.x;
-					rDy(j, i) = dV.y;
-				}
-				else
-				{
-					rDx(j, i) = -i;
-					rDy(j, i) = -j;
-				}
-				continue;
-			}
-			Point2i v1 = V[id].v[1] - V[id].v[0];
-			Point2i v2 = V[id].v[2] - V[id].v[0];
-			Point2i curV(i, j);
-			curV -= V[id].v[0];
-
-			float d2 = float(v1.x * curV.y - curV.x * v1.y)/(v1.x*v2.y-v2.x*v1.y);
-			float d1 = float(v2.x * curV.y - curV.x * v2.y)/(v2.x*v1.y-v1.x*v2.y);
-			float d0 = 1-d1-d2;
-			rDx(j, i) = d0*rDx(V[id].v[0]) + d1*rDx(V[id].v[1]) + d2*rDx(V[id].v[2]);
-			rDy(j, i) = d0*rDy(V[id].v[0]) + d1*rDy(V[id].v[1]) + d2*rDy(V[id].v[2]);
+			if(static_cast<size_t>(N) == Feature::COUNT)
+				default_mesh.assign(Feature::triangle_indices.begin(), Feature::triangle_indices.end());
+			else
+				default_mesh = delaunay(src_points);
+			mesh = &default_mesh;
 		}
+		rasterize(field_dx, field_dy, src_points, dst_points, *mesh);
 	}
+
+	field_dirty = false;
 }
-#endif
+
 } /* namespace venus */
\ No newline at end of file
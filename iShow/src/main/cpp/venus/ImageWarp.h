@@ -14,8 +14,18 @@ namespace venus {
 class ImageWarp
 {
 private:
+	cv::Mat_<float> map_x, map_y;        ///< remap coordinates, kept to avoid reallocation per frame
 
 protected:
+	cv::Mat_<float> field_dx, field_dy;  ///< rDx, rDy interpolated to every target pixel, built on demand
+	bool field_dirty;
+
+	/**
+	 * Build field_dx and field_dy of dst_size, and clear field_dirty.
+	 * By default it bilinearly interpolates the grid nodes of rDx and rDy.
+	 */
+	virtual void updateField();
+
     int grid_size; ///< Parameter for MLS.
 
     std::vector<cv::Point2f> src_points;
@@ -26,6 +36,11 @@ protected:
 	cv::Size2i src_size;
 	cv::Size2i dst_size;
 
+	/**
+	 * Subclasses call this whenever rDx or rDy change, so that genNewImage rebuilds its dense field.
+	 */
+	void invalidateField() { field_dirty = true; }
+
 public:
 	ImageWarp();
     ImageWarp(int grid_size);
@@ -50,6 +65,10 @@ public:
 	 * Generate the warped image.
 	 * This function generate a warped image using PRE-CALCULATED data.
 	 * DO NOT CALL THIS AT FIRST! Call this after at least one call of setAllAndGenerate.
+	 *
+	 * The grid deltas are interpolated into a dense per-pixel field on the first call after calculateDelta,
+	 * later calls with another @p transRatio only scale that field and resample, so it's cheap to call it
+	 * per frame while animating.
 	 */
     cv::Mat genNewImage(const cv::Mat& src, float transRatio);
 
@@ -74,32 +93,78 @@ public:
 	void setTargetSize(const cv::Size2i& size) { dst_size = size; }
 };
 
+/**
+ * The base class of the MLS warps.
+ *
+ * Every grid node keeps the weighted moments of all the control points around it (weights, first and second
+ * order sums). The MLS solution of a node only needs those sums, and each control point contributes its own
+ * independent terms, so moving some points just replaces their terms, see updateMappingPoints().
+ */
+class ImageWarp_MLS : public ImageWarp
+{
+protected:
+	enum class Transform
+	{
+		SIMILARITY,
+		RIGID,
+	};
+
+	const Transform transform;
+	bool  prescale;  ///< Whether unify scaling the points before deformation, rigid transform only.
+	float alpha;
+
+private:
+	std::vector<int>    grid_x, grid_y;  ///< node coordinates, the last ones are clamped to the image border
+	std::vector<double> moments;         ///< MOMENT_COUNT sums per node, in node-relative coordinates
+	std::vector<int>    pinned;          ///< per node, index of the control point lying on it, or -1
+
+	void evaluate();
+
+protected:
+	explicit ImageWarp_MLS(Transform transform);
+
+public:
+	virtual void calculateDelta(float alpha) override;
+
+	/**
+	 * Move some of the points after calculateDelta(), then only their terms are recomputed,
+	 * which costs O(grid nodes * indices.size()) instead of O(grid nodes * all points).
+	 *
+	 * @param[in] indices    Indices of the points to be moved.
+	 * @param[in] dst_points New target points, dst_points[i] is for indices[i].
+	 * @param[in] src_points New source points, src_points[i] is for indices[i].
+	 * @see setMappingPoints
+	 */
+	void updateMappingPoints(const std::vector<int>& indices,
+			const std::vector<cv::Point2f>& dst_points, const std::vector<cv::Point2f>& src_points);
+};
+
 /**
  * The class for MLS Rigid transform.
  * It will try to keep the image rigid. You can set preScale if you
  * can accept uniform transform.
  */
-class ImageWarp_Rigid : public ImageWarp
+class ImageWarp_Rigid : public ImageWarp_MLS
 {
-private:
-	bool prescale;  ///< Whether unify scaling the points before deformation
-
-public:    
-    ImageWarp_Rigid();
-    virtual void calculateDelta(float alpha) override;
+public:
+	ImageWarp_Rigid();
 
 	void set(bool prescale);
 };
 
 
 //! The class for MLS Similarity transform.
-class ImageWarp_Similarity: public ImageWarp
+class ImageWarp_Similarity: public ImageWarp_MLS
 {
 public:
-	virtual void calculateDelta(float alpha) override;
+	ImageWarp_Similarity();
 };
-#if 0
-class ImageWarp_PiecewiseAffine: public ImageWarp
+/**
+ * Piecewise affine warp over a triangle mesh of the points, each triangle is mapped with its own affine transform.
+ * By default the mesh is Feature::triangle_indices when there are Feature::COUNT points, otherwise the Delaunay
+ * triangulation of the points. It's much cheaper than MLS, since every pixel is rasterized exactly once.
+ */
+class ImageWarp_PiecewiseAffine: public ImageWarp_MLS
 {
 public:
 	/**
@@ -113,18 +178,20 @@ public:
 	};
 
 private:
-	BackgroundFillMode fill_mood;
-
-	cv::Point2f getMLSDelta(int x, int y);
+	BackgroundFillMode fill_mode;
+	std::vector<cv::Vec3i> triangles;  ///< empty to use the default mesh
 
+protected:
+	virtual void updateField() override;
 
 public:
 	ImageWarp_PiecewiseAffine();
-	~ImageWarp_PiecewiseAffine();
+
+	void setBackgroundFillMode(BackgroundFillMode mode) { fill_mode = mode; invalidateField(); }
+	void setTriangles(const std::vector<cv::Vec3i>& triangles) { this->triangles = triangles; invalidateField(); }
 
 	virtual void calculateDelta(float alpha) override;
 };
-#endif
 
 } /* namespace venus */
 #endif /* VENUS_IMAGE_WARP_H_ */
@@ -0,0 +1,150 @@
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+
+#include "venus/Feature.h"
+#include "venus/LandmarkFilter.h"
+
+using namespace cv;
+
+namespace venus {
+
+// Feature point indices of each part, see the figures in Feature::calculate*Polygon().
+static const std::vector<int> part_indices[static_cast<int>(LandmarkFilter::Part::COUNT)] =
+{
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19 },
+	{ 20, 21, 22, 23, 24, 25 },
+	{ 26, 27, 28, 29, 30, 31 },
+	{ 33, 34, 35, 36, 37, 38, 39, 40, 41, 42 },
+	{ 32, 43, 44, 45, 46, 47, 48, 49, 50, 51 },
+	{ 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62 },
+	{ 63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80 },
+};
+
+// pupils, their distance normalizes speed so that parameters don't depend on face size
+static constexpr int RIGHT_PUPIL = 42, LEFT_PUPIL = 43;
+
+// used when timestamps don't increase
+static constexpr float DEFAULT_INTERVAL = 1.0F / 30;
+
+LandmarkFilter::LandmarkFilter(float min_cutoff/* = 1.0F */, float beta/* = 4.0F */, float threshold/* = 1.0F */):
+	min_cutoff(min_cutoff),
+	beta(beta),
+	derivative_cutoff(1.0F),
+	prediction_speed(0.3F),
+	threshold(threshold),
+	timestamp(0)
+{
+	reset();
+}
+
+void LandmarkFilter::setMinCutoff(float min_cutoff)
+{
+	assert(min_cutoff > 0);
+	this->min_cutoff = min_cutoff;
+}
+
+void LandmarkFilter::setBeta(float beta)
+{
+	assert(beta >= 0);
+	this->beta = beta;
+}
+
+void LandmarkFilter::setDerivativeCutoff(float derivative_cutoff)
+{
+	assert(derivative_cutoff > 0);
+	this->derivative_cutoff = derivative_cutoff;
+}
+
+void LandmarkFilter::setPredictionSpeed(float speed)
+{
+	assert(speed >= 0);
+	prediction_speed = speed;
+}
+
+void LandmarkFilter::setThreshold(float threshold)
+{
+	assert(threshold >= 0);
+	this->threshold = threshold;
+}
+
+void LandmarkFilter::reset()
+{
+	previous.clear();
+	smoothed.clear();
+	output.clear();
+	std::fill(velocity, velocity + static_cast<int>(Part::COUNT), Point2f(0, 0));
+	std::fill(moved, moved + static_cast<int>(Part::COUNT), true);
+}
+
+/*
+	Smoothing factor of the exponential filter y += alpha * (x - y) sampled at the given interval, whose
+	time constant is tau = 1 / (2 * pi * cutoff).
+*/
+float LandmarkFilter::alpha(float cutoff, float interval)
+{
+	const float tau = 1.0F / (2 * static_cast<float>(CV_PI) * cutoff);
+	return 1.0F / (1.0F + tau / interval);
+}
+
+const std::vector<cv::Point2f>& LandmarkFilter::filter(const std::vector<cv::Point2f>& points, double timestamp)
+{
+	assert(points.size() == Feature::COUNT);
+
+	if(smoothed.empty())  // first frame
+	{
+		previous = points;
+		smoothed = points;
+		output = points;
+		this->timestamp = timestamp;
+		std::fill(moved, moved + static_cast<int>(Part::COUNT), true);
+		return output;
+	}
+
+	float interval = static_cast<float>(timestamp - this->timestamp);
+	if(!(interval > 0))
+		interval = DEFAULT_INTERVAL;
+	this->timestamp = timestamp;
+
+	const float eye_distance = std::max(1.0F, static_cast<float>(norm(points[RIGHT_PUPIL] - points[LEFT_PUPIL])));
+	const float derivative_alpha = alpha(derivative_cutoff, interval);
+
+	for(int p = 0; p < static_cast<int>(Part::COUNT); ++p)
+	{
+		const std::vector<int>& indices = part_indices[p];
+
+		// velocity of the part as a whole, its points move together and jitter independently
+		Point2f sum(0, 0);
+		for(int i : indices)
+			sum += points[i] - previous[i];
+		const Point2f raw_velocity = sum / (static_cast<float>(indices.size()) * interval);
+		velocity[p] += derivative_alpha * (raw_velocity - velocity[p]);
+
+		const float speed = static_cast<float>(norm(velocity[p])) / eye_distance;
+		const float cutoff = min_cutoff + beta * speed;
+		const float a = alpha(cutoff, interval);
+
+		// A ramp x = v * t falls behind by v * interval * (1 - a) / a in exponential filter, add it back. Weight
+		// it by speed, since velocity at rest is nothing but jitter and it must not shake the resting points.
+		const float weight = speed * speed / (speed * speed + prediction_speed * prediction_speed + 1e-12F);
+		const Point2f lead = velocity[p] * (weight * interval * (1 - a) / a);
+
+		float drift = 0;
+		for(int i : indices)
+		{
+			smoothed[i] += a * (points[i] - smoothed[i]);
+			const Point2f delta = smoothed[i] + lead - output[i];
+			drift = std::max(drift, delta.dot(delta));
+		}
+
+		moved[p] = drift > threshold * threshold;
+		if(moved[p])
+			for(int i : indices)
+				output[i] = smoothed[i] + lead;
+	}
+
+	previous = points;
+	return output;
+}
+
+} /* namespace venus */
@@ -0,0 +1,113 @@
+#ifndef VENUS_LANDMARK_FILTER_H_
+#define VENUS_LANDMARK_FILTER_H_
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace venus {
+
+/**
+ * Stabilizes the feature points of one face across the frames of a video.
+ *
+ * Landmarks found by FaceTracker jitter by a pixel or so from frame to frame even when the face holds still, which
+ * makes makeup overlays shimmer and regenerates their masks for nothing. This is a
+ * <a href="http://cristal.univ-lille.fr/~casiez/1euro/">One Euro filter</a> whose speed term is taken per facial
+ * part: the points of an eye or the lips move together, so they share one velocity, estimated from all of them, and
+ * one cutoff frequency. At rest the cutoff is low and jitter is removed, when the part moves the cutoff rises and the
+ * lag with it shrinks. The lag left, the filtered velocity times the lag of the filter, is added back so that steady
+ * motion is followed without delay.
+ *
+ * A part is reported as moved only when one of its points drifted more than a threshold since the part last moved;
+ * until then its points are returned exactly as before. Masks keyed by the points, such as MaskCache, are then reused
+ * on static frames instead of being made again.
+ *
+ * <code>
+ * FaceTracker tracker(CLASSIFIER_DIR);
+ * LandmarkFilter filter;
+ * while(camera.read(frame))
+ * {
+ *     std::vector<Point2f> points = tracker.track(gray);
+ *     if(points.empty())
+ *     {
+ *         filter.reset();
+ *         continue;
+ *     }
+ *     const std::vector<Point2f>& stable = filter.filter(points, timestamp);
+ *     if(filter.hasMoved(LandmarkFilter::Part::LIPS))
+ *         ...  // regenerate lip mask with stable points
+ * }
+ * </code>
+ */
+class LandmarkFilter
+{
+public:
+	enum class Part
+	{
+		FACE,        ///< contour, from temple to chin and forehead
+		BROW_RIGHT,
+		BROW_LEFT,
+		EYE_RIGHT,   ///< with eyelid and pupil
+		EYE_LEFT,
+		NOSE,
+		LIPS,
+
+		COUNT
+	};
+
+private:
+	float min_cutoff;   ///< in Hz, cutoff frequency at rest
+	float beta;         ///< in Hz per eye distance per second, how fast cutoff rises with speed
+	float derivative_cutoff;  ///< in Hz, for the velocity
+	float prediction_speed;   ///< in eye distance per second, half weight of lag compensation at this speed
+	float threshold;    ///< in pixels, movement that makes a part move
+
+	std::vector<cv::Point2f> previous;  ///< input points of the previous frame
+	std::vector<cv::Point2f> smoothed;  ///< filtered points, lagging
+	std::vector<cv::Point2f> output;    ///< what filter() returns
+	cv::Point2f velocity[static_cast<int>(Part::COUNT)];  ///< filtered, in pixels per second
+	bool moved[static_cast<int>(Part::COUNT)];
+	double timestamp;   ///< of the previous frame
+
+	static float alpha(float cutoff, float interval);
+
+public:
+	/**
+	 * @param[in] min_cutoff Cutoff frequency in Hz when the face holds still, lower for less jitter and more lag.
+	 * @param[in] beta       Rise of cutoff frequency with speed, higher for less lag in fast motion.
+	 * @param[in] threshold  In pixels, smaller movements don't make a part move.
+	 */
+	explicit LandmarkFilter(float min_cutoff = 1.0F, float beta = 4.0F, float threshold = 1.0F);
+
+	void setMinCutoff(float min_cutoff);
+	void setBeta(float beta);
+	void setDerivativeCutoff(float derivative_cutoff);
+
+	/**
+	 * @param[in] speed In eye distance per second. Lag compensation of a part moving at v is weighted
+	 *                  v² / (v² + speed²), to keep it from amplifying jitter at rest. 0 compensates all the lag.
+	 */
+	void setPredictionSpeed(float speed);
+
+	void setThreshold(float threshold);
+
+	/**
+	 * @param[in] points    Feature points of a frame, Feature::COUNT of them as FaceTracker::track() returns.
+	 * @param[in] timestamp Time of the frame in seconds, increasing.
+	 * @return Stabilized points, valid until next call.
+	 */
+	const std::vector<cv::Point2f>& filter(const std::vector<cv::Point2f>& points, double timestamp);
+
+	/**
+	 * @return Whether points of the @p part changed in last filter() call. All parts move on the first frame.
+	 */
+	bool hasMoved(Part part) const { return moved[static_cast<int>(part)]; }
+
+	/**
+	 * Forget the history, call it when the face is lost, so that next frame is taken as is.
+	 */
+	void reset();
+};
+
+} /* namespace venus */
+#endif /* VENUS_LANDMARK_FILTER_H_ */
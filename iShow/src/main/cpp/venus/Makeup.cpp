@@ -6,9 +6,11 @@
 #include "venus/Feature.h"
 #include "venus/ImageWarp.h"
 #include "venus/Makeup.h"
+#include "venus/MaskCache.h"
 #include "venus/opencv_utility.h"
 #include "venus/scalar.h"
 
+#include <opencv2/core/hal/intrin.hpp>
 #include <opencv2/imgproc.hpp>
 
 // OpenCV's inpainting algorithm is lame, needs an alternative.
@@ -223,138 +225,215 @@ std::vector<cv::Point2f> Makeup::createPolygon(const std::vector<cv::Point2f>& p
 	}
 }
 
-void Makeup::blend(cv::Mat& result, const cv::Mat& dst, const cv::Mat& src, const cv::Point2i& origin, float amount)
-{
-	assert(!src.empty() && (src.type() == CV_8UC4 || src.type() == CV_32FC4));
-
-	// Note that dst.copyTo(result); will invoke result.create(src.size(), src.type());
-	// which has this clause if( dims <= 2 && rows == _rows && cols == _cols && type() == _type && data ) return;
-	// which means that result's memory will only be allocated the first time in if result is empty.
-	if(dst.data != result.data)
-		dst.copyTo(result);
-
-	Rect rect_src(origin.x, origin.y, src.cols, src.rows);
-	Rect rect_dst(0, 0, dst.cols, dst.rows);
-	Rect rect = rect_dst & rect_src;
+/*
+	Row kernels of Makeup::blend(). src is a straight alpha RGBA layer, its color premultiplied by a = alpha * amount
+	is composited over dst, result = src * a + dst * (1 - a), which is SRC_OVER on an opaque backdrop. The alpha
+	channel of dst is kept. alpha is scaled by mask / 255 so that anti-aliased or feathered masks blend their edges
+	partially, pixels whose mask value is 0 are left untouched. mask can be nullptr.
 
-	switch(dst.type())
+	8-bit rows work in 16-bit fixed point, x = src * a + dst * (255 - a) can't exceed 255 * 255, and it's divided
+	by 255 with shifts, @see divide255().
+*/
+template <int CN>
+static void compositeRow(uint8_t* dst, const uint8_t* src, const uint8_t* mask, int count, float amount)
+{
+	const int weight = cvRound(amount * 256);  // Q8, so a = (alpha * weight + 128) >> 8 stays in [0, 255]
+	int c = 0;
+
+#if CV_SIMD128
+	const v_uint8x16 zero = v_setzero_u8();
+	const v_uint16x8 v_weight = v_setall_u16(static_cast<ushort>(weight));
+	const v_uint16x8 v_255 = v_setall_u16(255), v_128 = v_setall_u16(128);
+	for(; c <= count - 16; c += 16)
 	{
-	case CV_8UC3:
-		for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-		for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
-		{
-			const cv::Vec4b& src_color = src.at<cv::Vec4b>(r - origin.y, c - origin.x);
-			cv::Vec3b& dst_color = result.at<cv::Vec3b>(r, c);
-			dst_color = mix(dst_color, *reinterpret_cast<const cv::Vec3b*>(&src_color), src_color[3]/255.0F * amount);
-		}
-		break;
-	case CV_8UC4:
-		for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-		for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
+		v_uint8x16 s0, s1, s2, s3;
+		v_load_deinterleave(src + c * 4, s0, s1, s2, s3);
+		if(mask != nullptr)
 		{
-			const cv::Vec4b& src_color = src.at<cv::Vec4b>(r - origin.y, c - origin.x);
-			cv::Vec4b& dst_color = result.at<cv::Vec4b>(r, c);
-			dst_color = mix(dst_color, src_color, amount);
+			v_uint16x8 s_lo, s_hi, m_lo, m_hi;
+			v_expand(s3, s_lo, s_hi);
+			v_expand(v_load(mask + c), m_lo, m_hi);
+			s_lo = s_lo * m_lo + v_128;
+			s_hi = s_hi * m_hi + v_128;
+			s3 = v_pack(v_shr<8>(s_lo + v_shr<8>(s_lo)), v_shr<8>(s_hi + v_shr<8>(s_hi)));
 		}
-		break;
-#if 0  // currently unused case
-	case CV_32FC3:
-		for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-		for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
+
+		// skip fully transparent spans, they are common at the border of cosmetics
+		if(!v_check_any(~(s3 == zero)))
+			continue;
+
+		v_uint16x8 a[2], l_a[2];
+		v_expand(s3, a[0], a[1]);
+		for(int i = 0; i < 2; ++i)
 		{
-			const cv::Vec3f& src_color = src.at<cv::Vec3f>(r - origin.y, c - origin.x);
-			cv::Vec3f& dst_color = result.at<cv::Vec3f>(r, c);
-			dst_color = mix(dst_color, src_color, amount);
+			a[i] = v_shr<8>(a[i] * v_weight + v_128);
+			l_a[i] = v_255 - a[i];
 		}
-		break;
-	case CV_32FC4:
-		for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-		for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
+
+		v_uint8x16 d[4];
+		if(CN == 4)
+			v_load_deinterleave(dst + c * 4, d[0], d[1], d[2], d[3]);
+		else
+			v_load_deinterleave(dst + c * 3, d[0], d[1], d[2]);
+
+		const v_uint8x16 s[3] = { s0, s1, s2 };
+		for(int k = 0; k < 3; ++k)
 		{
-			const cv::Vec4f& src_color = src.at<cv::Vec4f>(r - origin.y, c - origin.x);
-			cv::Vec4f& dst_color = result.at<cv::Vec4f>(r, c);
-			dst_color = mix(dst_color, src_color, amount);
+			v_uint16x8 s_lo, s_hi, d_lo, d_hi;
+			v_expand(s[k], s_lo, s_hi);
+			v_expand(d[k], d_lo, d_hi);
+			v_uint16x8 x_lo = s_lo * a[0] + d_lo * l_a[0] + v_128;
+			v_uint16x8 x_hi = s_hi * a[1] + d_hi * l_a[1] + v_128;
+			x_lo = v_shr<8>(x_lo + v_shr<8>(x_lo));
+			x_hi = v_shr<8>(x_hi + v_shr<8>(x_hi));
+			d[k] = v_pack(x_lo, x_hi);
 		}
-		break;
+
+		if(CN == 4)
+			v_store_interleave(dst + c * 4, d[0], d[1], d[2], d[3]);
+		else
+			v_store_interleave(dst + c * 3, d[0], d[1], d[2]);
+	}
 #endif
-	default:
-		assert(false);
-		break;
+
+	for(; c < count; ++c)
+	{
+		if(mask != nullptr && mask[c] == 0)
+			continue;
+
+		const uint8_t* s = src + c * 4;
+		const int alpha = mask != nullptr ? divide255(s[3] * mask[c]) : s[3];
+		const int a = (alpha * weight + 128) >> 8;
+		if(a == 0)
+			continue;
+
+		uint8_t* d = dst + c * CN;
+		for(int k = 0; k < 3; ++k)
+			d[k] = divide255(s[k] * a + d[k] * (255 - a));
 	}
 }
 
-void Makeup::blend(cv::Mat& result, const cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, const cv::Point2i& origin, float amount)
+template <int CN>
+static void compositeRow(float* dst, const float* src, const uint8_t* mask, int count, float amount)
 {
-	assert(!src.empty() && (src.type() == CV_8UC4 || src.type() == CV_32FC4));
-	assert(mask.type() == CV_8UC1);
-	if(dst.data != result.data)
-		dst.copyTo(result);
+	for(int c = 0; c < count; ++c)
+	{
+		if(mask != nullptr && mask[c] == 0)
+			continue;
 
-	Rect rect_src(origin.x, origin.y, src.cols, src.rows);
-	Rect rect_dst(0, 0, dst.cols, dst.rows);
-	Rect rect = rect_dst & rect_src;
+		const float* s = src + c * 4;
+		const float a = mask != nullptr ? s[3] * amount * (mask[c] * (1.0F / 255)) : s[3] * amount;
+		if(a == 0.0F)
+			continue;
 
-	Rect2i rect_mask(0, 0, mask.cols, mask.rows);
-	int offset_x = (src.cols - mask.cols)/2;
-	int offset_y = (src.rows - mask.rows)/2;
+		float* d = dst + c * CN;
+		for(int k = 0; k < 3; ++k)
+			d[k] = s[k] * a + d[k] * (1.0F - a);
+	}
+}
+
+Makeup::Layer::Layer(const cv::Mat& image, const cv::Point2i& origin, float amount, const cv::Mat& mask/* = cv::Mat() */):
+	image(image),
+	mask(mask),
+	origin(origin),
+	amount(amount)
+{
+	assert(!image.empty() && (image.type() == CV_8UC4 || image.type() == CV_32FC4));
+	assert(mask.empty() || mask.type() == CV_8UC1);
+}
+
+cv::Rect Makeup::Layer::getRect() const
+{
+	Rect rect(origin.x, origin.y, image.cols, image.rows);
+	if(!mask.empty())  // mask is centered on image
+		rect &= Rect(origin.x + (image.cols - mask.cols)/2, origin.y + (image.rows - mask.rows)/2, mask.cols, mask.rows);
+	return rect;
+}
 
-	for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-	for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
+/**
+ * Only the rows/columns where dst, layer image and mask all overlap are visited. Rows are blended in parallel,
+ * and each of them with all the layers in order.
+ */
+template <typename T, int CN>
+static void composite(cv::Mat& dst, const std::vector<Makeup::Layer>& layers)
+{
+	const Rect bounds(0, 0, dst.cols, dst.rows);
+	std::vector<Rect> rects(layers.size());
+	int top = dst.rows, bottom = 0;
+	for(size_t i = 0; i < layers.size(); ++i)
 	{
-		const int src_r = r - rect.y, src_c = c - rect.x;
-		Point2i mask_position(src_c - offset_x, src_r - offset_y);
-		if(!rect_mask.contains(mask_position) || mask.at<uint8_t>(mask_position) == 0)
+		rects[i] = layers[i].getRect() & bounds;
+		if(rects[i].area() <= 0)  // not overlap
 			continue;
+		top = std::min(top, rects[i].y);
+		bottom = std::max(bottom, rects[i].y + rects[i].height);
+	}
 
-		switch(dst.type())
-		{
-		case CV_8UC3:
-		{
-			const cv::Vec4b& src_color = src.at<cv::Vec4b>(src_r, src_c);
-			cv::Vec3b& dst_color = result.at<cv::Vec3b>(r, c);
-			dst_color = mix(dst_color, *reinterpret_cast<const cv::Vec3b*>(&src_color), src_color[3]/255.0F * amount);
-		}
-			break;
-		case CV_8UC4:
-		{
-			const cv::Vec4b& src_color = src.at<cv::Vec4b>(src_r, src_c);
-			cv::Vec4b& dst_color = result.at<cv::Vec4b>(r, c);
-			dst_color = mix(dst_color, src_color, amount);
-		}
-			break;
-#if 0  // currently unused case
-		case CV_32FC3:
-		{
-			const cv::Vec4f& src_color = src.at<cv::Vec4f>(src_r, src_c);
-			cv::Vec3f& dst_color = result.at<cv::Vec3f>(r, c);
-			dst_color = mix(dst_color, *reinterpret_cast<const cv::Vec3f*>(&src_color), src_color[3] * amount);
-		}
-			break;
-		case CV_32FC4:
+	#pragma omp parallel for
+	for(int r = top; r < bottom; ++r)
+	{
+		T* dst_row = dst.ptr<T>(r);
+		for(size_t i = 0; i < layers.size(); ++i)
 		{
-			const cv::Vec4f& src_color = src.at<cv::Vec4f>(src_r, src_c);
-			cv::Vec4f& dst_color = result.at<cv::Vec4f>(r, c);
-			dst_color = mix(dst_color, src_color, amount);
+			const Makeup::Layer& layer = layers[i];
+			const Rect& rect = rects[i];
+			if(r < rect.y || r >= rect.y + rect.height)
+				continue;
+
+			const int src_r = r - layer.origin.y, src_x = rect.x - layer.origin.x;
+			const uint8_t* mask_row = nullptr;
+			if(!layer.mask.empty())
+				mask_row = layer.mask.ptr<uint8_t>(src_r - (layer.image.rows - layer.mask.rows)/2) +
+						(src_x - (layer.image.cols - layer.mask.cols)/2);
+
+			compositeRow<CN>(dst_row + rect.x * CN, layer.image.ptr<T>(src_r) + src_x * 4, mask_row, rect.width, layer.amount);
 		}
-			break;
+	}
+}
+
+void Makeup::blend(cv::Mat& dst, const std::vector<Layer>& layers)
+{
+#ifndef NDEBUG
+	for(const Layer& layer : layers)
+		assert(layer.image.depth() == dst.depth());
 #endif
-		default:
-			assert(false);
-			break;
-		}
+
+	// dispatch once, rather than per pixel
+	switch(dst.type())
+	{
+	case CV_8UC3:  composite<uint8_t, 3>(dst, layers);  break;
+	case CV_8UC4:  composite<uint8_t, 4>(dst, layers);  break;
+	case CV_32FC3: composite<float, 3>  (dst, layers);  break;
+	case CV_32FC4: composite<float, 4>  (dst, layers);  break;
+	default:       assert(false);                       break;
 	}
 }
 
-void Makeup::applyBrow(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points,
-		const cv::Mat& brow, uint32_t color, float amount, float offsetY/* = 0.0F */)
+void Makeup::blend(cv::Mat& result, const cv::Mat& dst, const cv::Mat& src, const cv::Point2i& origin, float amount)
 {
-	assert(src.type() == CV_8UC4 && points.size() == Feature::COUNT);
+	// Note that dst.copyTo(result); will invoke result.create(src.size(), src.type());
+	// which has this clause if( dims <= 2 && rows == _rows && cols == _cols && type() == _type && data ) return;
+	// which means that result's memory will only be allocated the first time in if result is empty.
+	if(dst.data != result.data)
+		dst.copyTo(result);
+
+	blend(result, std::vector<Layer>{ Layer(src, origin, amount) });
+}
+
+void Makeup::blend(cv::Mat& result, const cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, const cv::Point2i& origin, float amount)
+{
+	if(dst.data != result.data)
+		dst.copyTo(result);
+
+	blend(result, std::vector<Layer>{ Layer(src, origin, amount, mask) });
+}
+
+void Makeup::createBrowLayers(std::vector<Layer>& layers, cv::Mat& image, const std::vector<cv::Point2f>& points,
+		const cv::Vec4f& line, const cv::Mat& brow, uint32_t color, float amount, float offsetY/* = 0.0F */)
+{
+	assert(image.type() == CV_8UC4 && points.size() == Feature::COUNT);
 	assert(brow.type() == CV_8UC1 || brow.type() == CV_8UC4);
-	if(src.data != dst.data)
-		src.copyTo(dst);
 
-	Feature feature(src, points);
-	Vec4f line = feature.getSymmetryAxis();
 	float angle = std::atan2(line[1], line[0]) - static_cast<float>(M_PI/2);
 //	std::cout << __FUNCTION__ << " angle: " << rad2deg(angle) << '\n';
 	float cosa = std::abs(std::cos(angle));
@@ -369,7 +448,7 @@ void Makeup::applyBrow(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::P
 	Point2f makeup_center(static_cast<float>(makeup_moment.m10 / makeup_moment.m00),
 	                      static_cast<float>(makeup_moment.m01 / makeup_moment.m00));
 
-	const bool has_alpha = src.channels() > 3;
+	const bool has_alpha = image.channels() > 3;
 
 	for(int i = 0; i < 2; ++i)
 	{
@@ -384,10 +463,10 @@ void Makeup::applyBrow(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::P
 		int offset = cvRound(rect.height / cosa);
 		Region::inset(rect_with_margin, -offset);
 
-		Mat roi = dst(rect_with_margin).clone();
+		Mat roi = image(rect_with_margin).clone();
 		if(has_alpha)
 			cv::cvtColor(roi, roi, CV_RGBA2RGB);  // or CV_BGRA2BGR, just strip alpha.
-		Mat roi_mask = Feature::createMask(polygon);
+		const Mat roi_mask = MaskCache::instance().createMask(polygon);
 
 		Mat target_mask(rect_with_margin.height, rect_with_margin.width, CV_8UC1, Scalar::all(0));
 		roi_mask.copyTo(target_mask(Rect(offset, offset, roi_mask.cols, roi_mask.rows)));
@@ -462,7 +541,7 @@ void Makeup::applyBrow(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::P
 		// This branch will overwrite alpha channel value if @p src is not opaque(255).
 		if(has_alpha)
 			cv::cvtColor(roi, roi, CV_RGB2RGBA);  // recover alpha with full value(255).
-		roi.copyTo(dst(rect_with_margin), target_mask);
+		roi.copyTo(image(rect_with_margin), target_mask);
 #else
 		// This branch keeps alpha channel untouched, so it's preferable.
 		for(int r = 0; r < rect.height; ++r)
@@ -473,7 +552,7 @@ void Makeup::applyBrow(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::P
 				continue;
 
 			const cv::Vec3b& src_color = roi.at<cv::Vec3b>(r, c);
-			cv::Vec4b& dst_color = dst.at<cv::Vec4b>(r + rect.y, c + rect.x);
+			cv::Vec4b& dst_color = image.at<cv::Vec4b>(r + rect.y, c + rect.x);
 
 //			*reinterpret_cast<cv::Vec3b*>(&dst_color) = src_color;
 			// mixing(below) seems better than just overwriting(above).
@@ -502,16 +581,26 @@ void Makeup::applyBrow(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::P
 		// need to move X coordinate with respect to the 1/slant.
 		Point2f translation(offsetY/line[1] * line[0], offsetY);
 		Point2f origin = center - target_center + translation;
-		Makeup::blend(dst, dst, affined_brow, origin, amount);
+		layers.push_back(Layer(affined_brow, origin, amount));
 	}
 }
 
-void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& cosmetic, float amount)
+void Makeup::applyBrow(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points,
+		const cv::Mat& brow, uint32_t color, float amount, float offsetY/* = 0.0F */)
 {
-	assert(src.type() == CV_8UC4 && cosmetic.type() == CV_8UC4);
+	assert(src.type() == CV_8UC4 && points.size() == Feature::COUNT);
 	if(src.data != dst.data)
 		src.copyTo(dst);
 
+	std::vector<Layer> layers;
+	createBrowLayers(layers, dst, points, Feature::getSymmetryAxis(points), brow, color, amount, offsetY);
+	blend(dst, layers);
+}
+
+void Makeup::createEyeLayers(std::vector<Layer>& layers, const std::vector<cv::Point2f>& points, const cv::Mat& cosmetic, float amount)
+{
+	assert(cosmetic.type() == CV_8UC4);
+
 /*
 	Below are eye feature point indices:
 
@@ -605,7 +694,7 @@ void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Po
 		}
 		Point2i origin = dst_pivot - pivot;
 
-		Makeup::blend(dst, dst, _cosmetic, origin, amount);
+		layers.push_back(Layer(_cosmetic, origin, amount));
 	}
 #else
 	const Point2f LEFT(284, 287), RIGHT(633, 287);
@@ -613,7 +702,7 @@ void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Po
 	Point2f PIVOT, pivot;
 	Vec4f DISTANCE = Feature::calcuateDistance(PIVOT, LEFT, TOP, RIGHT, BOTTOM);
 
-	Feature feature(src, points);
+	Feature feature(Mat(), points);
 
 	for(int i = 0; i <= 1; ++i)
 	{
@@ -645,11 +734,22 @@ void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Po
 
 		// rotate if skew too much
 
-		Makeup::blend(dst, dst, _cosmetic, position, amount);
+		layers.push_back(Layer(_cosmetic, position, amount));
 	}
 #endif
 }
 
+void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& cosmetic, float amount)
+{
+	assert(src.type() == CV_8UC4 && cosmetic.type() == CV_8UC4);
+	if(src.data != dst.data)
+		src.copyTo(dst);
+
+	std::vector<Layer> layers;
+	createEyeLayers(layers, points, cosmetic, amount);
+	blend(dst, layers);
+}
+
 void Makeup::applyEyeLash(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& mask, uint32_t color, float amount)
 {
 	assert(mask.type() == CV_8UC1);
@@ -708,11 +808,10 @@ void Makeup::applyEyeShadow(cv::Mat& dst, const cv::Mat& src, const std::vector<
 	applyEye(dst, src, points, eye_shadow, amount);
 }
 
-void Makeup::applyIris(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& mask, float amount)
+void Makeup::createIrisLayers(std::vector<Layer>& layers, const std::vector<cv::Point2f>& points,
+		const Region eye_region[2], const cv::Mat& mask, float amount)
 {
 	assert(0 <= amount && amount <= 1.0F);
-	if(src.data != dst.data)
-		src.copyTo(dst);
 
 	cv::Mat mask2 = mask.clone();
 	if(mask2.channels() == 3)
@@ -736,7 +835,6 @@ void Makeup::applyIris(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::P
 	float mask_radius = mask.rows / 2.0F;
 	amount = 1.2F * amount + 1.0F;  // [0, 1] => [1, 1.2]  interval can be tweaked.
 	
-	Feature feature(src, points);
 	for(int i = 0; i < 2; ++i)
 	{
 		const bool is_right = i == 0;
@@ -749,19 +847,28 @@ void Makeup::applyIris(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::P
 		cv::resize(mask2, iris, Size(/*radius, radius*/), scale, scale, cv::INTER_LINEAR);
 
 		Point2i origin = center - Point2f(iris.cols, iris.rows)/2;
-		Region region = feature.calculateEyeRegion(is_right);
-		Makeup::blend(dst, dst, iris, region.mask, origin, 1.0F);
+		layers.push_back(Layer(iris, origin, 1.0F, eye_region[i].mask));
 	}
 }
 
-void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, BlushShape shape, uint32_t color, float amount)
+void Makeup::applyIris(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& mask, float amount)
 {
-	assert(!src.empty() && points.size() == Feature::COUNT);
-	assert(0.0F <= amount && amount <= 1.0F);
-
 	if(src.data != dst.data)
 		src.copyTo(dst);
 
+	Feature feature(src, points);
+	const Region eye_region[2] = { feature.calculateEyeRegion(true), feature.calculateEyeRegion(false) };
+
+	std::vector<Layer> layers;
+	createIrisLayers(layers, points, eye_region, mask, amount);
+	blend(dst, layers);
+}
+
+void Makeup::createBlushLayers(std::vector<Layer>& layers, const std::vector<cv::Point2f>& points, BlushShape shape, uint32_t color, float amount)
+{
+	assert(points.size() == Feature::COUNT);
+	assert(0.0F <= amount && amount <= 1.0F);
+
 	for(int i = 0; i < 2; ++i)
 	{
 		// static_cast<bool>(i) emits warning "C4800: 'int' : forcing value to bool 'true' or 'false' (performance warning)".
@@ -770,31 +877,39 @@ void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::
 		std::vector<Point2f> polygon = createPolygon(points, shape, i == 0);
 
 		Rect rect = cv::boundingRect(polygon);
-		Mat  mask = Feature::maskPolygonSmooth(rect, polygon, 8);  // level (here 8) can be tuned.
+		Mat  mask = MaskCache::instance().maskPolygonSmooth(rect, polygon, 8);  // level (here 8) can be tuned.
 		Mat blush = pack(mask, color);
 //		cv::imshow(std::string("blush mask ") + (i == 0 ? "right":"left"), mask);
-		blend(dst, dst, blush, rect.tl(), amount);
+		layers.push_back(Layer(blush, rect.tl(), amount));
 
 		if(shape == BlushShape::SEAGULL)  // apply seagull shape in one go
 			break;
 	}
 }
 
-void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& mask, uint32_t color, float amount)
+void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, BlushShape shape, uint32_t color, float amount)
 {
-	assert(!src.empty() && points.size() == Feature::COUNT);
-	assert(!mask.empty() && mask.type() == CV_8UC1);  // In fact, relaxing CV_8UC1 restriction can be achieved by Effect::grayscale()
-	assert(0.0F <= amount && amount <= 1.0F);
-
+	assert(!src.empty());
 	if(src.data != dst.data)
 		src.copyTo(dst);
 
+	std::vector<Layer> layers;
+	createBlushLayers(layers, points, shape, color, amount);
+	blend(dst, layers);
+}
+
+void Makeup::createBlushLayers(std::vector<Layer>& layers, const std::vector<cv::Point2f>& points,
+		const cv::Vec4f& line, const cv::Mat& mask, uint32_t color, float amount)
+{
+	assert(points.size() == Feature::COUNT);
+	assert(!mask.empty() && mask.type() == CV_8UC1);  // In fact, relaxing CV_8UC1 restriction can be achieved by Effect::grayscale()
+	assert(0.0F <= amount && amount <= 1.0F);
+
 	constexpr bool crop_margin = false;  // enable this variable if you want to crop transparent margin
 	Mat mask2 = crop_margin? mask(Region::boundingRect(mask, 0/* tolerance */)): mask;
 //	mask2 = Effect::grayscale(mask2);  // relaxation can be done here.
 	const Size2i source_size(mask2.cols, mask2.rows);
 	
-	Vec4f line = Feature::getSymmetryAxis(points);
 	float angle = std::atan2(line[1], line[0]) - static_cast<float>(M_PI/2);
 	const bool is_square_shape = mask.rows == mask.cols;
 
@@ -835,106 +950,58 @@ void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::
 		Point2f center((size.width - 1)/2.0F, (size.height - 1)/2.0F);
 		Mat affine = Region::transform(size, center, deg2rad(rotated_rect.angle), scale);
 
-		Mat affined_mask;
-		cv::warpAffine(mask2, affined_mask, affine, size, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
-		
-		if(is_right)  // mirror mask for the upcomming left side.
-			cv::flip(mask2, mask2, 1/* horizontal */);
+		// The left side uses the mask mirrored, x' = width - 1 - x. Mirror in the matrix rather than flipping
+		// mask2, which is the caller's mask, so that both sides warp the same source and are found in MaskCache.
+		if(!is_right)
+		{
+			affine.col(2) += affine.col(0) * (source_size.width - 1);
+			affine.col(0) *= -1;
+		}
+
+		Mat affined_mask = MaskCache::instance().warpAffine(mask2, affine, size);
 
 		Point2i origin = rotated_rect.center - center;
 		Mat blush = pack(affined_mask, color);
-		blend(dst, dst, blush, origin, amount);
+		layers.push_back(Layer(blush, origin, amount));
 	}
 }
 
-void Makeup::applyLip(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, uint32_t color, float amount)
+void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& mask, uint32_t color, float amount)
 {
-	assert(!src.empty() && src.channels() == 4);  // only handles RGBA image
+	assert(!src.empty());
+	if(src.data != dst.data)
+		src.copyTo(dst);
 
-	Feature feature(src, points);
-	Region region = feature.calculateLipshRegion();
-	const Mat& mask = region.mask;
-	const Point2f& pivot = region.pivot;
+	std::vector<Layer> layers;
+	createBlushLayers(layers, points, Feature::getSymmetryAxis(points), mask, color, amount);
+	blend(dst, layers);
+}
+
+void Makeup::createLipLayers(std::vector<Layer>& layers, const Region& lip_region, uint32_t color, float amount)
+{
+	const Mat& mask = lip_region.mask;
+	const Point2f& pivot = lip_region.pivot;
 	const int& rows = mask.rows, &cols = mask.cols;
 	const Point2i& origin = pivot - static_cast<Point2f>(Point2i(mask.cols, mask.rows))/2;
-	
-/*
-	Rect all(0, 0, src.cols, src.rows);
-	Rect lip(origin.x, origin.y, rows, cols);
-	const Rect rect = all & lip;
-	
-	if(rect.area() <= 0)  // not overlap
-		return;
-*/
+
 	cv::Mat lip(rows, cols, CV_8UC4, Scalar::all(0));
 	uint32_t* lip_data = reinterpret_cast<uint32_t*>(lip.data);
 	for(int i = 0, length = rows * cols; i < length; ++i)
 		lip_data[i] = color;
 
-#if 1
-	blend(dst, src, lip, mask, origin, amount);
-#else
-	// SRC_OVER mode, [Sa + (1 - Sa)*Da, Rc = Sc + (1 - Sa)*Dc]
-	const float l_amount = 1 - amount;
-	if(src.type() == CV_8UC4)
-	{
-		float color_0_x_amount = (color      &0xff) * amount;
-		float color_1_x_amount = ((color>> 8)&0xff) * amount;
-		float color_2_x_amount = ((color>>16)&0xff) * amount;
-		float color_3_x_amount = ((color>>24)&0xff) * amount;
-
-//		uint8_t color_0 = color, color_1 = color>>8, color_2 = color>>16, color_3 = color>>24;
-		for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-		for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
-		{
-			uint8_t mask = region.mask.at<uint8_t>(r - rect_mask.y, c - rect_mask.x);
-			if(mask == 0)  // skip transparent area
-				continue;
+	layers.push_back(Layer(lip, origin, amount, mask));
+}
 
-			const Vec4b& src_color = src.at<Vec4b>(r, c);
-//			uint8_t src_0 = src_color, src_1 = src_color>>8, src_2 = src_color>>16, src_3 = src_color>>24;
-//			uint32_t mixed = mix(src_color, color, amount);
-			uint8_t _0 = saturate_cast<uint8_t>((src_color[0] & 0xff) * l_amount + color_0_x_amount);
-			uint8_t _1 = saturate_cast<uint8_t>((src_color[1] & 0xff) * l_amount + color_1_x_amount);
-			uint8_t _2 = saturate_cast<uint8_t>((src_color[2] & 0xff) * l_amount + color_2_x_amount);
-			uint8_t _3 = saturate_cast<uint8_t>((src_color[3] & 0xff) * l_amount + color_3_x_amount);
-
-			uint8_t dst_0 = (src_color[0] * (255 - mask) + _0 * mask + 127) / 255;
-			uint8_t dst_1 = (src_color[1] * (255 - mask) + _1 * mask + 127) / 255;
-			uint8_t dst_2 = (src_color[2] * (255 - mask) + _2 * mask + 127) / 255;
-			uint8_t dst_3 = _3; // (src_color[3] * (255 - mask) + _3 * mask + 127) / 255;
-
-//			uint32_t dst_color = dst_0 || (dst_1 << 8) || (dst_2 << 16) || (dst_3 << 24);
-			dst.at<Vec4b>(r, c) = Vec4b(dst_0, dst_1, dst_2, dst_3);
-		}
-	}
-	else if(src.type() == CV_32FC4)
-	{
-		float color_0_x_amount = (color      &0xff) * (amount / 255.0f);
-		float color_1_x_amount = ((color>> 8)&0xff) * (amount / 255.0f);
-		float color_2_x_amount = ((color>>16)&0xff) * (amount / 255.0f);
-		float color_3_x_amount = ((color>>24)&0xff) * (amount / 255.0f);
-		for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-		for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
-		{
-			float mask = region.mask.at<float>(r - rect_mask.y, c - rect_mask.x);
-			float l_mask = 1 - mask;
-			const Vec4f& src_color = src.at<Vec4f>(r, c);
-			float _0 = src_color[0] * l_amount + color_0_x_amount;
-			float _1 = src_color[1] * l_amount + color_1_x_amount;
-			float _2 = src_color[2] * l_amount + color_2_x_amount;
-			float _3 = src_color[3] * l_amount + color_3_x_amount;
-
-			Vec4f& dst_color = dst.at<Vec4f>(r, c);
-			dst_color[0] = src_color[0] * l_mask + _0 * mask;
-			dst_color[1] = src_color[1] * l_mask + _1 * mask;
-			dst_color[2] = src_color[2] * l_mask + _2 * mask;
-			dst_color[3] = src_color[3] * l_mask + _3 * mask;
-		}
-	}
-	else
-		assert(false);  // unimplemented yet
-#endif
+void Makeup::applyLip(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, uint32_t color, float amount)
+{
+	assert(!src.empty() && src.channels() == 4);  // only handles RGBA image
+	if(src.data != dst.data)
+		src.copyTo(dst);
+
+	Feature feature(src, points);
+	std::vector<Layer> layers;
+	createLipLayers(layers, feature.calculateLipshRegion(), color, amount);
+	blend(dst, layers);
 }
 
 } /* namespace venus */
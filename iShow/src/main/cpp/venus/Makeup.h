@@ -2,6 +2,7 @@
 #define VENUS_MAKEUP_H_
 
 #include <stdint.h>
+#include <vector>
 
 #include <opencv2/core.hpp>
 
@@ -25,6 +26,24 @@ public:
 		SHAPE_COUNT
 	};
 
+	/**
+	 * A cosmetic placed on an image, waiting to be composited by blend(cv::Mat&, const std::vector<Layer>&).
+	 */
+	struct Layer
+	{
+		cv::Mat     image;   ///< CV_8UC4 or CV_32FC4 cosmetic, of the same depth as the destination image.
+		cv::Mat     mask;    ///< Optional CV_8UC1 mask centered on @p image, scales alpha by mask / 255.
+		cv::Point2i origin;  ///< Relative origin of @p image on the destination image.
+		float       amount;  ///< Blending amount in range [0, 1].
+
+		Layer(const cv::Mat& image, const cv::Point2i& origin, float amount, const cv::Mat& mask = cv::Mat());
+
+		/**
+		 * @return area covered on the destination image, where @p image and @p mask overlap.
+		 */
+		cv::Rect getRect() const;
+	};
+
 private:
 
 	static std::vector<cv::Point2f> createPolygon(const std::vector<cv::Point2f>& points, BlushShape shape, bool right);
@@ -46,9 +65,13 @@ public:
 	static cv::Mat pack(const cv::Mat& mask, uint32_t color);
 
 	/**
-	 * @param[out] dst    The destination image
-	 * @param[in] src     The source image
-	 * @param[in] mask    Value 0 means transparent, namely blending area, 255 means opaque.
+	 * Composite <code>src</code> over <code>dst</code>, weighted by its alpha channel times <code>amount</code>.
+	 * Alpha channel of <code>dst</code> is kept.
+	 *
+	 * @param[out] result The output image, can be the same as <code>dst</code>.
+	 * @param[in] dst     The destination image, CV_8UC3, CV_8UC4, CV_32FC3 or CV_32FC4.
+	 * @param[in] src     The source image, CV_8UC4 or CV_32FC4 of the same depth as <code>dst</code>.
+	 * @param[in] mask    CV_8UC1 centered on <code>src</code>, alpha is scaled by mask / 255, pixels of value 0 are not blended.
 	 * @param[in] origin  Relative origin of the <code>src</code> image on <code>dst</code> image.
 	 * @param[in] amount  Blending amount in range [0, 1], 0 being no effect, 1 being fully applied.
 	 */
@@ -57,6 +80,39 @@ public:
 	static void blend(cv::Mat& result, const cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, const cv::Point2i& origin, float amount);
 	/**@}*/
 
+	/**
+	 * Composite layers onto an image in place, in order. The rows of the union of their areas are visited once,
+	 * and each row is blended with all the layers covering it while it's in cache, which gives the same result as
+	 * blending the layers one after another.
+	 *
+	 * @param[in,out] dst    CV_8UC3, CV_8UC4, CV_32FC3 or CV_32FC4 image.
+	 * @param[in]     layers Cosmetics to be composited, bottom first.
+	 */
+	static void blend(cv::Mat& dst, const std::vector<Layer>& layers);
+
+	/**
+	 * Geometry part of the apply* functions below, the cosmetics are placed as layers rather than blended right
+	 * away, so that a whole look can be composited in one go, @see MakeupSession.
+	 *
+	 * @param[out] layers  Layers are appended to it.
+	 * @param[in]  line    Symmetry axis, @see Feature::getSymmetryAxis()
+	 * @param[in]  eye_region  Regions of the right and the left eye, @see Feature::calculateEyeRegion()
+	 * @param[in]  lip_region  @see Feature::calculateLipshRegion()
+	 *
+	 * Eye brows are erased from @p image in place before their layers are placed, so that a new brow can be drawn.
+	 */
+	/**@{*/
+	static void createBrowLayers(std::vector<Layer>& layers, cv::Mat& image, const std::vector<cv::Point2f>& points,
+			const cv::Vec4f& line, const cv::Mat& brow, uint32_t color, float amount, float offsetY = 0.0F);
+	static void createEyeLayers(std::vector<Layer>& layers, const std::vector<cv::Point2f>& points, const cv::Mat& cosmetic, float amount);
+	static void createIrisLayers(std::vector<Layer>& layers, const std::vector<cv::Point2f>& points,
+			const Region eye_region[2], const cv::Mat& mask, float amount);
+	static void createBlushLayers(std::vector<Layer>& layers, const std::vector<cv::Point2f>& points, BlushShape shape, uint32_t color, float amount);
+	static void createBlushLayers(std::vector<Layer>& layers, const std::vector<cv::Point2f>& points,
+			const cv::Vec4f& line, const cv::Mat& mask, uint32_t color, float amount);
+	static void createLipLayers(std::vector<Layer>& layers, const Region& lip_region, uint32_t color, float amount);
+	/**@}*/
+
 	/**
 	 * @param[out] dst
 	 * @param[in] src     The source image
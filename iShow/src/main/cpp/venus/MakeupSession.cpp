@@ -0,0 +1,87 @@
+#include <assert.h>
+
+#include "venus/MakeupSession.h"
+
+using namespace cv;
+
+namespace venus {
+
+MakeupSession::MakeupSession(cv::Mat& image, const std::vector<cv::Point2f>& points):
+	image(image),
+	points(points),
+	feature(image, this->points),
+	has_eye_region(false),
+	has_lip_region(false)
+{
+	assert(image.type() == CV_8UC4);
+}
+
+const Region* MakeupSession::getEyeRegions()
+{
+	if(!has_eye_region)
+	{
+		eye_region[0] = feature.calculateEyeRegion(true);
+		eye_region[1] = feature.calculateEyeRegion(false);
+		has_eye_region = true;
+	}
+	return eye_region;
+}
+
+const Region& MakeupSession::getLipRegion()
+{
+	if(!has_lip_region)
+	{
+		lip_region = feature.calculateLipshRegion();
+		has_lip_region = true;
+	}
+	return lip_region;
+}
+
+void MakeupSession::addBrow(const cv::Mat& brow, uint32_t color, float amount, float offsetY/* = 0.0F */)
+{
+	Makeup::createBrowLayers(layers, image, points, feature.getSymmetryAxis(), brow, color, amount, offsetY);
+}
+
+void MakeupSession::addEye(const cv::Mat& cosmetic, float amount)
+{
+	Makeup::createEyeLayers(layers, points, cosmetic, amount);
+}
+
+void MakeupSession::addEyeLash(const cv::Mat& mask, uint32_t color, float amount)
+{
+	assert(mask.type() == CV_8UC1);
+	addEye(Makeup::pack(mask, color), amount);
+}
+
+void MakeupSession::addEyeShadow(cv::Mat mask[3], uint32_t color[3], float amount)
+{
+	addEye(Makeup::createEyeShadow(mask, color), amount);
+}
+
+void MakeupSession::addIris(const cv::Mat& mask, float amount)
+{
+	Makeup::createIrisLayers(layers, points, getEyeRegions(), mask, amount);
+}
+
+void MakeupSession::addBlush(Makeup::BlushShape shape, uint32_t color, float amount)
+{
+	Makeup::createBlushLayers(layers, points, shape, color, amount);
+}
+
+void MakeupSession::addBlush(const cv::Mat& mask, uint32_t color, float amount)
+{
+	Makeup::createBlushLayers(layers, points, feature.getSymmetryAxis(), mask, color, amount);
+}
+
+void MakeupSession::addLip(uint32_t color, float amount)
+{
+	Makeup::createLipLayers(layers, getLipRegion(), color, amount);
+}
+
+void MakeupSession::apply()
+{
+	Makeup::blend(image, layers);
+	layers.clear();
+}
+
+} /* namespace venus */
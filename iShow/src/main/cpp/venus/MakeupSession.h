@@ -0,0 +1,95 @@
+#ifndef VENUS_MAKEUP_SESSION_H_
+#define VENUS_MAKEUP_SESSION_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "venus/Feature.h"
+#include "venus/Makeup.h"
+#include "venus/Region.h"
+
+namespace venus {
+
+/**
+ * Applies a full makeup look to one face. Makeup::apply* functions each build their own Feature, copy the image
+ * and blend over it, a session instead computes the face geometry once (symmetry axis, eye and lip regions), takes
+ * all the cosmetics as layers, and composites them in a single pass over the union of their areas, in place.
+ *
+ * <code>
+ * MakeupSession session(image, points);
+ * session.addBrow(brow, color, 0.8F);
+ * session.addEyeShadow(masks, colors, 0.6F);
+ * session.addBlush(Makeup::BlushShape::OVAL, blush_color, 0.5F);
+ * session.addLip(lip_color, 0.7F);
+ * session.apply();  // image now wears the look
+ * </code>
+ *
+ * Layers are composited in the order they are added. Eye brows are the exception that they need to erase the
+ * original brows, which is done in place by addBrow().
+ */
+class MakeupSession
+{
+private:
+	cv::Mat image;                          ///< shares data with the image given to constructor
+	const std::vector<cv::Point2f> points;
+	const Feature feature;                  ///< refers to points above
+
+	// cached geometry, computed on first use
+	Region eye_region[2];                   ///< right and left
+	Region lip_region;
+	bool has_eye_region;
+	bool has_lip_region;
+
+	std::vector<Makeup::Layer> layers;
+
+	const Region* getEyeRegions();
+	const Region& getLipRegion();
+
+public:
+	/**
+	 * @param[in,out] image   CV_8UC4 image, it's modified in place.
+	 * @param[in]     points  Feature points detected from @p image.
+	 */
+	MakeupSession(cv::Mat& image, const std::vector<cv::Point2f>& points);
+
+	// feature refers to points of this very object
+	MakeupSession(const MakeupSession&) = delete;
+	MakeupSession& operator=(const MakeupSession&) = delete;
+
+	const Feature& getFeature() const { return feature; }
+
+	/// @see Makeup::applyBrow()
+	void addBrow(const cv::Mat& brow, uint32_t color, float amount, float offsetY = 0.0F);
+
+	/// @see Makeup::applyEye()
+	void addEye(const cv::Mat& cosmetic, float amount);
+
+	/// @see Makeup::applyEyeLash()
+	void addEyeLash(const cv::Mat& mask, uint32_t color, float amount);
+
+	/// @see Makeup::applyEyeShadow()
+	void addEyeShadow(cv::Mat mask[3], uint32_t color[3], float amount);
+
+	/// @see Makeup::applyIris()
+	void addIris(const cv::Mat& mask, float amount);
+
+	/// @see Makeup::applyBlush(cv::Mat&, const cv::Mat&, const std::vector<cv::Point2f>&, Makeup::BlushShape, uint32_t, float)
+	void addBlush(Makeup::BlushShape shape, uint32_t color, float amount);
+
+	/// @see Makeup::applyBlush(cv::Mat&, const cv::Mat&, const std::vector<cv::Point2f>&, const cv::Mat&, uint32_t, float)
+	void addBlush(const cv::Mat& mask, uint32_t color, float amount);
+
+	/// @see Makeup::applyLip()
+	void addLip(uint32_t color, float amount);
+
+	/**
+	 * Composite all the layers added so far onto the image, then clear them. The geometry is kept, so the session
+	 * can go on with other cosmetics.
+	 */
+	void apply();
+};
+
+} /* namespace venus */
+#endif /* VENUS_MAKEUP_SESSION_H_ */
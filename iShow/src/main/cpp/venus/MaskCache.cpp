@@ -0,0 +1,254 @@
+#include <assert.h>
+#include <string.h>
+
+#include <opencv2/imgproc.hpp>
+
+#include "venus/Feature.h"
+#include "venus/MaskCache.h"
+#include "venus/opencv_utility.h"
+
+using namespace cv;
+
+namespace venus {
+
+static inline void hashCombine(size_t& seed, size_t value)
+{
+	seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+// hashes a word at a time, memcpy() so that rows of any alignment can be read
+static size_t hashPixels(const cv::Mat& mask)
+{
+	const size_t length = mask.cols * mask.elemSize();
+	size_t seed = 0;
+	for(int r = 0; r < mask.rows; ++r)
+	{
+		const uchar* row = mask.ptr<uchar>(r);
+		size_t i = 0, word;
+		for(; i + sizeof(word) <= length; i += sizeof(word))
+		{
+			memcpy(&word, row + i, sizeof(word));
+			hashCombine(seed, word);
+		}
+		for(; i < length; ++i)
+			hashCombine(seed, row[i]);
+	}
+	return seed;
+}
+
+MaskCache::Key::Key(Kind kind, const cv::Rect2i& rect, const cv::Vec3f& values, std::vector<cv::Point2f> points,
+		const uchar* source/* = nullptr */, size_t checksum/* = 0 */):
+	kind(kind),
+	rect(rect),
+	values(values),
+	points(std::move(points)),
+	source(source),
+	checksum(checksum),
+	hash(static_cast<size_t>(kind))
+{
+	const std::hash<cv::Point2f> hasher;
+	hashCombine(hash, hasher(Point2f(static_cast<float>(rect.x), static_cast<float>(rect.y))));
+	hashCombine(hash, hasher(Point2f(static_cast<float>(rect.width), static_cast<float>(rect.height))));
+	hashCombine(hash, hasher(Point2f(values[0], values[1])));
+	hashCombine(hash, hasher(Point2f(values[2], 0.0F)));
+	hashCombine(hash, std::hash<const void*>()(source));
+	hashCombine(hash, checksum);
+	for(const Point2f& point : this->points)
+		hashCombine(hash, hasher(point));
+}
+
+bool MaskCache::Key::operator==(const Key& other) const
+{
+	// compare all, so that hash collisions never return a wrong mask
+	return hash == other.hash && kind == other.kind && rect == other.rect && values == other.values &&
+			source == other.source && checksum == other.checksum && points == other.points;
+}
+
+size_t MaskCache::Key::bytes() const
+{
+	return sizeof(Key) + points.size() * sizeof(Point2f);
+}
+
+MaskCache::MaskCache(size_t capacity/* = 8 * 1024 * 1024 */):
+	capacity(capacity),
+	statistics()
+{
+}
+
+MaskCache& MaskCache::instance()
+{
+	static MaskCache cache;
+	return cache;
+}
+
+bool MaskCache::find(const Key& key, cv::Mat& mask, cv::Point2i* position)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = table.find(key);
+	if(it == table.end())
+	{
+		++statistics.misses;
+		return false;
+	}
+
+	++statistics.hits;
+	entries.splice(entries.begin(), entries, it->second);  // move to front
+	mask = it->second->mask;
+	if(position)
+		*position = it->second->position;
+	return true;
+}
+
+void MaskCache::insert(Key&& key, const cv::Mat& mask, const cv::Point2i& position, const cv::Mat& source/* = cv::Mat() */)
+{
+	const size_t bytes = mask.total() * mask.elemSize() + 2 * key.bytes();
+	std::lock_guard<std::mutex> lock(mutex);
+	if(bytes > capacity || table.find(key) != table.end())  // too large, or made by another thread meanwhile
+		return;
+
+	entries.push_front(Entry{ std::move(key), mask, position, source });
+	table.emplace(entries.front().key, entries.begin());
+	++statistics.count;
+	statistics.bytes += bytes;
+	evict();
+}
+
+void MaskCache::evict()
+{
+	while(statistics.bytes > capacity)
+	{
+		const Entry& entry = entries.back();
+		statistics.bytes -= entry.bytes();
+		--statistics.count;
+		++statistics.evictions;
+		table.erase(entry.key);
+		entries.pop_back();
+	}
+}
+
+cv::Mat MaskCache::createMask(const std::vector<cv::Point2f>& points, float blur_radius/* = 0.0F */, cv::Point2i* position/* = nullptr */)
+{
+	Key key(Kind::MASK, Rect2i(), Vec3f(blur_radius, 0, 0), points);
+	Mat mask;
+	if(find(key, mask, position))
+		return mask;
+
+	// create outside the lock, so that misses don't block each other.
+	Point2i _position;
+	mask = Feature::createMask(points, blur_radius, &_position);
+	if(position)
+		*position = _position;
+	insert(std::move(key), mask, _position);
+	return mask;
+}
+
+cv::Mat MaskCache::maskPolygon(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points)
+{
+	Key key(Kind::POLYGON, rect, Vec3f(), points);
+	Mat mask;
+	if(find(key, mask, nullptr))
+		return mask;
+
+	mask = Feature::maskPolygon(rect, points);
+	insert(std::move(key), mask, rect.tl());
+	return mask;
+}
+
+cv::Mat MaskCache::maskPolygonSmooth(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points, int level/* = 8 */)
+{
+	Key key(Kind::POLYGON_SMOOTH, rect, Vec3f(static_cast<float>(level), 0, 0), points);
+	Mat mask;
+	if(find(key, mask, nullptr))
+		return mask;
+
+	mask = Feature::maskPolygonSmooth(rect, points, level);
+	insert(std::move(key), mask, rect.tl());
+	return mask;
+}
+
+cv::Mat MaskCache::maskPolygonSoft(const cv::Rect2i& rect, const std::vector<std::vector<cv::Point2f>>& polygons,
+		float inner, float outer, Feature::Falloff falloff/* = Feature::Falloff::SMOOTH */)
+{
+	// flatten, each polygon preceded by its size, so that different splits of the same points differ
+	std::vector<Point2f> points;
+	for(const std::vector<Point2f>& polygon : polygons)
+	{
+		points.push_back(Point2f(static_cast<float>(polygon.size()), 0.0F));
+		points.insert(points.end(), polygon.begin(), polygon.end());
+	}
+
+	Key key(Kind::POLYGON_SOFT, rect, Vec3f(inner, outer, static_cast<float>(falloff)), std::move(points));
+	Mat mask;
+	if(find(key, mask, nullptr))
+		return mask;
+
+	mask = Feature::maskPolygonSoft(rect, polygons, inner, outer, falloff);
+	insert(std::move(key), mask, rect.tl());
+	return mask;
+}
+
+cv::Mat MaskCache::maskPolygonSoft(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points,
+		float inner, float outer, Feature::Falloff falloff/* = Feature::Falloff::SMOOTH */)
+{
+	return maskPolygonSoft(rect, std::vector<std::vector<Point2f>>{ points }, inner, outer, falloff);
+}
+
+cv::Mat MaskCache::warpAffine(const cv::Mat& mask, const cv::Mat& affine, const cv::Size& size)
+{
+	assert(mask.type() == CV_8UC1 && affine.rows == 2 && affine.cols == 3);
+	Mat_<float> m;
+	affine.convertTo(m, CV_32F);
+	std::vector<Point2f> matrix
+	{
+		Point2f(m(0, 0), m(1, 0)), Point2f(m(0, 1), m(1, 1)), Point2f(m(0, 2), m(1, 2)),
+		Point2f(static_cast<float>(mask.cols), static_cast<float>(mask.rows)),  // a ROI may start at the same data
+	};
+
+	Key key(Kind::WARP, Rect2i(Point2i(0, 0), size), Vec3f(static_cast<float>(mask.step[0]), 0, 0), std::move(matrix),
+			mask.data, hashPixels(mask));
+	Mat result;
+	if(find(key, result, nullptr))
+		return result;
+
+	cv::warpAffine(mask, result, affine, size, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+	insert(std::move(key), result, Point2i(0, 0), mask);
+	return result;
+}
+
+void MaskCache::setCapacity(size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->capacity = capacity;
+	evict();
+}
+
+size_t MaskCache::getCapacity() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return capacity;
+}
+
+void MaskCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	table.clear();
+	entries.clear();
+	statistics.count = 0;
+	statistics.bytes = 0;
+}
+
+MaskCache::Statistics MaskCache::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return statistics;
+}
+
+void MaskCache::resetStatistics()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	statistics.hits = 0;
+	statistics.misses = 0;
+	statistics.evictions = 0;
+}
+
+} /* namespace venus */
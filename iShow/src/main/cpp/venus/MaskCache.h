@@ -0,0 +1,157 @@
+#ifndef VENUS_MASK_CACHE_H_
+#define VENUS_MASK_CACHE_H_
+
+#include <stddef.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "venus/Feature.h"
+
+namespace venus {
+
+/**
+ * A bounded LRU cache of the masks made by Feature::createMask(), Feature::maskPolygon(),
+ * Feature::maskPolygonSmooth() and Feature::maskPolygonSoft(), and of cosmetic masks warped onto a face.
+ *
+ * Those masks depend on the landmarks only, but they are filled (maskPolygonSmooth() fills @p level times)
+ * and blurred again every time a cosmetic is applied, even when a slider only changed the color or amount.
+ * The cache keys a mask by the polygon points (hashed with std::hash<cv::Point2f>), the kind of mask and its
+ * parameters, and keeps the most recently used ones within a memory budget. The budget counts the keys too,
+ * which hold the points and are stored twice, in the table and in the LRU list.
+ *
+ * The returned masks share data with the cache, treat them as read only, clone() before writing. They stay
+ * valid after being evicted, since cv::Mat is reference counted. All the functions are thread safe.
+ */
+class MaskCache
+{
+public:
+	struct Statistics
+	{
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+		size_t count;  ///< masks currently cached
+		size_t bytes;  ///< memory used by the cached masks and their keys
+	};
+
+private:
+	enum class Kind
+	{
+		MASK,            ///< Feature::createMask()
+		POLYGON,         ///< Feature::maskPolygon()
+		POLYGON_SMOOTH,  ///< Feature::maskPolygonSmooth()
+		POLYGON_SOFT,    ///< Feature::maskPolygonSoft()
+		WARP,            ///< cv::warpAffine() of a cosmetic mask
+	};
+
+	struct Key
+	{
+		Kind kind;
+		cv::Rect2i rect;    ///< empty for Kind::MASK, output size for Kind::WARP
+		cv::Vec3f values;   ///< blur radius, level, or inner, outer and falloff, depends on kind
+		std::vector<cv::Point2f> points;  ///< polygons each preceded by its size, or the affine matrix for Kind::WARP
+		const uchar* source;  ///< data of the warped mask for Kind::WARP, kept alive by Entry::source
+		size_t checksum;      ///< of the pixels of the warped mask for Kind::WARP, so that repainting it is noticed
+		size_t hash;
+
+		Key(Kind kind, const cv::Rect2i& rect, const cv::Vec3f& values, std::vector<cv::Point2f> points,
+				const uchar* source = nullptr, size_t checksum = 0);
+		bool operator==(const Key& other) const;
+
+		/** @return memory held by a copy of the key, with its points. */
+		size_t bytes() const;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const noexcept { return key.hash; }
+	};
+
+	struct Entry
+	{
+		Key key;
+		cv::Mat mask;
+		cv::Point2i position;
+		cv::Mat source;  ///< for Kind::WARP, so that Key::source is not freed and reused by another mask
+
+		/** @return what the entry adds to the budget, its mask and its key in both table and list. */
+		size_t bytes() const { return mask.total() * mask.elemSize() + 2 * key.bytes(); }
+	};
+
+	using Iterator = std::list<Entry>::iterator;
+
+	size_t capacity;          ///< in bytes
+	std::list<Entry> entries; ///< most recently used first
+	std::unordered_map<Key, Iterator, KeyHash> table;
+	Statistics statistics;
+	mutable std::mutex mutex;
+
+	bool find(const Key& key, cv::Mat& mask, cv::Point2i* position);
+	void insert(Key&& key, const cv::Mat& mask, const cv::Point2i& position, const cv::Mat& source = cv::Mat());
+	void evict();
+
+public:
+	/**
+	 * @param[in] capacity Memory budget in bytes.
+	 */
+	explicit MaskCache(size_t capacity = 8 * 1024 * 1024);
+
+	MaskCache(const MaskCache&) = delete;
+	MaskCache& operator=(const MaskCache&) = delete;
+
+	/**
+	 * The process wide cache, which Makeup uses.
+	 */
+	static MaskCache& instance();
+
+	/// @see Feature::createMask()
+	cv::Mat createMask(const std::vector<cv::Point2f>& points, float blur_radius = 0.0F, cv::Point2i* position = nullptr);
+
+	/// @see Feature::maskPolygon()
+	cv::Mat maskPolygon(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points);
+
+	/// @see Feature::maskPolygonSmooth()
+	cv::Mat maskPolygonSmooth(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points, int level = 8);
+
+	/// @see Feature::maskPolygonSoft()
+	cv::Mat maskPolygonSoft(const cv::Rect2i& rect, const std::vector<std::vector<cv::Point2f>>& polygons,
+			float inner, float outer, Feature::Falloff falloff = Feature::Falloff::SMOOTH);
+	cv::Mat maskPolygonSoft(const cv::Rect2i& rect, const std::vector<cv::Point2f>& points,
+			float inner, float outer, Feature::Falloff falloff = Feature::Falloff::SMOOTH);
+
+	/**
+	 * cv::warpAffine(mask, result, affine, size, INTER_LINEAR, BORDER_CONSTANT), for cosmetic masks placed on a face.
+	 *
+	 * @p mask is known by its data and a checksum of its pixels, which is one pass over it, much cheaper than the
+	 * warp. So a mask repainted in place, by a brush or in a reused bitmap, is warped again instead of returning the
+	 * old shape. While a warp of it is cached, @p mask is kept alive by the cache, its memory is not counted in the
+	 * budget since the caller holds it anyway.
+	 *
+	 * @param[in] mask   CV_8UC1 source mask.
+	 * @param[in] affine 2x3 affine matrix, CV_32F or CV_64F.
+	 * @param[in] size   Size of the result.
+	 */
+	cv::Mat warpAffine(const cv::Mat& mask, const cv::Mat& affine, const cv::Size& size);
+
+	/**
+	 * Set memory budget, masks are evicted at once if they no longer fit in. A mask larger than the budget is
+	 * never cached, so 0 disables caching.
+	 */
+	void setCapacity(size_t capacity);
+	size_t getCapacity() const;
+
+	/**
+	 * Drop all the cached masks, statistics are kept.
+	 */
+	void clear();
+
+	Statistics getStatistics() const;
+	void resetStatistics();
+};
+
+} /* namespace venus */
+#endif /* VENUS_MASK_CACHE_H_ */
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cmath>  // M_PI used by compiler.h
+
+#include "venus/compiler.h"
+#include "venus/ThreadPool.h"
+
+namespace venus {
+
+// the pool and queue index of the calling thread, set only in worker threads
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local int current_index = -1;
+
+ThreadPool::ThreadPool(int thread_count):
+	stop(false),
+	queued(0),
+	victim(0)
+{
+	if(thread_count <= 0)
+		thread_count = std::max(1U, std::thread::hardware_concurrency());
+
+	for(int i = 0; i <= thread_count; ++i)
+		queues.emplace_back(new Queue());
+
+	threads.reserve(thread_count);
+	for(int i = 0; i < thread_count; ++i)
+		threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stop = true;
+	}
+	wakeup.notify_all();
+
+	for(std::thread& thread: threads)
+		thread.join();
+}
+
+void ThreadPool::push(Task&& task)
+{
+	// workers push to their own queue, everyone else to the shared last one
+	const int index = current_pool == this ? current_index : static_cast<int>(queues.size()) - 1;
+	Queue& queue = *queues[index];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	++queued;
+
+	// Taking the lock orders this notify after a worker's predicate check, so a wakeup can't be lost.
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wakeup.notify_one();
+}
+
+bool ThreadPool::pop(Task& task)
+{
+	if(queued.load(std::memory_order_acquire) <= 0)
+		return false;
+
+	const int count = static_cast<int>(queues.size());
+	const int self = current_pool == this ? current_index : count - 1;
+
+	// newest task of our own queue first, it's likely still hot in cache
+	{
+		Queue& queue = *queues[self];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			--queued;
+			return true;
+		}
+	}
+
+	// then steal the oldest task of another queue, it's likely the biggest chunk of work left
+	const int start = static_cast<int>(victim++ % count);
+	for(int i = 0; i < count; ++i)
+	{
+		const int index = (start + i) % count;
+		if(index == self)
+			continue;
+
+		Queue& queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			--queued;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::workerLoop(int index)
+{
+	current_pool = this;
+	current_index = index;
+
+	Task task;
+	while(!stop)
+	{
+		if(pop(task))
+		{
+			task();
+			task = nullptr;  // release captures before sleeping
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wakeup.wait(lock, [this] { return stop || queued > 0; });
+	}
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& func)
+{
+	if(count <= 0)
+		return;
+
+	if(count == 1 || threads.empty())
+	{
+		for(int i = 0; i < count; ++i)
+			func(i);
+		return;
+	}
+
+	struct Group
+	{
+		std::atomic<int> remaining;
+		std::mutex error_mutex;
+		std::exception_ptr error;
+	} group;
+	group.remaining = count;
+
+	for(int i = 0; i < count; ++i)
+		push([this, &group, &func, i]()
+		{
+			try
+			{
+				func(i);
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock(group.error_mutex);
+				if(!group.error)
+					group.error = std::current_exception();
+			}
+			// must be the last access of group, the caller may return as soon as it sees 0
+			if(group.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex);
+				wakeup.notify_all();
+			}
+		});
+
+	// Help instead of blocking, this is what makes nested parallelFor calls safe. When there is nothing
+	// to help with, the rest of the calls are running on other threads, sleep until the last of them
+	// finishes or more tasks are queued.
+	Task task;
+	while(group.remaining.load(std::memory_order_acquire) > 0)
+	{
+		if(pop(task))
+		{
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wakeup.wait(lock, [this, &group] { return group.remaining.load(std::memory_order_acquire) == 0 || queued > 0; });
+	}
+
+	if(group.error)
+		std::rethrow_exception(group.error);
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+} /* namespace venus */
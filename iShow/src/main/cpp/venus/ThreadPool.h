@@ -0,0 +1,78 @@
+#ifndef VENUS_THREAD_POOL_H_
+#define VENUS_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace venus {
+
+/**
+ * A work-stealing thread pool.
+ *
+ * Each worker owns a task queue. A worker pops its own newest task first, and steals the oldest
+ * task from other workers when its queue runs dry, so nested parallel loops keep all the cores busy
+ * without a central queue becoming the bottleneck.
+ *
+ * parallelFor() may be called from inside a task. The calling thread helps to run queued tasks
+ * while it waits, so nesting never deadlocks and never leaves a core idle. When no task is left to
+ * help with it sleeps, rather than spins, until its last call finishes.
+ */
+class ThreadPool
+{
+private:
+	using Task = std::function<void()>;
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::thread> threads;
+	std::vector<std::unique_ptr<Queue>> queues;  ///< one per worker, the last one is for outside threads
+
+	std::atomic<bool> stop;
+	std::atomic<int>  queued;      ///< tasks in all the queues
+	std::atomic<unsigned int> victim;  ///< round-robin start for stealing and outside submissions
+
+	std::mutex sleep_mutex;
+	std::condition_variable wakeup;
+
+	void workerLoop(int index);
+
+	void push(Task&& task);
+	bool pop(Task& task);
+
+public:
+	/**
+	 * @param[in] thread_count Number of worker threads, 0 means std::thread::hardware_concurrency().
+	 */
+	explicit ThreadPool(int thread_count = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int getThreadCount() const { return static_cast<int>(threads.size()); }
+
+	/**
+	 * Run func(i) for i in [0, count), returns when all are done. The first exception thrown by
+	 * func is rethrown here after the other calls have finished.
+	 */
+	void parallelFor(int count, const std::function<void(int)>& func);
+
+	/**
+	 * The pool shared by the library, created on first use with hardware_concurrency() workers.
+	 */
+	static ThreadPool& shared();
+};
+
+} /* namespace venus */
+#endif /* VENUS_THREAD_POOL_H_ */
@@ -1,7 +1,15 @@
+#include <assert.h>
+#include <cmath>
+#include <limits>
+
+#include <opencv2/core/hal/intrin.hpp>
+
 #include "venus/blend.h"
 #include "venus/colorspace.h"
 #include "venus/scalar.h"
 
+using namespace cv;
+
 namespace venus {
 
 uint32_t mix(const uint32_t& from, const uint32_t& to, float amount)
@@ -80,4 +88,580 @@ void blendColor     (float* target, const float* rgbA, const float* rgbB)
 	hsl2rgb(hslB, target);
 }
 
+/*
+	Kernels of blendLayers(). Each mode is a struct whose apply() overloads take (base, layer), in the order of
+	blendAlphaF(), as 8-bit values, 16-bit lanes of 8-bit values, floats and float lanes, the templated row kernels
+	then inline them. Normal is the exception, it returns the layer, where blendNormal() returns its first argument.
+
+	The SIMD 8-bit modes do the same integer arithmetic as the scalar functions, the ones which need a division
+	look up a 256x256 table of the scalar function instead. Float modes follow the scalar ones operation by operation.
+*/
+#if CV_SIMD128
+static inline v_uint16x8 divide255(const v_uint16x8& x)
+{
+	const v_uint16x8 y = x + v_setall_u16(128);
+	return v_shr<8>(y + v_shr<8>(y));
+}
+
+static inline v_float32x4 v_fabs(const v_float32x4& x)
+{
+	return v_max(x, v_setzero_f32() - x);
+}
+
+// fuzzyEqual(), |a - b| <= sqrt(epsilon)
+static inline v_float32x4 fuzzyEqual(const v_float32x4& a, const v_float32x4& b)
+{
+	return v_fabs(a - b) <= v_setall_f32(std::sqrt(std::numeric_limits<float>::epsilon()));
+}
+#endif
+
+template <uint8_t (*F)(uint8_t, uint8_t)>
+static const uint8_t* blendTable()
+{
+	struct Table
+	{
+		uint8_t data[256 * 256];
+		Table()
+		{
+			for(int a = 0; a < 256; ++a)
+			for(int b = 0; b < 256; ++b)
+				data[(a << 8) | b] = F(a, b);
+		}
+	};
+	static const Table table;  // built once, on first use
+	return table.data;
+}
+
+#define BLEND_SCALAR(name)                                                                 \
+	static inline uint8_t apply(uint8_t A, uint8_t B)  { return blend##name(A, B); }       \
+	static inline float   apply(float A, float B)      { return blend##name(A, B); }
+
+// modes that can't be done in 16-bit lanes, 8-bit values are looked up
+#define BLEND_TABLE(name)                                                                  \
+	static inline uint8_t apply(uint8_t A, uint8_t B)  { return blendTable<blend##name>()[(A << 8) | B]; } \
+	static inline float   apply(float A, float B)      { return blend##name(A, B); }       \
+	static inline v_uint16x8 apply(const v_uint16x8& A, const v_uint16x8& B)                \
+	{                                                                                      \
+		const uint8_t* table = blendTable<blend##name>();                                  \
+		CV_DECL_ALIGNED(16) ushort a[8], b[8];                                             \
+		v_store(a, A);                                                                     \
+		v_store(b, B);                                                                     \
+		for(int i = 0; i < 8; ++i)                                                         \
+			a[i] = table[(a[i] << 8) | b[i]];                                              \
+		return v_load(a);                                                                  \
+	}
+
+#if CV_SIMD128
+#define U16 const v_uint16x8&
+#define F32 const v_float32x4&
+
+struct BlendNormal
+{
+	static inline uint8_t     apply(uint8_t A, uint8_t B)  { return B; }
+	static inline float       apply(float A, float B)      { return B; }
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return B; }
+	static inline v_float32x4 apply(F32 A, F32 B)  { return B; }
+};
+
+struct BlendLighten
+{
+	BLEND_SCALAR(Lighten)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return v_max(A, B); }
+	static inline v_float32x4 apply(F32 A, F32 B)  { return v_max(A, B); }
+};
+
+struct BlendDarken
+{
+	BLEND_SCALAR(Darken)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return v_min(A, B); }
+	static inline v_float32x4 apply(F32 A, F32 B)  { return v_min(A, B); }
+};
+
+struct BlendMultiply
+{
+	BLEND_SCALAR(Multiply)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return divide255(A * B); }
+	static inline v_float32x4 apply(F32 A, F32 B)  { return A * B; }
+};
+
+struct BlendAverage
+{
+	BLEND_SCALAR(Average)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return v_shr<1>(A + B + v_setall_u16(1)); }
+	static inline v_float32x4 apply(F32 A, F32 B)  { return (A + B) / v_setall_f32(2.0F); }
+};
+
+struct BlendAdd
+{
+	BLEND_SCALAR(Add)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return v_min(A + B, v_setall_u16(255)); }
+	static inline v_float32x4 apply(F32 A, F32 B)  { return v_min(v_setall_f32(1.0F), A + B); }
+};
+
+struct BlendSubtract
+{
+	BLEND_SCALAR(Subtract)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return (A + B) - v_setall_u16(255); }  // saturated
+	static inline v_float32x4 apply(F32 A, F32 B)  { return v_max(v_setzero_f32(), A + B - v_setall_f32(1.0F)); }
+};
+
+struct BlendDifference
+{
+	BLEND_SCALAR(Difference)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return (A - B) | (B - A); }  // saturated
+	static inline v_float32x4 apply(F32 A, F32 B)  { return v_fabs(A - B); }
+};
+
+struct BlendNegation
+{
+	BLEND_SCALAR(Negation)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { const v_uint16x8 S = A + B; return v_min(S, v_setall_u16(510) - S); }
+	static inline v_float32x4 apply(F32 A, F32 B)  { const v_float32x4 one = v_setall_f32(1.0F); return one - v_fabs(one - A - B); }
+};
+
+struct BlendScreen
+{
+	BLEND_SCALAR(Screen)
+	static inline v_uint16x8 apply(U16 A, U16 B)
+	{
+		const v_uint16x8 v_255 = v_setall_u16(255);
+		return v_255 - divide255((v_255 - A) * (v_255 - B));
+	}
+	static inline v_float32x4 apply(F32 A, F32 B)  { const v_float32x4 one = v_setall_f32(1.0F); return one - (one - A) * (one - B); }
+};
+
+struct BlendExclusion
+{
+	BLEND_TABLE(Exclusion)
+	static inline v_float32x4 apply(F32 A, F32 B)  { return A + B - v_setall_f32(2.0F) * A * B; }
+};
+
+struct BlendOverlay
+{
+	BLEND_SCALAR(Overlay)
+	static inline v_uint16x8 apply(U16 A, U16 B)
+	{
+		const v_uint16x8 v_255 = v_setall_u16(255), two = v_setall_u16(2);
+		return v_select(B < v_setall_u16(128), divide255(two * A * B),
+				divide255(v_setall_u16(255 * 255) - two * (v_255 - A) * (v_255 - B)));
+	}
+	static inline v_float32x4 apply(F32 A, F32 B)
+	{
+		const v_float32x4 one = v_setall_f32(1.0F), two = v_setall_f32(2.0F);
+		return v_select(B <= v_setall_f32(0.5F), two * A * B, one - two * (one - A) * (one - B));
+	}
+};
+
+struct BlendSoftLight
+{
+	BLEND_SCALAR(SoftLight)
+	static inline v_uint16x8 apply(U16 A, U16 B)
+	{
+		const v_uint16x8 v_255 = v_setall_u16(255), two = v_setall_u16(2);
+		const v_uint16x8 C = v_shr<1>(A) + v_setall_u16(64);
+		return v_select(B < v_setall_u16(128), divide255(two * C * B), v_255 - divide255(two * (v_255 - C) * (v_255 - B)));
+	}
+	static inline v_float32x4 apply(F32 A, F32 B)
+	{
+		const v_float32x4 one = v_setall_f32(1.0F), half = v_setall_f32(0.5F);
+		return v_select(B <= half, (A + half) * B, one - (v_setall_f32(1.5F) - A) * (one - B));
+	}
+};
+
+struct BlendHardLight
+{
+	BLEND_SCALAR(HardLight)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return BlendOverlay::apply(B, A); }
+	static inline v_float32x4 apply(F32 A, F32 B)  { return BlendOverlay::apply(B, A); }
+};
+
+struct BlendColorDodge
+{
+	BLEND_TABLE(ColorDodge)
+	static inline v_float32x4 apply(F32 A, F32 B)
+	{
+		const v_float32x4 one = v_setall_f32(1.0F);
+		return v_select(fuzzyEqual(B, one), B, v_min(one, A * one / (one - B)));
+	}
+};
+
+struct BlendColorBurn
+{
+	BLEND_TABLE(ColorBurn)
+	static inline v_float32x4 apply(F32 A, F32 B)
+	{
+		const v_float32x4 zero = v_setzero_f32(), one = v_setall_f32(1.0F);
+		return v_select(fuzzyEqual(B, zero), B, v_max(zero, one - (one - A) * one / B));
+	}
+};
+
+struct BlendLinearDodge
+{
+	BLEND_SCALAR(LinearDodge)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return BlendAdd::apply(A, B); }
+	static inline v_float32x4 apply(F32 A, F32 B)  { return BlendAdd::apply(A, B); }
+};
+
+struct BlendLinearBurn
+{
+	BLEND_SCALAR(LinearBurn)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return BlendSubtract::apply(A, B); }
+	static inline v_float32x4 apply(F32 A, F32 B)  { return BlendSubtract::apply(A, B); }
+};
+
+struct BlendLinearLight
+{
+	BLEND_SCALAR(LinearLight)
+	static inline v_uint16x8 apply(U16 A, U16 B)
+	{
+		const v_uint16x8 S = A + B + B;
+		return v_select(B < v_setall_u16(128), S - v_setall_u16(255), v_min(S - v_setall_u16(256), v_setall_u16(255)));
+	}
+	static inline v_float32x4 apply(F32 A, F32 B)
+	{
+		const v_float32x4 half = v_setall_f32(0.5F), two = v_setall_f32(2.0F);
+		return v_select(B <= half, BlendSubtract::apply(A, two * B), BlendAdd::apply(A, two * (B - half)));
+	}
+};
+
+struct BlendVividLight
+{
+	BLEND_TABLE(VividLight)
+	static inline v_float32x4 apply(F32 A, F32 B)
+	{
+		const v_float32x4 half = v_setall_f32(0.5F), two = v_setall_f32(2.0F);
+		return v_select(B <= half, BlendColorBurn::apply(A, two * B), BlendColorDodge::apply(A, two * (B - half)));
+	}
+};
+
+struct BlendPinLight
+{
+	BLEND_SCALAR(PinLight)
+	static inline v_uint16x8 apply(U16 A, U16 B)
+	{
+		const v_uint16x8 B2 = B + B;
+		return v_select(B < v_setall_u16(128), v_min(A, B2), v_max(A, B2 - v_setall_u16(256)));
+	}
+	static inline v_float32x4 apply(F32 A, F32 B)
+	{
+		const v_float32x4 half = v_setall_f32(0.5F), two = v_setall_f32(2.0F);
+		return v_select(B <= half, v_min(A, two * B), v_max(A, two * (B - half)));
+	}
+};
+
+struct BlendHardMix
+{
+	BLEND_TABLE(HardMix)
+	static inline v_float32x4 apply(F32 A, F32 B)
+	{
+		return v_select(BlendVividLight::apply(A, B) <= v_setall_f32(0.5F), v_setzero_f32(), v_setall_f32(1.0F));
+	}
+};
+
+struct BlendReflect
+{
+	BLEND_TABLE(Reflect)
+	static inline v_float32x4 apply(F32 A, F32 B)
+	{
+		const v_float32x4 one = v_setall_f32(1.0F);
+		return v_select(fuzzyEqual(B, one), B, v_min(one, A * A / (one - B)));
+	}
+};
+
+struct BlendGlow
+{
+	BLEND_TABLE(Glow)
+	static inline v_float32x4 apply(F32 A, F32 B)  { return BlendReflect::apply(B, A); }
+};
+
+struct BlendPhoenix
+{
+	BLEND_SCALAR(Phoenix)
+	static inline v_uint16x8  apply(U16 A, U16 B)  { return v_min(A, B) + v_setall_u16(255) - v_max(A, B); }
+	static inline v_float32x4 apply(F32 A, F32 B)  { return v_min(A, B) - v_max(A, B) + v_setall_f32(1.0F); }
+};
+
+#undef U16
+#undef F32
+#else
+// scalar fallback, the row kernels only call the scalar apply()
+struct BlendNormal
+{
+	static inline uint8_t apply(uint8_t A, uint8_t B)  { return B; }
+	static inline float   apply(float A, float B)      { return B; }
+};
+
+#define BLEND_MODE(name)    struct Blend##name { BLEND_SCALAR(name) };
+                       BLEND_MODE(Lighten)    BLEND_MODE(Darken)      BLEND_MODE(Multiply)    BLEND_MODE(Average)
+BLEND_MODE(Add)        BLEND_MODE(Subtract)   BLEND_MODE(Difference)  BLEND_MODE(Negation)    BLEND_MODE(Screen)
+BLEND_MODE(Exclusion)  BLEND_MODE(Overlay)    BLEND_MODE(SoftLight)   BLEND_MODE(HardLight)   BLEND_MODE(ColorDodge)
+BLEND_MODE(ColorBurn)  BLEND_MODE(LinearDodge) BLEND_MODE(LinearBurn) BLEND_MODE(LinearLight) BLEND_MODE(VividLight)
+BLEND_MODE(PinLight)   BLEND_MODE(HardMix)    BLEND_MODE(Reflect)     BLEND_MODE(Glow)        BLEND_MODE(Phoenix)
+#undef BLEND_MODE
+#endif
+#undef BLEND_SCALAR
+#undef BLEND_TABLE
+
+/*
+	8-bit rows are blended 16 pixels at a time. Weight w = layer alpha * opacity * mask is in range [0, 255],
+	and dst = (F(base, layer) * w + base * (255 - w)) / 255, in 16-bit lanes. Spans of zero weight are skipped.
+*/
+template <typename Mode, int CN>
+static void blendRow(uint8_t* dst, const uint8_t* base, const uint8_t* layer, const uint8_t* mask, int count, float opacity)
+{
+	const int weight = cvRound(opacity * 256);  // Q8
+	int c = 0;
+
+#if CV_SIMD128
+	const v_uint8x16 zero = v_setzero_u8();
+	const v_uint16x8 v_weight = v_setall_u16(static_cast<ushort>(weight));
+	const v_uint16x8 v_255 = v_setall_u16(255), v_128 = v_setall_u16(128);
+	for(; c <= count - 16; c += 16)
+	{
+		v_uint8x16 a[4], b[4];
+		if(CN == 4)
+		{
+			v_load_deinterleave(layer + c * 4, a[0], a[1], a[2], a[3]);
+			v_load_deinterleave(base  + c * 4, b[0], b[1], b[2], b[3]);
+		}
+		else
+		{
+			v_load_deinterleave(layer + c * 3, a[0], a[1], a[2]);
+			v_load_deinterleave(base  + c * 3, b[0], b[1], b[2]);
+			a[3] = v_setall_u8(255);
+		}
+
+		v_uint16x8 w[2], l_w[2];
+		v_expand(a[3], w[0], w[1]);
+		for(int i = 0; i < 2; ++i)
+			w[i] = v_shr<8>(w[i] * v_weight + v_128);
+		if(mask != nullptr)
+		{
+			v_uint16x8 m[2];
+			v_expand(v_load(mask + c), m[0], m[1]);
+			for(int i = 0; i < 2; ++i)
+				w[i] = divide255(w[i] * m[i]);
+		}
+
+		if(!v_check_any(~(v_pack(w[0], w[1]) == zero)))
+		{
+			if(dst != base)  // nothing to blend, but dst still needs base
+			{
+				if(CN == 4)
+					v_store_interleave(dst + c * 4, b[0], b[1], b[2], b[3]);
+				else
+					v_store_interleave(dst + c * 3, b[0], b[1], b[2]);
+			}
+			continue;
+		}
+
+		for(int i = 0; i < 2; ++i)
+			l_w[i] = v_255 - w[i];
+
+		for(int k = 0; k < 3; ++k)
+		{
+			v_uint16x8 A[2], B[2];
+			v_expand(a[k], A[0], A[1]);
+			v_expand(b[k], B[0], B[1]);
+			for(int i = 0; i < 2; ++i)
+				A[i] = divide255(Mode::apply(B[i], A[i]) * w[i] + B[i] * l_w[i]);
+			b[k] = v_pack(A[0], A[1]);
+		}
+
+		if(CN == 4)
+			v_store_interleave(dst + c * 4, b[0], b[1], b[2], b[3]);
+		else
+			v_store_interleave(dst + c * 3, b[0], b[1], b[2]);
+	}
+#endif
+
+	for(; c < count; ++c)
+	{
+		const uint8_t* A = layer + c * CN;
+		const uint8_t* B = base + c * CN;
+		uint8_t* D = dst + c * CN;
+
+		int w = ((CN == 4 ? A[3] : 255) * weight + 128) >> 8;
+		if(mask != nullptr)
+			w = divide255(w * mask[c]);
+
+		for(int k = 0; k < 3; ++k)
+			D[k] = divide255(Mode::apply(B[k], A[k]) * w + B[k] * (255 - w));
+		if(CN == 4)
+			D[3] = B[3];
+	}
+}
+
+static constexpr int TILE = 256;
+
+/*
+	Float rows are split into planes of TILE pixels, so that each channel runs 4 pixels per SIMD lane.
+	dst = base + (F(base, layer) - base) * w, the same as lerp().
+*/
+template <typename Mode>
+static void blendPlane(float* b, const float* a, const float* w, int count)
+{
+	int i = 0;
+#if CV_SIMD128
+	for(; i <= count - 4; i += 4)
+	{
+		const v_float32x4 A = v_load(a + i), B = v_load(b + i);
+		v_store(b + i, B + (Mode::apply(B, A) - B) * v_load(w + i));
+	}
+#endif
+	for(; i < count; ++i)
+		b[i] = b[i] + (Mode::apply(b[i], a[i]) - b[i]) * w[i];
+}
+
+template <typename Mode, int CN>
+static void blendRow(float* dst, const float* base, const float* layer, const uint8_t* mask, int count, float opacity)
+{
+	CV_DECL_ALIGNED(16) float a[3][TILE], b[3][TILE], w[TILE];
+	for(int c = 0; c < count; c += TILE)
+	{
+		const int length = std::min(TILE, count - c);
+		const float* A = layer + c * CN;
+		const float* B = base + c * CN;
+		float* D = dst + c * CN;
+
+		for(int i = 0; i < length; ++i)
+		{
+			for(int k = 0; k < 3; ++k)
+			{
+				a[k][i] = A[i * CN + k];
+				b[k][i] = B[i * CN + k];
+			}
+
+			w[i] = opacity;
+			if(CN == 4)
+				w[i] *= A[i * CN + 3];
+			if(mask != nullptr)
+				w[i] *= mask[c + i] * (1 / 255.0F);
+		}
+
+		for(int k = 0; k < 3; ++k)
+			blendPlane<Mode>(b[k], a[k], w, length);
+
+		for(int i = 0; i < length; ++i)
+		{
+			for(int k = 0; k < 3; ++k)
+				D[i * CN + k] = b[k][i];
+			if(CN == 4)
+				D[i * CN + 3] = B[i * CN + 3];
+		}
+	}
+}
+
+template <typename Mode, typename T, int CN>
+static void blendImage(cv::Mat& dst, const cv::Mat& base, const cv::Mat& layer, float opacity, const cv::Mat& mask)
+{
+	#pragma omp parallel for
+	for(int r = 0; r < base.rows; ++r)
+	{
+		const uint8_t* mask_row = mask.empty() ? nullptr : mask.ptr<uint8_t>(r);
+		blendRow<Mode, CN>(dst.ptr<T>(r), base.ptr<T>(r), layer.ptr<T>(r), mask_row, base.cols, opacity);
+	}
+}
+
+template <typename Mode>
+static void blendImage(cv::Mat& dst, const cv::Mat& base, const cv::Mat& layer, float opacity, const cv::Mat& mask)
+{
+	switch(base.type())
+	{
+	case CV_8UC3:  blendImage<Mode, uint8_t, 3>(dst, base, layer, opacity, mask);  break;
+	case CV_8UC4:  blendImage<Mode, uint8_t, 4>(dst, base, layer, opacity, mask);  break;
+	case CV_32FC3: blendImage<Mode, float, 3>  (dst, base, layer, opacity, mask);  break;
+	case CV_32FC4: blendImage<Mode, float, 4>  (dst, base, layer, opacity, mask);  break;
+	default:       assert(false);                                                  break;
+	}
+}
+
+/*
+	The non-separable modes convert base and layer to HSL as whole images, swap the channels of the mode,
+	and convert back, then the result is blended onto base as a NORMAL layer with the alpha of layer.
+*/
+static void blendNonSeparable(cv::Mat& dst, const cv::Mat& base, const cv::Mat& layer, BlendMode mode, float opacity, const cv::Mat& mask)
+{
+	cv::Mat hsl_base, hsl_layer;
+	rgb2hsl(base, hsl_base);
+	rgb2hsl(layer, hsl_layer);
+
+	bool take[3] = { false, false, false };  // H, S, L from layer
+	switch(mode)
+	{
+	case BlendMode::HUE:        take[0] = true;                  break;
+	case BlendMode::SATURATION: take[1] = true;                  break;
+	case BlendMode::COLOR:      take[0] = take[1] = true;        break;
+	case BlendMode::LUMINOSITY: take[2] = true;                  break;
+	default:                    assert(false);                   break;
+	}
+
+	const int channels = base.channels();
+	#pragma omp parallel for
+	for(int r = 0; r < base.rows; ++r)
+	{
+		float* base_row = hsl_base.ptr<float>(r);
+		const float* layer_row = hsl_layer.ptr<float>(r);
+		for(int c = 0; c < base.cols * channels; c += channels)
+			for(int k = 0; k < 3; ++k)
+				if(take[k])
+					base_row[c + k] = layer_row[c + k];
+	}
+
+	cv::Mat blended;
+	hsl2rgb(hsl_base, blended, base.depth());
+	if(channels == 4)
+	{
+		const int from_to[] = { 3, 3 };
+		cv::mixChannels(&layer, 1, &blended, 1, from_to, 1);
+	}
+
+	blendImage<BlendNormal>(dst, base, blended, opacity, mask);
+}
+
+void blendLayers(cv::Mat& dst, const cv::Mat& base, const cv::Mat& layer, BlendMode mode,
+		float opacity/* = 1.0F */, const cv::Mat& mask/* = cv::Mat() */)
+{
+	assert(base.type() == CV_8UC3 || base.type() == CV_8UC4 || base.type() == CV_32FC3 || base.type() == CV_32FC4);
+	assert(layer.size() == base.size() && layer.type() == base.type());
+	assert(mask.empty() || (mask.size() == base.size() && mask.type() == CV_8UC1));
+	assert(0.0F <= opacity && opacity <= 1.0F);
+
+	dst.create(base.size(), base.type());
+
+	switch(mode)
+	{
+	case BlendMode::NORMAL:       blendImage<BlendNormal>     (dst, base, layer, opacity, mask);  break;
+	case BlendMode::LIGHTEN:      blendImage<BlendLighten>    (dst, base, layer, opacity, mask);  break;
+	case BlendMode::DARKEN:       blendImage<BlendDarken>     (dst, base, layer, opacity, mask);  break;
+	case BlendMode::MULTIPLY:     blendImage<BlendMultiply>   (dst, base, layer, opacity, mask);  break;
+	case BlendMode::AVERAGE:      blendImage<BlendAverage>    (dst, base, layer, opacity, mask);  break;
+	case BlendMode::ADD:          blendImage<BlendAdd>        (dst, base, layer, opacity, mask);  break;
+	case BlendMode::SUBTRACT:     blendImage<BlendSubtract>   (dst, base, layer, opacity, mask);  break;
+	case BlendMode::DIFFERENCE:   blendImage<BlendDifference> (dst, base, layer, opacity, mask);  break;
+	case BlendMode::NEGATION:     blendImage<BlendNegation>   (dst, base, layer, opacity, mask);  break;
+	case BlendMode::SCREEN:       blendImage<BlendScreen>     (dst, base, layer, opacity, mask);  break;
+	case BlendMode::EXCLUSION:    blendImage<BlendExclusion>  (dst, base, layer, opacity, mask);  break;
+	case BlendMode::OVERLAY:      blendImage<BlendOverlay>    (dst, base, layer, opacity, mask);  break;
+	case BlendMode::SOFT_LIGHT:   blendImage<BlendSoftLight>  (dst, base, layer, opacity, mask);  break;
+	case BlendMode::HARD_LIGHT:   blendImage<BlendHardLight>  (dst, base, layer, opacity, mask);  break;
+	case BlendMode::COLOR_DODGE:  blendImage<BlendColorDodge> (dst, base, layer, opacity, mask);  break;
+	case BlendMode::COLOR_BURN:   blendImage<BlendColorBurn>  (dst, base, layer, opacity, mask);  break;
+	case BlendMode::LINEAR_DODGE: blendImage<BlendLinearDodge>(dst, base, layer, opacity, mask);  break;
+	case BlendMode::LINEAR_BURN:  blendImage<BlendLinearBurn> (dst, base, layer, opacity, mask);  break;
+	case BlendMode::LINEAR_LIGHT: blendImage<BlendLinearLight>(dst, base, layer, opacity, mask);  break;
+	case BlendMode::VIVID_LIGHT:  blendImage<BlendVividLight> (dst, base, layer, opacity, mask);  break;
+	case BlendMode::PIN_LIGHT:    blendImage<BlendPinLight>   (dst, base, layer, opacity, mask);  break;
+	case BlendMode::HARD_MIX:     blendImage<BlendHardMix>    (dst, base, layer, opacity, mask);  break;
+	case BlendMode::REFLECT:      blendImage<BlendReflect>    (dst, base, layer, opacity, mask);  break;
+	case BlendMode::GLOW:         blendImage<BlendGlow>       (dst, base, layer, opacity, mask);  break;
+	case BlendMode::PHOENIX:      blendImage<BlendPhoenix>    (dst, base, layer, opacity, mask);  break;
+	case BlendMode::HUE:
+	case BlendMode::SATURATION:
+	case BlendMode::COLOR:
+	case BlendMode::LUMINOSITY:   blendNonSeparable(dst, base, layer, mode, opacity, mask);       break;
+	default:                      assert(false);                                                  break;
+	}
+}
+
 } /* namespace venus */
@@ -57,6 +57,16 @@ cv::Vec4f mix(const cv::Vec4f& from, const cv::Vec4f& to, float amount);
  */
 uint32_t mix(const uint32_t& from, const uint32_t& to, float amount);
 
+/**
+ * @param[in] x  Value in range [0, 255 * 255].
+ * @return (x + 127) / 255, namely x / 255 rounded, but without division.
+ */
+inline uint8_t divide255(int x)
+{
+	x += 128;
+	return static_cast<uint8_t>((x + (x >> 8)) >> 8);
+}
+
 
 
 // gimp/app/actions/layers-commands.c
@@ -76,7 +86,7 @@ inline uint8_t blendDifference (uint8_t A, uint8_t B)  { return std::abs(A - B);
 inline uint8_t blendNegation   (uint8_t A, uint8_t B)  { return 255 - std::abs(255 - A - B); }
 inline uint8_t blendScreen     (uint8_t A, uint8_t B)  { return 255 - ((255 - A) * (255 - B) + 127) / 255; }
 inline uint8_t blendExclusion  (uint8_t A, uint8_t B)  { return A + B - (2 * A * B + 127)/ 255; }
-inline uint8_t blendOverlay    (uint8_t A, uint8_t B)  { return (uint8_t)((B < 128 ? 2*A*B : (255 - 2*(255 - A)*(255 - B)) + 127)/ 255); }
+inline uint8_t blendOverlay    (uint8_t A, uint8_t B)  { return (uint8_t)((((B < 128) ? 2*A*B : (255*255 - 2*(255 - A)*(255 - B))) + 127)/ 255); }
 inline uint8_t blendSoftLight  (uint8_t A, uint8_t B)  { return (B < 128) ? ((2*((A>>1)+64)) * B + 127)/255 : (255 - (2*(255-((A>>1)+64))*(255-B) + 127)/255); }
 inline uint8_t blendHardLight  (uint8_t A, uint8_t B)  { return blendOverlay(B, A); }
 inline uint8_t blendColorDodge (uint8_t A, uint8_t B)  { return (B == 255) ? 255 : std::min(255, A * 255 / (255 - B)); }
@@ -133,6 +143,61 @@ void blendSaturation(float* target, const float* rgbA, const float* rgbB);
 void blendLuminosity(float* target, const float* rgbA, const float* rgbB);
 void blendColor     (float* target, const float* rgbA, const float* rgbB);
 
+enum class BlendMode
+{
+	NORMAL,
+	LIGHTEN,
+	DARKEN,
+	MULTIPLY,
+	AVERAGE,
+	ADD,
+	SUBTRACT,
+	DIFFERENCE,
+	NEGATION,
+	SCREEN,
+	EXCLUSION,
+	OVERLAY,
+	SOFT_LIGHT,
+	HARD_LIGHT,
+	COLOR_DODGE,
+	COLOR_BURN,
+	LINEAR_DODGE,
+	LINEAR_BURN,
+	LINEAR_LIGHT,
+	VIVID_LIGHT,
+	PIN_LIGHT,
+	HARD_MIX,
+	REFLECT,
+	GLOW,
+	PHOENIX,
+
+	// non-separable modes, in HSL space
+	HUE,         ///< hue of layer, saturation and lightness of base
+	SATURATION,  ///< saturation of layer, hue and lightness of base
+	COLOR,       ///< hue and saturation of layer, lightness of base
+	LUMINOSITY,  ///< lightness of layer, hue and saturation of base
+};
+
+/**
+ * Blend a whole layer onto a base image. Per channel modes compute blendXxx(base, layer), with base first as in
+ * blendAlphaF(), except NORMAL which takes the layer as is. The result is mixed with base by weight
+ * opacity * layer alpha * mask. Each mode is a template instance, so there's no call per pixel, rows run in parallel
+ * with SIMD kernels, and the non-separable modes convert both images to HSL in batch.
+ *
+ * <code>
+ * blendLayers(image, image, rouge, BlendMode::MULTIPLY, 0.6F, lip_mask);
+ * </code>
+ *
+ * @param[out] dst      Output image, can be the same as @p base or @p layer.
+ * @param[in]  base     CV_8UC3, CV_8UC4, CV_32FC3 or CV_32FC4, alpha channel is kept in @p dst.
+ * @param[in]  layer    Image of the same size and type as @p base, its alpha channel weights the blending.
+ * @param[in]  mode     Blend mode.
+ * @param[in]  opacity  Range [0, 1], 0 keeps @p base, 1 applies the blending fully.
+ * @param[in]  mask     Optional CV_8UC1 weights of the same size, 0 keeps @p base.
+ */
+void blendLayers(cv::Mat& dst, const cv::Mat& base, const cv::Mat& layer, BlendMode mode,
+		float opacity = 1.0F, const cv::Mat& mask = cv::Mat());
+
 
 
 
@@ -1,4 +1,8 @@
 #include <stdint.h>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <vector>
 
 #include <opencv2/imgproc.hpp>
 
@@ -21,6 +25,36 @@ void gaussianBlur(cv::Mat& dst, const cv::Mat& src, float radius)
 	cv::GaussianBlur(src, dst, Size(width, width), std_dev, std_dev, cv::BorderTypes::BORDER_CONSTANT);
 }
 
+/*
+ * Horizontal pass of the selective blur. @p src points at the first pixel of a row that is padded
+ * by @p R sentinel values on both sides, so the taps need no bounds test: a sentinel is never
+ * within tolerance of a real pixel and drops out just like the out-of-image taps used to do.
+ * The loop is tap-outer and pixel-inner so that the compiler can vectorize it.
+ */
+static void blurSelectiveRow(float* dst, float* weight_sum, const float* src, int width,
+		const float* kernel, int R, float tolerance)
+{
+	std::fill(dst, dst + width, 0.0F);
+	std::fill(weight_sum, weight_sum + width, 0.0F);
+
+	for(int k = -R; k <= R; ++k)
+	{
+		const float weight = kernel[std::abs(k)];
+		const float* around = src + k;
+		for(int i = 0; i < width; ++i)
+		{
+			// a single select, so that plain SSE2/NEON can vectorize it too
+			const float w = std::abs(around[i] - src[i]) <= tolerance ? weight : 0.0F;
+			dst[i] += w * around[i];
+			weight_sum[i] += w;
+		}
+	}
+
+	// weight_sum can not be ZERO, since center point is counted.
+	for(int i = 0; i < width; ++i)
+		dst[i] /= weight_sum[i];
+}
+
 void gaussianBlurSelective(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float tolerance)
 {
 	assert(dst.data != src.data);
@@ -30,207 +64,266 @@ void gaussianBlurSelective(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask
 		src.copyTo(dst);
 		return;
 	}
-	
-	int width = (R << 1) + 1;
-#if 0
-	std::vector<cv::Mat> channels;
-	cv::split(src, channels);
 
-	const int N = src.channels() < 4 ? src.channels() : 3;
-	#pragma omp parallel for
-//	for(cv::Mat& channel: src_channels)  // It seems that OpenMP doesn't support range based for in C++11.
-	// error C3016: 'i' : index variable in OpenMP 'for' statement must have signed integral type
-	// The Microsoft C/C++ Compiler 12.0 integrated with Visual Studio 2013 still only support OpenMP 2.5 and doesn't allow unsigned int for the loop counter.
-	// GCC support OpenMP 3.0 since its version 4.4 and allows unsigned int for the loop counter.
-	for(int i = 0; i < N; ++i)
+	const int channel = src.channels();
+	assert(channel >= 3);  // currently only support color image
+	assert(src.depth() == CV_8U || src.depth() == CV_32F);
+	assert(mask.type() == CV_8UC1 && mask.size() == src.size());
+
+	/*
+	 * The old brute-force kernel visited the full (2R+1)^2 window of every masked pixel. Here the
+	 * filter runs as a horizontal pass followed by a vertical pass, each with the same Gaussian and
+	 * the same per channel tolerance test against the center value, so a pixel costs 2*(2R+1) taps.
+	 * This is the usual separable approximation of a bilateral filter; flat areas and straight edges
+	 * come out the same, only thin diagonal details are smoothed slightly differently.
+	 *
+	 * The kernel exp(-0.5 * d^2 / radius) has a standard deviation of sqrt(radius), so the taps
+	 * beyond 3 sigma carry less than 1% weight and are dropped.
+	 */
+	const float sigma = std::sqrt(radius);
+	R = std::min(R, static_cast<int>(std::ceil(3 * sigma)));
+	std::vector<float> kernel(R + 1);
+	for(int i = 0; i <= R; ++i)
+		kernel[i] = std::exp(-0.5F * i * i / radius);
+
+	// rows which have any masked pixel, and the row range the horizontal pass must cover
+	std::vector<uint8_t> row_masked(src.rows);
+	int top = src.rows, bottom = -1;
+	for(int r = 0; r < src.rows; ++r)
 	{
-		cv::Mat& channel = channels[i];
-		cv::Mat tmp;  // Bilateral filter does not work inplace.
-		cv::bilateralFilter(channel, tmp, width, width*2.0, width/2.0);
-		channel = tmp;
+		const uint8_t* mask_row = mask.ptr<uint8_t>(r);
+		row_masked[r] = std::any_of(mask_row, mask_row + src.cols, [](uint8_t m) { return m != 0; });
+		if(row_masked[r])
+		{
+			top = std::min(top, r);
+			bottom = r;
+		}
 	}
 
-	cv::merge(channels.data(), channels.size(), dst);
-#else
-	Mat _src;
-	src.convertTo(_src, CV_32F);
-//	dst.create(src.rows, src.cols, CV_32F);
-	_src.copyTo(dst);
-	
-	assert(mask.type() == CV_8UC1);
-	const uint8_t* const mask_data = mask.ptr<uint8_t>();
-//	Mat _mask = normalize(mask);
-//	const float* const mask_data = mask.ptr<float>();
-
-	// initialize Gaussian kernel
-	float sum = 0.0F;
-	Mat kernel(width, width, CV_32FC1);
-//	kernel.at<float>(R, R) = 1.0F;
-	for(int r = 0; r <= R; ++r)
-	for(int c = 0; c <= R; ++c)
+	src.copyTo(dst);
+	if(bottom < 0)
+		return;
+
+	const int row_begin = std::max(top - R, 0), row_end = std::min(bottom + R + 1, src.rows);
+	const float SENTINEL = std::numeric_limits<float>::max();
+	tolerance = std::min(tolerance, SENTINEL / 2);  // keep sentinels out even for an infinite tolerance
+
+	Mat plane, padded;
+	// horizontal pass result, with R sentinel rows above and below for the vertical pass
+	Mat horizontal(src.rows + 2 * R, src.cols, CV_32FC1, Scalar(SENTINEL));
+	for(int m = 0; m < 3; ++m)
 	{
-		float v = std::exp(-0.5F * (r*r + c*c) / radius);
-		kernel.at<float>(R - r, R - c) = v;
-		kernel.at<float>(R - r, R + c) = v;
-		kernel.at<float>(R + r, R - c) = v;
-		kernel.at<float>(R + r, R + c) = v;
-		sum += v * 4;
-	}
-	printf("kernel sum: %f\n", sum);
-	//TODO scale all the values???
+		cv::extractChannel(src, plane, m);
+		plane.convertTo(plane, CV_32F);
+		cv::copyMakeBorder(plane, padded, 0, 0, R, R, cv::BORDER_CONSTANT, Scalar(SENTINEL));
 
-	const int channel = src.channels();
-	assert(channel >= 3);  // currently only support color image
-	const int length = src.rows * src.cols;
+		// scratch rows are allocated once per thread, not once per row
+		#pragma omp parallel
+		{
+			std::vector<float> weight_sum(src.cols);
 
-	assert(_src.depth() == CV_32F && dst.depth() == CV_32F);
-	const float* const _src_data = _src.ptr<float>();
-	float* const dst_data = dst.ptr<float>();
+			#pragma omp for
+			for(int r = row_begin; r < row_end; ++r)
+				blurSelectiveRow(horizontal.ptr<float>(r + R), weight_sum.data(), padded.ptr<float>(r) + R,
+						src.cols, kernel.data(), R, tolerance);
+		}
 
-	#pragma omp parallel for
-	for(int k = 0; k < length; ++k)
-	{
-		if(mask_data[k] == 0)
-			continue;
-
-		int r = k / src.cols, c = k % src.cols;
-		int offset = k * channel;
-		const float* center = _src_data + offset;
-		
-		Vec3f accumulated(0, 0, 0), count(0, 0, 0);
-		for(int y = -R; y <= R; ++y)
+		#pragma omp parallel
 		{
-			int j = r + y;
-			if(j < 0 || j >= src.rows)
-				continue;
+			std::vector<float> accumulated(src.cols), weight_sum(src.cols);
 
-			for(int x = -R; x <= R; ++x)
+			#pragma omp for
+			for(int r = top; r <= bottom; ++r)
 			{
-				int i = c + x;
-				if(i < 0 || i >= src.cols)
+				if(!row_masked[r])
 					continue;
-				
-				float weight = kernel.at<float>(R + y, R + x);
-				const float* around = _src_data + (j * src.cols + i) * channel;
-#if 1
-				// individual channel
-				for(int m = 0; m < 3; ++m)
+
+				std::fill(accumulated.begin(), accumulated.end(), 0.0F);
+				std::fill(weight_sum.begin(), weight_sum.end(), 0.0F);
+				const float* center = horizontal.ptr<float>(r + R);
+				for(int k = -R; k <= R; ++k)
 				{
-					float diff = std::abs(center[m] - around[m]);
-					if(diff > tolerance)
-						continue;
-					
-					accumulated[m] += weight * around[m];
-					count[m] += weight;
+					const float weight = kernel[std::abs(k)];
+					const float* around = horizontal.ptr<float>(r + R + k);
+					for(int c = 0; c < src.cols; ++c)
+					{
+						const float w = std::abs(around[c] - center[c]) <= tolerance ? weight : 0.0F;
+						accumulated[c] += w * around[c];
+						weight_sum[c] += w;
+					}
 				}
-#else
-				// RGB weighted measure method
-				float diff = (std::abs(center[0] - around[0]) +
-					std::abs(center[1] - around[1]) + std::abs(center[2] - around[2]))/3;
-				if(diff > tolerance)
-					continue;
 
-				for(int m = 0; m < 3; ++m)
+				const uint8_t* mask_row = mask.ptr<uint8_t>(r);
+				if(src.depth() == CV_8U)
 				{
-					accumulated[m] += weight * around[m];
-					count[m] += weight;
+					uint8_t* dst_row = dst.ptr<uint8_t>(r);
+					for(int c = 0; c < src.cols; ++c)
+						if(mask_row[c] != 0)
+							dst_row[c * channel + m] = saturate_cast<uint8_t>(accumulated[c] / weight_sum[c]);
+				}
+				else
+				{
+					float* dst_row = dst.ptr<float>(r);
+					for(int c = 0; c < src.cols; ++c)
+						if(mask_row[c] != 0)
+							dst_row[c * channel + m] = accumulated[c] / weight_sum[c];
 				}
-#endif
 			}
 		}
-
-		// weight_sum can not be ZERO, since center point is counted.
-		dst_data[offset + 0] = accumulated[0] / count[0];
-		dst_data[offset + 1] = accumulated[1] / count[1];
-		dst_data[offset + 2] = accumulated[2] / count[2];
 	}
-
-	if(src.depth() == CV_8U)
-		dst.convertTo(dst, CV_8U);
-#endif
 }
 
 
-// Radius can be tuned, but dont't make the radius too large, since it's time-consuming.
-static constexpr float BLUR_RADIUS = 8;
+// Sum type of the integral image. 8-bit sums are unsigned and may wrap around on large images, the
+// difference of four corners is still exact as long as a single box sums to less than 2^32.
+template <typename T> struct IntegralType;
+template <> struct IntegralType<uint8_t> { using type = uint32_t; };
+template <> struct IntegralType<float>   { using type = double;   };
 
-static cv::Vec4b getBlurredValue(const cv::Mat& image, const cv::Point2i& point, const float& blur_radius)
+/*
+ * Build the integral image of a 4 channel image into @p sum, which is (rows + 1) x (cols + 1) x 4
+ * with a leading row and column of zeros. Row prefix sums run in parallel over rows, then column
+ * prefix sums run in parallel over strips of columns.
+ */
+template <typename T, typename S>
+static void integral4(std::vector<S>& sum, const cv::Mat& src)
 {
-	assert(image.type() == CV_8UC4 && blur_radius >= 1.0F);
-	int count = 0;
-	Vec4d sum(0, 0, 0, 0);
-
-	const int R = static_cast<int>(std::ceil(blur_radius));
-	const int RR= static_cast<int>(blur_radius * blur_radius);
+	const int stride = (src.cols + 1) * 4;
+	sum.resize(static_cast<size_t>(src.rows + 1) * stride);
+	std::fill(sum.begin(), sum.begin() + stride, S(0));
 
-	for(int dy = -R; dy < R; ++dy)
-	for(int dx = -R; dx < R; ++dx)
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
 	{
-		if(dx*dx + dy*dy > RR)
-			continue;
-
-		int c = point.x + dx, r = point.y + dy;
-		if(c < 0 || c >= image.cols || r < 0 || r >= image.rows)
-			continue;
-				
-		const Vec4b& color = image.at<Vec4b>(r, c);
-		sum += static_cast<Vec4d>(color);
-		++count;
+		const T* src_row = src.ptr<T>(r);
+		S* sum_row = sum.data() + static_cast<size_t>(r + 1) * stride;
+		sum_row[0] = sum_row[1] = sum_row[2] = sum_row[3] = S(0);
+		for(int i = 0; i < src.cols * 4; ++i)
+			sum_row[i + 4] = sum_row[i] + src_row[i];
 	}
 
-	Vec4d avg = sum / count;
-	return Vec4b(
-		saturate_cast<uint8_t>(avg[0]),
-		saturate_cast<uint8_t>(avg[1]), 
-		saturate_cast<uint8_t>(avg[2]),
-		saturate_cast<uint8_t>(avg[3]));
+	const int STRIP = 256;
+	#pragma omp parallel for
+	for(int x = 0; x < stride; x += STRIP)
+	{
+		const int end = std::min(x + STRIP, stride);
+		for(int r = 2; r <= src.rows; ++r)
+		{
+			S* sum_row = sum.data() + static_cast<size_t>(r) * stride;
+			const S* above = sum_row - stride;
+			for(int i = x; i < end; ++i)
+				sum_row[i] += above[i];
+		}
+	}
 }
 
-void radialBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& center, float inner_radius, float outer_radius)
+/*
+ * Blur each pixel with its own radius. The circular window of @p radius is replaced by a square of
+ * the same area, and a fractional size blends the two nearest integer boxes, so that the radius can
+ * vary smoothly. Each box average is four lookups in the integral image, whatever the radius.
+ * The window is clipped to the image, and averaged over the pixels inside, like before.
+ *
+ * @param[out] dst     The output image, which is a copy of @p src where radius <= 1.
+ * @param[in]  src     CV_8UC4 or CV_32FC4 image.
+ * @param[in]  radius  float radius(const cv::Point2f& point), blur radius of the pixel, 1 means no blurring.
+ */
+template <typename T, typename Radius>
+static void blurVariable(cv::Mat& dst, const cv::Mat& src, float max_radius, Radius radius)
 {
-	assert(0 < inner_radius && inner_radius < outer_radius);
-	assert(src.data != dst.data);
+	using S = typename IntegralType<T>::type;
+	assert(src.channels() == 4);
+
+	(void)max_radius;  // only used by DEBUG_BLUR
 	src.copyTo(dst);
+	std::vector<S> sum;
+	integral4<T, S>(sum, src);
+
+	const int stride = (src.cols + 1) * 4;
+	const float HALF_SQRT_PI = 0.886226925F;  // a square of side sqrt(pi)*r has the area of a circle of radius r
+
+	// average of the box [r - h, r + h] x [c - h, c + h] clipped to the image
+	auto average = [&](Vec4d& color, int r, int c, int h)
+	{
+		const int top  = std::max(r - h, 0), bottom = std::min(r + h + 1, src.rows);
+		const int left = std::max(c - h, 0), right  = std::min(c + h + 1, src.cols);
+		const S* S0 = sum.data() + static_cast<size_t>(top) * stride;
+		const S* S1 = sum.data() + static_cast<size_t>(bottom) * stride;
+		const double area = static_cast<double>((bottom - top) * (right - left));
+		for(int m = 0; m < 4; ++m)
+		{
+			S box = S1[right * 4 + m] - S0[right * 4 + m] - S1[left * 4 + m] + S0[left * 4 + m];
+			color[m] = box / area;
+		}
+	};
 
 	#pragma omp parallel for
 	for(int r = 0; r < src.rows; ++r)
-	for(int c = 0; c < src.cols; ++c)
 	{
-		Point2f point = Point2i(c, r);
-		float distance = venus::distance(point, center);
-
-#if DEBUG_BLUR
-		// color values are the weight of blurring radius, so white means full blurring, black means no blurring.
-		if(distance >= outer_radius)
-			dst.at<Vec4b>(r, c) = Vec4b(255, 255, 255, 255);
-		else if(distance >= inner_radius)
+		T* dst_row = dst.ptr<T>(r);
+		for(int c = 0; c < src.cols; ++c)
 		{
-			float t = (distance - inner_radius) / (outer_radius - inner_radius);
-			uint8_t x = t * 253 + 1;  // map to interval [1, 254]
-			dst.at<Vec4b>(r, c) = Vec4b(x, x, x, 255);
-		}
-		else  // since blur radius == 1 means no blurring.
-			dst.at<Vec4b>(r, c) = Vec4b(0, 0, 0, 255);
+			const float blur_radius = radius(Point2f(static_cast<float>(c), static_cast<float>(r)));
+			T* target = dst_row + c * 4;
+#if DEBUG_BLUR
+			// color values are the weight of blurring radius, so white means full blurring, black means no blurring.
+			double x = (venus::clamp(blur_radius, 1.0F, max_radius) - 1.0F) / (max_radius - 1.0F);
+			const double full = std::is_integral<T>::value ? 255 : 1;
+			target[0] = target[1] = target[2] = saturate_cast<T>(x * full);
+			target[3] = saturate_cast<T>(full);
 #else
+			const float h = (blur_radius - 1.0F) * HALF_SQRT_PI;
+			if(h <= 0.0F)
+				continue;
+
+			const int h0 = static_cast<int>(h);
+			const double t = h - h0;
+			Vec4d color0, color1;
+			average(color0, r, c, h0);
+			average(color1, r, c, h0 + 1);
+			for(int m = 0; m < 4; ++m)
+				target[m] = saturate_cast<T>(color0[m] + (color1[m] - color0[m]) * t);
+#endif
+		}
+	}
+}
+
+template <typename Radius>
+static void blurVariable(cv::Mat& dst, const cv::Mat& src, float max_radius, Radius radius)
+{
+	switch(src.type())
+	{
+	case CV_8UC4:  blurVariable<uint8_t>(dst, src, max_radius, radius); break;
+	case CV_32FC4: blurVariable<float>  (dst, src, max_radius, radius); break;
+	default: assert(false); break;  // only 4 channel images are supported
+	}
+}
+
+void radialBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& center, float inner_radius, float outer_radius, float blur_radius/* = 8.0F */)
+{
+	assert(0 < inner_radius && inner_radius < outer_radius);
+	assert(src.data != dst.data);
+	assert(blur_radius >= 1.0F);
+
+	blurVariable(dst, src, blur_radius, [&](const Point2f& point)
+	{
+		float distance = venus::distance(point, center);
 		if(distance >= outer_radius)
-			dst.at<Vec4b>(r, c) = getBlurredValue(src, point, BLUR_RADIUS);
+			return blur_radius;
 		else if(distance >= inner_radius)
 		{
 			float t = (outer_radius - distance) / (outer_radius - inner_radius);
-			float blur_radius = t * (BLUR_RADIUS - 1.0F) + 1.0F;
-			dst.at<Vec4b>(r, c) = getBlurredValue(src, point, blur_radius);
+			return t * (blur_radius - 1.0F) + 1.0F;
 		}
-//		else  // distance < inner_radius
-//			dst.at<Vec4b>(r, c) = src.at<Vec4b>(r, c);
-#endif
-	}
+		else  // since blur radius == 1 means no blurring.
+			return 1.0F;
+	});
 }
 
-void bilinearBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& point0, cv::Point2f& point1, float band_width)
+void bilinearBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& point0, cv::Point2f& point1, float band_width, float blur_radius/* = 8.0F */)
 {
 	assert(band_width > 0);
 	assert(src.data != dst.data);
-	src.copyTo(dst);
+	assert(blur_radius >= 1.0F);
 
 	Point2f center = (point1 + point0) / 2.0F;
 	Vec2f v01 = point1 - point0;
@@ -244,27 +337,16 @@ void bilinearBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& point0, cv::Poi
 	float inner_radius = half_length - band_width/2;
 	float outer_radius = half_length + band_width/2;
 
-	#pragma omp parallel for
-	for(int r = 0; r < src.rows; ++r)
-	for(int c = 0; c < src.cols; ++c)
+	blurVariable(dst, src, blur_radius, [&](const Point2f& point)
 	{
-		Point2f point = Point2i(c, r);
 		float distance = venus::distance(point, line);
-#if DEBUG_BLUR
-		// color values are the weight of blurring radius, so white means full blurring, black means no blurring.
-		distance = venus::clamp(distance, inner_radius, outer_radius);
-		float t = (distance - inner_radius) / (outer_radius - inner_radius);
-		uint8_t x = t * 255;
-		dst.at<Vec4b>(r, c) = Vec4b(x, x, x, 255);
-#else
 		if(distance >= outer_radius)
-			dst.at<Vec4b>(r, c) = getBlurredValue(src, point, BLUR_RADIUS);
+			return blur_radius;
 		else if(distance >= inner_radius)
-			dst.at<Vec4b>(r, c) = getBlurredValue(src, point, distance / outer_radius * BLUR_RADIUS);
+			return std::max(distance / outer_radius * blur_radius, 1.0F);
 		else  // distance < inner_radius
-			dst.at<Vec4b>(r, c) = src.at<Vec4b>(r, c);
-#endif
-	}
+			return 1.0F;
+	});
 }
 
 } /* namespace venus */
\ No newline at end of file
@@ -20,19 +20,44 @@ void gaussianBlur(cv::Mat& dst, const cv::Mat& src, float radius);
 
 /**
  * "Selective Gaussian blur" blurs neighboring pixels, but only in low-contrast areas. It can't take in-place.
- * Large filters (radius > 5) are very slow, so it is recommended to use radius = 3 for real-time applications.
- * And a mask can be used to shorten processing time.
+ * It runs as a horizontal and a vertical pass, so the cost grows linearly with radius, and only rows with masked
+ * pixels are processed, so a tight mask shortens processing time. Only the first 3 channels are blurred.
  *
  * @param[out] dst        The output image.
- * @param[in]  src        The input image.
- * @param[in]  mask       CV_8UC1 format
+ * @param[in]  src        The input image, CV_8UC3/CV_8UC4 or CV_32FC3/CV_32FC4.
+ * @param[in]  mask       CV_8UC1 format, pixels outside of it are copied from @p src.
  * @param[in]  radius     Gaussian kernel radius, or bluring radius.
  * @param[in]  tolerance  Range [0, 255], pixels within tolerance will be handled.
  */
 void gaussianBlurSelective(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float tolerance);
 
-void radialBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& center, float inner_radius, float outer_radius);
-void bilinearBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& point0, cv::Point2f& point1, float band_width);
+/**
+ * Blur the image outside a circle, the blur radius increases from 1 (no blurring) at @p inner_radius to
+ * @p blur_radius at @p outer_radius. Every pixel costs the same whatever the blur radius, since the blurring
+ * is done with box averages from an integral image.
+ *
+ * @param[out] dst          The output image, it can't be @p src.
+ * @param[in]  src          The input image, CV_8UC4 or CV_32FC4.
+ * @param[in]  center       Center of the focus circle.
+ * @param[in]  inner_radius Pixels within this distance from @p center are kept unchanged.
+ * @param[in]  outer_radius Pixels beyond this distance from @p center are blurred with @p blur_radius.
+ * @param[in]  blur_radius  The largest blur radius, at least 1.
+ */
+void radialBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& center, float inner_radius, float outer_radius, float blur_radius = 8.0F);
+
+/**
+ * Tilt-shift blur, the focus band is centered on the perpendicular bisector of @p point0 and @p point1,
+ * and the blur radius increases with the distance from it, up to @p blur_radius. Like radialBlur(), the
+ * cost doesn't depend on the blur radius.
+ *
+ * @param[out] dst          The output image, it can't be @p src.
+ * @param[in]  src          The input image, CV_8UC4 or CV_32FC4.
+ * @param[in]  point0       The first end point.
+ * @param[in]  point1       The second end point.
+ * @param[in]  band_width   Width of the transition band.
+ * @param[in]  blur_radius  The largest blur radius, at least 1.
+ */
+void bilinearBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& point0, cv::Point2f& point1, float band_width, float blur_radius = 8.0F);
 
 
 
@@ -2,10 +2,15 @@
 #include "venus/scalar.h"
 #include "venus/compiler.h"
 
+#include <assert.h>
 #include <algorithm>
 
+#include <opencv2/core/hal/intrin.hpp>
+
 static constexpr float HSL_UNDEFINED = -1.0F;
 
+using namespace cv;
+
 namespace venus {
 
 void rgb2hsv(const float* rgb, float* hsv)
@@ -238,5 +243,248 @@ void color2alpha(const float* color, const float* src, float* dst)
 	dst[3] *= alpha[3];
 }
 
+/*
+	Image conversions. Each row is processed in tiles of TILE pixels: a tile is loaded into planar float buffers, which
+	deals with 8-bit scaling and the channel order, converted 4 pixels a time by SIMD code without branches, where both
+	sides of every branch of the per pixel functions are computed and then selected, and stored back. The remaining
+	pixels of a tile go through the per pixel functions. A tile stays in L1 cache, and it's loaded completely before
+	being stored, which makes the conversions work in place.
+
+	The SIMD code does the same arithmetic as the per pixel functions, so both give the same results, except that
+	OpenCV's division on ARMv7 NEON is a refined reciprocal, which can be off by a rounding.
+*/
+static constexpr int TILE = 256;
+
+#if USE_BGRA_LAYOUT
+static const int RGB_ORDER[3] = { 2, 1, 0 };
+#else
+static const int RGB_ORDER[3] = { 0, 1, 2 };
+#endif
+static const int PLANE_ORDER[3] = { 0, 1, 2 };
+
+static inline float load(uint8_t x) { return x * (1 / 255.0F); }
+static inline float load(float x)   { return x; }
+
+static inline void store(uint8_t& y, float x) { y = static_cast<uint8_t>(std::min(std::max(x, 0.0F), 1.0F) * 255.0F + 0.5F); }
+static inline void store(float& y, float x)   { y = x; }
+
+static inline void convertPixel(float tile[][TILE], int i, void (*convert)(const float*, float*))
+{
+	const float src[3] = { tile[0][i], tile[1][i], tile[2][i] };
+	float dst[3];
+	convert(src, dst);
+	for(int k = 0; k < 3; ++k)
+		tile[k][i] = dst[k];
+}
+
+static void rgb2hsvTile(float tile[][TILE], int count)
+{
+	int i = 0;
+#if CV_SIMD128
+	const v_float32x4 zero = v_setzero_f32(), eps = v_setall_f32(0.0001F);
+	const v_float32x4 two = v_setall_f32(2.0F), four = v_setall_f32(4.0F), six = v_setall_f32(6.0F);
+	for(; i <= count - 4; i += 4)
+	{
+		const v_float32x4 r = v_load(tile[0] + i), g = v_load(tile[1] + i), b = v_load(tile[2] + i);
+		const v_float32x4 max = v_max(v_max(r, g), b);
+		const v_float32x4 min = v_min(v_min(r, g), b);
+		const v_float32x4 delta = max - min;
+
+		const v_float32x4 r_max = r == max, g_max = g == max;
+		const v_float32x4 base = v_select(r_max, zero, v_select(g_max, two, four));
+		const v_float32x4 diff = v_select(r_max, g - b, v_select(g_max, b - r, r - g));
+		v_float32x4 h = base + diff / v_max(delta, eps);
+		h = v_select(h < zero, h + six, h) / six;
+
+		const v_float32x4 chromatic = delta > eps;
+		v_store(tile[0] + i, v_select(chromatic, h, zero));
+		v_store(tile[1] + i, v_select(chromatic, delta / v_max(max, eps), zero));
+		v_store(tile[2] + i, max);
+	}
+#endif
+	for(; i < count; ++i)
+		convertPixel(tile, i, rgb2hsv);
+}
+
+static void hsv2rgbTile(float tile[][TILE], int count)
+{
+	int i = 0;
+#if CV_SIMD128
+	const v_float32x4 zero = v_setzero_f32(), one = v_setall_f32(1.0F), five = v_setall_f32(5.0F), six = v_setall_f32(6.0F);
+	for(; i <= count - 4; i += 4)
+	{
+		const v_float32x4 h = v_load(tile[0] + i), s = v_load(tile[1] + i), v = v_load(tile[2] + i);
+		const v_float32x4 hue = v_select(h == one, zero, h) * six;
+
+		// s = 0 needs no special case, then w = q = t = v.
+		const v_int32x4 k = v_trunc(v_min(v_max(hue, zero), five));
+		const v_float32x4 f = hue - v_cvt_f32(k);
+		const v_float32x4 w = v * (one - s);
+		const v_float32x4 q = v * (one - (s * f));
+		const v_float32x4 t = v * (one - (s * (one - f)));
+
+		v_float32x4 sector[6];
+		for(int j = 0; j < 6; ++j)
+			sector[j] = v_reinterpret_as_f32(k == v_setall_s32(j));
+
+		v_store(tile[0] + i, v_select(sector[0] | sector[5], v, v_select(sector[1], q, v_select(sector[4], t, w))));
+		v_store(tile[1] + i, v_select(sector[1] | sector[2], v, v_select(sector[0], t, v_select(sector[3], q, w))));
+		v_store(tile[2] + i, v_select(sector[3] | sector[4], v, v_select(sector[2], t, v_select(sector[5], q, w))));
+	}
+#endif
+	for(; i < count; ++i)
+		convertPixel(tile, i, hsv2rgb);
+}
+
+static void rgb2hslTile(float tile[][TILE], int count)
+{
+	int i = 0;
+#if CV_SIMD128
+	const v_float32x4 zero = v_setzero_f32(), half = v_setall_f32(0.5F), one = v_setall_f32(1.0F);
+	const v_float32x4 two = v_setall_f32(2.0F), four = v_setall_f32(4.0F), six = v_setall_f32(6.0F);
+	const v_float32x4 undefined = v_setall_f32(HSL_UNDEFINED);
+	for(; i <= count - 4; i += 4)
+	{
+		const v_float32x4 r = v_load(tile[0] + i), g = v_load(tile[1] + i), b = v_load(tile[2] + i);
+		const v_float32x4 max = v_max(v_max(r, g), b);
+		const v_float32x4 min = v_min(v_min(r, g), b);
+		const v_float32x4 delta = max - min;
+		const v_float32x4 l = (max + min) / two;
+
+		const v_float32x4 denominator = v_select(l <= half, max + min, two - max - min);
+		const v_float32x4 s = delta / v_select(denominator == zero, one, denominator);
+
+		const v_float32x4 r_max = r == max, g_max = g == max;
+		const v_float32x4 base = v_select(r_max, zero, v_select(g_max, two, four));
+		const v_float32x4 diff = v_select(r_max, g - b, v_select(g_max, b - r, r - g));
+		v_float32x4 h = (base + diff / v_select(delta == zero, one, delta)) / six;
+		h = v_select(h < zero, h + one, h);
+
+		const v_float32x4 chromatic = max != min;
+		v_store(tile[0] + i, v_select(chromatic, h, undefined));
+		v_store(tile[1] + i, v_select(chromatic, s, zero));
+		v_store(tile[2] + i, l);
+	}
+#endif
+	for(; i < count; ++i)
+		convertPixel(tile, i, rgb2hsl);
+}
+
+#if CV_SIMD128
+static inline v_float32x4 hsl_value(const v_float32x4& n1, const v_float32x4& n2, v_float32x4 hue)
+{
+	const v_float32x4 zero = v_setzero_f32(), one = v_setall_f32(1.0F);
+	const v_float32x4 three = v_setall_f32(3.0F), four = v_setall_f32(4.0F), six = v_setall_f32(6.0F);
+
+	hue = v_select(hue > six, hue - six, v_select(hue < zero, hue + six, hue));
+	return v_select(hue < one, n1 + (n2 - n1) * hue,
+			v_select(hue < three, n2,
+			v_select(hue < four, n1 + (n2 - n1) * (four - hue), n1)));
+}
+#endif
+
+static void hsl2rgbTile(float tile[][TILE], int count)
+{
+	int i = 0;
+#if CV_SIMD128
+	const v_float32x4 half = v_setall_f32(0.5F), one = v_setall_f32(1.0F), two = v_setall_f32(2.0F), six = v_setall_f32(6.0F);
+	for(; i <= count - 4; i += 4)
+	{
+		const v_float32x4 h = v_load(tile[0] + i), s = v_load(tile[1] + i), l = v_load(tile[2] + i);
+
+		// s = 0 needs no special case, then m1 = m2 = l.
+		const v_float32x4 m2 = v_select(l <= half, l * (one + s), l + s - l * s);
+		const v_float32x4 m1 = two * l - m2;
+
+		const v_float32x4 hue = h * six;
+		v_store(tile[0] + i, hsl_value(m1, m2, hue + two));
+		v_store(tile[1] + i, hsl_value(m1, m2, hue));
+		v_store(tile[2] + i, hsl_value(m1, m2, hue - two));
+	}
+#endif
+	for(; i < count; ++i)
+		convertPixel(tile, i, hsl2rgb);
+}
+
+template <typename S, typename D>
+static void convertImage(const cv::Mat& src, cv::Mat& dst, const int src_order[3], const int dst_order[3],
+		void (*convert)(float[][TILE], int))
+{
+	const int channels = src.channels();
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+	{
+		const S* src_row = src.ptr<S>(r);
+		D* dst_row = dst.ptr<D>(r);
+		CV_DECL_ALIGNED(16) float tile[4][TILE];
+
+		for(int c = 0; c < src.cols; c += TILE)
+		{
+			const int count = std::min(TILE, src.cols - c);
+			const S* src_data = src_row + c * channels;
+			D* dst_data = dst_row + c * channels;
+
+			for(int i = 0; i < count; ++i)
+			for(int k = 0; k < channels; ++k)
+				tile[k][i] = load(src_data[i * channels + (k < 3 ? src_order[k] : k)]);
+
+			convert(tile, count);
+
+			for(int i = 0; i < count; ++i)
+			for(int k = 0; k < channels; ++k)
+				store(dst_data[i * channels + (k < 3 ? dst_order[k] : k)], tile[k][i]);
+		}
+	}
+}
+
+static void convertImage(const cv::Mat& src, cv::Mat& dst, int depth, const int src_order[3], const int dst_order[3],
+		void (*convert)(float[][TILE], int))
+{
+	const int channels = src.channels();
+	assert(channels == 3 || channels == 4);
+	assert(src.depth() == CV_8U || src.depth() == CV_32F);
+	assert(depth == CV_8U || depth == CV_32F);
+
+	// keeps the source alive if dst is the same Mat and gets reallocated for another depth
+	const cv::Mat source = src;
+	dst.create(source.size(), CV_MAKETYPE(depth, channels));
+
+	if(source.depth() == CV_8U)
+	{
+		if(depth == CV_8U)
+			convertImage<uint8_t, uint8_t>(source, dst, src_order, dst_order, convert);
+		else
+			convertImage<uint8_t, float>(source, dst, src_order, dst_order, convert);
+	}
+	else
+	{
+		if(depth == CV_8U)
+			convertImage<float, uint8_t>(source, dst, src_order, dst_order, convert);
+		else
+			convertImage<float, float>(source, dst, src_order, dst_order, convert);
+	}
+}
+
+void rgb2hsv(const cv::Mat& rgb, cv::Mat& hsv)
+{
+	convertImage(rgb, hsv, CV_32F, RGB_ORDER, PLANE_ORDER, rgb2hsvTile);
+}
+
+void hsv2rgb(const cv::Mat& hsv, cv::Mat& rgb, int depth/* = CV_32F */)
+{
+	assert(hsv.depth() == CV_32F);
+	convertImage(hsv, rgb, depth, PLANE_ORDER, RGB_ORDER, hsv2rgbTile);
+}
+
+void rgb2hsl(const cv::Mat& rgb, cv::Mat& hsl)
+{
+	convertImage(rgb, hsl, CV_32F, RGB_ORDER, PLANE_ORDER, rgb2hslTile);
+}
+
+void hsl2rgb(const cv::Mat& hsl, cv::Mat& rgb, int depth/* = CV_32F */)
+{
+	assert(hsl.depth() == CV_32F);
+	convertImage(hsl, rgb, depth, PLANE_ORDER, RGB_ORDER, hsl2rgbTile);
+}
 
-} /* namespace venus */
\ No newline at end of file
+} /* namespace venus */
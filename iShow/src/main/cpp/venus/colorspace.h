@@ -1,6 +1,8 @@
 #ifndef VENUS_COLORSPACE_H_
 #define VENUS_COLORSPACE_H_
 
+#include <opencv2/core/mat.hpp>
+
 namespace venus {
 
 /*
@@ -36,6 +38,49 @@ void cmyk2rgb(const float* cmyk, float* rgb);
  */
 void color2alpha(const float* color, const float* src, float* dst);
 
+/*
+ * Image versions of the conversions above, they give the same results as the per pixel functions, but convert tiles
+ * of pixels 4 at a time with OpenCV universal intrinsics (CV_SIMD128, so SSE2 or NEON), branch-free by computing both
+ * sides of each branch and selecting. Without CV_SIMD128 they fall back to the per pixel functions.
+ *
+ * RGB images are CV_8UC3, CV_8UC4, CV_32FC3 or CV_32FC4 in the channel order of USE_BGRA_LAYOUT, float values in
+ * range [0, 1]. HSV and HSL images are CV_32FC3 or CV_32FC4, with components in channel 0, 1 and 2, and alpha
+ * scaled to [0, 1] in channel 3 if there is one.
+ *
+ * The destination can be the same as the source, so a float image makes a round trip in place:
+ * <code>
+ * rgb2hsl(image, image);
+ * // edit hue, saturation and lightness
+ * hsl2rgb(image, image);
+ * </code>
+ */
+
+/**
+ * @param[in]  rgb  RGB(A) image.
+ * @param[out] hsv  CV_32F image of the same size and channels.
+ */
+void rgb2hsv(const cv::Mat& rgb, cv::Mat& hsv);
+
+/**
+ * @param[in]  hsv    HSV(A) image.
+ * @param[out] rgb    RGB(A) image of the same size and channels.
+ * @param[in]  depth  CV_8U or CV_32F, 8-bit values are clamped and rounded.
+ */
+void hsv2rgb(const cv::Mat& hsv, cv::Mat& rgb, int depth = CV_32F);
+
+/**
+ * @param[in]  rgb  RGB(A) image.
+ * @param[out] hsl  CV_32F image of the same size and channels.
+ */
+void rgb2hsl(const cv::Mat& rgb, cv::Mat& hsl);
+
+/**
+ * @param[in]  hsl    HSL(A) image.
+ * @param[out] rgb    RGB(A) image of the same size and channels.
+ * @param[in]  depth  CV_8U or CV_32F, 8-bit values are clamped and rounded.
+ */
+void hsl2rgb(const cv::Mat& hsl, cv::Mat& rgb, int depth = CV_32F);
+
 
 } /* namespace venus */
 #endif  /* VENUS_COLORSPACE_H_ */
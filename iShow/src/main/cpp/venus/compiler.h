@@ -5,6 +5,7 @@
 #if defined(_WIN32) && _MSC_VER < 1900/* VS2015 */
 #  define noexcept
 #  define constexpr const
+#  define thread_local __declspec(thread)  // POD types only
 #endif
 
 #define NELEM(array) (sizeof(array)/sizeof(array[0]))
@@ -1,3 +1,7 @@
+#include <assert.h>
+#include <limits>
+
+#include <opencv2/core/hal/intrin.hpp>
 #include <opencv2/imgproc.hpp>
 
 #include "venus/compiler.h"
@@ -10,33 +14,50 @@ void TemplateMatchCandidates::setSourceImage(const cv::Mat &image)
 {
 	CV_Assert((image.channels() == 1 || image.channels() == 3) && (image.depth() == CV_8U));
 	_image = image;
+	_integral.release();
 }
 
 void TemplateMatchCandidates::initialize()
 {
-	std::vector<cv::Mat1b> imageChannels;
-	cv::split(_image, imageChannels);
-	const size_t nChannels = imageChannels.size();
-
-	_integrals.resize(nChannels);
-	for(size_t i = 0; i < nChannels; ++i)
-		cv::integral(imageChannels[i], _integrals[i]);
+	// One integral image with all the channels interleaved, so a corner of all channels is a single cache line.
+	const cv::Size size(_image.cols + 1, _image.rows + 1);
+	if(!_integral || _integral->size() != size || _integral->type() != CV_MAKETYPE(CV_32S, _image.channels()))
+	{
+		_integral = cv::makePtr<cv::Mat>();
+		cv::integral(_image, *_integral, CV_32S);
+	}
 	
 	_blocks.clear();
 	computeBlockRects(_templateSize, _partitionSize, _blocks);
 }
 
+#if CV_SIMD128
+/*
+ * Means of a box at 4 adjacent positions x ... x+3 in one channel of an interleaved integral image.
+ * @p top and @p bottom point to the integral rows and the channel, at the box's left edge of position x.
+ */
+static inline cv::v_float32x4 boxMean4(const int* top, const int* bottom, int cn, int width, const cv::v_float32x4& area)
+{
+	const int r = width * cn;
+	const cv::v_int32x4 tl(top[0], top[cn], top[2 * cn], top[3 * cn]);
+	const cv::v_int32x4 tr(top[r], top[r + cn], top[r + 2 * cn], top[r + 3 * cn]);
+	const cv::v_int32x4 bl(bottom[0], bottom[cn], bottom[2 * cn], bottom[3 * cn]);
+	const cv::v_int32x4 br(bottom[r], bottom[r + cn], bottom[r + 2 * cn], bottom[r + 3 * cn]);
+	return cv::v_cvt_f32(br - bl - tr + tl) / area;
+}
+#endif
+
 void TemplateMatchCandidates::findCandidates(const cv::Mat &templ, const cv::Mat &templMask, cv::Mat &candidates,
 		int maxWeakErrors, float maxMeanDifference)
 {
-	CV_Assert(templ.type() == CV_MAKETYPE(CV_8U, static_cast<int>(_integrals.size())) && templ.size() == _templateSize && 
+	const int nChannels = _image.channels();
+	CV_Assert(templ.type() == CV_MAKETYPE(CV_8U, nChannels) && templ.size() == _templateSize && 
 			(templMask.empty() || templMask.size() == _templateSize));
 
 	candidates.create(
 			_image.size().height - templ.size().height + 1, 
 			_image.size().width - templ.size().width + 1,
 			CV_8UC1);
-	candidates.setTo(255);
 
 	std::vector<cv::Rect> blocks = _blocks;
 	removeInvalidBlocks(templMask, blocks);
@@ -45,25 +66,62 @@ void TemplateMatchCandidates::findCandidates(const cv::Mat &templ, const cv::Mat
 	cv::Scalar templMean;
 	weakClassifiersForTemplate(templ, templMask, blocks, referenceClass, templMean);
 	
-	// For each channel we loop over all possible template positions and compare with classifiers.
-	for(size_t i = 0; i < _integrals.size(); ++i) 
-	{
-		cv::Mat1i &integral = _integrals[i];
-		const int *referenceClassRow = referenceClass.ptr<int>(static_cast<int>(i));
+	const cv::Mat &integral = *_integral;
+	const cv::Size templSize = templ.size();
 
-		// For all template positions ty, tx (top-left template position)
-		for(int ty = 0; ty < candidates.rows; ++ty) 
+	// For all template positions ty, tx (top-left template position), a row at a time.
+	#pragma omp parallel for
+	for(int ty = 0; ty < candidates.rows; ++ty) 
+	{
+		uchar *outputRow = candidates.ptr<uchar>(ty);
+		int tx = 0;
+#if CV_SIMD128
+		using namespace cv;
+		const v_float32x4 templArea = v_setall_f32(static_cast<float>(templSize.area()));
+		const v_int32x4 maxErrors = v_setall_s32(maxWeakErrors);
+		const v_float32x4 maxMeanDiff = v_setall_f32(maxMeanDifference);
+		const int *templTop = integral.ptr<int>(ty);
+		const int *templBottom = integral.ptr<int>(ty + templSize.height);
+		for(; tx <= candidates.cols - 4; tx += 4)
 		{
-			uchar *outputRow = candidates.ptr<uchar>(ty);
-			for(int tx = 0; tx < candidates.cols; ++tx) 
+			// All channels must pass, namely a candidate is rejected by any channel.
+			v_int32x4 alive = v_setall_s32(-1);
+			for(int i = 0; i < nChannels; ++i)
 			{
-				if(!outputRow[tx])
-					continue;
-				
-				outputRow[tx] = compareWeakClassifiers(integral, tx, ty, templ.size(), blocks, referenceClassRow, 
-						(float)templMean[static_cast<int>(i)], maxMeanDifference, maxWeakErrors);
+				const int offset = tx * nChannels + i;
+				const v_float32x4 posMean = boxMean4(templTop + offset, templBottom + offset, nChannels, templSize.width, templArea);
+				const v_float32x4 diff = posMean - v_setall_f32(static_cast<float>(templMean[i]));
+				alive &= v_reinterpret_as_s32(v_max(diff, v_setzero_f32() - diff) <= maxMeanDiff);
+
+				// Evaluate means of sub-blocks
+				const int *referenceClassRow = referenceClass.ptr<int>(i);
+				v_int32x4 errors = v_setzero_s32();
+				for(size_t r = 0; r < blocks.size(); ++r)
+				{
+					const cv::Rect &b = blocks[r];
+					const int *top = integral.ptr<int>(ty + b.y) + (tx + b.x) * nChannels + i;
+					const int *bottom = integral.ptr<int>(ty + b.y + b.height) + (tx + b.x) * nChannels + i;
+					const v_float32x4 blockMean = boxMean4(top, bottom, nChannels, b.width, v_setall_f32(static_cast<float>(b.width * b.height)));
+
+					// -1 where classifier is 1, 0 where -1, and a mismatch subtracts -1.
+					const v_int32x4 c = v_reinterpret_as_s32(blockMean > posMean);
+					const v_int32x4 reference = v_setall_s32(referenceClassRow[r] > 0 ? -1 : 0);
+					errors -= c ^ reference;
+				}
+				alive &= ~(errors > maxErrors);
+
+				if(!v_check_any(alive))
+					break;
 			}
+
+			int CV_DECL_ALIGNED(16) lanes[4];
+			v_store_aligned(lanes, alive);
+			for(int k = 0; k < 4; ++k)
+				outputRow[tx + k] = lanes[k] ? 255 : 0;
 		}
+#endif
+		for(; tx < candidates.cols; ++tx)
+			outputRow[tx] = compareWeakClassifiers(tx, ty, templSize, blocks, referenceClass, templMean, maxMeanDifference, maxWeakErrors);
 	}
 }
 
@@ -86,36 +144,42 @@ void TemplateMatchCandidates::weakClassifiersForTemplate(const cv::Mat &templ, c
 	}
 }
 
-unsigned char TemplateMatchCandidates::compareWeakClassifiers(const cv::Mat1i &i, int x, int y, const cv::Size &templSize, 
-		const std::vector<cv::Rect> &blocks, const int *compareTo, float templateMean, float maxMeanDiff, int maxWeakErrors)
+unsigned char TemplateMatchCandidates::compareWeakClassifiers(int x, int y, const cv::Size &templSize, 
+		const std::vector<cv::Rect> &blocks, const cv::Mat1i &compareTo, const cv::Scalar &templateMean, float maxMeanDiff, int maxWeakErrors) const
 {
-	const int *topRow = i.ptr<int>(y);
-	const int *bottomRow = i.ptr<int>(y + templSize.height); // +1 required for integrals
-	
-	// Mean of image under given template position
-	const float posMean = (bottomRow[x + templSize.width] - bottomRow[x] - topRow[x + templSize.width] + topRow[x]) / static_cast<float>(templSize.area());
-
-	if(std::abs(posMean - templateMean) > maxMeanDiff)
-		return 0;
+	const cv::Mat &integral = *_integral;
+	const int nChannels = integral.channels();
 
-	// Evaluate means of sub-blocks
-	int sumErrors = 0;
-	for(size_t r = 0; r < blocks.size(); ++r)
+	// Mean of all channels at a box, which share the cache lines of the corners.
+	auto boxMean = [&](int ox, int oy, int width, int height, int i) -> float
 	{
-		const cv::Rect &b = blocks[r];
+		const int *topRow = integral.ptr<int>(oy) + i;
+		const int *bottomRow = integral.ptr<int>(oy + height) + i; // +1 required for integrals
+		const int left = ox * nChannels, right = (ox + width) * nChannels;
+		return (bottomRow[right] - bottomRow[left] - topRow[right] + topRow[left]) / static_cast<float>(width * height);
+	};
 
-		int ox = x + b.x;
-		int oy = y + b.y;
+	for(int i = 0; i < nChannels; ++i)
+	{
+		// Mean of image under given template position
+		const float posMean = boxMean(x, y, templSize.width, templSize.height, i);
 
-		const int *topRow = i.ptr<int>(oy);
-		const int *bottomRow = i.ptr<int>(oy + b.height);
+		if(std::abs(posMean - static_cast<float>(templateMean[i])) > maxMeanDiff)
+			return 0;
 
-		const float blockMean = (bottomRow[ox + b.width] - bottomRow[ox] - topRow[ox + b.width] + topRow[ox]) / static_cast<float>(b.width * b.height);
-		const int c = blockMean > posMean ? 1 : -1;
-		sumErrors += (c != compareTo[r]) ? 1 : 0;
+		// Evaluate means of sub-blocks
+		const int *compareToRow = compareTo.ptr<int>(i);
+		int sumErrors = 0;
+		for(size_t r = 0; r < blocks.size(); ++r)
+		{
+			const cv::Rect &b = blocks[r];
+			const float blockMean = boxMean(x + b.x, y + b.y, b.width, b.height, i);
+			const int c = blockMean > posMean ? 1 : -1;
+			sumErrors += (c != compareToRow[r]) ? 1 : 0;
 
-		if(sumErrors > maxWeakErrors)
-			return 0;
+			if(sumErrors > maxWeakErrors)
+				return 0;
+		}
 	}
 
 	return 255;
@@ -360,109 +424,167 @@ void Inpainter::initialize()
 	_endX = _image.cols - _halfMatchSize - 1;
 	_endY = _image.rows - _halfMatchSize - 1;
 
+	// Build the fill front once, later steps only update it around the filled patches.
+	_remaining = cv::countNonZero(_targetRegion);
+	_fillFront.reset(_image.rows * _image.cols);
+	updateFillFront(cv::Rect(0, 0, _image.cols, _image.rows));
+
+	if(_input.method == Method::PATCH_MATCH)
+	{
+		initializeNearestNeighborField();
+		return;
+	}
+	_nnf.release();  // propagatePatch() writes a field left over from a previous run
+
 	// Setup template match performance improvement
 	_tmc.setSourceImage(_image);
+	_tmc.setIntegral(_input.integral);
 	_tmc.setTemplateSize(cv::Size(_halfMatchSize * 2 + 1, _halfMatchSize * 2 + 1));
 	_tmc.setPartitionSize(cv::Size(3,3));
 	_tmc.initialize();
 }
 
+void Inpainter::initializeNearestNeighborField()
+{
+	_nnf.create(_image.size());
+	_nnf.setTo(cv::Scalar::all(-1));
+
+	// Stop when the half size image can't hold a few patches.
+	const cv::Size coarseSize((_image.cols + 1) / 2, (_image.rows + 1) / 2);
+	const int minSize = 8 * (_halfMatchSize * 2 + 1);
+	if(coarseSize.width < minSize || coarseSize.height < minSize)
+		return;
+
+	// A coarse pixel is to be inpainted if any of its pixels is, and is a source only if all of its pixels are.
+	cv::Mat coarseImage, coarseTarget, coarseSource;
+	cv::pyrDown(_input.image, coarseImage, coarseSize);
+	cv::resize(_input.targetMask, coarseTarget, coarseSize, 0, 0, cv::INTER_AREA);
+	coarseTarget = (coarseTarget > 0);
+	if(!_input.sourceMask.empty())
+	{
+		cv::resize(_input.sourceMask, coarseSource, coarseSize, 0, 0, cv::INTER_AREA);
+		coarseSource = (coarseSource == 255);
+	}
+
+	Inpainter coarse;
+	coarse.setSourceImage(coarseImage);
+	coarse.setSourceMask(coarseSource);
+	coarse.setTargetMask(coarseTarget);
+	coarse.setPatchSize(_input.patchSize);
+	coarse.setMethod(Method::PATCH_MATCH);
+	coarse.initialize();
+	while(coarse.hasMoreSteps())
+		coarse.step();
+
+	// Upsample the coarse field, each is only a guess, and will be validated when used.
+	for(int y = 0; y < _nnf.rows; ++y)
+	{
+		const uchar* tRow = _targetRegion.ptr(y);
+		const cv::Vec2i* coarseRow = coarse._nnf.ptr<cv::Vec2i>(y / 2);
+		cv::Vec2i* nnfRow = _nnf.ptr<cv::Vec2i>(y);
+		for(int x = 0; x < _nnf.cols; ++x)
+		{
+			const cv::Vec2i& m = coarseRow[x / 2];
+			if(tRow[x] > 0 && m[0] >= 0)
+				nnfRow[x] = cv::Vec2i(m[0] * 2 + (x & 1), m[1] * 2 + (y & 1));
+		}
+	}
+}
+
 bool Inpainter::hasMoreSteps() const
 {
-	return cv::countNonZero(_targetRegion) > 0;
+	return _remaining > 0;
 }
 
 void Inpainter::step()
-{	
-	// We also need an updated knowledge of gradients in the border region
-	updateFillFront();
-	
-	// Next, we need to select the best target patch on the boundary to be inpainted.
+{
+	if(_fillFront.empty())
+	{
+		// What's left can't be reached from inside the valid image region, discard it.
+		_targetRegion.setTo(0);
+		_remaining = 0;
+		return;
+	}
+
+	// Select the best target patch on the boundary to be inpainted.
 	cv::Point targetPatchLocation = findTargetPatchLocation();
 
 	// Determine the best matching source patch from which to inpaint.
-	cv::Point sourcePatchLocation = findSourcePatchLocation(targetPatchLocation, true);
-	if(sourcePatchLocation.x == -1)
-		sourcePatchLocation = findSourcePatchLocation(targetPatchLocation, false);
+	cv::Point sourcePatchLocation;
+	if(_input.method == Method::PATCH_MATCH)
+	{
+		sourcePatchLocation = findSourcePatchLocationPatchMatch(targetPatchLocation);
+		if(sourcePatchLocation.x == -1)  // hardly happens, unless source region is tiny
+			sourcePatchLocation = findSourcePatchLocation(targetPatchLocation, false);
+	}
+	else
+	{
+		sourcePatchLocation = findSourcePatchLocation(targetPatchLocation, true);
+		if(sourcePatchLocation.x == -1)
+			sourcePatchLocation = findSourcePatchLocation(targetPatchLocation, false);
+	}
 
 	// Copy values
 	propagatePatch(targetPatchLocation, sourcePatchLocation);
+
+	// Target region changed within the patch, which moves fill front and its gradients one pixel further, and
+	// confidence changed within the patch, which affects priorities of the pixels one patch further.
+	const int reach = 2 * _halfPatchSize + 1;
+	updateFillFront(cv::Rect(targetPatchLocation.x - reach, targetPatchLocation.y - reach, 2 * reach + 1, 2 * reach + 1));
 }
 
-void Inpainter::updateFillFront()
+void Inpainter::updateFillFront(const cv::Rect& area)
 {
-	// 2nd order derivative used to find border.
-	cv::Laplacian(_targetRegion, _borderRegion, CV_8U, 3, 1, 0, cv::BORDER_REPLICATE);
-
-	// Update confidence values along fill front.
-	for(int y = _startY; y < _endY; ++y)
+	const cv::Rect rect = area & cv::Rect(_startX, _startY, _endX - _startX, _endY - _startY);
+	for(int y = rect.y; y < rect.y + rect.height; ++y)
 	{
-		const uchar *bRow = _borderRegion.ptr(y);
-		for(int x = _startX; x < _endX; ++x)
+		const uchar *tTop = _targetRegion.ptr(y - 1);
+		const uchar *tRow = _targetRegion.ptr(y);
+		const uchar *tBottom = _targetRegion.ptr(y + 1);
+		for(int x = rect.x; x < rect.x + rect.width; ++x)
 		{
-			if(bRow[x] > 0)
-			{
-				// Update confidence for border item
-				cv::Point p(x, y);
-				_confidence(p) = confidenceForPatchLocation(p);
-			}
+			// Same as cv::Laplacian(_targetRegion, border, CV_8U, 3) > 0 used to be. Its 3x3 kernel is
+			// [2 0 2; 0 -8 0; 2 0 2], so it's a known pixel with any diagonal neighbor to be inpainted.
+			const bool border = tRow[x] == 0 && (tTop[x - 1] | tTop[x + 1] | tBottom[x - 1] | tBottom[x + 1]) != 0;
+
+			const int index = y * _image.cols + x;
+			if(border)
+				_fillFront.set(index, priorityForPatchLocation(cv::Point(x, y)));
+			else
+				_fillFront.erase(index);
 		}
 	}
 }
 
-cv::Point Inpainter::findTargetPatchLocation()
+float Inpainter::priorityForPatchLocation(const cv::Point& point) const
 {
-	// Sweep over all pixels in the border region and priorize them based on 
-	// a confidence term (i.e how many pixels are already known) and a data term that prefers
-	// border pixels on strong edges running through them.
+	// Prioritize a fill front pixel based on a confidence term (i.e how many pixels are already known) and
+	// a data term that prefers border pixels on strong edges running through them.
 
-	float maxPriority = 0;
-	cv::Point bestLocation(0, 0);
+	// Data term, the normal of fill front is the gradient of target region, same as 3x3 cv::Sobel().
+	const uchar *tTop = _targetRegion.ptr(point.y - 1) + point.x;
+	const uchar *tRow = _targetRegion.ptr(point.y) + point.x;
+	const uchar *tBottom = _targetRegion.ptr(point.y + 1) + point.x;
+	const int gx = (tTop[1] + 2 * tRow[1] + tBottom[1]) - (tTop[-1] + 2 * tRow[-1] + tBottom[-1]);
+	const int gy = (tBottom[-1] + 2 * tBottom[0] + tBottom[1]) - (tTop[-1] + 2 * tTop[0] + tTop[1]);
 
-	_borderGradX.create(_targetRegion.size());
-	_borderGradY.create(_targetRegion.size());
-	cv::Sobel(_targetRegion, _borderGradX, CV_32F, 1, 0, 3, 1, 0, cv::BORDER_REPLICATE);
-	cv::Sobel(_targetRegion, _borderGradY, CV_32F, 0, 1, 3, 1, 0, cv::BORDER_REPLICATE);
+	cv::Vec2f grad(static_cast<float>(gx), static_cast<float>(gy));
+	float dot = grad.dot(grad);
+	if(dot != 0)
+		grad /= std::sqrt(dot);
 
-	for(int y = _startY; y < _endY; ++y)
-	{
-		const uchar *bRow  = _borderRegion.ptr(y);
-		const float *gxRow = _borderGradX.ptr<float>(y);
-		const float *gyRow = _borderGradY.ptr<float>(y);
-		const float *ixRow = _isophoteX.ptr<float>(y);
-		const float *iyRow = _isophoteY.ptr<float>(y);
-		const float *cRow  = _confidence.ptr<float>(y);
-
-		for(int x = _startX; x < _endX; ++x)
-		{
-			if(bRow[x] > 0)
-			{
-				// Data term
-				cv::Vec2f grad(gxRow[x], gyRow[x]);
-				float dot = grad.dot(grad);
-
-				if(dot == 0)
-					grad *= 0;
-				else
-					grad /= std::sqrt(dot);
-		
-				const float d = std::abs(grad[0] * ixRow[x] + grad[1] * iyRow[x]) + 0.0001F;
+	const float d = std::abs(grad[0] * _isophoteX(point) + grad[1] * _isophoteY(point)) + 0.0001F;
 
-				// Confidence term
-				const float c = cRow[x];
+	// Confidence term
+	const float c = confidenceForPatchLocation(point);
 
-				// Priority of patch
-				const float prio = c * d;
-				if(prio > maxPriority)
-				{
-					maxPriority = prio;
-					bestLocation = cv::Point(x,y);
-				}
-			}
-		}
-	}
+	return c * d;
+}
 
-	return bestLocation;
+cv::Point Inpainter::findTargetPatchLocation() const
+{
+	const int index = _fillFront.top();
+	return cv::Point(index % _image.cols, index / _image.cols);
 }
 
 float Inpainter::confidenceForPatchLocation(const cv::Point& point) const
@@ -510,10 +632,138 @@ cv::Point Inpainter::findSourcePatchLocation(const cv::Point& targetPatchLocatio
 	return bestLocation;
 }
 
+/*
+ * Sum of absolute differences of two 8-bit patches over the bytes where @p mask is 0xFF, namely the same as
+ * cv::norm(a, b, cv::NORM_L1, mask) with mask expanded to every channel. It returns as soon as the sum goes
+ * beyond @p bound, since the candidate has lost already.
+ */
+static int maskedPatchDistance(const uchar* a, const uchar* b, size_t step, const uchar* mask, int rows, int rowBytes, int bound)
+{
+	// each 16 bytes add at most 2*255 to a 16-bit lane
+	assert(rowBytes / 16 * 2 * 255 <= std::numeric_limits<ushort>::max());
+
+	int sum = 0;
+	for(int r = 0; r < rows; ++r, a += step, b += step, mask += rowBytes)
+	{
+		int c = 0;
+#if CV_SIMD128
+		cv::v_uint16x8 rowSum = cv::v_setzero_u16();
+		for(; c <= rowBytes - 16; c += 16)
+		{
+			cv::v_uint8x16 diff = cv::v_absdiff(cv::v_load(a + c), cv::v_load(b + c)) & cv::v_load(mask + c);
+			cv::v_uint16x8 lo, hi;
+			cv::v_expand(diff, lo, hi);
+			rowSum += lo + hi;
+		}
+		cv::v_uint32x4 lo, hi;
+		cv::v_expand(rowSum, lo, hi);
+		sum += static_cast<int>(cv::v_reduce_sum(lo + hi));
+#endif
+		for(; c < rowBytes; ++c)
+			sum += mask[c] & std::abs(a[c] - b[c]);
+
+		if(sum > bound)
+			break;
+	}
+
+	return sum;
+}
+
+bool Inpainter::isSourcePatchLocation(const cv::Point& point) const
+{
+	return _startX <= point.x && point.x < _endX && _startY <= point.y && point.y < _endY &&
+			_sourceRegion(point) > 0;
+}
+
+cv::Point Inpainter::findSourcePatchLocationPatchMatch(const cv::Point& targetPatchLocation)
+{
+	const int size = _halfMatchSize * 2 + 1;
+	const int rowBytes = size * 3;
+	const cv::Point topLeft(_halfMatchSize, _halfMatchSize);
+
+	// known pixels of the target patch, expanded to each channel
+	_matchMask.create(size, rowBytes);
+	for(int y = 0; y < size; ++y)
+	{
+		const uchar* tRow = _targetRegion.ptr(targetPatchLocation.y - _halfMatchSize + y) + (targetPatchLocation.x - _halfMatchSize);
+		uchar* mRow = _matchMask.ptr(y);
+		for(int x = 0; x < size; ++x)
+			mRow[3 * x] = mRow[3 * x + 1] = mRow[3 * x + 2] = (tRow[x] == 0) ? 255 : 0;
+	}
+
+	const cv::Point t = targetPatchLocation - topLeft;
+	const uchar* targetData = _image.ptr(t.y) + t.x * 3;
+
+	cv::Point bestLocation(-1, -1);
+	int bestError = std::numeric_limits<int>::max();
+	auto tryLocation = [&](const cv::Point& p)
+	{
+		if(p == bestLocation || !isSourcePatchLocation(p))
+			return;
+
+		const cv::Point s = p - topLeft;
+		int error = maskedPatchDistance(targetData, _image.ptr(s.y) + s.x * 3, _image.step, _matchMask.data, size, rowBytes, bestError);
+		if(error < bestError)
+		{
+			bestError = error;
+			bestLocation = p;
+		}
+	};
+
+	// The persistent field, seeded from coarse level or by filled patch.
+	const cv::Vec2i& guess = _nnf(targetPatchLocation);
+	tryLocation(cv::Point(guess[0], guess[1]));
+
+	// Propagation, neighbors that know their match suggest the same offset. Patch size apart ones are tested too,
+	// since the adjacent pixels are mostly unknown along the fill front.
+	static const cv::Point directions[] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {1, -1}, {-1, 1}, {1, 1} };
+	const int distances[] = { 1, _halfPatchSize + 1 };
+	for(int distance : distances)
+	for(const cv::Point& direction : directions)
+	{
+		const cv::Point q = targetPatchLocation + direction * distance;
+		if(q.x < 0 || q.x >= _nnf.cols || q.y < 0 || q.y >= _nnf.rows)
+			continue;
+
+		const cv::Vec2i& m = _nnf(q);
+		if(m[0] >= 0)
+			tryLocation(cv::Point(m[0], m[1]) + (targetPatchLocation - q));
+	}
+
+	// A few random guesses to escape, more if nothing valid is found yet.
+	constexpr int RANDOM_GUESSES = 4, MAX_RANDOM_GUESSES = 64;
+	for(int i = 0; i < MAX_RANDOM_GUESSES && (i < RANDOM_GUESSES || bestLocation.x < 0); ++i)
+		tryLocation(cv::Point(_rng.uniform(_startX, _endX), _rng.uniform(_startY, _endY)));
+
+	if(bestLocation.x < 0)
+		return bestLocation;
+
+	// Random search around the best one, with exponentially decreasing radius.
+	constexpr int SEARCH_ROUNDS = 2;
+	for(int round = 0; round < SEARCH_ROUNDS; ++round)
+	for(int radius = std::max(_endX - _startX, _endY - _startY); radius >= 1; radius /= 2)
+	{
+		const cv::Point center = bestLocation;
+		tryLocation(center + cv::Point(_rng.uniform(-radius, radius + 1), _rng.uniform(-radius, radius + 1)));
+	}
+
+	_nnf(targetPatchLocation) = cv::Vec2i(bestLocation.x, bestLocation.y);
+	return bestLocation;
+}
+
 void Inpainter::propagatePatch(const cv::Point& target, const cv::Point& source)
 {
 	cv::Mat1b copyMask = centeredPatch<PATCHFLAGS>(_targetRegion, target.y, target.x, _halfPatchSize);
 
+	// Filled pixels take the offset of the patch, so that their neighbors can propagate it.
+	if(!_nnf.empty())
+	{
+		for(int y = -_halfPatchSize; y <= _halfPatchSize; ++y)
+		for(int x = -_halfPatchSize; x <= _halfPatchSize; ++x)
+			if(_targetRegion(target.y + y, target.x + x) > 0)
+				_nnf(target.y + y, target.x + x) = cv::Vec2i(source.x + x, source.y + y);
+	}
+
 	centeredPatch<PATCHFLAGS>(_image, source.y, source.x, _halfPatchSize).copyTo(
 	centeredPatch<PATCHFLAGS>(_image, target.y, target.x, _halfPatchSize), copyMask);
 
@@ -523,10 +773,93 @@ void Inpainter::propagatePatch(const cv::Point& target, const cv::Point& source)
 	centeredPatch<PATCHFLAGS>(_isophoteY, source.y, source.x, _halfPatchSize).copyTo(
 	centeredPatch<PATCHFLAGS>(_isophoteY, target.y, target.x, _halfPatchSize), copyMask);
 
-	float cPatch = _confidence.at<float>(target);
+	float cPatch = confidenceForPatchLocation(target);
 	centeredPatch<PATCHFLAGS>(_confidence, target.y, target.x, _halfPatchSize).setTo(cPatch, copyMask);
 	
+	_remaining -= cv::countNonZero(copyMask);
 	copyMask.setTo(0);
 }
 
+void Inpainter::FillFront::reset(int size)
+{
+	_heap.clear();
+	_position.assign(size, -1);
+}
+
+void Inpainter::FillFront::swap(int i, int j)
+{
+	std::swap(_heap[i], _heap[j]);
+	_position[_heap[i].index] = i;
+	_position[_heap[j].index] = j;
+}
+
+void Inpainter::FillFront::siftUp(int i)
+{
+	while(i > 0)
+	{
+		const int parent = (i - 1) / 2;
+		if(!higher(_heap[i], _heap[parent]))
+			break;
+		swap(i, parent);
+		i = parent;
+	}
+}
+
+void Inpainter::FillFront::siftDown(int i)
+{
+	const int size = static_cast<int>(_heap.size());
+	for(;;)
+	{
+		int best = i;
+		const int left = 2 * i + 1, right = left + 1;
+		if(left < size && higher(_heap[left], _heap[best]))
+			best = left;
+		if(right < size && higher(_heap[right], _heap[best]))
+			best = right;
+		if(best == i)
+			break;
+		swap(i, best);
+		i = best;
+	}
+}
+
+void Inpainter::FillFront::set(int index, float priority)
+{
+	int i = _position[index];
+	if(i < 0)
+	{
+		i = static_cast<int>(_heap.size());
+		_heap.push_back(Node{ priority, index });
+		_position[index] = i;
+		siftUp(i);
+		return;
+	}
+
+	const float old = _heap[i].priority;
+	_heap[i].priority = priority;
+	if(priority > old)
+		siftUp(i);
+	else
+		siftDown(i);
+}
+
+void Inpainter::FillFront::erase(int index)
+{
+	const int i = _position[index];
+	if(i < 0)
+		return;
+
+	const int last = static_cast<int>(_heap.size()) - 1;
+	if(i != last)
+		swap(i, last);
+	_heap.pop_back();
+	_position[index] = -1;
+
+	if(i != last)
+	{
+		siftUp(i);
+		siftDown(i);
+	}
+}
+
 } /* namespace venus */
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef VENUS_INPAINT_H_
 #define VENUS_INPAINT_H_
 
+#include <vector>
+
 #include <opencv2/core.hpp>
 
 namespace venus {
@@ -37,7 +39,7 @@ class TemplateMatchCandidates
 {
 private:
 	cv::Mat _image;
-    std::vector<cv::Mat1i> _integrals;
+    cv::Ptr<cv::Mat> _integral;  ///< CV_32SC1/CV_32SC3, all channels interleaved
     std::vector<cv::Rect>  _blocks;
     cv::Size _templateSize;
     cv::Size _partitionSize;
@@ -53,12 +55,21 @@ private:
     /** Calculate the weak classifiers for the template, taking the mask into account. */
     void weakClassifiersForTemplate(const cv::Mat &templ, const cv::Mat &templMask, const std::vector<cv::Rect> &rects, cv::Mat1i &classifiers, cv::Scalar &mean);
 
-    /** Compare the template classifiers to the classifiers generated from the given template position. */
-    unsigned char compareWeakClassifiers(const cv::Mat1i &i, int x, int y, const cv::Size &templSize, const std::vector<cv::Rect> &blocks, const int *compareTo, float templateMean, float maxMeanDiff, int maxWeakErrors);
+    /** Compare the template classifiers of all channels to the classifiers generated from the given template position. */
+    unsigned char compareWeakClassifiers(int x, int y, const cv::Size &templSize, const std::vector<cv::Rect> &blocks, const cv::Mat1i &compareTo, const cv::Scalar &templateMean, float maxMeanDiff, int maxWeakErrors) const;
 
 public:
-	/** Set the source image. */
+	/** Set the source image, which drops the integral image of previous one. */
 	void setSourceImage(const cv::Mat &image);
+
+	/**
+	 * Reuse the integral image of the same source image, which was computed by a previous initialize(), so that
+	 * repeated runs on an image don't compute it again. Call it after setSourceImage().
+	 */
+	void setIntegral(const cv::Ptr<cv::Mat> &integral) { _integral = integral; }
+
+	/** Integral image of the source image, available after initialize(). */
+	const cv::Ptr<cv::Mat>& integral() const { return _integral; }
         
 	/** Set the template size. */
 	inline void setTemplateSize(const cv::Size &templateSize) { _templateSize = templateSize; }
@@ -70,7 +81,7 @@ public:
 	void initialize();
 
 	/** 
-	 * Find candidates.
+	 * Find candidates. Rows are scanned in parallel, and adjacent positions are classified together with SIMD.
 	 * 
 	 * @param templ Template image.
 	 * @param templMask Optional template mask.
@@ -98,9 +109,28 @@ public:
 	Please note edge cases (i.e regions on the image border) are crudely handled by simply 
 	discarding them.
 
+	Two ways are provided to search the best matching source patch, see Inpainter::Method.
 */
 class Inpainter
 {
+public:
+	enum class Method
+	{
+		/**
+		 * Test every source position that passes TemplateMatchCandidates, it's the slowest.
+		 */
+		EXEMPLAR,
+
+		/**
+		 * Keep a nearest-neighbor field (NNF) that maps each target pixel to its source patch, and update it with
+		 * randomized propagation and search from "PatchMatch: A Randomized Correspondence Algorithm for Structural
+		 * Image Editing", C. Barnes et. al. A filled patch hands its offsets down to the pixels it fills, which
+		 * neighbors then propagate, and the field is seeded by inpainting a half size image first, recursively.
+		 * Only a few dozens of patches are compared per step, regardless of image size.
+		 */
+		PATCH_MATCH,
+	};
+
 private:
 	struct UserSpecified
 	{
@@ -108,33 +138,89 @@ private:
         cv::Mat sourceMask;
         cv::Mat targetMask;
         int patchSize;
+        Method method;
+        cv::Ptr<cv::Mat> integral;
 
         UserSpecified():
-			patchSize(9)
+			patchSize(9),
+			method(Method::EXEMPLAR)
 		{
 		}
     };
 
+	/**
+	 * Indexed max-heap of the fill front pixels by priority, so that a priority can be changed or removed in place.
+	 * Pixels are identified by index y * cols + x, ties go to the smaller index, namely the first in raster order.
+	 */
+	class FillFront
+	{
+	private:
+		struct Node
+		{
+			float priority;
+			int index;
+		};
+
+		std::vector<Node> _heap;
+		std::vector<int> _position;  ///< heap position of each pixel, -1 if it's not on the fill front
+
+		static bool higher(const Node& a, const Node& b) { return a.priority > b.priority || (a.priority == b.priority && a.index < b.index); }
+		void swap(int i, int j);
+		void siftUp(int i);
+		void siftDown(int i);
+
+	public:
+		void reset(int size);
+		bool empty() const { return _heap.empty(); }
+		int top() const { return _heap.front().index; }
+
+		/** Insert @p index, or update its priority. */
+		void set(int index, float priority);
+		void erase(int index);
+	};
+
     UserSpecified _input;
 	
     TemplateMatchCandidates _tmc;
 	cv::Mat _image, _candidates;
-	cv::Mat1b _targetRegion, _borderRegion, _sourceRegion;
-	cv::Mat1f _isophoteX, _isophoteY, _confidence, _borderGradX, _borderGradY;
+	cv::Mat1b _targetRegion, _sourceRegion;
+	cv::Mat1f _isophoteX, _isophoteY, _confidence;
 	int _halfPatchSize, _halfMatchSize;
 	int _startX, _startY, _endX, _endY;
 
+	FillFront _fillFront;
+	int _remaining;  ///< pixels left to inpaint
+
+	cv::Mat2i _nnf;        ///< source patch center of each target pixel, (-1, -1) if unknown, Method::PATCH_MATCH only
+	cv::Mat1b _matchMask;  ///< known pixels of the target patch, one byte per channel
+	cv::RNG _rng;
+
 private:
 
-	/** Updates the fill-front which is the border between filled and unfilled regions. */
-	void updateFillFront();
+	/**
+	 * Updates the fill-front which is the border between filled and unfilled regions, within @p area only.
+	 * Filling a patch only changes the fill front and priorities around it, so each step costs by patch size.
+	 */
+	void updateFillFront(const cv::Rect& area);
+
+	/** Priority of a fill front pixel, which is the product of confidence term and data term. */
+	float priorityForPatchLocation(const cv::Point& point) const;
 
 	/** Find patch on fill front with highest priortiy. This will be the patch to be inpainted in this step. */
-	cv::Point findTargetPatchLocation();
+	cv::Point findTargetPatchLocation() const;
 
 	/** For a given patch to inpaint, search for the best matching source patch to use for inpainting. */
 	cv::Point findSourcePatchLocation(const cv::Point& targetPatchLocation, bool useCandidateFilter);
 
+	/** Search the best matching source patch with PatchMatch, return (-1, -1) if there's no valid source. */
+	cv::Point findSourcePatchLocationPatchMatch(const cv::Point& targetPatchLocation);
+
+	/** Seed nearest-neighbor field by inpainting a half size image. */
+	void initializeNearestNeighborField();
+
+	/** True if the patch centered at @p point lies in source region entirely. */
+	bool isSourcePatchLocation(const cv::Point& point) const;
+
 	/** Calculate the confidence for the given patch location. */
 	float confidenceForPatchLocation(const cv::Point& point) const;
 	
@@ -146,8 +232,12 @@ public:
 	/** Empty constructor */
 	Inpainter() = default;
 	
-	/** Set the image to be inpainted. */
-	inline void setSourceImage(const cv::Mat &bgrImage) { _input.image = bgrImage; }
+	/** Set the image to be inpainted, which drops the candidate integral image of previous one. */
+	inline void setSourceImage(const cv::Mat &bgrImage)
+	{
+		_input.image = bgrImage;
+		_input.integral.release();
+	}
 
     /** Set the mask that describes the region inpainting can copy from. */
 	inline void setSourceMask(const cv::Mat &mask) { _input.sourceMask = mask; }
@@ -158,6 +248,15 @@ public:
 	/** Set the patch size. */
 	inline void setPatchSize(int size) { _input.patchSize = size; }
 
+	/** Set the method to search source patches, Method::EXEMPLAR by default. */
+	inline void setMethod(Method method) { _input.method = method; }
+
+	/**
+	 * Reuse the integral image for TemplateMatchCandidates from a previous run on the same source image,
+	 * see candidateIntegral(). Only Method::EXEMPLAR uses it. Call it after setSourceImage().
+	 */
+	inline void setCandidateIntegral(const cv::Ptr<cv::Mat> &integral) { _input.integral = integral; }
+
 	/** Initialize inpainting. */
 	void initialize();
 
@@ -172,6 +271,9 @@ public:
 
     /** Access the current state of the target region. */
 	const cv::Mat& targetRegion() const { return _targetRegion; }
+
+	/** Access the integral image of the source image, after initialize() with Method::EXEMPLAR. */
+	const cv::Ptr<cv::Mat>& candidateIntegral() const { return _tmc.integral(); }
 };
 
 } /* namespace venus */